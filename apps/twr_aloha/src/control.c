@@ -245,6 +245,9 @@ uwb_ev_cb(struct dpl_event *ev)
 #endif
 #if MYNEWT_VAL(TWR_DS_EXT_ENABLED)
         mode_v[mode_i++] = UWB_DATA_CODE_DS_TWR_EXT;
+#endif
+#if MYNEWT_VAL(TWR_ADS_ENABLED)
+        mode_v[mode_i++] = UWB_DATA_CODE_ADS_TWR;
 #endif
         if (++last_used_mode >= mode_i) last_used_mode=0;
         mode = mode_v[last_used_mode];
@@ -55,6 +55,7 @@ typedef enum uwb_extension_id {
     UWBEXT_NMGR_UWB,                         //!< UWB transport layer
     UWBEXT_NMGR_CMD,                         //!< UWB command support
     UWBEXT_CIR,                              //!< Channel impulse response
+    UWBEXT_RNG_ADS,                          //!< Asymmetric double sided ranging, three frames
     UWBEXT_OT = 0x30,                        //!< Openthread
     UWBEXT_RTDOA = 0x40,                     //!< RTDoA
     UWBEXT_RTDOA_BH,                         //!< RTDoA Backhaul
@@ -1058,6 +1059,7 @@ struct uwb_dev {
     uint8_t *txbuf;                             //!< Local transmit buffer, needs aligned allocation
     uint16_t rxbuf_size;                        //!< Size of local receive buffer
     uint16_t txbuf_size;                        //!< Size of local transmit buffer
+    uint16_t txbuf_seq;                         //!< Bumped on tx buffer and frame control writes, mac config and wakeup through the uwb api
 
     struct uwb_dev_status status;               //!< Device status
     struct uwb_dev_config config;               //!< Device configuration
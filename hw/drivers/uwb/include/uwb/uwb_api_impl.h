@@ -30,6 +30,8 @@
 UWB_API_IMPL_PREFIX struct uwb_dev_status
 uwb_mac_config(struct uwb_dev * dev, struct uwb_dev_config * config)
 {
+    /* Drivers rewrite the frame control here */
+    dev->txbuf_seq++;
     return (dev->uw_funcs->uf_mac_config(dev, config));
 }
 EXPORT_SYMBOL(uwb_mac_config);
@@ -143,6 +145,7 @@ EXPORT_SYMBOL(uwb_enter_sleep_after_rx);
 UWB_API_IMPL_PREFIX struct uwb_dev_status
 uwb_wakeup(struct uwb_dev * dev)
 {
+    dev->txbuf_seq++;
     return (dev->uw_funcs->uf_wakeup(dev));
 }
 EXPORT_SYMBOL(uwb_wakeup);
@@ -325,6 +328,7 @@ UWB_API_IMPL_PREFIX struct uwb_dev_status
 uwb_write_tx(struct uwb_dev* dev, uint8_t *tx_frame_bytes,
              uint16_t tx_buffer_offset, uint16_t tx_frame_length)
 {
+    dev->txbuf_seq++;
     return (dev->uw_funcs->uf_write_tx(dev, tx_frame_bytes, tx_buffer_offset, tx_frame_length));
 }
 EXPORT_SYMBOL(uwb_write_tx);
@@ -341,6 +345,7 @@ EXPORT_SYMBOL(uwb_write_tx);
 UWB_API_IMPL_PREFIX void
 uwb_write_tx_fctrl(struct uwb_dev* dev, uint16_t tx_frame_length, uint16_t tx_buffer_offset)
 {
+    dev->txbuf_seq++;
     return (dev->uw_funcs->uf_write_tx_fctrl_ext(dev, tx_frame_length, tx_buffer_offset, 0));
 }
 EXPORT_SYMBOL(uwb_write_tx_fctrl);
@@ -359,6 +364,7 @@ UWB_API_IMPL_PREFIX void
 uwb_write_tx_fctrl_ext(struct uwb_dev* dev, uint16_t tx_frame_length,
                        uint16_t tx_buffer_offset, struct uwb_fctrl_ext *ext)
 {
+    dev->txbuf_seq++;
     return (dev->uw_funcs->uf_write_tx_fctrl_ext(dev, tx_frame_length, tx_buffer_offset, ext));
 }
 EXPORT_SYMBOL(uwb_write_tx_fctrl_ext);
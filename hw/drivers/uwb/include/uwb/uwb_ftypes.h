@@ -92,6 +92,11 @@ typedef enum _uwb_dataframe_code_t{
     UWB_DATA_CODE_DS_TWR_EXT_T2,               //!< Response for double sided TWR in extended mode
     UWB_DATA_CODE_DS_TWR_EXT_FINAL,            //!< Final response of double sided TWR in extended mode
     UWB_DATA_CODE_DS_TWR_EXT_END,              //!< End of double sided TWR in extended mode
+    UWB_DATA_CODE_ADS_TWR,                     //!< Asymmetric double sided TWR (three message)
+    UWB_DATA_CODE_ADS_TWR_T1,                  //!< Response for asymmetric double sided TWR
+    UWB_DATA_CODE_ADS_TWR_FINAL,               //!< Final with initiator timestamps for asymmetric double sided TWR
+    UWB_DATA_CODE_ADS_TWR_REPORT,              //!< Optional result report of asymmetric double sided TWR
+    UWB_DATA_CODE_ADS_TWR_END,                 //!< End of asymmetric double sided TWR
 
     UWB_DATA_CODE_SS_TWR_NRNG = 0x0130,        //!< Single sided N-range TWR
     UWB_DATA_CODE_SS_TWR_NRNG_T1,
@@ -0,0 +1,233 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file uwb_telemetry.h
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Binary telemetry records
+ *
+ * @details Fixed layout records emitted on the rng, ccp, wcs and cir character devices
+ * as an alternative to the JSON text stream. Every record starts with a struct
+ * _uwb_telemetry_hdr_t carrying a magic byte, the schema version and the total record
+ * length, so binary and JSON records can be told apart on the same stream ('{' is never
+ * a valid magic). Fields are written in native byte order, which is little-endian on
+ * all supported targets; floating point values are stored as IEEE-754 bit patterns so
+ * that no float operations are needed to produce them.
+ *
+ * This header is self contained and is shared with host side decoders.
+ */
+
+#ifndef _UWB_TELEMETRY_H_
+#define _UWB_TELEMETRY_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UWB_TELEMETRY_MAGIC     (0xB7)  //!< First byte of every binary record
+#define UWB_TELEMETRY_VERSION   (1)     //!< Schema version, bumped on any layout change
+
+//! Output format of a character device
+typedef enum _uwb_telemetry_format_t{
+    UWB_TELEMETRY_FORMAT_JSON = 0,      //!< Newline terminated JSON, default
+    UWB_TELEMETRY_FORMAT_BINARY = 1     //!< Records defined in this file
+}uwb_telemetry_format_t;
+
+//! Record types
+typedef enum _uwb_telemetry_type_t{
+    UWB_TELEMETRY_RNG = 1,              //!< uwb_telemetry_rng_t
+    UWB_TELEMETRY_CCP = 2,              //!< uwb_telemetry_ccp_t
+    UWB_TELEMETRY_WCS = 3,              //!< uwb_telemetry_wcs_t
+    UWB_TELEMETRY_CIR = 4,              //!< uwb_telemetry_cir_t
+    UWB_TELEMETRY_TWR = 5,              //!< uwb_telemetry_twr_t
+    UWB_TELEMETRY_TDOA = 6              //!< uwb_telemetry_tdoa_t
+}uwb_telemetry_type_t;
+
+//! Common record header
+typedef struct _uwb_telemetry_hdr_t{
+    uint8_t magic;                      //!< UWB_TELEMETRY_MAGIC
+    uint8_t version;                    //!< UWB_TELEMETRY_VERSION
+    uint8_t type;                       //!< uwb_telemetry_type_t
+    uint8_t dev_idx;                    //!< Index of the uwb device that produced the record
+    uint16_t length;                    //!< Total record length in bytes, header included
+    uint16_t reserved;                  //!< Zero
+}__attribute__((__packed__,aligned(1))) uwb_telemetry_hdr_t;
+
+//! Range record flags
+#define UWB_TELEMETRY_RNG_HAS_REMOTE  (0x01)  //!< braz holds the remote end's measurement
+#define UWB_TELEMETRY_RNG_HAS_DIAG    (0x02)  //!< rssi and los are valid
+#define UWB_TELEMETRY_RNG_HAS_STS     (0x04)  //!< Frame received with STS enabled
+#define UWB_TELEMETRY_RNG_VALID_STS   (0x08)  //!< Ipatov and STS timestamps agree
+
+//! Range record
+typedef struct _uwb_telemetry_rng_t{
+    struct _uwb_telemetry_hdr_t hdr;
+    uint64_t utime;                     //!< Timestamp, usec (master timescale if WCS enabled)
+    uint16_t uid;                       //!< Source address
+    uint16_t ouid;                      //!< Destination address
+    uint16_t code;                      //!< Final frame code
+    uint8_t seq;                        //!< Frame sequence number
+    uint8_t flags;                      //!< UWB_TELEMETRY_RNG_* flags
+    uint32_t raz[3];                    //!< Local range (m), azimuth, zenith (rad), float32
+    uint32_t braz[3];                   //!< Remote range, azimuth, zenith, float32
+    uint32_t rssi[3];                   //!< [ipatov, sts, sts2] receive level (dBm), float32
+    uint32_t los;                       //!< Line of sight estimate, float32
+    uint32_t pdoa;                      //!< Phase difference of arrival (rad), float32
+}__attribute__((__packed__,aligned(1))) uwb_telemetry_rng_t;
+
+//! Clock calibration packet record
+typedef struct _uwb_telemetry_ccp_t{
+    struct _uwb_telemetry_hdr_t hdr;
+    uint64_t utime;                     //!< Master epoch, usec
+    uint64_t timestamp;                 //!< Transmission timestamp of the ccp frame, dwt units
+    uint64_t delta;                     //!< Interval to the previous ccp frame, dwt units
+    uint8_t seq;                        //!< Frame sequence number
+    uint8_t reserved[3];                //!< Zero
+    uint32_t ppm;                       //!< Carrier integrator clock offset (ppm), float32
+}__attribute__((__packed__,aligned(1))) uwb_telemetry_ccp_t;
+
+//! Wireless clock synchronisation record
+typedef struct _uwb_telemetry_wcs_t{
+    struct _uwb_telemetry_hdr_t hdr;
+    uint64_t utime;                     //!< Master epoch, usec
+    uint64_t wcs[3];                    //!< Timescale states [time, skew, drift], float64
+    uint64_t ppm;                       //!< Fractional skew (ppm), float64
+}__attribute__((__packed__,aligned(1))) uwb_telemetry_wcs_t;
+
+//! Channel impulse response record, followed by cir_count interleaved real/imag int32 pairs
+typedef struct _uwb_telemetry_cir_t{
+    struct _uwb_telemetry_hdr_t hdr;
+    uint64_t utime;                     //!< Timestamp, usec
+    uint64_t raw_ts;                    //!< Raw rx timestamp, dwt units
+    char type[8];                       //!< Accumulator type, not necessarily null terminated
+    uint32_t resampler_delay;           //!< Resampler delay
+    uint32_t fp_idx;                    //!< First path index, float32
+    uint32_t fp_power;                  //!< First path power (dBm), float32
+    uint32_t angle;                     //!< Carrier phase angle (rad), float32
+    uint16_t accumulator_count;         //!< Accumulator count
+    uint16_t cir_offset;                //!< Index of first sample relative to first path
+    uint16_t cir_count;                 //!< Number of samples that follow
+    uint16_t reserved;                  //!< Zero
+    int32_t samples[];                  //!< real[0], imag[0], real[1], imag[1], ...
+}__attribute__((__packed__,aligned(1))) uwb_telemetry_cir_t;
+
+//! Two way ranging timestamp record flags
+#define UWB_TELEMETRY_TWR_WCS  (0x01)   //!< Timestamps were skew compensated by wcs, the range used no skew
+
+//! Raw timestamps of a two way range, enough to recompute the time of flight
+typedef struct _uwb_telemetry_twr_t{
+    struct _uwb_telemetry_hdr_t hdr;
+    uint64_t utime;                     //!< Timestamp, usec (master timescale if WCS enabled)
+    uint16_t uid;                       //!< Source address
+    uint16_t ouid;                      //!< Destination address
+    uint16_t code;                      //!< Final frame code
+    uint8_t seq;                        //!< Frame sequence number
+    uint8_t flags;                      //!< UWB_TELEMETRY_TWR_* flags
+    uint32_t ts[2][4];                  //!< [first, final] frame [request, response, reception, transmission], dwt units
+    int32_t carrier_integrator;         //!< Raw carrier integrator of the final frame
+    uint32_t reserved;                  //!< Zero
+    uint64_t skew;                      //!< Clock offset ratio from the carrier integrator, float64
+}__attribute__((__packed__,aligned(1))) uwb_telemetry_twr_t;
+
+//! Time difference of arrival record, one per anchor response received by a tag.
+//! No firmware emits the binary record yet, rtdoa_tag prints its JSON form with RTDOA_TAG_TRACE
+typedef struct _uwb_telemetry_tdoa_t{
+    struct _uwb_telemetry_hdr_t hdr;
+    uint64_t utime;                     //!< Timestamp, usec (master timescale)
+    uint16_t uid;                       //!< Receiving tag
+    uint16_t ouid;                      //!< Transmitting anchor
+    uint8_t seq;                        //!< Sequence number of the request, shared by a round
+    uint8_t reserved[3];                //!< Zero
+    uint32_t tdoa;                      //!< Arrival less transmit time in the master timebase (m), float32
+}__attribute__((__packed__,aligned(1))) uwb_telemetry_tdoa_t;
+
+/**
+ * Fill in a record header.
+ *
+ * @param hdr       Pointer to the header at the start of the record.
+ * @param type      uwb_telemetry_type_t of the record.
+ * @param dev_idx   Index of the producing uwb device.
+ * @param length    Total record length in bytes.
+ *
+ * @return void
+ */
+static inline void
+uwb_telemetry_hdr_init(struct _uwb_telemetry_hdr_t * hdr, uint8_t type, uint8_t dev_idx, uint16_t length)
+{
+    hdr->magic = UWB_TELEMETRY_MAGIC;
+    hdr->version = UWB_TELEMETRY_VERSION;
+    hdr->type = type;
+    hdr->dev_idx = dev_idx;
+    hdr->length = length;
+    hdr->reserved = 0;
+}
+
+/**
+ * Bit pattern of a 32bit float. Takes a pointer so that both native floats
+ * and the kernel's softfloat types can be stored without float operations.
+ *
+ * @param f  Pointer to a float32 value.
+ *
+ * @return IEEE-754 binary32 bit pattern
+ */
+static inline uint32_t
+uwb_telemetry_f32(const void * f)
+{
+    uint32_t u;
+    __builtin_memcpy(&u, f, sizeof(u));
+    return u;
+}
+
+/**
+ * Bit pattern of a 64bit float.
+ *
+ * @param f  Pointer to a float64 value.
+ *
+ * @return IEEE-754 binary64 bit pattern
+ */
+static inline uint64_t
+uwb_telemetry_f64(const void * f)
+{
+    uint64_t u;
+    __builtin_memcpy(&u, f, sizeof(u));
+    return u;
+}
+
+/*
+ * Format selection on the character devices, takes a pointer to a uint32_t
+ * holding a uwb_telemetry_format_t.
+ */
+#if defined(__KERNEL__)
+#include <linux/ioctl.h>
+#elif defined(__linux__)
+#include <sys/ioctl.h>
+#endif
+#ifdef _IOW
+#define UWB_TELEMETRY_IOC_SET_FORMAT _IOW(UWB_TELEMETRY_MAGIC, 0x01, uint32_t)
+#define UWB_TELEMETRY_IOC_GET_FORMAT _IOR(UWB_TELEMETRY_MAGIC, 0x02, uint32_t)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UWB_TELEMETRY_H_ */
@@ -0,0 +1,88 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file uwb_trace.h
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Recorded ccp and range trace file
+ *
+ * @details A trace file is a struct _uwb_trace_hdr_t followed by count fixed size
+ * records, so that it can be memory mapped and indexed directly. Traces are built on
+ * the host from the telemetry stream of the ccp and rng character devices (or the JSON
+ * output of a Mynewt target) by tools/uwb_trace/uwb_trace_capture and replayed through
+ * the clock and ranging math by tools/uwb_trace/uwb_trace_replay. Fields are native
+ * byte order (little-endian), floating point values are IEEE-754 bit patterns.
+ */
+
+#ifndef _UWB_TRACE_H_
+#define _UWB_TRACE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UWB_TRACE_MAGIC     "UWBTRACE"  //!< First 8 bytes of a trace file
+#define UWB_TRACE_VERSION   (1)         //!< Bumped on any layout change
+
+//! Record types
+typedef enum _uwb_trace_type_t{
+    UWB_TRACE_CCP = 1,                  //!< Clock calibration packet
+    UWB_TRACE_TWR = 2                   //!< Two way range
+}uwb_trace_type_t;
+
+//! File header
+typedef struct _uwb_trace_hdr_t{
+    char magic[8];                      //!< UWB_TRACE_MAGIC, not null terminated
+    uint32_t version;                   //!< UWB_TRACE_VERSION
+    uint16_t hdr_size;                  //!< sizeof(uwb_trace_hdr_t), records start here
+    uint16_t rec_size;                  //!< sizeof(uwb_trace_rec_t)
+    uint64_t count;                     //!< Number of records
+    uint64_t reserved;                  //!< Zero
+}uwb_trace_hdr_t;
+
+//! Record, 64 bytes
+typedef struct _uwb_trace_rec_t{
+    uint8_t type;                       //!< uwb_trace_type_t
+    uint8_t dev_idx;                    //!< Index of the uwb device that produced the event
+    uint8_t seq;                        //!< Frame sequence number
+    uint8_t flags;                      //!< UWB_TELEMETRY_TWR_* flags for ranges
+    uint16_t uid;                       //!< Source address (ranges)
+    uint16_t ouid;                      //!< Destination address (ranges)
+    uint16_t code;                      //!< Final frame code (ranges)
+    uint16_t reserved;                  //!< Zero
+    int32_t carrier_integrator;         //!< Raw carrier integrator (ranges)
+    uint64_t utime;                     //!< Timestamp as reported by the device
+    uint64_t skew;                      //!< Clock offset ratio from the carrier integrator, float64
+    union {
+        struct {
+            uint64_t timestamp;         //!< Master transmission timestamp, dwt units
+            uint64_t delta;             //!< Local interval to the previous ccp frame, dwt units
+        } ccp;
+        uint32_t ts[2][4];              //!< [first, final] frame [request, response, reception, transmission]
+    };
+}uwb_trace_rec_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UWB_TRACE_H_ */
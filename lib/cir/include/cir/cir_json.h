@@ -57,15 +57,16 @@ typedef struct cir_json{
     int64_t imag[MYNEWT_VAL(CIR_MAX_SIZE)];
     /* */
     char iobuf[MYNEWT_VAL(CIR_VERBOSE_BUFFER_SIZE)];
-    uint16_t idx;
 } cir_json_t;
 
 cir_json_t * cir_json_init(struct cir_json * json);
 void cir_json_free(struct cir_json * json);
 int cir_json_write(struct cir_json * json);
+size_t cir_json_write_binary(struct cir_json * json, uint8_t dev_idx, void * buf, size_t size);
 
 #ifdef __KERNEL__
 int cir_chrdev_output(char *buf, size_t len);
+int cir_chrdev_format(void);
 #endif  /* __KERNEL__ */
 
 #ifdef __cplusplus
@@ -32,6 +32,8 @@
 #include <linux/sched/signal.h>
 #endif
 #include <linux/kfifo.h>
+#include <syscfg/syscfg.h>
+#include <uwb/uwb_telemetry.h>
 
 
 
@@ -48,6 +50,7 @@ struct cir_encode_data {
     struct mutex write_lock;
     local_record_fifo_t fifo;
     int have_init;
+    uint32_t format;                    //!< uwb_telemetry_format_t of this device
 	struct device *dev;
 	struct cdev cdev;
 	struct class *class;
@@ -154,6 +157,29 @@ cir_poll(struct file *filp, struct poll_table_struct *wait)
 	return mask;
 }
 
+static long
+cir_chrdev_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    uint32_t format;
+    struct cir_encode_data *ed = file->private_data;
+
+    switch (cmd) {
+    case UWB_TELEMETRY_IOC_SET_FORMAT:
+        if (get_user(format, (uint32_t __user *)arg)) {
+            return -EFAULT;
+        }
+        if (format > UWB_TELEMETRY_FORMAT_BINARY) {
+            return -EINVAL;
+        }
+        ed->format = format;
+        return 0;
+    case UWB_TELEMETRY_IOC_GET_FORMAT:
+        return put_user(ed->format, (uint32_t __user *)arg);
+    default:
+        return -ENOTTY;
+    }
+}
+
 static const struct file_operations cir_chrdev_fops = {
     .owner   = THIS_MODULE,
     .open    = cir_chrdev_open,
@@ -161,6 +187,7 @@ static const struct file_operations cir_chrdev_fops = {
     .read    = cir_chrdev_read,
     .write   = cir_chrdev_write,
     .poll    = cir_poll,
+    .unlocked_ioctl = cir_chrdev_ioctl,
 };
 
 static char*
@@ -221,6 +248,7 @@ cir_chrdev_create(struct cir_encode_data *ed)
     INIT_KFIFO(ed->fifo);
     init_waitqueue_head(&ed->wait);
 
+    ed->format = MYNEWT_VAL(UWB_TELEMETRY_FORMAT);
     ed->have_init = 1;
     return 0;
 
@@ -249,6 +277,16 @@ cir_chrdev_destroy(struct cir_encode_data *ed)
     ed->have_init = 0;
 }
 
+int
+cir_chrdev_format(void)
+{
+    struct cir_encode_data *ed = &cir_encode_inst;
+    if (!ed->have_init) {
+        return UWB_TELEMETRY_FORMAT_JSON;
+    }
+    return ed->format;
+}
+
 int
 cir_chrdev_output(char *buf, size_t len)
 {
@@ -29,14 +29,13 @@
 #include <stddef.h>
 #include <assert.h>
 #include <cir/cir_json.h>
+#include <uwb/uwb_telemetry.h>
 
 #ifndef __KERNEL__
 static_assert(MYNEWT_VAL(CIR_VERBOSE_BUFFER_SIZE) > (64+12*MYNEWT_VAL(CIR_MAX_SIZE)),
               "CIR_VERBOSE_BUFFER_SIZE needs to be large enough to hold the entire CIR_MAX_SIZE vector");
 #endif
 
-static int cir_write_line(void *buf, char* data, int len);
-
 struct cir_json * cir_json_init(struct cir_json * json)
 {
     if (json == NULL){
@@ -58,24 +57,6 @@ void cir_json_free(struct cir_json * json)
     }
 }
 
-int
-cir_write_line(void *buf, char* data, int len)
-{
-    uint16_t i;
-    struct cir_json * json = buf;
-    for (i=0; i < len; i++) {
-        json->iobuf[json->idx++] = data[i];
-        if (data[i]=='\0'){
-            break;
-        }
-    }
-    if (json->iobuf[json->idx-1]=='\0') {
-        json->idx = 0;
-    }
-
-    return len;
-}
-
 
 int
 cir_json_write(struct cir_json * json)
@@ -84,8 +65,7 @@ cir_json_write(struct cir_json * json)
     int i;
     struct json_value value;
 
-    json->encoder.je_write = cir_write_line;
-    json->encoder.je_arg = (void *)json;
+    json_encode_buf_init(&json->encoder, json->iobuf, sizeof(json->iobuf));
     json->decoder.json_buf.jb_read_next = json_read_next;
     json->decoder.json_buf.jb_read_prev = json_read_prev;
     json->decoder.json_buf.jb_readn = json_readn;
@@ -141,6 +121,54 @@ cir_json_write(struct cir_json * json)
     json->encoder.je_wr_commas = 0;
     assert(rc == 0);
 
-    cir_write_line(json->encoder.je_arg, "\0", 1);
+    if (json_encode_buf_finish(&json->encoder) < 0) {
+        rc = -1;
+    }
     return rc;
 }
+
+/**
+ * @fn cir_json_write_binary(struct cir_json * json, uint8_t dev_idx, void * buf, size_t size)
+ * @brief Encode the cir as a uwb_telemetry_cir_t record instead of JSON text.
+ *
+ * @param json      Pointer to struct cir_json holding the cir.
+ * @param dev_idx   Index of the uwb device the cir was read from.
+ * @param buf       Output buffer.
+ * @param size      Size of buf.
+ *
+ * @return length of the record, 0 if it does not fit in buf
+ */
+size_t
+cir_json_write_binary(struct cir_json * json, uint8_t dev_idx, void * buf, size_t size)
+{
+    int i;
+    dpl_float32_t tmp;
+    uwb_telemetry_cir_t * rec = (uwb_telemetry_cir_t *) buf;
+    size_t len = sizeof(uwb_telemetry_cir_t) + json->cir_count * 2 * sizeof(int32_t);
+
+    if (len > size || len > 0xFFFF) {
+        return 0;
+    }
+    memset(rec, 0, sizeof(uwb_telemetry_cir_t));
+    uwb_telemetry_hdr_init(&rec->hdr, UWB_TELEMETRY_CIR, dev_idx, len);
+    rec->utime = json->utime;
+    rec->raw_ts = json->raw_ts;
+    if (json->type) {
+        strncpy(rec->type, json->type, sizeof(rec->type));
+    }
+    rec->resampler_delay = json->resampler_delay;
+    tmp = DPL_FLOAT32_FROM_F64(json->fp_idx);
+    rec->fp_idx = uwb_telemetry_f32(&tmp);
+    tmp = DPL_FLOAT32_FROM_F64(json->fp_power);
+    rec->fp_power = uwb_telemetry_f32(&tmp);
+    tmp = DPL_FLOAT32_FROM_F64(json->angle);
+    rec->angle = uwb_telemetry_f32(&tmp);
+    rec->accumulator_count = json->accumulator_count;
+    rec->cir_offset = json->cir_offset;
+    rec->cir_count = json->cir_count;
+    for (i = 0; i < json->cir_count; i++) {
+        rec->samples[2*i] = json->real[i];
+        rec->samples[2*i + 1] = json->imag[i];
+    }
+    return len;
+}
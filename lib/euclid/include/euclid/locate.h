@@ -0,0 +1,65 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file locate.h
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Anchor localization from inter-anchor ranges
+ */
+
+#ifndef _EUCLID_LOCATE_H_
+#define _EUCLID_LOCATE_H_
+
+#include <stdint.h>
+#include <euclid/triad.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOCATE_DEFAULT_VARIANCE (0.01)  //!< Range variance (m^2) used where none is given
+
+//! One measured range between two anchors
+typedef struct _locate_range_t{
+    uint16_t a;                 //!< Index of the first anchor
+    uint16_t b;                 //!< Index of the second anchor
+    double range;               //!< Measured range (m)
+    double variance;            //!< Range variance (m^2), <= 0 for LOCATE_DEFAULT_VARIANCE
+}locate_range_t;
+
+//! Outcome of a localization
+typedef struct _locate_report_t{
+    double rms;                 //!< Root mean square range residual (m)
+    double chi2;                //!< Sum of squared residuals weighted by the inverse variance
+    double max;                 //!< Largest absolute range residual (m)
+    uint32_t worst;             //!< Index of the range with the largest residual
+    uint16_t iterations;        //!< Levenberg-Marquardt iterations
+}locate_report_t;
+
+int locate_anchors(const locate_range_t * ranges, uint32_t nranges, uint16_t nanchors, uint8_t dim,
+                   triad_t * pos, double * residuals, locate_report_t * report);
+uint32_t locate_ranges_from_matrix(const float * range, const float * variance, uint16_t n,
+                                   locate_range_t * ranges, uint32_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EUCLID_LOCATE_H_ */
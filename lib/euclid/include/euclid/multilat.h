@@ -0,0 +1,64 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file multilat.h
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Position from ranges to known anchors
+ */
+
+#ifndef _EUCLID_MULTILAT_H_
+#define _EUCLID_MULTILAT_H_
+
+#include <stdint.h>
+#include <euclid/triad.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MULTILAT_MAX_MEAS           (32)    //!< Largest set of ranges per solve
+#define MULTILAT_DEFAULT_VARIANCE   (0.01)  //!< Range variance (m^2) used where none is given
+#define MULTILAT_OUTLIER_SIGMA      (3.0)   //!< Ranges further off than this many sigma are rejected
+
+//! One range to an anchor
+typedef struct _multilat_meas_t{
+    triad_t anchor;             //!< Anchor position (m)
+    double range;               //!< Measured range (m)
+    double variance;            //!< Range variance (m^2), <= 0 for MULTILAT_DEFAULT_VARIANCE
+}multilat_meas_t;
+
+//! Solved position
+typedef struct _multilat_result_t{
+    triad_t pos;                //!< Position (m), z is 0 for 2D solves
+    triad_t variance;           //!< Position variance (m^2) implied by the range variances
+    double rms;                 //!< Root mean square residual of the ranges used (m)
+    uint32_t inliers;           //!< Bit i is set if range i was used
+    uint16_t iterations;        //!< Gauss-Newton iterations, summed over the fit and its leave one out refits
+}multilat_result_t;
+
+int multilat_solve(const multilat_meas_t * meas, uint16_t n, uint8_t dim, const triad_t * guess,
+                   multilat_result_t * result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EUCLID_MULTILAT_H_ */
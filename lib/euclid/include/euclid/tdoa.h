@@ -0,0 +1,81 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file tdoa.h
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Position from time differences of arrival from known anchors
+ */
+
+#ifndef _EUCLID_TDOA_H_
+#define _EUCLID_TDOA_H_
+
+#include <stdint.h>
+#include <euclid/triad.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TDOA_MAX_MEAS           (32)    //!< Largest set of arrival times per solve
+#define TDOA_DEFAULT_VARIANCE   (0.01)  //!< Arrival time variance (m^2) used where none is given
+
+//! Anchor position by short address
+typedef struct _tdoa_anchor_t{
+    uint16_t uid;               //!< Short address of the anchor
+    triad_t pos;                //!< Anchor position (m)
+}tdoa_anchor_t;
+
+//! Anchor registry, the caller provides the storage
+typedef struct _tdoa_registry_t{
+    uint16_t nanchors;          //!< Anchors registered
+    uint16_t max;               //!< Size of anchors[]
+    tdoa_anchor_t * anchors;    //!< Sorted by uid
+}tdoa_registry_t;
+
+//! One arrival of an anchor transmission
+typedef struct _tdoa_meas_t{
+    triad_t anchor;             //!< Anchor position (m)
+    double tdoa;                //!< Arrival time less transmit time (m), any offset common to all is solved for
+    double variance;            //!< Variance of tdoa (m^2), <= 0 for TDOA_DEFAULT_VARIANCE
+}tdoa_meas_t;
+
+//! Solved position
+typedef struct _tdoa_result_t{
+    triad_t pos;                //!< Position (m), z is 0 for 2D solves
+    triad_t variance;           //!< Position variance (m^2) implied by the tdoa variances
+    double offset;              //!< Offset common to all tdoa (m)
+    double gdop;                //!< Geometric dilution of precision, position and offset
+    double rms;                 //!< Root mean square residual (m)
+    uint8_t iterations;         //!< Gauss-Newton iterations
+}tdoa_result_t;
+
+void tdoa_registry_init(tdoa_registry_t * reg, tdoa_anchor_t * storage, uint16_t max);
+int tdoa_registry_set(tdoa_registry_t * reg, uint16_t uid, const triad_t * pos);
+const triad_t * tdoa_registry_get(const tdoa_registry_t * reg, uint16_t uid);
+
+int tdoa_solve(const tdoa_meas_t * meas, uint16_t n, uint8_t dim, const triad_t * guess,
+               tdoa_result_t * result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EUCLID_TDOA_H_ */
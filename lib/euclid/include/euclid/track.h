@@ -0,0 +1,104 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file track.h
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Constant velocity tracking of tags from single ranges and arrival times
+ */
+
+#ifndef _EUCLID_TRACK_H_
+#define _EUCLID_TRACK_H_
+
+#include <stdint.h>
+#include <euclid/triad.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACK_NSTATES       (7)         //!< x, y, z, vx, vy, vz and the offset of the current tdoa round
+#define TRACK_INIT_MEAS     (8)         //!< Measurements held while a track is started
+#define TRACK_INIT_WINDOW   (1000000)   //!< Age (usec) after which a held measurement is dropped
+#define TRACK_INIT_SPEED    (2.0)       //!< Speed standard deviation (m/s) of a new track
+
+//! Track state
+typedef enum _track_state_t{
+    TRACK_FREE = 0,                     //!< Table entry unused
+    TRACK_INIT,                         //!< Collecting measurements for a first position
+    TRACK_ACTIVE                        //!< Tracking
+}track_state_t;
+
+//! Tracker parameters
+typedef struct _track_config_t{
+    uint8_t dim;                        //!< 2 to track x and y only, 3 for x, y and z
+    double accel_noise;                 //!< Acceleration noise density (m^2/s^3)
+    double variance;                    //!< Measurement variance (m^2) used where none is given
+    double gate;                        //!< Measurements further off than this many sigma are rejected, 0 for none
+    uint64_t expiry;                    //!< Inactivity (usec) after which a track is dropped
+}track_config_t;
+
+//! Held measurement of a track being started
+typedef struct _track_meas_t{
+    triad_t anchor;
+    double value;                       //!< Range or tdoa (m)
+    double variance;
+    uint64_t utime;
+}track_meas_t;
+
+//! One tracked tag
+typedef struct _track_t{
+    uint16_t uid;                       //!< Tag address
+    uint8_t state;                      //!< track_state_t
+    uint8_t seq;                        //!< Sequence number of the current tdoa round
+    uint8_t npending;                   //!< Held measurements
+    uint8_t tdoa;                       //!< Tracked from tdoa rather than ranges
+    uint64_t utime;                     //!< Time of the state (usec)
+    uint64_t seen;                      //!< Time of the last measurement (usec)
+    uint32_t updates;                   //!< Measurements applied
+    uint32_t rejected;                  //!< Measurements refused by the gate
+    double x[TRACK_NSTATES];            //!< State
+    double P[TRACK_NSTATES][TRACK_NSTATES]; //!< State covariance
+    track_meas_t pending[TRACK_INIT_MEAS];
+}track_t;
+
+//! Table of tracks, the caller provides the storage
+typedef struct _track_table_t{
+    track_config_t config;
+    uint16_t max;                       //!< Size of tracks[]
+    uint16_t ntracks;                   //!< Entries in use
+    track_t * tracks;
+}track_table_t;
+
+void track_table_init(track_table_t * table, track_t * storage, uint16_t max, const track_config_t * config);
+track_t * track_find(const track_table_t * table, uint16_t uid);
+int track_range(track_table_t * table, uint16_t uid, uint64_t utime, const triad_t * anchor, double range,
+                double variance);
+int track_tdoa(track_table_t * table, uint16_t uid, uint64_t utime, uint8_t seq, const triad_t * anchor,
+               double tdoa, double variance);
+int track_position(const track_table_t * table, const track_t * track, uint64_t utime, triad_t * pos,
+                   triad_t * vel, triad_t * variance);
+uint16_t track_expire(track_table_t * table, uint64_t utime);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EUCLID_TRACK_H_ */
@@ -138,11 +138,21 @@ bool epsilon_same_double(double a, double b)
 
 TEST_CASE_DECL(euclid_test_norm)
 TEST_CASE_DECL(euclid_test_normf)
+TEST_CASE_DECL(euclid_test_locate)
+TEST_CASE_DECL(euclid_test_locate_flat)
+TEST_CASE_DECL(euclid_test_multilat)
+TEST_CASE_DECL(euclid_test_tdoa)
+TEST_CASE_DECL(euclid_test_track)
 
 TEST_SUITE(euclid_test_all)
 {
         euclid_test_norm();
         euclid_test_normf();
+        euclid_test_locate();
+        euclid_test_locate_flat();
+        euclid_test_multilat();
+        euclid_test_tdoa();
+        euclid_test_track();
 }
 
 int
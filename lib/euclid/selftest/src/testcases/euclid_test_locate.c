@@ -0,0 +1,199 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdlib.h>
+#include "euclid_test.h"
+#include "euclid/locate.h"
+
+#define LOCATE_TEST_N   (24)
+#define LOCATE_TEST_BIG (300)
+#define LOCATE_TEST_LAYOUTS (8)
+
+static uint32_t test_seed;
+
+/* Uniform in [0, 1), xorshift so the layout is the same whatever the libc */
+static double
+test_rand(void)
+{
+        test_seed ^= test_seed << 13;
+        test_seed ^= test_seed >> 17;
+        test_seed ^= test_seed << 5;
+        return test_seed / 4294967296.0;
+}
+
+static double
+test_dist(const triad_t * a, const triad_t * b)
+{
+        return sqrt((a->x - b->x) * (a->x - b->x) + (a->y - b->y) * (a->y - b->y) +
+                    (a->z - b->z) * (a->z - b->z));
+}
+
+/* Largest error of the solved anchor to anchor distances, independent of the frame */
+static double
+test_shape_error(const triad_t * truth, const triad_t * pos, uint16_t n)
+{
+        double err = 0;
+        for (uint16_t a = 0; a < n; a++) {
+                for (uint16_t b = a + 1; b < n; b++) {
+                        err = fmax(err, fabs(test_dist(&truth[a], &truth[b]) - test_dist(&pos[a], &pos[b])));
+                }
+        }
+        return err;
+}
+
+TEST_CASE_SELF(euclid_test_locate)
+{
+        static triad_t truth[LOCATE_TEST_N], pos[LOCATE_TEST_N];
+        static locate_range_t ranges[LOCATE_TEST_N * LOCATE_TEST_N];
+        static double residuals[LOCATE_TEST_N * LOCATE_TEST_N];
+        locate_report_t report;
+        uint32_t n = 0;
+        int rc;
+
+        /* Anchors spread over a 40 x 30 x 6 m hall */
+        srand(1);
+        for (uint16_t i = 0; i < LOCATE_TEST_N; i++) {
+                truth[i].x = 40.0 * rand() / RAND_MAX;
+                truth[i].y = 30.0 * rand() / RAND_MAX;
+                truth[i].z = 6.0 * rand() / RAND_MAX;
+        }
+
+        /* Case1 : Exact ranges up to 25 m, longer pairs are out of reach */
+        for (uint16_t a = 0; a < LOCATE_TEST_N; a++) {
+                for (uint16_t b = a + 1; b < LOCATE_TEST_N; b++) {
+                        double d = test_dist(&truth[a], &truth[b]);
+                        if (d < 25) {
+                                ranges[n++] = (locate_range_t){.a = a, .b = b, .range = d};
+                        }
+                }
+        }
+        TEST_ASSERT(n < LOCATE_TEST_N * (LOCATE_TEST_N - 1) / 2);
+        rc = locate_anchors(ranges, n, LOCATE_TEST_N, 3, pos, residuals, &report);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(report.rms < 1e-6);
+        TEST_ASSERT(test_shape_error(truth, pos, LOCATE_TEST_N) < 1e-4);
+
+        /* The frame starts at anchor 0 with anchor 1 on the x axis */
+        TEST_ASSERT(fabs(pos[0].x) + fabs(pos[0].y) + fabs(pos[0].z) < 1e-9);
+        TEST_ASSERT(pos[1].x > 0 && fabs(pos[1].y) + fabs(pos[1].z) < 1e-9);
+
+        /* Case2 : 5 cm noise in both directions of every pair */
+        n = 0;
+        for (uint16_t a = 0; a < LOCATE_TEST_N; a++) {
+                for (uint16_t b = 0; b < LOCATE_TEST_N; b++) {
+                        double d = test_dist(&truth[a], &truth[b]);
+                        if (a != b && d < 25) {
+                                double noise = 0.05 * (2.0 * rand() / RAND_MAX - 1) * sqrt(3);
+                                ranges[n++] = (locate_range_t){.a = a, .b = b, .range = d + noise,
+                                                               .variance = 0.05 * 0.05};
+                        }
+                }
+        }
+        rc = locate_anchors(ranges, n, LOCATE_TEST_N, 3, pos, residuals, &report);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(report.rms < 0.06);
+        TEST_ASSERT(report.max == fabs(residuals[report.worst]));
+        TEST_ASSERT(test_shape_error(truth, pos, LOCATE_TEST_N) < 0.15);
+
+        /* Case3 : Anchor 3 only ranges with anchor 2, its position is undefined */
+        n = 0;
+        ranges[n++] = (locate_range_t){.a = 0, .b = 1, .range = 5};
+        ranges[n++] = (locate_range_t){.a = 1, .b = 2, .range = 5};
+        ranges[n++] = (locate_range_t){.a = 0, .b = 2, .range = 5};
+        rc = locate_anchors(ranges, n, 4, 2, pos, NULL, NULL);
+        TEST_ASSERT(rc == -1);
+        ranges[n++] = (locate_range_t){.a = 3, .b = 2, .range = 5};
+        rc = locate_anchors(ranges, n, 4, 2, pos, NULL, NULL);
+        TEST_ASSERT(rc == 0);
+}
+
+TEST_CASE_SELF(euclid_test_locate_flat)
+{
+        triad_t * truth = malloc(LOCATE_TEST_BIG * sizeof(triad_t));
+        triad_t * pos = malloc(LOCATE_TEST_BIG * sizeof(triad_t));
+        locate_range_t * ranges = malloc(LOCATE_TEST_BIG * (LOCATE_TEST_BIG - 1) / 2 * sizeof(locate_range_t));
+        locate_report_t report;
+        uint32_t n = 0;
+        int rc;
+
+        TEST_ASSERT_FATAL(truth && pos && ranges);
+
+        /* Case1 : Anchors over a 100 x 80 m hall within 6 m of height, 3 cm noise on ranges up
+         * to 30 m. This layout used to settle with a region folded through its mean height. */
+        test_seed = 4;
+        for (uint16_t i = 0; i < LOCATE_TEST_BIG; i++) {
+                truth[i].x = 100.0 * test_rand();
+                truth[i].y = 80.0 * test_rand();
+                truth[i].z = 6.0 * test_rand();
+        }
+        for (uint16_t a = 0; a < LOCATE_TEST_BIG; a++) {
+                for (uint16_t b = a + 1; b < LOCATE_TEST_BIG; b++) {
+                        double d = test_dist(&truth[a], &truth[b]);
+                        if (d < 30) {
+                                double noise = 0.03 * (2.0 * test_rand() - 1) * sqrt(3);
+                                ranges[n++] = (locate_range_t){.a = a, .b = b, .range = d + noise,
+                                                               .variance = 0.03 * 0.03};
+                        }
+                }
+        }
+        rc = locate_anchors(ranges, n, LOCATE_TEST_BIG, 3, pos, NULL, &report);
+        TEST_ASSERT(rc == 0);
+        TEST_ASSERT(report.rms < 0.035);
+        TEST_ASSERT(test_shape_error(truth, pos, LOCATE_TEST_BIG) < 0.1);
+
+        /* Case2 : A 2 m outlier is far outside the range variance, the fit is rejected but
+         * still reported */
+        ranges[n / 2].range += 2.0;
+        rc = locate_anchors(ranges, n, LOCATE_TEST_BIG, 3, pos, NULL, &report);
+        TEST_ASSERT(rc == -3);
+        TEST_ASSERT(report.worst == n / 2);
+
+        /* Case3 : The same anchors spread thinner over a 140 x 140 m hall with 5 cm noise, several
+         * layouts. Each fit must be accepted and reach the chi2 of the true positions, which a
+         * folded sheet or a pair of anchors with swapped heights does not */
+        for (uint32_t layout = 1; layout <= LOCATE_TEST_LAYOUTS; layout++) {
+                double chi2 = 0;
+                test_seed = layout * 2654435761u | 1;
+                for (uint16_t i = 0; i < LOCATE_TEST_BIG; i++) {
+                        truth[i].x = 140.0 * test_rand();
+                        truth[i].y = 140.0 * test_rand();
+                        truth[i].z = 6.0 * test_rand();
+                }
+                n = 0;
+                for (uint16_t a = 0; a < LOCATE_TEST_BIG; a++) {
+                        for (uint16_t b = a + 1; b < LOCATE_TEST_BIG; b++) {
+                                double d = test_dist(&truth[a], &truth[b]);
+                                if (d < 30) {
+                                        double noise = 0.05 * (2.0 * test_rand() - 1) * sqrt(3);
+                                        ranges[n++] = (locate_range_t){.a = a, .b = b, .range = d + noise,
+                                                                       .variance = 0.05 * 0.05};
+                                        chi2 += noise * noise / (0.05 * 0.05);
+                                }
+                        }
+                }
+                rc = locate_anchors(ranges, n, LOCATE_TEST_BIG, 3, pos, NULL, &report);
+                TEST_ASSERT(rc == 0);
+                TEST_ASSERT(report.chi2 < chi2);
+                TEST_ASSERT(test_shape_error(truth, pos, LOCATE_TEST_BIG) < 0.3);
+        }
+
+        free(truth);
+        free(pos);
+        free(ranges);
+}
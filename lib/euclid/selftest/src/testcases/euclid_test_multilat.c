@@ -0,0 +1,121 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdlib.h>
+#include "euclid_test.h"
+#include "euclid/multilat.h"
+
+static const triad_t multilat_anchors[] = {
+        {.x = 0, .y = 0, .z = 2.5},
+        {.x = 20, .y = 0, .z = 3.0},
+        {.x = 20, .y = 15, .z = 0.5},
+        {.x = 0, .y = 15, .z = 2.8},
+        {.x = 10, .y = -2, .z = 0.3},
+        {.x = 10, .y = 17, .z = 3.1},
+        {.x = -2, .y = 7, .z = 1.0},
+        {.x = 22, .y = 8, .z = 2.2},
+};
+#define MULTILAT_NANCHORS (sizeof(multilat_anchors) / sizeof(multilat_anchors[0]))
+
+static double
+test_range(const triad_t * a, const triad_t * b)
+{
+        return sqrt((a->x - b->x) * (a->x - b->x) + (a->y - b->y) * (a->y - b->y) +
+                    (a->z - b->z) * (a->z - b->z));
+}
+
+static double
+test_noise(double sigma)
+{
+        /* Sum of uniforms, close enough to gaussian for these tests */
+        double s = 0;
+        for (int k = 0; k < 12; k++) {
+                s += (double)rand() / RAND_MAX;
+        }
+        return (s - 6) * sigma;
+}
+
+static void
+test_fill(multilat_meas_t * meas, const triad_t * tag, double sigma)
+{
+        for (uint16_t i = 0; i < MULTILAT_NANCHORS; i++) {
+                meas[i].anchor = multilat_anchors[i];
+                meas[i].range = test_range(&multilat_anchors[i], tag) + test_noise(sigma);
+                meas[i].variance = (sigma > 0) ? sigma * sigma : 0;
+        }
+}
+
+TEST_CASE_SELF(euclid_test_multilat)
+{
+        multilat_meas_t meas[MULTILAT_NANCHORS];
+        multilat_result_t result;
+        triad_t tag = {.x = 7.3, .y = 4.1, .z = 1.2};
+        int rc;
+
+        srand(7);
+
+        /* Case1 : Exact ranges, closed form start */
+        test_fill(meas, &tag, 0);
+        rc = multilat_solve(meas, MULTILAT_NANCHORS, 3, NULL, &result);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(test_range(&result.pos, &tag) < 1e-6);
+        TEST_ASSERT(result.inliers == (1UL << MULTILAT_NANCHORS) - 1);
+        TEST_ASSERT(result.rms < 1e-6);
+
+        /* Case2 : Ceiling anchors all at 3 m, the tag is placed below them */
+        triad_t ceiling = {.x = 12, .y = 9, .z = 1};
+        for (uint16_t i = 0; i < 4; i++) {
+                meas[i].anchor = multilat_anchors[i];
+                meas[i].anchor.z = 3;
+                meas[i].range = test_range(&meas[i].anchor, &ceiling);
+                meas[i].variance = 0;
+        }
+        rc = multilat_solve(meas, 4, 3, NULL, &result);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(test_range(&result.pos, &ceiling) < 1e-4);
+
+        /* Case3 : 5 cm noise and one reflection 1.5 m long */
+        test_fill(meas, &tag, 0.05);
+        meas[3].range += 1.5;
+        rc = multilat_solve(meas, MULTILAT_NANCHORS, 3, NULL, &result);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(!(result.inliers & 1UL << 3));
+        /* Height is the weak axis with these anchors, hold each axis to its own variance */
+        for (uint8_t c = 0; c < 3; c++) {
+                TEST_ASSERT(result.variance.array[c] > 0);
+                TEST_ASSERT(fabs(result.pos.array[c] - tag.array[c]) < 4 * sqrt(result.variance.array[c]));
+        }
+        TEST_ASSERT(result.variance.z > result.variance.x);
+
+        /* Case4 : 2D from a guess, z is ignored */
+        triad_t flat = {.x = 5, .y = 5, .z = 0}, guess = {.x = 1, .y = 1};
+        for (uint16_t i = 0; i < MULTILAT_NANCHORS; i++) {
+                meas[i].anchor = multilat_anchors[i];
+                meas[i].anchor.z = 0;
+                meas[i].range = test_range(&meas[i].anchor, &flat);
+        }
+        rc = multilat_solve(meas, MULTILAT_NANCHORS, 2, &guess, &result);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(test_range(&result.pos, &flat) < 1e-6);
+        TEST_ASSERT(result.pos.z == 0);
+
+        /* Case5 : Too few ranges */
+        rc = multilat_solve(meas, 3, 3, NULL, &result);
+        TEST_ASSERT(rc == -1);
+}
@@ -0,0 +1,162 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdlib.h>
+#include "euclid_test.h"
+#include "euclid/tdoa.h"
+
+#define TDOA_TEST_OFFSET    (1234.5)
+
+static const triad_t tdoa_anchors[] = {
+        {.x = 0, .y = 0, .z = 2.5},
+        {.x = 20, .y = 0, .z = 3.0},
+        {.x = 20, .y = 15, .z = 0.5},
+        {.x = 0, .y = 15, .z = 2.8},
+        {.x = 10, .y = -2, .z = 0.3},
+        {.x = 10, .y = 17, .z = 3.1},
+        {.x = -2, .y = 7, .z = 1.0},
+        {.x = 22, .y = 8, .z = 2.2},
+};
+#define TDOA_NANCHORS (sizeof(tdoa_anchors) / sizeof(tdoa_anchors[0]))
+
+static double
+test_range(const triad_t * a, const triad_t * b)
+{
+        return sqrt((a->x - b->x) * (a->x - b->x) + (a->y - b->y) * (a->y - b->y) +
+                    (a->z - b->z) * (a->z - b->z));
+}
+
+static double
+test_noise(double sigma)
+{
+        double s = 0;
+        for (int k = 0; k < 12; k++) {
+                s += (double)rand() / RAND_MAX;
+        }
+        return (s - 6) * sigma;
+}
+
+static void
+test_fill(tdoa_meas_t * meas, uint16_t n, const triad_t * tag, double sigma)
+{
+        for (uint16_t i = 0; i < n; i++) {
+                meas[i].tdoa = test_range(&meas[i].anchor, tag) + TDOA_TEST_OFFSET + test_noise(sigma);
+                meas[i].variance = (sigma > 0) ? sigma * sigma : 0;
+        }
+}
+
+TEST_CASE_SELF(euclid_test_tdoa)
+{
+        tdoa_meas_t meas[TDOA_NANCHORS];
+        tdoa_anchor_t storage[4];
+        tdoa_registry_t reg;
+        tdoa_result_t result;
+        triad_t tag = {.x = 7.3, .y = 4.1, .z = 1.2};
+        int rc;
+
+        srand(11);
+
+        /* Case1 : Registry lookups by short address */
+        tdoa_registry_init(&reg, storage, 4);
+        for (uint16_t i = 0; i < 4; i++) {
+                TEST_ASSERT(tdoa_registry_set(&reg, 0x1400 - i, &tdoa_anchors[i]) == 0);
+        }
+        TEST_ASSERT(tdoa_registry_set(&reg, 0x1400, &tdoa_anchors[5]) == 0);
+        TEST_ASSERT(tdoa_registry_set(&reg, 0x1401, &tdoa_anchors[5]) == -1);
+        TEST_ASSERT(tdoa_registry_get(&reg, 0x1401) == NULL);
+        TEST_ASSERT(tdoa_registry_get(&reg, 0x13ff)->x == tdoa_anchors[1].x);
+        TEST_ASSERT(tdoa_registry_get(&reg, 0x1400)->y == tdoa_anchors[5].y);
+
+        /* Case2 : Exact arrivals, closed form start */
+        for (uint16_t i = 0; i < TDOA_NANCHORS; i++) {
+                meas[i].anchor = tdoa_anchors[i];
+        }
+        test_fill(meas, TDOA_NANCHORS, &tag, 0);
+        rc = tdoa_solve(meas, TDOA_NANCHORS, 3, NULL, &result);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(test_range(&result.pos, &tag) < 1e-6);
+        TEST_ASSERT(fabs(result.offset - TDOA_TEST_OFFSET) < 1e-6);
+        TEST_ASSERT(result.rms < 1e-6);
+        TEST_ASSERT(result.gdop > 1 && result.gdop < 10);
+
+        /* Case3 : Ceiling anchors all at 3 m, the tag is placed below them */
+        triad_t ceiling = {.x = 12, .y = 9, .z = 1};
+        for (uint16_t i = 0; i < 5; i++) {
+                meas[i].anchor.z = 3;
+        }
+        test_fill(meas, 5, &ceiling, 0);
+        rc = tdoa_solve(meas, 5, 3, NULL, &result);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(test_range(&result.pos, &ceiling) < 1e-4);
+
+        /* Case4 : 5 cm noise, each axis within its own variance */
+        for (uint16_t i = 0; i < TDOA_NANCHORS; i++) {
+                meas[i].anchor = tdoa_anchors[i];
+        }
+        test_fill(meas, TDOA_NANCHORS, &tag, 0.05);
+        rc = tdoa_solve(meas, TDOA_NANCHORS, 3, NULL, &result);
+        TEST_ASSERT_FATAL(rc == 0);
+        for (uint8_t c = 0; c < 3; c++) {
+                TEST_ASSERT(result.variance.array[c] > 0);
+                TEST_ASSERT(fabs(result.pos.array[c] - tag.array[c]) < 4 * sqrt(result.variance.array[c]));
+        }
+        TEST_ASSERT(result.rms < 0.1);
+
+        /* Case5 : 2D from a guess, z is ignored */
+        triad_t flat = {.x = 5, .y = 5, .z = 0}, guess = {.x = 1, .y = 1};
+        for (uint16_t i = 0; i < TDOA_NANCHORS; i++) {
+                meas[i].anchor.z = 0;
+        }
+        test_fill(meas, TDOA_NANCHORS, &flat, 0);
+        rc = tdoa_solve(meas, TDOA_NANCHORS, 2, &guess, &result);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(test_range(&result.pos, &flat) < 1e-6);
+        TEST_ASSERT(result.pos.z == 0);
+
+        /* Case6 : Too few arrivals */
+        rc = tdoa_solve(meas, 3, 3, NULL, &result);
+        TEST_ASSERT(rc == -1);
+
+        /* Case7 : 2D, the fit runs off to where every anchor is in one direction */
+        static const tdoa_meas_t runaway[] = {
+                {.anchor = {.x = 19.88, .y = 5.90}, .tdoa = 112.32750058346213},
+                {.anchor = {.x = 17.99, .y = 5.87}, .tdoa = 110.42558903969675},
+                {.anchor = {.x = 13.11, .y = 7.90}, .tdoa = 105.32222538004494},
+                {.anchor = {.x = 9.02, .y = 8.03}, .tdoa = 101.30989663228874},
+        };
+        memcpy(meas, runaway, sizeof(runaway));
+        for (uint16_t i = 0; i < 4; i++) {
+                meas[i].variance = 0.05 * 0.05;
+        }
+        rc = tdoa_solve(meas, 4, 2, NULL, &result);
+        TEST_ASSERT(rc == -2);
+
+        /* Case8 : Random 2D layouts, a solution always comes with a finite dilution */
+        for (uint16_t k = 0; k < 2000; k++) {
+                triad_t t = {.x = rand() % 2000 / 100.0, .y = rand() % 1500 / 100.0};
+                for (uint16_t i = 0; i < 4; i++) {
+                        meas[i].anchor.x = rand() % 2000 / 100.0;
+                        meas[i].anchor.y = rand() % 1500 / 100.0;
+                        meas[i].anchor.z = 0;
+                }
+                test_fill(meas, 4, &t, 0.05);
+                rc = tdoa_solve(meas, 4, 2, NULL, &result);
+                TEST_ASSERT(rc != 0 || isfinite(result.gdop));
+        }
+}
@@ -0,0 +1,128 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdlib.h>
+#include "euclid_test.h"
+#include "euclid/track.h"
+
+#define TRACK_TEST_TAGS     (4)
+
+static const triad_t track_anchors[] = {
+        {.x = 0, .y = 0, .z = 2.5},
+        {.x = 20, .y = 0, .z = 3.0},
+        {.x = 20, .y = 15, .z = 0.5},
+        {.x = 0, .y = 15, .z = 2.8},
+        {.x = 10, .y = -2, .z = 0.3},
+        {.x = 10, .y = 17, .z = 3.1},
+};
+#define TRACK_NANCHORS (sizeof(track_anchors) / sizeof(track_anchors[0]))
+
+static double
+test_range(const triad_t * a, const triad_t * b)
+{
+        return sqrt((a->x - b->x) * (a->x - b->x) + (a->y - b->y) * (a->y - b->y) +
+                    (a->z - b->z) * (a->z - b->z));
+}
+
+static double
+test_noise(double sigma)
+{
+        double s = 0;
+        for (int k = 0; k < 12; k++) {
+                s += (double)rand() / RAND_MAX;
+        }
+        return (s - 6) * sigma;
+}
+
+/* Tag walking at 1 m/s along x, seen by one anchor every 10 ms */
+static void
+test_walk(uint64_t utime, triad_t * tag)
+{
+        tag->x = 3 + utime * 1e-6;
+        tag->y = 6;
+        tag->z = 1.2;
+}
+
+TEST_CASE_SELF(euclid_test_track)
+{
+        static track_t storage[TRACK_TEST_TAGS];
+        track_config_t config = {.dim = 3, .accel_noise = 0.5, .variance = 0.05 * 0.05, .gate = 5,
+                                 .expiry = 2000000};
+        track_table_t table;
+        triad_t tag, pos, vel, var;
+        track_t * track;
+        uint64_t utime = 0;
+        int rc;
+
+        srand(5);
+        track_table_init(&table, storage, TRACK_TEST_TAGS, &config);
+
+        /* Case1 : Ranges one at a time, the track starts once dim + 2 anchors are heard */
+        for (int i = 0; i < 1000; i++, utime += 10000) {
+                const triad_t * a = &track_anchors[i % TRACK_NANCHORS];
+                test_walk(utime, &tag);
+                rc = track_range(&table, 0x1234, utime, a, test_range(a, &tag) + test_noise(0.05), 0);
+                TEST_ASSERT_FATAL(rc == ((i < 4) ? 1 : 0) || rc == -2);
+        }
+        track = track_find(&table, 0x1234);
+        TEST_ASSERT_FATAL(track && track->state == TRACK_ACTIVE);
+        TEST_ASSERT(track->rejected < 10);
+        rc = track_position(&table, track, utime, &pos, &vel, &var);
+        test_walk(utime, &tag);
+        TEST_ASSERT(rc == 0);
+        TEST_ASSERT(fabs(pos.x - tag.x) < 0.1 && fabs(pos.y - tag.y) < 0.1);
+        TEST_ASSERT(fabs(pos.z - tag.z) < 4 * sqrt(var.z));
+        TEST_ASSERT(fabs(vel.x - 1) < 0.2 && fabs(vel.y) < 0.2);
+
+        /* Case2 : A 2 m reflection is gated out */
+        uint32_t rejected = track->rejected;
+        rc = track_range(&table, 0x1234, utime, &track_anchors[0], test_range(&track_anchors[0], &tag) + 2, 0);
+        TEST_ASSERT(rc == -2 && track->rejected == rejected + 1);
+
+        /* Case3 : Arrivals of 6 anchor rounds at 10 Hz, each round with its own offset */
+        for (int r = 0; r < 100; r++) {
+                double offset = 1000.0 * rand() / RAND_MAX;
+                for (uint16_t i = 0; i < TRACK_NANCHORS; i++, utime += 1000) {
+                        const triad_t * a = &track_anchors[i];
+                        test_walk(utime, &tag);
+                        rc = track_tdoa(&table, 0x4321, utime, r, a, test_range(a, &tag) + offset + test_noise(0.05), 0);
+                        TEST_ASSERT(rc >= 0 || rc == -2);
+                }
+                utime += 100000 - 1000 * TRACK_NANCHORS;
+        }
+        track = track_find(&table, 0x4321);
+        TEST_ASSERT_FATAL(track && track->state == TRACK_ACTIVE && track->tdoa);
+        track_position(&table, track, utime, &pos, &vel, NULL);
+        test_walk(utime, &tag);
+        TEST_ASSERT(fabs(pos.x - tag.x) < 0.2 && fabs(pos.y - tag.y) < 0.2);
+        TEST_ASSERT(fabs(vel.x - 1) < 0.3);
+
+        /* Case4 : A full table refuses new tags, quiet tags expire and make room */
+        TEST_ASSERT(track_range(&table, 1, utime, &track_anchors[0], 5, 0) == 1);
+        TEST_ASSERT(track_range(&table, 2, utime, &track_anchors[0], 5, 0) == 1);
+        TEST_ASSERT(track_range(&table, 3, utime, &track_anchors[0], 5, 0) == -1);
+        /* The range track has been quiet since Case2 */
+        TEST_ASSERT(track_expire(&table, utime + 1000000) == 1);
+        TEST_ASSERT(track_find(&table, 0x1234) == NULL);
+        TEST_ASSERT(track_range(&table, 3, utime + 1000000, &track_anchors[0], 5, 0) == 1);
+        track_range(&table, 2, utime + 1500000, &track_anchors[0], 5, 0);
+        TEST_ASSERT(track_expire(&table, utime + 2500000) == 2);
+        TEST_ASSERT(table.ntracks == 2);
+        TEST_ASSERT(track_find(&table, 2) != NULL && track_find(&table, 3) != NULL);
+}
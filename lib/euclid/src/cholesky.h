@@ -0,0 +1,85 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file cholesky.h
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Small dense Cholesky factorisation shared by the position solvers
+ */
+
+#ifndef _EUCLID_CHOLESKY_H_
+#define _EUCLID_CHOLESKY_H_
+
+#include <stdint.h>
+#include <math.h>
+
+#define CHOLESKY_MAX    (4)     //!< Largest system, three coordinates and a clock offset
+
+/* In place Cholesky factor of the dim x dim matrix a, returns the number of columns factored */
+static inline int
+cholesky(double a[][CHOLESKY_MAX], uint8_t dim)
+{
+    double tol = 0;
+    uint8_t i, j, k;
+
+    for (j = 0; j < dim; j++) {
+        tol = fmax(tol, a[j][j] * 1e-12);
+    }
+    for (j = 0; j < dim; j++) {
+        double s = a[j][j];
+        for (k = 0; k < j; k++) {
+            s -= a[j][k] * a[j][k];
+        }
+        if (!(s > tol)) {
+            return j;
+        }
+        a[j][j] = sqrt(s);
+        for (i = j + 1; i < dim; i++) {
+            s = a[i][j];
+            for (k = 0; k < j; k++) {
+                s -= a[i][k] * a[j][k];
+            }
+            a[i][j] = s / a[j][j];
+        }
+    }
+    return dim;
+}
+
+/* Solve l l' x = b in place */
+static inline void
+cholesky_solve(double l[][CHOLESKY_MAX], uint8_t dim, double * b)
+{
+    int8_t i, k;
+
+    for (i = 0; i < dim; i++) {
+        for (k = 0; k < i; k++) {
+            b[i] -= l[i][k] * b[k];
+        }
+        b[i] /= l[i][i];
+    }
+    for (i = dim - 1; i >= 0; i--) {
+        for (k = i + 1; k < dim; k++) {
+            b[i] -= l[k][i] * b[k];
+        }
+        b[i] /= l[i][i];
+    }
+}
+
+#endif /* _EUCLID_CHOLESKY_H_ */
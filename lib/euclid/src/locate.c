@@ -0,0 +1,1334 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file locate.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Anchor localization from inter-anchor ranges
+ * @details
+ * ## Algorithm Details
+ * Missing ranges are first filled in with the shortest path through the range graph,
+ * and classical multidimensional scaling of that complete matrix gives the initial
+ * coordinates: the top dim eigenvectors of the double centered squared distance matrix,
+ * found by orthogonal iteration. The coordinates are then refined by Levenberg-Marquardt
+ * on the measured ranges only, minimising
+ *
+ * \f$\sum_{ab} (d_{ab} - \|x_a - x_b\|)^2 / \sigma^2_{ab}\f$
+ *
+ * Each Jacobian row touches two anchors, so the damped normal equations are solved with
+ * Jacobi preconditioned conjugate gradients without forming the matrix; an iteration
+ * costs O(ranges) and hundreds of anchors solve well within a second on a host.
+ * Anchors that settle on the wrong side of their neighbours in the least resolved
+ * direction are moved to their best fitting side and the refinement is repeated.
+ * Layouts that are close to flat, such as anchors a few meters apart in height over a
+ * large hall, also fold as a whole region. Such regions are reflected back through their
+ * mean height before refining again.
+ *
+ * Over a hall much larger than the range reach the shortest paths bend and the scaling
+ * leaves a sheet folded in too many places to undo. 3D layouts therefore start from small
+ * cliques of mutually ranged anchors, each scaled on its own and fitted onto the anchors
+ * already placed by the rotation or reflection that matches them best. Should the fit
+ * from that start still leave ranges far outside their variance, the patches are grown
+ * again from the other end of the layout, and then classical scaling is tried. Only when
+ * every start leaves such ranges is the fit reported as failed, with the lowest cost one
+ * returned.
+ *
+ * The result is expressed in a local frame: anchor 0 at the origin, the next anchor
+ * off the origin on the +x axis, the next one off that axis in the +y half plane and,
+ * in 3D, the next one off that plane at +z.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <euclid/locate.h>
+
+#define LOCATE_MAX_ITER     (200)       //!< Levenberg-Marquardt iterations
+#define LOCATE_EIG_ITER     (500)       //!< Orthogonal iterations for the scaling
+#define LOCATE_CG_ITER      (250)       //!< Conjugate gradient iterations per step
+#define LOCATE_TOL          (1e-12)     //!< Relative cost decrease considered converged
+#define LOCATE_RELOCATE_PASSES (16)     //!< Rounds of moving misplaced anchors or regions
+#define LOCATE_UNFOLD_SPLITS   (16)     //!< Directions, and offsets per direction, of the half planes tried
+#define LOCATE_REJECT_SIGMA    (6.0)    //!< Residual, in standard deviations, above which the fit fails
+#define LOCATE_PATCH_SIZE      (20)     //!< Anchors per patch of the 3D embedding
+
+static double
+range_weight(const locate_range_t * r)
+{
+    return 1.0 / ((r->variance > 0) ? r->variance : LOCATE_DEFAULT_VARIANCE);
+}
+
+static uint16_t
+root(uint16_t * parent, uint16_t i)
+{
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+/* All anchors must be linked by ranges for the geometry to be defined */
+static int
+connected(const locate_range_t * ranges, uint32_t nranges, uint16_t n)
+{
+    uint16_t * parent = malloc(n * sizeof(uint16_t));
+    uint16_t i, groups = n;
+    uint32_t k;
+
+    if (parent == NULL) {
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        parent[i] = i;
+    }
+    for (k = 0; k < nranges; k++) {
+        uint16_t ra = root(parent, ranges[k].a);
+        uint16_t rb = root(parent, ranges[k].b);
+        if (ra != rb) {
+            parent[ra] = rb;
+            groups--;
+        }
+    }
+    free(parent);
+    return groups == 1;
+}
+
+/* Orthonormalise the dim columns of v (n x dim, row major), returns the smallest norm */
+static double
+orthonormalise(double * v, uint16_t n, uint8_t dim)
+{
+    double dot, nrm, min = INFINITY;
+    uint16_t i;
+    uint8_t c, p;
+
+    for (c = 0; c < dim; c++) {
+        for (p = 0; p < c; p++) {
+            for (dot = 0, i = 0; i < n; i++) {
+                dot += v[i * dim + c] * v[i * dim + p];
+            }
+            for (i = 0; i < n; i++) {
+                v[i * dim + c] -= dot * v[i * dim + p];
+            }
+        }
+        for (nrm = 0, i = 0; i < n; i++) {
+            nrm += v[i * dim + c] * v[i * dim + c];
+        }
+        nrm = sqrt(nrm);
+        min = (nrm < min) ? nrm : min;
+        for (i = 0; i < n; i++) {
+            v[i * dim + c] = (nrm > 0) ? v[i * dim + c] / nrm : 0;
+        }
+    }
+    return min;
+}
+
+/* Classical multidimensional scaling, x is n x dim */
+static int
+locate_mds(const locate_range_t * ranges, uint32_t nranges, uint16_t n, uint8_t dim, double * x)
+{
+    double * d = malloc((size_t)n * n * sizeof(double));
+    double * w = malloc((size_t)n * n * sizeof(double));
+    double * v = malloc((size_t)n * dim * sizeof(double));
+    double * y = malloc((size_t)n * dim * sizeof(double));
+    double lambda[3] = {0};
+    uint16_t i, j, k;
+    uint32_t e;
+    uint8_t c;
+    int it, rc = -1;
+
+    if (d == NULL || w == NULL || v == NULL || y == NULL) {
+        goto done;
+    }
+
+    /* Inverse variance weighted mean of the ranges measured for each pair */
+    memset(d, 0, (size_t)n * n * sizeof(double));
+    memset(w, 0, (size_t)n * n * sizeof(double));
+    for (e = 0; e < nranges; e++) {
+        const locate_range_t * r = &ranges[e];
+        double wr = range_weight(r);
+        d[r->a * n + r->b] += wr * r->range;
+        d[r->b * n + r->a] += wr * r->range;
+        w[r->a * n + r->b] += wr;
+        w[r->b * n + r->a] += wr;
+    }
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
+            d[i * n + j] = (i == j) ? 0 : (w[i * n + j] > 0) ? d[i * n + j] / w[i * n + j] : INFINITY;
+        }
+    }
+
+    /* Shortest paths stand in for the missing ranges */
+    for (k = 0; k < n; k++) {
+        for (i = 0; i < n; i++) {
+            double dik = d[i * n + k];
+            if (isinf(dik)) {
+                continue;
+            }
+            for (j = 0; j < n; j++) {
+                if (dik + d[k * n + j] < d[i * n + j]) {
+                    d[i * n + j] = dik + d[k * n + j];
+                }
+            }
+        }
+    }
+
+    /* Double centering of the squared distances, w is reused for the row means */
+    double mean = 0;
+    for (i = 0; i < n; i++) {
+        w[i] = 0;
+        for (j = 0; j < n; j++) {
+            d[i * n + j] *= d[i * n + j];
+            w[i] += d[i * n + j];
+        }
+        w[i] /= n;
+        mean += w[i];
+    }
+    mean /= n;
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
+            d[i * n + j] = -0.5 * (d[i * n + j] - w[i] - w[j] + mean);
+        }
+    }
+
+    /* Orthogonal iteration for the dominant eigenvectors, fixed start for repeatable results */
+    for (i = 0; i < n; i++) {
+        for (c = 0; c < dim; c++) {
+            v[i * dim + c] = cos(1.0 + i * (c + 1) * 0.7548776662) + ((i % dim) == c);
+        }
+    }
+    orthonormalise(v, n, dim);
+    for (it = 0; it < LOCATE_EIG_ITER; it++) {
+        double change = 0;
+        memset(y, 0, (size_t)n * dim * sizeof(double));
+        for (i = 0; i < n; i++) {
+            for (j = 0; j < n; j++) {
+                double bij = d[i * n + j];
+                for (c = 0; c < dim; c++) {
+                    y[i * dim + c] += bij * v[j * dim + c];
+                }
+            }
+        }
+        for (c = 0; c < dim; c++) {
+            for (lambda[c] = 0, i = 0; i < n; i++) {
+                lambda[c] += v[i * dim + c] * y[i * dim + c];
+            }
+        }
+        orthonormalise(y, n, dim);
+        for (c = 0; c < dim; c++) {
+            double dot = 0;
+            for (i = 0; i < n; i++) {
+                dot += v[i * dim + c] * y[i * dim + c];
+            }
+            change = fmax(change, 1 - fabs(dot));
+        }
+        memcpy(v, y, (size_t)n * dim * sizeof(double));
+        if (change < 1e-12) {
+            break;
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        for (c = 0; c < dim; c++) {
+            x[i * dim + c] = v[i * dim + c] * sqrt(fmax(lambda[c], 0));
+        }
+    }
+    rc = 0;
+
+done:
+    free(d);
+    free(w);
+    free(v);
+    free(y);
+    return rc;
+}
+
+/* Jacobi eigen decomposition of the symmetric a, eigenvalues end up on its diagonal, the
+ * eigenvectors in the columns of v */
+static void
+locate_eig3(double a[3][3], double v[3][3])
+{
+    uint8_t p, q, k;
+    int sweep;
+
+    for (p = 0; p < 3; p++) {
+        for (q = 0; q < 3; q++) {
+            v[p][q] = (p == q);
+        }
+    }
+    for (sweep = 0; sweep < 50; sweep++) {
+        if (a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2] <
+            1e-30 * (a[0][0] * a[0][0] + a[1][1] * a[1][1] + a[2][2] * a[2][2])) {
+            break;
+        }
+        for (p = 0; p < 2; p++) {
+            for (q = p + 1; q < 3; q++) {
+                double theta, t, c, s;
+                if (a[p][q] == 0) {
+                    continue;
+                }
+                theta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+                t = ((theta < 0) ? -1 : 1) / (fabs(theta) + sqrt(theta * theta + 1));
+                c = 1 / sqrt(t * t + 1);
+                s = t * c;
+                for (k = 0; k < 3; k++) {
+                    double akp = a[k][p], akq = a[k][q];
+                    a[k][p] = c * akp - s * akq;
+                    a[k][q] = s * akp + c * akq;
+                }
+                for (k = 0; k < 3; k++) {
+                    double apk = a[p][k], aqk = a[q][k];
+                    a[p][k] = c * apk - s * aqk;
+                    a[q][k] = s * apk + c * aqk;
+                }
+                for (k = 0; k < 3; k++) {
+                    double vkp = v[k][p], vkq = v[k][q];
+                    v[k][p] = c * vkp - s * vkq;
+                    v[k][q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Rotation or reflection m that best maps the n centered points p onto q, both n x 3. Flat
+ * point sets fit almost as well mirrored; fails when the mirrored fit is not clearly worse
+ * than amb times the residual of the best one, amb 0 accepts any non degenerate fit.
+ */
+static int
+locate_align(const double * p, const double * q, uint16_t n, double amb, double m[3][3])
+{
+    double a[3][3] = {{0}}, ata[3][3] = {{0}}, v[3][3], s[3], sse = 0;
+    uint16_t i;
+    uint8_t r, c, k;
+
+    for (i = 0; i < n; i++) {
+        for (r = 0; r < 3; r++) {
+            sse += p[i * 3 + r] * p[i * 3 + r] + q[i * 3 + r] * q[i * 3 + r];
+            for (c = 0; c < 3; c++) {
+                a[r][c] += q[i * 3 + r] * p[i * 3 + c];
+            }
+        }
+    }
+    for (r = 0; r < 3; r++) {
+        for (c = 0; c < 3; c++) {
+            for (k = 0; k < 3; k++) {
+                ata[r][c] += a[k][r] * a[k][c];
+            }
+        }
+    }
+    locate_eig3(ata, v);
+    for (k = 0; k < 3; k++) {
+        s[k] = sqrt(fmax(ata[k][k], 0));
+        if (!(s[k] > 0)) {
+            return -1;
+        }
+        sse -= 2 * s[k];
+    }
+    /* Mirroring costs four times the smallest singular value in squared error */
+    if (4 * fmin(s[0], fmin(s[1], s[2])) < amb * sse) {
+        return -1;
+    }
+    /* The orthogonal polar factor a (a'a)^-1/2 */
+    for (r = 0; r < 3; r++) {
+        for (c = 0; c < 3; c++) {
+            double t = 0;
+            for (k = 0; k < 3; k++) {
+                uint8_t j;
+                double av = 0;
+                for (j = 0; j < 3; j++) {
+                    av += a[r][j] * v[j][k];
+                }
+                t += av * v[c][k] / s[k];
+            }
+            m[r][c] = t;
+        }
+    }
+    return 0;
+}
+
+//! Work memory of the patch embedding
+typedef struct _locate_stitch_t{
+    uint16_t * order;   //!< Anchors in breadth first order
+    uint16_t * cand;    //!< Neighbours of the current anchor
+    double * cand_key;  //!< Sort key of cand
+    uint32_t * mark;    //!< Neighbour stamps, n entries
+    int16_t * local;    //!< Patch index of every anchor, -1 outside
+    locate_range_t * sub;   //!< Ranges within the patch
+    uint32_t stamp;     //!< Last stamp used in mark
+    uint16_t mem[LOCATE_PATCH_SIZE];        //!< Patch members, global index
+    double xp[LOCATE_PATCH_SIZE * 3];       //!< Patch coordinates
+    double pp[LOCATE_PATCH_SIZE * 3];       //!< Centered patch coordinates of placed members
+    double qq[LOCATE_PATCH_SIZE * 3];       //!< Centered coordinates of placed members
+}locate_stitch_t;
+
+static double
+locate_cost(const locate_range_t * ranges, uint32_t nranges, uint8_t dim, const double * x)
+{
+    double cost = 0;
+    uint32_t e;
+    uint8_t c;
+
+    for (e = 0; e < nranges; e++) {
+        const locate_range_t * r = &ranges[e];
+        double dist = 0;
+        for (c = 0; c < dim; c++) {
+            double dc = x[r->a * dim + c] - x[r->b * dim + c];
+            dist += dc * dc;
+        }
+        dist = sqrt(dist) - r->range;
+        cost += range_weight(r) * dist * dist;
+    }
+    return cost;
+}
+
+/* Unit vectors from b to a for every range, zero for coincident anchors */
+static void
+locate_units(const locate_range_t * ranges, uint32_t nranges, uint8_t dim, const double * x,
+             double * u, double * res)
+{
+    uint32_t e;
+    uint8_t c;
+
+    for (e = 0; e < nranges; e++) {
+        const locate_range_t * r = &ranges[e];
+        double dist = 0;
+        for (c = 0; c < dim; c++) {
+            u[e * dim + c] = x[r->a * dim + c] - x[r->b * dim + c];
+            dist += u[e * dim + c] * u[e * dim + c];
+        }
+        dist = sqrt(dist);
+        for (c = 0; c < dim; c++) {
+            u[e * dim + c] = (dist > 0) ? u[e * dim + c] / dist : 0;
+        }
+        res[e] = dist - r->range;
+    }
+}
+
+/* y = (J'WJ + lambda * diag) p */
+static void
+locate_normal_mul(const locate_range_t * ranges, uint32_t nranges, uint16_t n, uint8_t dim,
+                  const double * u, const double * diag, double lambda, const double * p, double * y)
+{
+    uint32_t e, i;
+    uint8_t c;
+
+    for (i = 0; i < (uint32_t)n * dim; i++) {
+        y[i] = lambda * diag[i] * p[i];
+    }
+    for (e = 0; e < nranges; e++) {
+        const locate_range_t * r = &ranges[e];
+        double s = 0;
+        for (c = 0; c < dim; c++) {
+            s += u[e * dim + c] * (p[r->a * dim + c] - p[r->b * dim + c]);
+        }
+        s *= range_weight(r);
+        for (c = 0; c < dim; c++) {
+            y[r->a * dim + c] += s * u[e * dim + c];
+            y[r->b * dim + c] -= s * u[e * dim + c];
+        }
+    }
+}
+
+/* Express x in the local frame described in the file header */
+static void
+locate_frame(double * x, uint16_t n, uint8_t dim)
+{
+    double e[3][3] = {{0}}, o[3], scale = 0, eps, t;
+    uint16_t i, k = 0;
+    uint8_t c, a;
+
+    memcpy(o, x, dim * sizeof(double));
+    for (i = 0; i < n; i++) {
+        for (t = 0, c = 0; c < dim; c++) {
+            x[i * dim + c] -= o[c];
+            t += x[i * dim + c] * x[i * dim + c];
+        }
+        scale = fmax(scale, sqrt(t));
+    }
+    eps = 1e-9 * scale;
+
+    /* Build the axes one at a time from the first anchor that is off the previous ones */
+    for (a = 0; a < dim; a++) {
+        double v[3];
+        for (; k < n; k++) {
+            for (c = 0; c < dim; c++) {
+                v[c] = x[k * dim + c];
+            }
+            for (uint8_t p = 0; p < a; p++) {
+                for (t = 0, c = 0; c < dim; c++) {
+                    t += v[c] * e[p][c];
+                }
+                for (c = 0; c < dim; c++) {
+                    v[c] -= t * e[p][c];
+                }
+            }
+            for (t = 0, c = 0; c < dim; c++) {
+                t += v[c] * v[c];
+            }
+            if (sqrt(t) > eps) {
+                break;
+            }
+        }
+        if (k == n) {
+            /* Degenerate layout, complete the basis with any orthogonal axis */
+            for (c = 0; c < dim; c++) {
+                v[c] = (c == a);
+            }
+            for (uint8_t p = 0; p < a; p++) {
+                for (t = 0, c = 0; c < dim; c++) {
+                    t += v[c] * e[p][c];
+                }
+                for (c = 0; c < dim; c++) {
+                    v[c] -= t * e[p][c];
+                }
+            }
+            for (t = 0, c = 0; c < dim; c++) {
+                t += v[c] * v[c];
+            }
+        }
+        for (c = 0; c < dim; c++) {
+            e[a][c] = v[c] / sqrt(t);
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        double p[3];
+        for (a = 0; a < dim; a++) {
+            for (p[a] = 0, c = 0; c < dim; c++) {
+                p[a] += x[i * dim + c] * e[a][c];
+            }
+        }
+        memcpy(&x[i * dim], p, dim * sizeof(double));
+    }
+}
+
+//! Work memory of the refinement
+typedef struct _locate_work_t{
+    const locate_range_t * ranges;
+    uint32_t nranges;
+    uint16_t n;
+    uint8_t dim;
+    double * x;         //!< Coordinates, n x dim
+    double * xt;        //!< Trial coordinates
+    double * xb;        //!< Fit from the first start while restarting
+    double * g;         //!< Gradient
+    double * diag;      //!< Diagonal of the normal matrix
+    double * dx;        //!< Step
+    double * cr, * cz, * cp, * cq;  //!< Conjugate gradient vectors
+    double * u;         //!< Unit vectors, nranges x dim
+    double * res;       //!< Solved minus measured ranges
+    uint32_t * adj_off; //!< Start of the ranges of each anchor in adj, n + 1 entries
+    uint32_t * adj;     //!< Range indices grouped by anchor, 2 x nranges
+    uint8_t * sel;      //!< Anchors in the region being reflected
+}locate_work_t;
+
+/*
+ * Patch around anchor k: k and up to LOCATE_PATCH_SIZE - 1 neighbours that are all ranged to
+ * each other, so its own scaling needs no shortest paths. Placed neighbours are taken first,
+ * nearest first. Fills st->mem and st->local, returns the number of members.
+ */
+static uint16_t
+locate_patch(const locate_work_t * w, locate_stitch_t * st, uint16_t k, const uint8_t * placed)
+{
+    uint16_t m = 0, nc = 0, p, q, j, o;
+    uint32_t a;
+
+    for (a = w->adj_off[k]; a < w->adj_off[k + 1]; a++) {
+        const locate_range_t * r = &w->ranges[w->adj[a]];
+        double key;
+        o = (r->a == k) ? r->b : r->a;
+        key = r->range + (placed[o] ? 0 : 1e6);
+        for (q = nc++; q > 0 && st->cand_key[q - 1] > key; q--) {
+            st->cand[q] = st->cand[q - 1];
+            st->cand_key[q] = st->cand_key[q - 1];
+        }
+        st->cand[q] = o;
+        st->cand_key[q] = key;
+    }
+
+    st->mem[m] = k;
+    st->local[k] = m++;
+    for (p = 0; p < nc && m < LOCATE_PATCH_SIZE; p++) {
+        o = st->cand[p];
+        if (st->local[o] >= 0) {
+            continue;
+        }
+        st->stamp++;
+        for (a = w->adj_off[o]; a < w->adj_off[o + 1]; a++) {
+            const locate_range_t * r = &w->ranges[w->adj[a]];
+            st->mark[(r->a == o) ? r->b : r->a] = st->stamp;
+        }
+        for (j = 0; j < m && st->mark[st->mem[j]] == st->stamp; j++);
+        if (j == m) {
+            st->mem[m] = o;
+            st->local[o] = m++;
+        }
+    }
+    return m;
+}
+
+/*
+ * Initial 3D coordinates from overlapping patches. Over a large flat hall the shortest paths
+ * bend, the scaling resolves the height poorly and the refinement then settles in a folded
+ * sheet that no single reflection undoes. Each patch is a small clique that scales well on its
+ * own; starting from the best connected anchor, or with far set from the anchor farthest from
+ * it, patches are fitted onto the anchors already placed, with reflection allowed, until all
+ * anchors are placed. Patches too flat to tell their mirror image apart wait for more placed
+ * neighbours, and are only accepted when no other patch can make progress. Uses w->sel as
+ * placed flags, returns 0 if every anchor was placed.
+ */
+static int
+locate_stitch(locate_work_t * w, uint8_t far)
+{
+    uint16_t n = w->n, i, j, k, m, np, head, tail = 0, start = 0, nplaced = 0, before;
+    uint32_t a, maxdeg = 0, ns;
+    uint8_t * placed = w->sel, r, c, pass;
+    double amb = 1;
+    int rc = -1;
+    locate_stitch_t st = {0};
+
+    for (i = 0; i < n; i++) {
+        if (w->adj_off[i + 1] - w->adj_off[i] > maxdeg) {
+            maxdeg = w->adj_off[i + 1] - w->adj_off[i];
+            start = i;
+        }
+    }
+    st.order = malloc(n * sizeof(uint16_t));
+    st.cand = malloc(maxdeg * sizeof(uint16_t));
+    st.cand_key = malloc(maxdeg * sizeof(double));
+    st.mark = calloc(n, sizeof(uint32_t));
+    st.local = malloc(n * sizeof(int16_t));
+    st.sub = malloc((size_t)LOCATE_PATCH_SIZE * maxdeg * sizeof(locate_range_t));
+    if (st.order == NULL || st.cand == NULL || st.cand_key == NULL || st.mark == NULL ||
+        st.local == NULL || st.sub == NULL) {
+        goto done;
+    }
+
+    /* Breadth first order from the start anchor, placed is the visited flag here. The last
+     * anchor reached is the start of the second pass when far is set */
+    for (pass = 0; pass <= far; pass++) {
+        start = (pass) ? st.order[tail - 1] : start;
+        memset(placed, 0, n);
+        tail = 0;
+        st.order[tail++] = start;
+        placed[start] = 1;
+        for (head = 0; head < tail; head++) {
+            k = st.order[head];
+            for (a = w->adj_off[k]; a < w->adj_off[k + 1]; a++) {
+                const locate_range_t * e = &w->ranges[w->adj[a]];
+                i = (e->a == k) ? e->b : e->a;
+                if (!placed[i]) {
+                    placed[i] = 1;
+                    st.order[tail++] = i;
+                }
+            }
+        }
+    }
+    memset(placed, 0, n);
+    for (i = 0; i < n; i++) {
+        st.local[i] = -1;
+    }
+
+    while (nplaced < n) {
+        before = nplaced;
+        for (head = 0; head < tail; head++) {
+            double pc[3] = {0}, qc[3] = {0}, rot[3][3];
+
+            m = locate_patch(w, &st, st.order[head], placed);
+            for (np = 0, j = 0; j < m; j++) {
+                np += placed[st.mem[j]];
+            }
+            if (m < 4 || np == m || (nplaced > 0 && np < 4)) {
+                goto next;
+            }
+
+            /* Each range within the patch once, from the side of its first anchor */
+            for (ns = 0, j = 0; j < m; j++) {
+                k = st.mem[j];
+                for (a = w->adj_off[k]; a < w->adj_off[k + 1]; a++) {
+                    const locate_range_t * e = &w->ranges[w->adj[a]];
+                    if (e->a != k || st.local[e->b] < 0) {
+                        continue;
+                    }
+                    st.sub[ns] = *e;
+                    st.sub[ns].a = j;
+                    st.sub[ns].b = st.local[e->b];
+                    ns++;
+                }
+            }
+            if (locate_mds(st.sub, ns, m, 3, st.xp)) {
+                goto done;
+            }
+
+            if (nplaced == 0) {
+                for (j = 0; j < m; j++) {
+                    memcpy(&w->x[st.mem[j] * 3], &st.xp[j * 3], 3 * sizeof(double));
+                    placed[st.mem[j]] = 1;
+                }
+                nplaced = m;
+                goto next;
+            }
+
+            for (j = 0; j < m; j++) {
+                if (placed[st.mem[j]]) {
+                    for (c = 0; c < 3; c++) {
+                        pc[c] += st.xp[j * 3 + c] / np;
+                        qc[c] += w->x[st.mem[j] * 3 + c] / np;
+                    }
+                }
+            }
+            for (i = 0, j = 0; j < m; j++) {
+                if (placed[st.mem[j]]) {
+                    for (c = 0; c < 3; c++) {
+                        st.pp[i * 3 + c] = st.xp[j * 3 + c] - pc[c];
+                        st.qq[i * 3 + c] = w->x[st.mem[j] * 3 + c] - qc[c];
+                    }
+                    i++;
+                }
+            }
+            if (locate_align(st.pp, st.qq, np, amb, rot)) {
+                goto next;
+            }
+            for (j = 0; j < m; j++) {
+                if (placed[st.mem[j]]) {
+                    continue;
+                }
+                for (r = 0; r < 3; r++) {
+                    double s = qc[r];
+                    for (c = 0; c < 3; c++) {
+                        s += rot[r][c] * (st.xp[j * 3 + c] - pc[c]);
+                    }
+                    w->x[st.mem[j] * 3 + r] = s;
+                }
+                placed[st.mem[j]] = 1;
+                nplaced++;
+            }
+next:
+            for (j = 0; j < m; j++) {
+                st.local[st.mem[j]] = -1;
+            }
+        }
+        if (nplaced == before) {
+            if (amb == 0) {
+                break;
+            }
+            amb = (amb > 0.5) ? amb / 2 : 0;
+        }
+    }
+
+    /* Anchors with too few ranges for any patch start at the mean of their placed neighbours,
+     * which is enough for the refinement and relocation to finish them */
+    for (before = 0; nplaced < n && nplaced != before;) {
+        before = nplaced;
+        for (i = 0; i < n; i++) {
+            double s[3] = {0}, range = 0;
+            if (placed[i]) {
+                continue;
+            }
+            for (np = 0, a = w->adj_off[i]; a < w->adj_off[i + 1]; a++) {
+                const locate_range_t * e = &w->ranges[w->adj[a]];
+                k = (e->a == i) ? e->b : e->a;
+                if (placed[k] == 1) {
+                    for (c = 0; c < 3; c++) {
+                        s[c] += w->x[k * 3 + c];
+                    }
+                    range = e->range;
+                    np++;
+                }
+            }
+            if (np) {
+                for (c = 0; c < 3; c++) {
+                    w->x[i * 3 + c] = s[c] / np;
+                }
+                /* Off a single neighbour, so that its range has a direction */
+                w->x[i * 3] += (np == 1) ? range : 0;
+                placed[i] = 2;
+            }
+        }
+        for (i = 0; i < n; i++) {
+            if (placed[i] == 2) {
+                placed[i] = 1;
+                nplaced++;
+            }
+        }
+    }
+    rc = (nplaced == n) ? 0 : -1;
+
+done:
+    free(st.order);
+    free(st.cand);
+    free(st.cand_key);
+    free(st.mark);
+    free(st.local);
+    free(st.sub);
+    return rc;
+}
+
+/* Levenberg-Marquardt from w->x, returns the number of iterations */
+static uint16_t
+locate_refine(locate_work_t * w)
+{
+    const locate_range_t * ranges = w->ranges;
+    uint32_t nranges = w->nranges, nx = (uint32_t)w->n * w->dim, e, i;
+    uint8_t dim = w->dim, c;
+    double cost, new_cost = 0, lambda = 0;
+    uint16_t it;
+
+    cost = locate_cost(ranges, nranges, dim, w->x);
+    for (it = 0; it < LOCATE_MAX_ITER && cost > 0; it++) {
+        double rz, rz0, rz_new, alpha, gnorm = 0;
+
+        /* Gradient and diagonal of the Gauss-Newton normal matrix */
+        locate_units(ranges, nranges, dim, w->x, w->u, w->res);
+        memset(w->g, 0, nx * sizeof(double));
+        memset(w->diag, 0, nx * sizeof(double));
+        for (e = 0; e < nranges; e++) {
+            const locate_range_t * r = &ranges[e];
+            double wr = range_weight(r);
+            for (c = 0; c < dim; c++) {
+                double uc = w->u[e * dim + c];
+                w->g[r->a * dim + c] += wr * w->res[e] * uc;
+                w->g[r->b * dim + c] -= wr * w->res[e] * uc;
+                w->diag[r->a * dim + c] += wr * uc * uc;
+                w->diag[r->b * dim + c] += wr * uc * uc;
+            }
+        }
+        for (i = 0; i < nx; i++) {
+            /* Keeps the damping effective for coordinates no range constrains yet */
+            w->diag[i] = fmax(w->diag[i], 1e-9);
+            gnorm = fmax(gnorm, fabs(w->g[i]));
+            lambda = (it == 0) ? fmax(lambda, 1e-3 * w->diag[i]) : lambda;
+        }
+        if (gnorm < 1e-12) {
+            break;
+        }
+
+        for (;;) {
+            /* Preconditioned conjugate gradients on (J'WJ + lambda diag) dx = -g */
+            memset(w->dx, 0, nx * sizeof(double));
+            for (rz = 0, i = 0; i < nx; i++) {
+                w->cr[i] = -w->g[i];
+                w->cz[i] = w->cr[i] / ((1 + lambda) * w->diag[i]);
+                w->cp[i] = w->cz[i];
+                rz += w->cr[i] * w->cz[i];
+            }
+            rz0 = rz;
+            for (uint16_t k = 0; k < LOCATE_CG_ITER && rz > 1e-6 * rz0; k++) {
+                double pq = 0;
+                locate_normal_mul(ranges, nranges, w->n, dim, w->u, w->diag, lambda, w->cp, w->cq);
+                for (i = 0; i < nx; i++) {
+                    pq += w->cp[i] * w->cq[i];
+                }
+                alpha = rz / pq;
+                for (rz_new = 0, i = 0; i < nx; i++) {
+                    w->dx[i] += alpha * w->cp[i];
+                    w->cr[i] -= alpha * w->cq[i];
+                    w->cz[i] = w->cr[i] / ((1 + lambda) * w->diag[i]);
+                    rz_new += w->cr[i] * w->cz[i];
+                }
+                for (i = 0; i < nx; i++) {
+                    w->cp[i] = w->cz[i] + rz_new / rz * w->cp[i];
+                }
+                rz = rz_new;
+            }
+
+            for (i = 0; i < nx; i++) {
+                w->xt[i] = w->x[i] + w->dx[i];
+            }
+            new_cost = locate_cost(ranges, nranges, dim, w->xt);
+            if (new_cost < cost || lambda > 1e16) {
+                break;
+            }
+            lambda *= 4;
+        }
+        if (!(new_cost < cost)) {
+            break;
+        }
+        lambda /= 3;
+        memcpy(w->x, w->xt, nx * sizeof(double));
+        if (cost - new_cost < LOCATE_TOL * cost) {
+            it++;
+            break;
+        }
+        cost = new_cost;
+    }
+    return it;
+}
+
+/* Cost of the ranges of anchor i with its last coordinate at z */
+static double
+locate_anchor_cost(const locate_work_t * w, uint16_t i, double z)
+{
+    uint8_t dim = w->dim, c;
+    double cost = 0;
+    uint32_t k;
+
+    for (k = w->adj_off[i]; k < w->adj_off[i + 1]; k++) {
+        const locate_range_t * r = &w->ranges[w->adj[k]];
+        uint16_t j = (r->a == i) ? r->b : r->a;
+        double dist = (z - w->x[j * dim + dim - 1]) * (z - w->x[j * dim + dim - 1]);
+        for (c = 0; c < dim - 1; c++) {
+            dist += (w->x[i * dim + c] - w->x[j * dim + c]) * (w->x[i * dim + c] - w->x[j * dim + c]);
+        }
+        dist = sqrt(dist) - r->range;
+        cost += range_weight(r) * dist * dist;
+    }
+    return cost;
+}
+
+/*
+ * The scaling resolves the smallest extent of the layout worst, typically the height of
+ * anchors mounted close to one plane, and an anchor that starts on the wrong side of its
+ * neighbours stays there. With the other anchors held, each range fits exactly at two
+ * values of the last coordinate; move every anchor to the candidate that fits all of its
+ * ranges clearly better, returns the number of anchors moved.
+ */
+static uint16_t
+locate_relocate(locate_work_t * w)
+{
+    uint8_t dim = w->dim, c;
+    uint16_t i, count = 0;
+    uint32_t k;
+
+    for (i = 0; i < w->n; i++) {
+        double z = w->x[i * dim + dim - 1];
+        double best = locate_anchor_cost(w, i, z), cost, zbest = z;
+        for (k = w->adj_off[i]; k < w->adj_off[i + 1]; k++) {
+            const locate_range_t * r = &w->ranges[w->adj[k]];
+            uint16_t j = (r->a == i) ? r->b : r->a;
+            double h = r->range * r->range;
+            for (c = 0; c < dim - 1; c++) {
+                h -= (w->x[i * dim + c] - w->x[j * dim + c]) * (w->x[i * dim + c] - w->x[j * dim + c]);
+            }
+            h = sqrt(fmax(h, 0));
+            for (int8_t s = -1; s <= 1; s += 2) {
+                cost = locate_anchor_cost(w, i, w->x[j * dim + dim - 1] + s * h);
+                if (cost < best) {
+                    best = cost;
+                    zbest = w->x[j * dim + dim - 1] + s * h;
+                }
+            }
+        }
+        if (best < 0.5 * locate_anchor_cost(w, i, z)) {
+            w->x[i * dim + dim - 1] = zbest;
+            count++;
+        }
+    }
+    return count;
+}
+
+/*
+ * Height of every anchor along the normal of the plane that best fits the layout, and its
+ * coordinates within that plane. u, v and h are n entries each.
+ */
+static void
+locate_plane(const double * x, uint16_t n, double * u, double * v, double * h, double * nrm)
+{
+    double cen[3] = {0}, cov[3][3] = {{0}}, e1[3], e2[3], t;
+    uint16_t i;
+    uint8_t c, d;
+    int it;
+
+    for (i = 0; i < n; i++) {
+        for (c = 0; c < 3; c++) {
+            cen[c] += x[i * 3 + c] / n;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        for (c = 0; c < 3; c++) {
+            for (d = 0; d < 3; d++) {
+                cov[c][d] += (x[i * 3 + c] - cen[c]) * (x[i * 3 + d] - cen[d]);
+            }
+        }
+    }
+    /* The normal is the dominant eigenvector of trace * I - cov */
+    t = cov[0][0] + cov[1][1] + cov[2][2];
+    nrm[0] = nrm[1] = 0;
+    nrm[2] = 1;
+    for (it = 0; it < LOCATE_EIG_ITER; it++) {
+        double y[3] = {0}, m = 0;
+        for (c = 0; c < 3; c++) {
+            for (d = 0; d < 3; d++) {
+                y[c] += ((c == d) * t - cov[c][d]) * nrm[d];
+            }
+            m += y[c] * y[c];
+        }
+        if (m == 0) {
+            break;
+        }
+        for (c = 0; c < 3; c++) {
+            nrm[c] = y[c] / sqrt(m);
+        }
+    }
+
+    c = (fabs(nrm[0]) < 0.6) ? 0 : 1;
+    for (t = 0, d = 0; d < 3; d++) {
+        e1[d] = (d == c) - nrm[c] * nrm[d];
+        t += e1[d] * e1[d];
+    }
+    for (d = 0; d < 3; d++) {
+        e1[d] /= sqrt(t);
+    }
+    e2[0] = nrm[1] * e1[2] - nrm[2] * e1[1];
+    e2[1] = nrm[2] * e1[0] - nrm[0] * e1[2];
+    e2[2] = nrm[0] * e1[1] - nrm[1] * e1[0];
+
+    for (i = 0; i < n; i++) {
+        u[i] = v[i] = h[i] = 0;
+        for (c = 0; c < 3; c++) {
+            u[i] += (x[i * 3 + c] - cen[c]) * e1[c];
+            v[i] += (x[i * 3 + c] - cen[c]) * e2[c];
+            h[i] += (x[i * 3 + c] - cen[c]) * nrm[c];
+        }
+    }
+}
+
+/*
+ * Select region cand into w->sel: the first LOCATE_UNFOLD_SPLITS^2 are half planes, the
+ * rest discs of half and of the whole longest range around each anchor. Returns the mean
+ * height of the region, NAN when it is empty or holds every anchor.
+ */
+static double
+locate_region(locate_work_t * w, uint32_t cand, double rmax, const double * u, const double * v,
+              const double * h)
+{
+    uint16_t n = w->n, i, count = 0;
+    double mean = 0;
+
+    if (cand < LOCATE_UNFOLD_SPLITS * LOCATE_UNFOLD_SPLITS) {
+        double a = M_PI * (cand / LOCATE_UNFOLD_SPLITS) / LOCATE_UNFOLD_SPLITS;
+        double lo = INFINITY, hi = -INFINITY, split;
+        for (i = 0; i < n; i++) {
+            lo = fmin(lo, u[i] * cos(a) + v[i] * sin(a));
+            hi = fmax(hi, u[i] * cos(a) + v[i] * sin(a));
+        }
+        split = lo + (hi - lo) * (cand % LOCATE_UNFOLD_SPLITS + 1) / (LOCATE_UNFOLD_SPLITS + 1);
+        for (i = 0; i < n; i++) {
+            w->sel[i] = (u[i] * cos(a) + v[i] * sin(a)) > split;
+        }
+    } else {
+        uint16_t k = (cand - LOCATE_UNFOLD_SPLITS * LOCATE_UNFOLD_SPLITS) / 2;
+        double radius = (cand & 1) ? rmax : 0.5 * rmax;
+        for (i = 0; i < n; i++) {
+            w->sel[i] = (u[i] - u[k]) * (u[i] - u[k]) + (v[i] - v[k]) * (v[i] - v[k]) < radius * radius;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        if (w->sel[i]) {
+            mean += h[i];
+            count++;
+        }
+    }
+    return (count == 0 || count == n) ? NAN : mean / count;
+}
+
+/*
+ * Near flat layouts also fold as a whole: a region of anchors ends up mirrored through its
+ * own mean height, consistent inside and strained only along the fold, which moving single
+ * anchors does not undo. Try reflecting half planes and discs of the layout along its normal
+ * and apply the region that lowers the cost the most. A reflection keeps the distances within
+ * the region, so only the ranges that cross its boundary need evaluating. 3D only, uses w->xt
+ * as scratch, returns 1 if a region was reflected.
+ */
+static int
+locate_unfold(locate_work_t * w)
+{
+    const locate_range_t * ranges = w->ranges;
+    uint16_t n = w->n, i;
+    uint32_t e, cand, best = 0;
+    uint32_t ncand = LOCATE_UNFOLD_SPLITS * LOCATE_UNFOLD_SPLITS + 2 * (uint32_t)n;
+    double * u = w->xt, * v = w->xt + n, * h = w->xt + 2 * n;
+    double nrm[3], mean, gain = 0, rmax = 0;
+    uint8_t c;
+
+    locate_plane(w->x, n, u, v, h, nrm);
+    for (e = 0; e < w->nranges; e++) {
+        rmax = fmax(rmax, ranges[e].range);
+    }
+
+    for (cand = 0; cand < ncand; cand++) {
+        double delta = 0;
+        if (isnan(mean = locate_region(w, cand, rmax, u, v, h))) {
+            continue;
+        }
+        for (e = 0; e < w->nranges; e++) {
+            const locate_range_t * r = &ranges[e];
+            double d0 = 0, d1 = 0;
+            if (w->sel[r->a] == w->sel[r->b]) {
+                continue;
+            }
+            i = w->sel[r->a] ? r->a : r->b;
+            for (c = 0; c < 3; c++) {
+                double dc = w->x[r->a * 3 + c] - w->x[r->b * 3 + c];
+                double mc = 2 * (mean - h[i]) * nrm[c] * ((i == r->a) ? 1 : -1);
+                d0 += dc * dc;
+                d1 += (dc + mc) * (dc + mc);
+            }
+            d0 = sqrt(d0) - r->range;
+            d1 = sqrt(d1) - r->range;
+            delta += range_weight(r) * (d1 * d1 - d0 * d0);
+        }
+        if (delta < gain) {
+            gain = delta;
+            best = cand;
+        }
+    }
+    /* Ignore gains at the rounding level of the cost */
+    if (!(gain < -1e-6 * locate_cost(ranges, w->nranges, 3, w->x))) {
+        return 0;
+    }
+
+    mean = locate_region(w, best, rmax, u, v, h);
+    for (i = 0; i < n; i++) {
+        if (w->sel[i]) {
+            for (c = 0; c < 3; c++) {
+                w->x[i * 3 + c] += 2 * (mean - h[i]) * nrm[c];
+            }
+        }
+    }
+    return 1;
+}
+
+/* Refinement with rounds of moving misplaced anchors and regions, returns the iterations */
+static uint16_t
+locate_solve(locate_work_t * w)
+{
+    uint16_t it, pass;
+
+    it = locate_refine(w);
+    for (pass = 0; pass < LOCATE_RELOCATE_PASSES; pass++) {
+        if (!locate_relocate(w) && !(w->dim == 3 && locate_unfold(w))) {
+            break;
+        }
+        it += locate_refine(w);
+    }
+    return it;
+}
+
+/* Fills w->u and w->res, returns 1 if a range is too far from the geometry in w->x */
+static int
+locate_rejected(locate_work_t * w)
+{
+    uint32_t e;
+
+    locate_units(w->ranges, w->nranges, w->dim, w->x, w->u, w->res);
+    for (e = 0; e < w->nranges; e++) {
+        if (w->res[e] * w->res[e] * range_weight(&w->ranges[e]) > LOCATE_REJECT_SIGMA * LOCATE_REJECT_SIGMA) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @fn locate_anchors(const locate_range_t * ranges, uint32_t nranges, uint16_t nanchors, uint8_t dim,
+ *     triad_t * pos, double * residuals, locate_report_t * report)
+ * @brief Anchor coordinates from measured inter-anchor ranges. Pairs may be missing or
+ * measured more than once, but every anchor must be linked to the others through ranges.
+ *
+ * @param ranges     Measured ranges.
+ * @param nranges    Number of ranges.
+ * @param nanchors   Number of anchors, anchors are indexed 0 to nanchors-1.
+ * @param dim        2 or 3, the unused coordinates of pos are set to 0.
+ * @param pos        Output anchor coordinates (m), nanchors entries.
+ * @param residuals  Optional output of the measured minus the solved range (m), nranges entries.
+ * @param report     Optional output of the fit quality.
+ *
+ * @return 0 on success, -1 if the ranges do not define all anchors, -2 if out of memory,
+ * -3 if from every start a range is left more than LOCATE_REJECT_SIGMA standard deviations
+ * from the solved geometry, typically an outlier. pos, residuals and report are still filled
+ * in from the lowest cost fit, report->worst names the range to check and report->iterations
+ * counts all starts.
+ */
+int
+locate_anchors(const locate_range_t * ranges, uint32_t nranges, uint16_t nanchors, uint8_t dim,
+               triad_t * pos, double * residuals, locate_report_t * report)
+{
+    uint32_t nx = (uint32_t)nanchors * dim;
+    locate_work_t w = {
+        .ranges = ranges, .nranges = nranges, .n = nanchors, .dim = dim,
+        .x = malloc(nx * sizeof(double)),
+        .xt = malloc(nx * sizeof(double)),
+        .xb = malloc(nx * sizeof(double)),
+        .g = malloc(nx * sizeof(double)),
+        .diag = malloc(nx * sizeof(double)),
+        .dx = malloc(nx * sizeof(double)),
+        .cr = malloc(nx * sizeof(double)),
+        .cz = malloc(nx * sizeof(double)),
+        .cp = malloc(nx * sizeof(double)),
+        .cq = malloc(nx * sizeof(double)),
+        .u = malloc((size_t)nranges * dim * sizeof(double)),
+        .res = malloc((size_t)nranges * sizeof(double)),
+        .adj_off = calloc(nanchors + 1, sizeof(uint32_t)),
+        .adj = malloc((size_t)nranges * 2 * sizeof(uint32_t)),
+        .sel = malloc(nanchors)
+    };
+    uint16_t it = 0;
+    uint32_t e, i;
+    uint8_t c, start;
+    double cost, best = INFINITY;
+    int rc = -2;
+
+    if (dim < 2 || dim > 3 || nanchors < 2 || nranges == 0) {
+        rc = -1;
+        goto done;
+    }
+    for (e = 0; e < nranges; e++) {
+        if (ranges[e].a >= nanchors || ranges[e].b >= nanchors) {
+            rc = -1;
+            goto done;
+        }
+    }
+    if (w.x == NULL || w.xt == NULL || w.xb == NULL || w.g == NULL || w.diag == NULL || w.dx == NULL ||
+        w.cr == NULL || w.cz == NULL || w.cp == NULL || w.cq == NULL || w.u == NULL || w.res == NULL ||
+        w.adj_off == NULL || w.adj == NULL || w.sel == NULL) {
+        goto done;
+    }
+    switch (connected(ranges, nranges, nanchors)) {
+    case 0:
+        rc = -1;
+        /* fall through */
+    case -1:
+        goto done;
+    }
+
+    for (e = 0; e < nranges; e++) {
+        w.adj_off[ranges[e].a + 1]++;
+        w.adj_off[ranges[e].b + 1]++;
+    }
+    for (i = 0; i < nanchors; i++) {
+        w.adj_off[i + 1] += w.adj_off[i];
+    }
+    for (e = 0; e < nranges; e++) {
+        w.adj[w.adj_off[ranges[e].a]++] = e;
+        w.adj[w.adj_off[ranges[e].b]++] = e;
+    }
+    for (i = nanchors; i > 0; i--) {
+        w.adj_off[i] = w.adj_off[i - 1];
+    }
+    w.adj_off[0] = 0;
+
+    /* 3D starts from patches grown from two ends of the layout, then from classical scaling,
+     * until a fit is accepted; 2D only from classical scaling. If all are rejected the lowest
+     * cost fit is returned */
+    for (start = (dim == 3) ? 0 : 2; start < 3; start++) {
+        if (start < 2 && locate_stitch(&w, start)) {
+            continue;
+        }
+        if (start == 2 && locate_mds(ranges, nranges, nanchors, dim, w.x)) {
+            goto done;
+        }
+        it += locate_solve(&w);
+        cost = (locate_rejected(&w)) ? locate_cost(ranges, nranges, dim, w.x) : 0;
+        if (cost < best) {
+            best = cost;
+            memcpy(w.xb, w.x, nx * sizeof(double));
+        }
+        if (cost == 0) {
+            break;
+        }
+    }
+    memcpy(w.x, w.xb, nx * sizeof(double));
+
+    locate_frame(w.x, nanchors, dim);
+    for (i = 0; i < nanchors; i++) {
+        for (c = 0; c < 3; c++) {
+            pos[i].array[c] = (c < dim) ? w.x[i * dim + c] : 0;
+        }
+    }
+
+    rc = locate_rejected(&w) ? -3 : 0;
+    if (report) {
+        memset(report, 0, sizeof(*report));
+        for (e = 0; e < nranges; e++) {
+            report->rms += w.res[e] * w.res[e];
+            report->chi2 += range_weight(&ranges[e]) * w.res[e] * w.res[e];
+            if (fabs(w.res[e]) > report->max) {
+                report->max = fabs(w.res[e]);
+                report->worst = e;
+            }
+        }
+        report->rms = sqrt(report->rms / nranges);
+        report->iterations = it;
+    }
+    if (residuals) {
+        for (e = 0; e < nranges; e++) {
+            residuals[e] = -w.res[e];
+        }
+    }
+
+done:
+    free(w.x);
+    free(w.xt);
+    free(w.xb);
+    free(w.g);
+    free(w.diag);
+    free(w.dx);
+    free(w.cr);
+    free(w.cz);
+    free(w.cp);
+    free(w.cq);
+    free(w.u);
+    free(w.res);
+    free(w.adj_off);
+    free(w.adj);
+    free(w.sel);
+    return rc;
+}
+
+/**
+ * @fn locate_ranges_from_matrix(const float * range, const float * variance, uint16_t n,
+ *     locate_range_t * ranges, uint32_t max)
+ * @brief Collect the valid entries of a row major n x n range matrix, as reported by
+ * lib/survey. Entries that are not finite or not positive are missing, both directions of
+ * a pair are kept as separate measurements.
+ *
+ * @param range     n x n matrix of ranges (m), row a holds the ranges measured by anchor a.
+ * @param variance  Optional n x n matrix of range variances (m^2).
+ * @param n         Number of anchors.
+ * @param ranges    Output ranges.
+ * @param max       Size of ranges.
+ *
+ * @return Number of ranges written
+ */
+uint32_t
+locate_ranges_from_matrix(const float * range, const float * variance, uint16_t n,
+                          locate_range_t * ranges, uint32_t max)
+{
+    uint32_t count = 0;
+    uint16_t a, b;
+
+    for (a = 0; a < n; a++) {
+        for (b = 0; b < n && count < max; b++) {
+            float r = range[a * n + b];
+            if (a == b || !isfinite(r) || r <= 0) {
+                continue;
+            }
+            ranges[count].a = a;
+            ranges[count].b = b;
+            ranges[count].range = r;
+            ranges[count].variance = (variance) ? variance[a * n + b] : 0;
+            count++;
+        }
+    }
+    return count;
+}
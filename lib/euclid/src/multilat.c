@@ -0,0 +1,317 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file multilat.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Position from ranges to known anchors
+ * @details
+ * ## Algorithm Details
+ * Without a guess, the start point is the closed form solution of the range equations
+ * linearised by subtracting their weighted mean,
+ *
+ * \f$2(a_i - \bar{a}) \cdot x = |a_i|^2 - r_i^2 - \overline{(|a|^2 - r^2)}\f$
+ *
+ * When all anchors share one height, as with ceiling mounted anchors, the height is not
+ * observable in that form; x and y are solved alone and the tag is placed below the
+ * anchors, or on the side of the guess.
+ *
+ * The position is then refined by weighted Gauss-Newton. While more than dim + 1 ranges
+ * remain and one of them is more than MULTILAT_OUTLIER_SIGMA standard deviations off,
+ * the range whose removal leaves the best fit is dropped.
+ *
+ * All work memory is on the stack, a solve does not allocate.
+ */
+
+#include <string.h>
+#include <math.h>
+#include <euclid/multilat.h>
+#include "cholesky.h"
+
+#define MULTILAT_MAX_ITER   (16)        //!< Gauss-Newton iterations per refinement
+#define MULTILAT_TOL        (1e-6)      //!< Step length (m) considered converged
+
+static double
+meas_weight(const multilat_meas_t * m)
+{
+    return 1.0 / ((m->variance > 0) ? m->variance : MULTILAT_DEFAULT_VARIANCE);
+}
+
+static double
+multilat_cost(const multilat_meas_t * meas, uint16_t n, uint32_t use, uint8_t dim, const double x[3])
+{
+    double cost = 0;
+    uint16_t i;
+    uint8_t c;
+
+    for (i = 0; i < n; i++) {
+        double dist = 0;
+        if (!(use & 1UL << i)) {
+            continue;
+        }
+        for (c = 0; c < dim; c++) {
+            dist += (x[c] - meas[i].anchor.array[c]) * (x[c] - meas[i].anchor.array[c]);
+        }
+        dist = sqrt(dist) - meas[i].range;
+        cost += meas_weight(&meas[i]) * dist * dist;
+    }
+    return cost;
+}
+
+/* Closed form start point */
+static int
+multilat_linear(const multilat_meas_t * meas, uint16_t n, uint8_t dim, const triad_t * guess, double x[3])
+{
+    double sw = 0, abar[3] = {0}, qbar = 0, a[CHOLESKY_MAX][CHOLESKY_MAX] = {{0}}, b[3] = {0};
+    uint16_t i;
+    uint8_t c, k;
+
+    for (i = 0; i < n; i++) {
+        double w = meas_weight(&meas[i]), q = -meas[i].range * meas[i].range;
+        for (c = 0; c < dim; c++) {
+            abar[c] += w * meas[i].anchor.array[c];
+            q += meas[i].anchor.array[c] * meas[i].anchor.array[c];
+        }
+        qbar += w * q;
+        sw += w;
+    }
+    for (c = 0; c < dim; c++) {
+        abar[c] /= sw;
+    }
+    qbar /= sw;
+
+    for (i = 0; i < n; i++) {
+        double w = meas_weight(&meas[i]), q = -meas[i].range * meas[i].range - qbar, d[3];
+        for (c = 0; c < dim; c++) {
+            d[c] = meas[i].anchor.array[c] - abar[c];
+            q += meas[i].anchor.array[c] * meas[i].anchor.array[c];
+        }
+        for (c = 0; c < dim; c++) {
+            for (k = 0; k < dim; k++) {
+                a[c][k] += 4 * w * d[c] * d[k];
+            }
+            b[c] += 2 * w * d[c] * q;
+        }
+    }
+
+    double height = a[2][2];
+    double span = a[0][0] + a[1][1];
+    k = cholesky(a, dim);
+    if (k == dim) {
+        cholesky_solve(a, dim, b);
+        memcpy(x, b, dim * sizeof(double));
+        return 0;
+    }
+    if (k < 2 || height > 1e-9 * span) {
+        return -1;
+    }
+
+    /* Anchors in one horizontal plane, the x-y block is factored all the same */
+    double h2 = 0;
+    cholesky_solve(a, 2, b);
+    for (i = 0; i < n; i++) {
+        double dx = b[0] - meas[i].anchor.x, dy = b[1] - meas[i].anchor.y;
+        h2 += meas_weight(&meas[i]) * (meas[i].range * meas[i].range - dx * dx - dy * dy);
+    }
+    h2 = sqrt(fmax(h2 / sw, 0));
+    x[0] = b[0];
+    x[1] = b[1];
+    x[2] = (guess && guess->z > abar[2]) ? abar[2] + h2 : abar[2] - h2;
+    return 0;
+}
+
+/* Weighted Gauss-Newton from x over the ranges in use, h returns the factored normal matrix */
+static int
+multilat_refine(const multilat_meas_t * meas, uint16_t n, uint32_t use, uint8_t dim, double x[3],
+                double h[CHOLESKY_MAX][CHOLESKY_MAX], uint16_t * iterations)
+{
+    double cost = multilat_cost(meas, n, use, dim, x);
+    uint8_t it, c, k;
+    uint16_t i;
+
+    for (it = 0; it < MULTILAT_MAX_ITER; it++) {
+        double g[3] = {0}, xt[3], step = 1, len = 0, trace = 0;
+
+        memset(h, 0, sizeof(double[CHOLESKY_MAX][CHOLESKY_MAX]));
+        for (i = 0; i < n; i++) {
+            double u[3], dist = 0, w = meas_weight(&meas[i]);
+            if (!(use & 1UL << i)) {
+                continue;
+            }
+            for (c = 0; c < dim; c++) {
+                u[c] = x[c] - meas[i].anchor.array[c];
+                dist += u[c] * u[c];
+            }
+            dist = sqrt(dist);
+            if (dist == 0) {
+                continue;
+            }
+            for (c = 0; c < dim; c++) {
+                u[c] /= dist;
+                g[c] += w * u[c] * (dist - meas[i].range);
+                for (k = 0; k < dim; k++) {
+                    h[c][k] += w * u[c] * u[k];
+                }
+            }
+        }
+        /* A whisker of damping keeps a tag in the plane of the anchors solvable */
+        for (c = 0; c < dim; c++) {
+            trace += h[c][c];
+        }
+        for (c = 0; c < dim; c++) {
+            h[c][c] += 1e-9 * trace;
+        }
+        if (cholesky(h, dim) < dim) {
+            return -2;
+        }
+        cholesky_solve(h, dim, g);
+
+        /* Halve the step until the cost no longer rises */
+        for (k = 0; k < 5; k++, step *= 0.5) {
+            for (c = 0; c < dim; c++) {
+                xt[c] = x[c] - step * g[c];
+            }
+            double new_cost = multilat_cost(meas, n, use, dim, xt);
+            if (new_cost <= cost) {
+                cost = new_cost;
+                break;
+            }
+        }
+        if (k == 5) {
+            break;
+        }
+        for (c = 0; c < dim; c++) {
+            len += (xt[c] - x[c]) * (xt[c] - x[c]);
+            x[c] = xt[c];
+        }
+        if (len < MULTILAT_TOL * MULTILAT_TOL) {
+            it++;
+            break;
+        }
+    }
+    *iterations = (*iterations + it > UINT16_MAX) ? UINT16_MAX : *iterations + it;
+    return 0;
+}
+
+/**
+ * @fn multilat_solve(const multilat_meas_t * meas, uint16_t n, uint8_t dim, const triad_t * guess,
+ *     multilat_result_t * result)
+ * @brief Position from ranges to known anchors, by weighted least squares with outlier rejection.
+ *
+ * @param meas      Ranges and the positions of the anchors they were measured to.
+ * @param n         Number of ranges, dim + 1 to MULTILAT_MAX_MEAS.
+ * @param dim       2 to solve x and y only, 3 for x, y and z.
+ * @param guess     Optional start point, such as the previous position of the tag.
+ * @param result    Solved position.
+ *
+ * @return 0 on success, -1 for too few ranges, -2 if the anchor geometry does not define a position
+ */
+int
+multilat_solve(const multilat_meas_t * meas, uint16_t n, uint8_t dim, const triad_t * guess,
+               multilat_result_t * result)
+{
+    double x[3] = {0}, h[CHOLESKY_MAX][CHOLESKY_MAX];
+    uint32_t use = (n >= 32) ? UINT32_MAX : (1UL << n) - 1;
+    uint16_t i, count = n, worst;
+    uint8_t c;
+
+    if (dim < 2 || dim > 3 || n < dim + 1 || n > MULTILAT_MAX_MEAS) {
+        return -1;
+    }
+    memset(result, 0, sizeof(*result));
+
+    if (guess) {
+        memcpy(x, guess->array, dim * sizeof(double));
+    } else if (multilat_linear(meas, n, dim, guess, x)) {
+        return -2;
+    }
+
+    if (multilat_refine(meas, n, use, dim, x, h, &result->iterations)) {
+        return -2;
+    }
+    while (count > dim + 1) {
+        double max = 0, best = INFINITY, xb[3], hb[CHOLESKY_MAX][CHOLESKY_MAX];
+        for (i = 0; i < n; i++) {
+            double dist = 0;
+            if (!(use & 1UL << i)) {
+                continue;
+            }
+            for (c = 0; c < dim; c++) {
+                dist += (x[c] - meas[i].anchor.array[c]) * (x[c] - meas[i].anchor.array[c]);
+            }
+            max = fmax(max, fabs(sqrt(dist) - meas[i].range) * sqrt(meas_weight(&meas[i])));
+        }
+        if (max <= MULTILAT_OUTLIER_SIGMA) {
+            break;
+        }
+
+        /*
+         * A long range pulls the fit towards itself and spreads its error over the others,
+         * so the largest residual does not reliably point at it. Drop the range without
+         * which the others fit best.
+         */
+        for (i = 0, worst = n; i < n; i++) {
+            double xi[3], hi[CHOLESKY_MAX][CHOLESKY_MAX], cost;
+            if (!(use & 1UL << i)) {
+                continue;
+            }
+            memcpy(xi, x, sizeof(xi));
+            if (multilat_refine(meas, n, use & ~(1UL << i), dim, xi, hi, &result->iterations)) {
+                continue;
+            }
+            cost = multilat_cost(meas, n, use & ~(1UL << i), dim, xi);
+            if (cost < best) {
+                best = cost;
+                worst = i;
+                memcpy(xb, xi, sizeof(xb));
+                memcpy(hb, hi, sizeof(hb));
+            }
+        }
+        if (worst == n) {
+            return -2;
+        }
+        use &= ~(1UL << worst);
+        count--;
+        memcpy(x, xb, sizeof(xb));
+        memcpy(h, hb, sizeof(hb));
+    }
+
+    /* Position variance from the diagonal of the inverse normal matrix */
+    for (c = 0; c < dim; c++) {
+        double e[3] = {0};
+        e[c] = 1;
+        cholesky_solve(h, dim, e);
+        result->variance.array[c] = e[c];
+        result->pos.array[c] = x[c];
+    }
+    for (i = 0; i < n; i++) {
+        if (use & 1UL << i) {
+            double dist = 0;
+            for (c = 0; c < dim; c++) {
+                dist += (x[c] - meas[i].anchor.array[c]) * (x[c] - meas[i].anchor.array[c]);
+            }
+            dist = sqrt(dist) - meas[i].range;
+            result->rms += dist * dist;
+        }
+    }
+    result->rms = sqrt(result->rms / count);
+    result->inliers = use;
+    return 0;
+}
@@ -0,0 +1,428 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file tdoa.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Position from time differences of arrival from known anchors
+ * @details
+ * ## Algorithm Details
+ * Each arrival is modelled as \f$t_i = |x - a_i| + b\f$ with b unknown, which is the
+ * same as solving the differences to a reference arrival but keeps the errors of the
+ * measurements independent.
+ *
+ * Without a guess, the start point follows Chan's closed form. With the reference anchor
+ * \f$a_0\f$ at the origin, \f$d_i = t_i - t_0\f$ and \f$R = |x|\f$,
+ *
+ * \f$2 a_i \cdot x + 2 d_i R = |a_i|^2 - d_i^2\f$
+ *
+ * is linear in x for a given R. Its least squares solution \f$x = u - vR\f$ put back into
+ * \f$R = |x|\f$ leaves a quadratic in R, the root with the lowest cost is taken. When all
+ * anchors share one height, x, y and R are solved together and the tag is placed below
+ * the anchors.
+ *
+ * The position and offset are then refined by weighted Gauss-Newton. All work memory is
+ * on the stack, a solve does not allocate.
+ */
+
+#include <string.h>
+#include <math.h>
+#include <euclid/tdoa.h>
+#include "cholesky.h"
+
+#define TDOA_MAX_ITER   (16)        //!< Gauss-Newton iterations
+#define TDOA_TOL        (1e-6)      //!< Step length (m) considered converged
+
+/**
+ * @fn tdoa_registry_init(tdoa_registry_t * reg, tdoa_anchor_t * storage, uint16_t max)
+ * @brief Empty anchor registry on caller provided storage.
+ *
+ * @param reg       Registry.
+ * @param storage   Room for max anchors.
+ * @param max       Size of storage.
+ *
+ * @return void
+ */
+void
+tdoa_registry_init(tdoa_registry_t * reg, tdoa_anchor_t * storage, uint16_t max)
+{
+    reg->nanchors = 0;
+    reg->max = max;
+    reg->anchors = storage;
+}
+
+static uint16_t
+tdoa_registry_find(const tdoa_registry_t * reg, uint16_t uid)
+{
+    uint16_t lo = 0, hi = reg->nanchors;
+
+    while (lo < hi) {
+        uint16_t mid = (lo + hi) / 2;
+        if (reg->anchors[mid].uid < uid) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * @fn tdoa_registry_set(tdoa_registry_t * reg, uint16_t uid, const triad_t * pos)
+ * @brief Add an anchor or move one already registered.
+ *
+ * @param reg       Registry.
+ * @param uid       Short address of the anchor.
+ * @param pos       Anchor position.
+ *
+ * @return 0 on success, -1 if the registry is full
+ */
+int
+tdoa_registry_set(tdoa_registry_t * reg, uint16_t uid, const triad_t * pos)
+{
+    uint16_t i = tdoa_registry_find(reg, uid);
+
+    if (i == reg->nanchors || reg->anchors[i].uid != uid) {
+        if (reg->nanchors == reg->max) {
+            return -1;
+        }
+        memmove(&reg->anchors[i + 1], &reg->anchors[i], (reg->nanchors - i) * sizeof(tdoa_anchor_t));
+        reg->anchors[i].uid = uid;
+        reg->nanchors++;
+    }
+    reg->anchors[i].pos = *pos;
+    return 0;
+}
+
+/**
+ * @fn tdoa_registry_get(const tdoa_registry_t * reg, uint16_t uid)
+ * @brief Position of a registered anchor.
+ *
+ * @param reg       Registry.
+ * @param uid       Short address of the anchor.
+ *
+ * @return anchor position, NULL if not registered
+ */
+const triad_t *
+tdoa_registry_get(const tdoa_registry_t * reg, uint16_t uid)
+{
+    uint16_t i = tdoa_registry_find(reg, uid);
+    return (i < reg->nanchors && reg->anchors[i].uid == uid) ? &reg->anchors[i].pos : NULL;
+}
+
+static double
+meas_weight(const tdoa_meas_t * m)
+{
+    return 1.0 / ((m->variance > 0) ? m->variance : TDOA_DEFAULT_VARIANCE);
+}
+
+static double
+tdoa_dist(const tdoa_meas_t * m, uint8_t dim, const double x[4])
+{
+    double dist = 0;
+    uint8_t c;
+
+    for (c = 0; c < dim; c++) {
+        dist += (x[c] - m->anchor.array[c]) * (x[c] - m->anchor.array[c]);
+    }
+    return sqrt(dist);
+}
+
+static double
+tdoa_cost(const tdoa_meas_t * meas, uint16_t n, uint8_t dim, const double x[4])
+{
+    double cost = 0;
+    uint16_t i;
+
+    for (i = 0; i < n; i++) {
+        double r = tdoa_dist(&meas[i], dim, x) + x[dim] - meas[i].tdoa;
+        cost += meas_weight(&meas[i]) * r * r;
+    }
+    return cost;
+}
+
+/* Best offset x[dim] for the position in x */
+static void
+tdoa_offset(const tdoa_meas_t * meas, uint16_t n, uint8_t dim, double x[4])
+{
+    double sw = 0, sb = 0;
+    uint16_t i;
+
+    for (i = 0; i < n; i++) {
+        double w = meas_weight(&meas[i]);
+        sb += w * (meas[i].tdoa - tdoa_dist(&meas[i], dim, x));
+        sw += w;
+    }
+    x[dim] = sb / sw;
+}
+
+/* Chan's closed form start point */
+static int
+tdoa_chan(const tdoa_meas_t * meas, uint16_t n, uint8_t dim, double x[4])
+{
+    double m[CHOLESKY_MAX][CHOLESKY_MAX] = {{0}}, r[CHOLESKY_MAX] = {0};
+    double l[CHOLESKY_MAX][CHOLESKY_MAX], u[CHOLESKY_MAX], v[CHOLESKY_MAX];
+    const triad_t * a0;
+    uint16_t i, ref = 0;
+    uint8_t c, k;
+
+    /* The most precise arrival is the reference */
+    for (i = 1; i < n; i++) {
+        if (meas_weight(&meas[i]) > meas_weight(&meas[ref])) {
+            ref = i;
+        }
+    }
+    a0 = &meas[ref].anchor;
+
+    /* Normal equations of the rows [2 a_i, 2 d_i] . [x, R] = |a_i|^2 - d_i^2 */
+    for (i = 0; i < n; i++) {
+        double g[CHOLESKY_MAX], h, w;
+        if (i == ref) {
+            continue;
+        }
+        w = 1.0 / (1.0 / meas_weight(&meas[i]) + 1.0 / meas_weight(&meas[ref]));
+        g[dim] = meas[i].tdoa - meas[ref].tdoa;
+        h = -g[dim] * g[dim];
+        for (c = 0; c < dim; c++) {
+            g[c] = meas[i].anchor.array[c] - a0->array[c];
+            h += g[c] * g[c];
+        }
+        for (c = 0; c <= dim; c++) {
+            for (k = 0; k <= dim; k++) {
+                m[c][k] += 4 * w * g[c] * g[k];
+            }
+            r[c] += 2 * w * g[c] * h;
+        }
+    }
+
+    memcpy(l, m, sizeof(l));
+    k = cholesky(l, dim);
+    if (k == dim) {
+        double qa = -1, qb = 0, qc = 0, roots[2], best = INFINITY, xt[4];
+        uint8_t nroots = 0;
+
+        for (c = 0; c < dim; c++) {
+            u[c] = r[c];
+            v[c] = m[c][dim];
+        }
+        cholesky_solve(l, dim, u);
+        cholesky_solve(l, dim, v);
+        for (c = 0; c < dim; c++) {
+            qa += v[c] * v[c];
+            qb -= 2 * u[c] * v[c];
+            qc += u[c] * u[c];
+        }
+
+        /* (|v|^2 - 1) R^2 - 2 u.v R + |u|^2 = 0 */
+        double disc = qb * qb - 4 * qa * qc;
+        if (fabs(qa) < 1e-12) {
+            roots[nroots++] = (qb != 0) ? -qc / qb : 0;
+        } else if (disc < 0) {
+            roots[nroots++] = -qb / (2 * qa);
+        } else {
+            roots[nroots++] = (-qb + sqrt(disc)) / (2 * qa);
+            roots[nroots++] = (-qb - sqrt(disc)) / (2 * qa);
+        }
+        for (k = 0; k < nroots; k++) {
+            double cost;
+            if (roots[k] < 0) {
+                continue;
+            }
+            for (c = 0; c < dim; c++) {
+                xt[c] = a0->array[c] + u[c] - v[c] * roots[k];
+            }
+            tdoa_offset(meas, n, dim, xt);
+            cost = tdoa_cost(meas, n, dim, xt);
+            if (cost < best) {
+                best = cost;
+                memcpy(x, xt, sizeof(xt));
+            }
+        }
+        return (best < INFINITY) ? 0 : -1;
+    }
+    if (dim < 3 || k < 2 || m[2][2] > 1e-9 * (m[0][0] + m[1][1])) {
+        return -1;
+    }
+
+    /* Anchors in one horizontal plane, solve x, y and R together */
+    double xy[CHOLESKY_MAX] = {r[0], r[1], r[3]};
+    static const uint8_t map[3] = {0, 1, 3};
+    for (c = 0; c < 3; c++) {
+        for (k = 0; k < 3; k++) {
+            l[c][k] = m[map[c]][map[k]];
+        }
+    }
+    if (cholesky(l, 3) < 3) {
+        return -1;
+    }
+    cholesky_solve(l, 3, xy);
+    x[0] = a0->x + xy[0];
+    x[1] = a0->y + xy[1];
+    x[2] = a0->z - sqrt(fmax(xy[2] * xy[2] - xy[0] * xy[0] - xy[1] * xy[1], 0));
+    tdoa_offset(meas, n, dim, x);
+    return 0;
+}
+
+/* Weighted Gauss-Newton on position and offset, h returns the factored normal matrix */
+static int
+tdoa_refine(const tdoa_meas_t * meas, uint16_t n, uint8_t dim, double x[4],
+            double h[CHOLESKY_MAX][CHOLESKY_MAX], uint8_t * iterations)
+{
+    double cost = tdoa_cost(meas, n, dim, x);
+    uint8_t it, c, k;
+    uint16_t i;
+
+    for (it = 0; it < TDOA_MAX_ITER; it++) {
+        double g[CHOLESKY_MAX] = {0}, xt[4], step = 1, len = 0, trace = 0;
+
+        memset(h, 0, sizeof(double[CHOLESKY_MAX][CHOLESKY_MAX]));
+        for (i = 0; i < n; i++) {
+            double j[CHOLESKY_MAX], w = meas_weight(&meas[i]);
+            double dist = tdoa_dist(&meas[i], dim, x);
+            if (dist == 0) {
+                continue;
+            }
+            for (c = 0; c < dim; c++) {
+                j[c] = (x[c] - meas[i].anchor.array[c]) / dist;
+            }
+            j[dim] = 1;
+            for (c = 0; c <= dim; c++) {
+                g[c] += w * j[c] * (dist + x[dim] - meas[i].tdoa);
+                for (k = 0; k <= dim; k++) {
+                    h[c][k] += w * j[c] * j[k];
+                }
+            }
+        }
+        for (c = 0; c <= dim; c++) {
+            trace += h[c][c];
+        }
+        for (c = 0; c <= dim; c++) {
+            h[c][c] += 1e-9 * trace;
+        }
+        if (cholesky(h, dim + 1) <= dim) {
+            return -2;
+        }
+        cholesky_solve(h, dim + 1, g);
+
+        /* Halve the step until the cost no longer rises */
+        for (k = 0; k < 5; k++, step *= 0.5) {
+            for (c = 0; c <= dim; c++) {
+                xt[c] = x[c] - step * g[c];
+            }
+            double new_cost = tdoa_cost(meas, n, dim, xt);
+            if (new_cost <= cost) {
+                cost = new_cost;
+                break;
+            }
+        }
+        if (k == 5) {
+            break;
+        }
+        for (c = 0; c < dim; c++) {
+            len += (xt[c] - x[c]) * (xt[c] - x[c]);
+        }
+        memcpy(x, xt, (dim + 1) * sizeof(double));
+        if (len < TDOA_TOL * TDOA_TOL) {
+            it++;
+            break;
+        }
+    }
+    *iterations = it;
+    return 0;
+}
+
+/**
+ * @fn tdoa_solve(const tdoa_meas_t * meas, uint16_t n, uint8_t dim, const triad_t * guess,
+ *     tdoa_result_t * result)
+ * @brief Position from the arrival times of transmissions from known anchors, such as one
+ * round of rtdoa responses.
+ *
+ * @param meas      Arrival times and the positions of the anchors that sent them.
+ * @param n         Number of arrivals, dim + 1 to TDOA_MAX_MEAS.
+ * @param dim       2 to solve x and y only, 3 for x, y and z.
+ * @param guess     Optional start point, such as the previous position of the tag. With only
+ *                  dim + 1 arrivals two positions can fit exactly, the guess picks one.
+ * @param result    Solved position.
+ *
+ * @return 0 on success, -1 for too few arrivals, -2 if the anchor geometry does not define a position
+ */
+int
+tdoa_solve(const tdoa_meas_t * meas, uint16_t n, uint8_t dim, const triad_t * guess,
+           tdoa_result_t * result)
+{
+    double x[4] = {0}, h[CHOLESKY_MAX][CHOLESKY_MAX], q[CHOLESKY_MAX][CHOLESKY_MAX] = {{0}};
+    uint16_t i;
+    uint8_t c, k;
+
+    if (dim < 2 || dim > 3 || n < dim + 1 || n > TDOA_MAX_MEAS) {
+        return -1;
+    }
+    memset(result, 0, sizeof(*result));
+
+    if (guess) {
+        memcpy(x, guess->array, dim * sizeof(double));
+        tdoa_offset(meas, n, dim, x);
+    } else if (tdoa_chan(meas, n, dim, x)) {
+        return -2;
+    }
+    if (tdoa_refine(meas, n, dim, x, h, &result->iterations)) {
+        return -2;
+    }
+
+    /* Unit weight geometry for the dilution of precision */
+    for (i = 0; i < n; i++) {
+        double j[CHOLESKY_MAX], dist = tdoa_dist(&meas[i], dim, x), r;
+        for (c = 0; c < dim; c++) {
+            j[c] = (dist > 0) ? (x[c] - meas[i].anchor.array[c]) / dist : 0;
+        }
+        j[dim] = 1;
+        for (c = 0; c <= dim; c++) {
+            for (k = 0; k <= dim; k++) {
+                q[c][k] += j[c] * j[k];
+            }
+        }
+        r = dist + x[dim] - meas[i].tdoa;
+        result->rms += r * r;
+    }
+    result->rms = sqrt(result->rms / n);
+
+    /* The directions to the anchors cannot separate position and offset */
+    if (cholesky(q, dim + 1) <= dim) {
+        return -2;
+    }
+
+    /* Variance and dilution from the diagonals of the inverse normal matrices */
+    for (c = 0; c <= dim; c++) {
+        double e[CHOLESKY_MAX] = {0};
+        e[c] = 1;
+        cholesky_solve(h, dim + 1, e);
+        if (c < dim) {
+            result->variance.array[c] = e[c];
+            result->pos.array[c] = x[c];
+        }
+        memset(e, 0, sizeof(e));
+        e[c] = 1;
+        cholesky_solve(q, dim + 1, e);
+        result->gdop += e[c];
+    }
+    result->gdop = sqrt(result->gdop);
+    result->offset = x[dim];
+    return 0;
+}
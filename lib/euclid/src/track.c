@@ -0,0 +1,483 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file track.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Constant velocity tracking of tags from single ranges and arrival times
+ * @details
+ * ## Algorithm Details
+ * Each tag carries an extended Kalman filter with a constant velocity model driven by
+ * white acceleration noise. Measurements are applied one at a time as scalar updates,
+ * a range as \f$|x - a|\f$ and an arrival time as \f$|x - a| + b\f$. The offset b is
+ * part of the state and is restarted with a wide variance on the first arrival of every
+ * tdoa round, so the arrivals of a round are used without forming differences.
+ *
+ * A new tag holds its measurements until dim + 2 different anchors have been heard,
+ * within TRACK_INIT_WINDOW for ranges or within one round for tdoa, and starts from
+ * the multilat_solve() or tdoa_solve() position.
+ *
+ * Tracks live in an open addressed table keyed by tag address. Removal shifts later
+ * entries back, so a track_t pointer is only valid until the next track_expire().
+ */
+
+#include <string.h>
+#include <math.h>
+#include <euclid/track.h>
+#include <euclid/multilat.h>
+#include <euclid/tdoa.h>
+
+#define TRACK_B             (6)         //!< Index of the offset in the state
+#define TRACK_B_VARIANCE    (1e4)       //!< Offset variance (m^2) at the start of a round
+
+/**
+ * @fn track_table_init(track_table_t * table, track_t * storage, uint16_t max, const track_config_t * config)
+ * @brief Empty track table on caller provided storage.
+ *
+ * @param table     Table.
+ * @param storage   Room for max tracks.
+ * @param max       Size of storage.
+ * @param config    Tracker parameters, copied.
+ *
+ * @return void
+ */
+void
+track_table_init(track_table_t * table, track_t * storage, uint16_t max, const track_config_t * config)
+{
+    table->config = *config;
+    table->max = max;
+    table->ntracks = 0;
+    table->tracks = storage;
+    memset(storage, 0, max * sizeof(track_t));
+}
+
+static uint16_t
+track_slot(const track_table_t * table, uint16_t uid)
+{
+    return ((uid * 0x9E3779B1u) >> 16) % table->max;
+}
+
+/**
+ * @fn track_find(const track_table_t * table, uint16_t uid)
+ * @brief Track of a tag.
+ *
+ * @param table     Table.
+ * @param uid       Tag address.
+ *
+ * @return track, NULL if the tag is not tracked
+ */
+track_t *
+track_find(const track_table_t * table, uint16_t uid)
+{
+    uint16_t i = track_slot(table, uid), k;
+
+    for (k = 0; k < table->max; k++, i = (i + 1) % table->max) {
+        track_t * track = &table->tracks[i];
+        if (track->state == TRACK_FREE) {
+            return NULL;
+        }
+        if (track->uid == uid) {
+            return track;
+        }
+    }
+    return NULL;
+}
+
+static void
+track_reset(track_t * track, uint16_t uid)
+{
+    memset(track, 0, sizeof(*track));
+    track->uid = uid;
+    track->state = TRACK_INIT;
+}
+
+/* Track of a tag, a new one if it is not tracked yet or has gone quiet */
+static track_t *
+track_get(track_table_t * table, uint16_t uid, uint64_t utime)
+{
+    uint16_t i = track_slot(table, uid), k;
+
+    for (k = 0; k < table->max; k++, i = (i + 1) % table->max) {
+        track_t * track = &table->tracks[i];
+        if (track->state == TRACK_FREE) {
+            if (table->ntracks == table->max) {
+                return NULL;
+            }
+            table->ntracks++;
+            track_reset(track, uid);
+            return track;
+        }
+        if (track->uid == uid) {
+            if (utime > track->seen + table->config.expiry) {
+                track_reset(track, uid);
+            }
+            return track;
+        }
+    }
+    return NULL;
+}
+
+static void
+track_remove(track_table_t * table, uint16_t i)
+{
+    uint16_t j = i;
+
+    table->tracks[i].state = TRACK_FREE;
+    table->ntracks--;
+    for (;;) {
+        uint16_t k;
+        j = (j + 1) % table->max;
+        if (table->tracks[j].state == TRACK_FREE) {
+            return;
+        }
+        k = track_slot(table, table->tracks[j].uid);
+        /* An entry whose home slot lies between the hole and itself stays put */
+        if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) {
+            continue;
+        }
+        table->tracks[i] = table->tracks[j];
+        table->tracks[j].state = TRACK_FREE;
+        i = j;
+    }
+}
+
+/**
+ * @fn track_expire(track_table_t * table, uint64_t utime)
+ * @brief Drop the tracks that have had no measurement for the expiry time.
+ *
+ * @param table     Table.
+ * @param utime     Current time (usec).
+ *
+ * @return number of tracks dropped
+ */
+uint16_t
+track_expire(track_table_t * table, uint64_t utime)
+{
+    uint16_t i = 0, n = 0;
+
+    while (i < table->max) {
+        track_t * track = &table->tracks[i];
+        if (track->state != TRACK_FREE && utime > track->seen + table->config.expiry) {
+            /* Look at this slot again, removal may have moved another track into it */
+            track_remove(table, i);
+            n++;
+            continue;
+        }
+        i++;
+    }
+    return n;
+}
+
+/* Advance the state to utime */
+static void
+track_predict(const track_table_t * table, track_t * track, uint64_t utime)
+{
+    double dt = (utime > track->utime) ? (utime - track->utime) * 1e-6 : 0;
+    double q = table->config.accel_noise;
+    uint8_t c, j;
+
+    if (dt == 0) {
+        return;
+    }
+    for (c = 0; c < table->config.dim; c++) {
+        uint8_t p = c, v = c + 3;
+        track->x[p] += dt * track->x[v];
+        for (j = 0; j < TRACK_NSTATES; j++) {
+            track->P[p][j] += dt * track->P[v][j];
+        }
+        for (j = 0; j < TRACK_NSTATES; j++) {
+            track->P[j][p] += dt * track->P[j][v];
+        }
+        track->P[p][p] += q * dt * dt * dt / 3;
+        track->P[p][v] += q * dt * dt / 2;
+        track->P[v][p] += q * dt * dt / 2;
+        track->P[v][v] += q * dt;
+    }
+    track->utime = utime;
+}
+
+/* Scalar update with measurement row h and innovation y, returns -2 if gated out */
+static int
+track_update(const track_table_t * table, track_t * track, const double h[TRACK_NSTATES], double y,
+             double variance, int gate)
+{
+    double ph[TRACK_NSTATES], s = variance;
+    uint8_t i, j;
+
+    for (i = 0; i < TRACK_NSTATES; i++) {
+        ph[i] = 0;
+        for (j = 0; j < TRACK_NSTATES; j++) {
+            ph[i] += track->P[i][j] * h[j];
+        }
+        s += h[i] * ph[i];
+    }
+    if (gate && table->config.gate > 0 && y * y > table->config.gate * table->config.gate * s) {
+        track->rejected++;
+        return -2;
+    }
+    for (i = 0; i < TRACK_NSTATES; i++) {
+        track->x[i] += ph[i] / s * y;
+        for (j = 0; j < TRACK_NSTATES; j++) {
+            track->P[i][j] -= ph[i] * ph[j] / s;
+        }
+    }
+    track->updates++;
+    return 0;
+}
+
+/* Unit vector from the anchor to the tag in h, returns the distance */
+static double
+track_geometry(const track_table_t * table, const track_t * track, const triad_t * anchor,
+               double h[TRACK_NSTATES])
+{
+    double dist = 0;
+    uint8_t c;
+
+    memset(h, 0, TRACK_NSTATES * sizeof(double));
+    for (c = 0; c < table->config.dim; c++) {
+        h[c] = track->x[c] - anchor->array[c];
+        dist += h[c] * h[c];
+    }
+    dist = sqrt(dist);
+    for (c = 0; c < table->config.dim && dist > 0; c++) {
+        h[c] /= dist;
+    }
+    return dist;
+}
+
+static void
+track_start(const track_table_t * table, track_t * track, const triad_t * pos, const triad_t * variance)
+{
+    uint8_t c;
+
+    memset(track->x, 0, sizeof(track->x));
+    memset(track->P, 0, sizeof(track->P));
+    for (c = 0; c < table->config.dim; c++) {
+        track->x[c] = pos->array[c];
+        track->P[c][c] = variance->array[c] + table->config.variance;
+        track->P[c + 3][c + 3] = TRACK_INIT_SPEED * TRACK_INIT_SPEED;
+    }
+    track->utime = track->pending[track->npending - 1].utime;
+    track->state = TRACK_ACTIVE;
+    track->npending = 0;
+}
+
+/* Hold a measurement of a track being started, replacing an earlier one from the same anchor */
+static void
+track_hold(track_t * track, uint64_t utime, const triad_t * anchor, double value, double variance)
+{
+    uint8_t i, j;
+
+    for (i = 0, j = 0; i < track->npending; i++) {
+        track_meas_t * m = &track->pending[i];
+        if (utime > m->utime + TRACK_INIT_WINDOW ||
+            memcmp(&m->anchor, anchor, sizeof(*anchor)) == 0) {
+            continue;
+        }
+        track->pending[j++] = *m;
+    }
+    if (j == TRACK_INIT_MEAS) {
+        memmove(&track->pending[0], &track->pending[1], (TRACK_INIT_MEAS - 1) * sizeof(track_meas_t));
+        j--;
+    }
+    track->pending[j] = (track_meas_t){.anchor = *anchor, .value = value, .variance = variance, .utime = utime};
+    track->npending = j + 1;
+}
+
+/**
+ * @fn track_range(track_table_t * table, uint16_t uid, uint64_t utime, const triad_t * anchor, double range,
+ *     double variance)
+ * @brief Apply one range between a tag and an anchor, such as from a uwb_rng or nrng completion.
+ *
+ * @param table     Table.
+ * @param uid       Tag address.
+ * @param utime     Time of the measurement (usec).
+ * @param anchor    Anchor position.
+ * @param range     Range (m).
+ * @param variance  Range variance (m^2), <= 0 for the configured variance.
+ *
+ * @return 0 if applied, 1 if held to start the track, -1 if the table is full, -2 if gated out
+ */
+int
+track_range(track_table_t * table, uint16_t uid, uint64_t utime, const triad_t * anchor, double range,
+            double variance)
+{
+    track_t * track = track_get(table, uid, utime);
+    double h[TRACK_NSTATES], dist;
+
+    if (track == NULL) {
+        return -1;
+    }
+    variance = (variance > 0) ? variance : table->config.variance;
+    track->seen = utime;
+    if (track->tdoa) {
+        track_reset(track, uid);
+        track->seen = utime;
+    }
+
+    if (track->state == TRACK_INIT) {
+        multilat_meas_t meas[TRACK_INIT_MEAS];
+        multilat_result_t result;
+        uint8_t i;
+
+        track_hold(track, utime, anchor, range, variance);
+        if (track->npending < table->config.dim + 2) {
+            return 1;
+        }
+        for (i = 0; i < track->npending; i++) {
+            meas[i].anchor = track->pending[i].anchor;
+            meas[i].range = track->pending[i].value;
+            meas[i].variance = track->pending[i].variance;
+        }
+        if (multilat_solve(meas, track->npending, table->config.dim, NULL, &result)) {
+            return 1;
+        }
+        track_start(table, track, &result.pos, &result.variance);
+        return 0;
+    }
+
+    track_predict(table, track, utime);
+    dist = track_geometry(table, track, anchor, h);
+    if (dist == 0) {
+        return 0;
+    }
+    return track_update(table, track, h, range - dist, variance, 1);
+}
+
+/**
+ * @fn track_tdoa(track_table_t * table, uint16_t uid, uint64_t utime, uint8_t seq, const triad_t * anchor,
+ *     double tdoa, double variance)
+ * @brief Apply the arrival time of one anchor transmission at a tag, such as one rtdoa response.
+ *
+ * @param table     Table.
+ * @param uid       Tag address.
+ * @param utime     Time of the measurement (usec).
+ * @param seq       Sequence number of the round, arrivals of one round share an offset.
+ * @param anchor    Anchor position.
+ * @param tdoa      Arrival less transmit time (m), as rtdoa_tdoa_batch().
+ * @param variance  Variance of tdoa (m^2), <= 0 for the configured variance.
+ *
+ * @return 0 if applied, 1 if held to start the track, -1 if the table is full, -2 if gated out
+ */
+int
+track_tdoa(track_table_t * table, uint16_t uid, uint64_t utime, uint8_t seq, const triad_t * anchor,
+           double tdoa, double variance)
+{
+    track_t * track = track_get(table, uid, utime);
+    double h[TRACK_NSTATES], dist;
+    int first;
+
+    if (track == NULL) {
+        return -1;
+    }
+    variance = (variance > 0) ? variance : table->config.variance;
+    if (!track->tdoa) {
+        track_reset(track, uid);
+        track->tdoa = 1;
+        track->seq = seq + 1;
+    }
+    track->seen = utime;
+    first = (seq != track->seq);
+    track->seq = seq;
+
+    if (track->state == TRACK_INIT) {
+        tdoa_meas_t meas[TRACK_INIT_MEAS];
+        tdoa_result_t result;
+        uint8_t i;
+
+        if (first) {
+            track->npending = 0;
+        }
+        track_hold(track, utime, anchor, tdoa, variance);
+        if (track->npending < table->config.dim + 2) {
+            return 1;
+        }
+        for (i = 0; i < track->npending; i++) {
+            meas[i].anchor = track->pending[i].anchor;
+            meas[i].tdoa = track->pending[i].value;
+            meas[i].variance = track->pending[i].variance;
+        }
+        if (tdoa_solve(meas, track->npending, table->config.dim, NULL, &result)) {
+            return 1;
+        }
+        track_start(table, track, &result.pos, &result.variance);
+        track->x[TRACK_B] = result.offset;
+        track->P[TRACK_B][TRACK_B] = result.rms * result.rms + table->config.variance;
+        return 0;
+    }
+
+    track_predict(table, track, utime);
+    dist = track_geometry(table, track, anchor, h);
+    if (first) {
+        /* A new round, the offset starts over from this arrival */
+        uint8_t i;
+        for (i = 0; i < TRACK_NSTATES; i++) {
+            track->P[TRACK_B][i] = track->P[i][TRACK_B] = 0;
+        }
+        track->P[TRACK_B][TRACK_B] = TRACK_B_VARIANCE;
+        track->x[TRACK_B] = tdoa - dist;
+    }
+    h[TRACK_B] = 1;
+    return track_update(table, track, h, tdoa - dist - track->x[TRACK_B], variance, !first);
+}
+
+/**
+ * @fn track_position(const track_table_t * table, const track_t * track, uint64_t utime, triad_t * pos,
+ *     triad_t * vel, triad_t * variance)
+ * @brief Position of a track extrapolated to any time, the track is not changed.
+ *
+ * @param table     Table.
+ * @param track     Track, from track_find().
+ * @param utime     Time of the position (usec).
+ * @param pos       Position.
+ * @param vel       Optional velocity.
+ * @param variance  Optional position variance.
+ *
+ * @return 0 on success, -1 if the track has no position yet
+ */
+int
+track_position(const track_table_t * table, const track_t * track, uint64_t utime, triad_t * pos,
+               triad_t * vel, triad_t * variance)
+{
+    double dt = (utime > track->utime) ? (utime - track->utime) * 1e-6 : 0;
+    uint8_t c;
+
+    if (track->state != TRACK_ACTIVE) {
+        return -1;
+    }
+    memset(pos, 0, sizeof(*pos));
+    if (vel) {
+        memset(vel, 0, sizeof(*vel));
+    }
+    if (variance) {
+        memset(variance, 0, sizeof(*variance));
+    }
+    for (c = 0; c < table->config.dim; c++) {
+        pos->array[c] = track->x[c] + dt * track->x[c + 3];
+        if (vel) {
+            vel->array[c] = track->x[c + 3];
+        }
+        if (variance) {
+            variance->array[c] = track->P[c][c] + 2 * dt * track->P[c][c + 3] +
+                                 dt * dt * track->P[c + 3][c + 3] + table->config.accel_noise * dt * dt * dt / 3;
+        }
+    }
+    return 0;
+}
@@ -36,6 +36,7 @@ extern "C" {
 #define JSON_VALUE_TYPE_ARRAY  (4)
 #define JSON_VALUE_TYPE_OBJECT (5)
 #define JSON_VALUE_TYPE_FLOAT64 (6)
+#define JSON_VALUE_TYPE_FLOAT32 (7)
 
 struct json_value {
     uint8_t jv_pad1;
@@ -79,6 +80,11 @@ struct json_value {
     (__jv)->jv_type = JSON_VALUE_TYPE_FLOAT64; \
     (__jv)->jv_val.fl = (dpl_float64_t) __v;
 
+/* A float32 quantity held in a double, written with float precision */
+#define JSON_VALUE_FLOAT32(__jv, __v)          \
+    (__jv)->jv_type = JSON_VALUE_TYPE_FLOAT32; \
+    (__jv)->jv_val.fl = (dpl_float64_t) __v;
+
 /* Encoding functions */
 typedef int (*json_write_func_t)(void *buf, char *data,
         int len);
@@ -88,8 +94,24 @@ struct json_encoder {
     void *je_arg;
     int je_wr_commas:1;
     char je_encode_buf[64];
+    /* Direct output, see json_encode_buf_init(). je_write is not used when je_buf is set */
+    char *je_buf;
+    uint16_t je_buf_size;
+    uint16_t je_buf_len;
+    uint8_t je_buf_overflow;
 };
 
+/* Worst case lengths of the number formatters */
+#define JSON_FMT_UINT64_MAX  (20)
+#define JSON_FMT_INT64_MAX   (21)
+#define JSON_FMT_FLOAT64_MAX (32)
+#define JSON_FMT_FLOAT32_MAX (24)
+
+int json_fmt_uint64(char *dst, uint64_t v);
+int json_fmt_int64(char *dst, int64_t v);
+int json_fmt_float64(char *dst, dpl_float64_t v);
+int json_fmt_float32(char *dst, dpl_float64_t v);
+
 
 #define JSON_NITEMS(x) (int)(sizeof(x)/sizeof(x[0]))
 
@@ -104,6 +126,9 @@ int json_encode_array_start(struct json_encoder *encoder);
 int json_encode_array_value(struct json_encoder *encoder, struct json_value *val);
 int json_encode_array_finish(struct json_encoder *encoder);
 
+void json_encode_buf_init(struct json_encoder *encoder, char *buf, uint16_t size);
+int json_encode_buf_finish(struct json_encoder *encoder);
+
 /* Json parser definitions */
 typedef enum {
     t_integer,
@@ -199,8 +224,25 @@ struct json_buffer {
 
 #define JSON_ATTR_MAX        31        /* max chars in JSON attribute name */
 #define JSON_VAL_MAX        512        /* max chars in JSON value part */
+#define JSON_ATTR_INDEX_MAX  16        /* max attributes in an indexed attr array */
+
+/*
+ * Attribute names of an attr array sorted by hash, so incoming keys are found
+ * with a binary search instead of a strcmp against every attribute. Only
+ * positions are stored, so one index serves every instance of an attr array
+ * with the same names in the same order, e.g. one built on the stack per call.
+ */
+struct json_attr_index {
+    uint8_t ji_built;
+    uint8_t ji_count;                   /* 0 falls back to a linear search */
+    uint8_t ji_idx[JSON_ATTR_INDEX_MAX];
+    uint32_t ji_hash[JSON_ATTR_INDEX_MAX];
+};
 
 int json_read_object(struct json_buffer *, const struct json_attr_t *);
+int json_read_object_indexed(struct json_buffer *, const struct json_attr_t *,
+        struct json_attr_index *);
+int json_attr_index_init(struct json_attr_index *, const struct json_attr_t *);
 int json_read_array(struct json_buffer *, const struct json_array_t *);
 
 #define JSON_ERR_OBSTART     1   /* non-WS when expecting object start */
@@ -29,6 +29,8 @@
 
 TEST_CASE_DECL(json_encode_test)
 TEST_CASE_DECL(json_decode_test)
+TEST_CASE_DECL(json_encode_buf_test)
+TEST_CASE_DECL(json_decode_index_test)
 
 TEST_SUITE(json_test_all)
 {
@@ -37,6 +39,8 @@ TEST_SUITE(json_test_all)
 
     json_encode_test();
     json_decode_test();
+    json_encode_buf_test();
+    json_decode_index_test();
 
 free(bigbuf);
 }
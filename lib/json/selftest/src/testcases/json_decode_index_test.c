@@ -0,0 +1,220 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "os/mynewt.h"
+#include "json_test.h"
+#include "json/json.h"
+#include "json/json_util.h"
+#include "json_test_priv.h"
+
+#define DECODE_LOG_LINES    (32)
+
+/* Decoded form of a range log line, as in rng_json_read() */
+struct decode_rng {
+    uint64_t utime;
+    uint64_t seq;
+    uint64_t uid;
+    uint64_t ouid;
+    dpl_float64_t raz[3];
+    dpl_float64_t rssi[3];
+    dpl_float64_t los[3];
+    dpl_float64_t ppm;
+    dpl_float64_t sts;
+    int64_t offset[4];
+};
+
+static char decode_log[DECODE_LOG_LINES][384];
+
+static void
+decode_attrs(struct json_attr_t *attrs, struct decode_rng *r)
+{
+    struct json_attr_t tmpl[] = {
+        {.attribute = "utime", .type = t_uinteger, .addr.uinteger = &r->utime, .nodefault = true},
+        {.attribute = "seq", .type = t_uinteger, .addr.uinteger = &r->seq},
+        {.attribute = "uid", .type = t_uinteger, .addr.uinteger = &r->uid},
+        {.attribute = "ouid", .type = t_uinteger, .addr.uinteger = &r->ouid},
+        {.attribute = "raz", .type = t_array, .addr.array = {
+            .element_type = t_real, .arr.reals.store = r->raz, .maxlen = 3}},
+        {.attribute = "rssi", .type = t_array, .addr.array = {
+            .element_type = t_real, .arr.reals.store = r->rssi, .maxlen = 3}},
+        {.attribute = "los", .type = t_array, .addr.array = {
+            .element_type = t_real, .arr.reals.store = r->los, .maxlen = 3}},
+        {.attribute = "offset", .type = t_array, .addr.array = {
+            .element_type = t_integer, .arr.integers.store = r->offset, .maxlen = 4}},
+        {.attribute = "ppm", .type = t_real, .addr.real = &r->ppm},
+        {.attribute = "sts", .type = t_real, .addr.real = &r->sts},
+        {.attribute = NULL}
+    };
+    memcpy(attrs, tmpl, sizeof(tmpl));
+}
+
+static void
+decode_log_fill(void)
+{
+    struct json_encoder encoder;
+    struct json_value value;
+    const char *arrays[] = {"raz", "rssi", "los"};
+
+    memset(&encoder, 0, sizeof(encoder));
+    for (int l = 0; l < DECODE_LOG_LINES; l++) {
+        json_encode_buf_init(&encoder, decode_log[l], sizeof(decode_log[l]));
+        json_encode_object_start(&encoder);
+        JSON_VALUE_UINT(&value, 1591714503113ULL + l * 10007ULL);
+        json_encode_object_entry(&encoder, "utime", &value);
+        JSON_VALUE_UINT(&value, l & 0xFF);
+        json_encode_object_entry(&encoder, "seq", &value);
+        JSON_VALUE_UINT(&value, 0x1234);
+        json_encode_object_entry(&encoder, "uid", &value);
+        JSON_VALUE_UINT(&value, 0x4321 + l);
+        json_encode_object_entry(&encoder, "ouid", &value);
+        for (int a = 0; a < 3; a++) {
+            json_encode_array_name(&encoder, (char *) arrays[a]);
+            json_encode_array_start(&encoder);
+            for (int i = 0; i < 3; i++) {
+                JSON_VALUE_FLOAT64(&value, (a == 1 ? -80.0 : 1.0) + l * 0.0731 + i * 0.5);
+                json_encode_array_value(&encoder, &value);
+            }
+            json_encode_array_finish(&encoder);
+        }
+        json_encode_array_name(&encoder, "offset");
+        json_encode_array_start(&encoder);
+        for (int i = 0; i < 4; i++) {
+            JSON_VALUE_INT(&value, (l - 16) * 1000 + i);
+            json_encode_array_value(&encoder, &value);
+        }
+        json_encode_array_finish(&encoder);
+        JSON_VALUE_FLOAT64(&value, -4.25 + l * 0.125);
+        json_encode_object_entry(&encoder, "ppm", &value);
+        json_encode_object_finish(&encoder);
+        TEST_ASSERT_FATAL(json_encode_buf_finish(&encoder) > 0);
+    }
+}
+
+static int
+decode_linear(char *line, struct decode_rng *r)
+{
+    struct test_jbuf tjb;
+    struct json_attr_t attrs[11];
+
+    decode_attrs(attrs, r);
+    test_buf_init(&tjb, line);
+    return json_read_object(&tjb.json_buf, attrs);
+}
+
+static int
+decode_indexed(char *line, struct decode_rng *r)
+{
+    static struct json_attr_index index;
+    json_decoder_t decoder;
+    struct json_attr_t attrs[11];
+
+    decode_attrs(attrs, r);
+    decoder.json_buf.jb_read_next = json_read_next;
+    decoder.json_buf.jb_read_prev = json_read_prev;
+    decoder.json_buf.jb_readn = json_readn;
+    decoder.start_buf = line;
+    decoder.end_buf = line + strlen(line);
+    decoder.current_position = 0;
+    return json_read_object_indexed(&decoder.json_buf, attrs, &index);
+}
+
+/* Encoder output read back in place, bit for bit as strtod reads it */
+static void
+decode_reals(void)
+{
+    const dpl_float64_t v[] = {1e-7, 1e20, 0.1, -81.12346, 1.0000030517578125,
+        -1.2079226507921703e-13, 832218710528.0, 1.23456789e33, 9007199254740993.0};
+    char line[64];
+    dpl_float64_t out[1], ref;
+    uint64_t count;
+    json_decoder_t decoder;
+    struct json_attr_t attrs[] = {
+        {.attribute = "v", .type = t_array, .addr.array = {
+            .element_type = t_real, .arr.reals.store = out, .maxlen = 1, .count = &count}},
+        {.attribute = NULL}
+    };
+    uint32_t seed = 0x2545F491;
+    int i, n;
+
+    decoder.json_buf.jb_read_next = json_read_next;
+    decoder.json_buf.jb_read_prev = json_read_prev;
+    decoder.json_buf.jb_readn = json_readn;
+    for (i = 0; i < 4000; i++) {
+        dpl_float64_t d;
+        if (i < 2 * sizeof(v) / sizeof(v[0])) {
+            d = v[i / 2];
+        } else {
+            seed = seed * 1664525 + 1013904223;
+            d = ldexp((double)(seed | 1) * (seed >> 7), (int)(seed % 97) - 80);
+        }
+        strcpy(line, "{\"v\":[");
+        n = strlen(line);
+        n += (i & 1) ? json_fmt_float32(line + n, d) : json_fmt_float64(line + n, d);
+        strcpy(line + n, "]}");
+        decoder.start_buf = line;
+        decoder.end_buf = line + strlen(line);
+        decoder.current_position = 0;
+        TEST_ASSERT(json_read_object(&decoder.json_buf, attrs) == 0);
+        ref = strtod(line + 6, NULL);
+        TEST_ASSERT(memcmp(out, &ref, sizeof(ref)) == 0);
+    }
+}
+
+/* JSON DECODE ATTRIBUTE INDEX TEST */
+TEST_CASE_SELF(json_decode_index_test)
+{
+    struct decode_rng a, b;
+    struct json_attr_index index;
+    struct json_attr_t attrs[JSON_ATTR_INDEX_MAX + 2];
+    int rc;
+
+    memset(&index, 0, sizeof(index));
+    decode_attrs(attrs, &a);
+    TEST_ASSERT(json_attr_index_init(&index, attrs) == 0);
+    TEST_ASSERT(index.ji_count == 10);
+
+    /* Too many attributes fall back to a linear search */
+    for (int i = 0; i <= JSON_ATTR_INDEX_MAX; i++) {
+        attrs[i] = attrs[0];
+    }
+    attrs[JSON_ATTR_INDEX_MAX + 1].attribute = NULL;
+    TEST_ASSERT(json_attr_index_init(&index, attrs) == -1);
+    TEST_ASSERT(index.ji_count == 0);
+
+    decode_log_fill();
+
+    /* Both paths decode every line to the same values */
+    for (int l = 0; l < DECODE_LOG_LINES; l++) {
+        memset(&a, 0, sizeof(a));
+        memset(&b, 0, sizeof(b));
+        rc = decode_linear(decode_log[l], &a);
+        TEST_ASSERT(rc == 0);
+        rc = decode_indexed(decode_log[l], &b);
+        TEST_ASSERT(rc == 0);
+        TEST_ASSERT(memcmp(&a, &b, sizeof(a)) == 0);
+        TEST_ASSERT(a.ouid == 0x4321 + l);
+        TEST_ASSERT(a.offset[3] == (l - 16) * 1000 + 3);
+    }
+
+    /* Unknown attributes are still rejected */
+    rc = decode_indexed("{\"utime\": 1,\"bogus\": 2}", &b);
+    TEST_ASSERT(rc == JSON_ERR_BADATTR);
+
+    decode_reals();
+}
@@ -0,0 +1,180 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdlib.h>
+#include "os/mynewt.h"
+#include "json_test.h"
+#include "json/json.h"
+#include "json_test_priv.h"
+
+#define ENCODE_BUF_SIZE     (512)
+
+static char encode_buf[ENCODE_BUF_SIZE];
+static uint16_t encode_idx;
+
+/* Per byte writer as used by the payload encoders before direct output */
+static int
+encode_write_line(void *buf, char *data, int len)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        encode_buf[(encode_idx++) % ENCODE_BUF_SIZE] = data[i];
+        if (data[i] == '\0') {
+            break;
+        }
+    }
+    if (encode_buf[encode_idx - 1] == '\0') {
+        encode_idx = 0;
+    }
+    return len;
+}
+
+static int
+encode_direct(struct json_encoder *e, void (*payload)(struct json_encoder *))
+{
+    json_encode_buf_init(e, encode_buf, sizeof(encode_buf));
+    payload(e);
+    return json_encode_buf_finish(e);
+}
+
+static void
+encode_legacy(struct json_encoder *e, void (*payload)(struct json_encoder *))
+{
+    json_encode_buf_init(e, NULL, 0);
+    e->je_write = encode_write_line;
+    e->je_arg = NULL;
+    payload(e);
+    encode_write_line(NULL, "\0", 1);
+}
+
+static const char *encode_int_output =
+    "{\"utime\": 18446744073709551615,\"neg\": -9223372036854775808,\"arr\": [0,-1,10,99,100],"
+    "\"obj\": {\"a\": 1,\"b\": true},\"str\": \"a\\\"b\\\\c\\n\"}";
+
+static void
+encode_ints(struct json_encoder *e)
+{
+    struct json_value value;
+    const int64_t arr[] = {0, -1, 10, 99, 100};
+
+    json_encode_object_start(e);
+    JSON_VALUE_UINT(&value, UINT64_MAX);
+    json_encode_object_entry(e, "utime", &value);
+    JSON_VALUE_INT(&value, INT64_MIN);
+    json_encode_object_entry(e, "neg", &value);
+    json_encode_array_name(e, "arr");
+    json_encode_array_start(e);
+    for (int i = 0; i < 5; i++) {
+        JSON_VALUE_INT(&value, arr[i]);
+        json_encode_array_value(e, &value);
+    }
+    json_encode_array_finish(e);
+    json_encode_object_key(e, "obj");
+    json_encode_object_start(e);
+    JSON_VALUE_UINT(&value, 1);
+    json_encode_object_entry(e, "a", &value);
+    JSON_VALUE_BOOL(&value, 1);
+    json_encode_object_entry(e, "b", &value);
+    json_encode_object_finish(e);
+    JSON_VALUE_STRING(&value, "a\"b\\c\n");
+    json_encode_object_entry(e, "str", &value);
+    json_encode_object_finish(e);
+}
+
+/* JSON ENCODE DIRECT BUFFER TEST */
+TEST_CASE_SELF(json_encode_buf_test)
+{
+    struct json_encoder encoder;
+    char small[16];
+    char num[JSON_FMT_FLOAT64_MAX + 1];
+    int len;
+
+    memset(&encoder, 0, sizeof(encoder));
+
+    /* Without floats both paths produce the same text */
+    len = encode_direct(&encoder, encode_ints);
+    TEST_ASSERT(len == strlen(encode_int_output));
+    TEST_ASSERT(strcmp(encode_buf, encode_int_output) == 0);
+    encode_legacy(&encoder, encode_ints);
+    TEST_ASSERT(strcmp(encode_buf, encode_int_output) == 0);
+
+    /* Truncation is reported and the output stays terminated */
+    json_encode_buf_init(&encoder, small, sizeof(small));
+    encode_ints(&encoder);
+    TEST_ASSERT(json_encode_buf_finish(&encoder) == -1);
+    TEST_ASSERT(strlen(small) == sizeof(small) - 1);
+    TEST_ASSERT(strncmp(small, encode_int_output, sizeof(small) - 1) == 0);
+
+    /* Shortest representation */
+    len = json_fmt_float64(num, 0.1);
+    TEST_ASSERT(len == 3 && strncmp(num, "0.1", 3) == 0);
+    len = json_fmt_float64(num, -2.0);
+    TEST_ASSERT(len == 4 && strncmp(num, "-2.0", 4) == 0);
+    len = json_fmt_float64(num, 1e-7);
+    TEST_ASSERT(len == 4 && strncmp(num, "1e-7", 4) == 0);
+    len = json_fmt_float64(num, DPL_FLOAT64_NAN());
+    TEST_ASSERT(len == 4 && strncmp(num, "null", 4) == 0);
+
+    /* Float precision for values that came from a float32 */
+    len = json_fmt_float32(num, (double)0.1f);
+    TEST_ASSERT(len == 3 && strncmp(num, "0.1", 3) == 0);
+    len = json_fmt_float32(num, (double)-81.123456f);
+    TEST_ASSERT(len == 9 && strncmp(num, "-81.12346", 9) == 0);
+    len = json_fmt_float32(num, 1e-50);
+    TEST_ASSERT(len == 3 && strncmp(num, "0.0", 3) == 0);
+    len = json_fmt_float32(num, 1e300);
+    TEST_ASSERT(len == 5 && strncmp(num, "1e300", 5) == 0);
+
+#ifdef FLOAT_SUPPORT
+    /* Every float written reads back to the same double */
+    {
+        uint64_t x = 88172645463325252ULL;
+        for (int i = 0; i < 10000; i++) {
+            double d, r;
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            d = (double)(int64_t)x / (double)(1 + (x >> 44));
+            len = json_fmt_float64(num, d);
+            TEST_ASSERT_FATAL(len <= JSON_FMT_FLOAT64_MAX);
+            num[len] = '\0';
+            r = strtod(num, NULL);
+            TEST_ASSERT(memcmp(&r, &d, sizeof(d)) == 0);
+        }
+    }
+    /* and every float32 back to the same float, subnormals included */
+    {
+        uint32_t x = 2463534242UL;
+        for (int i = 0; i < 10000; i++) {
+            float f, r;
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            memcpy(&f, &x, sizeof(f));
+            if (isnan(f) || isinf(f)) {
+                continue;
+            }
+            len = json_fmt_float32(num, (double)f);
+            TEST_ASSERT_FATAL(len <= JSON_FMT_FLOAT32_MAX);
+            num[len] = '\0';
+            r = strtof(num, NULL);
+            TEST_ASSERT(memcmp(&r, &f, sizeof(f)) == 0);
+        }
+    }
+#endif
+}
@@ -82,7 +82,45 @@ PERMISSIONS
 #define slog(fmt, ...)
 #endif
 
+#include <dpl/dpl.h>
 #include "json/json.h"
+#include "json/json_util.h"
+
+/* Input held in a json_decoder_t is contiguous and can be parsed in place */
+static inline bool
+json_is_contiguous(struct json_buffer *jb)
+{
+    return jb->jb_read_next == json_read_next;
+}
+
+/* jb_read_next()/jb_read_prev() with the json_decoder_t case inlined */
+static inline char
+json_next(struct json_buffer *jb)
+{
+    json_decoder_t *decoder = (json_decoder_t *) jb;
+
+    if (!json_is_contiguous(jb)) {
+        return jb->jb_read_next(jb);
+    }
+    if (decoder->start_buf + decoder->current_position <= decoder->end_buf) {
+        return decoder->start_buf[decoder->current_position++];
+    }
+    return '\0';
+}
+
+static inline char
+json_prev(struct json_buffer *jb)
+{
+    json_decoder_t *decoder = (json_decoder_t *) jb;
+
+    if (!json_is_contiguous(jb)) {
+        return jb->jb_read_prev(jb);
+    }
+    if (decoder->current_position) {
+        return decoder->start_buf[--decoder->current_position];
+    }
+    return '\0';
+}
 
 static void
 json_skip_ws(struct json_buffer *jb)
@@ -90,10 +128,10 @@ json_skip_ws(struct json_buffer *jb)
     char c;
 
     do {
-        c = jb->jb_read_next(jb);
+        c = json_next(jb);
     } while (isspace((int) c));
 
-    jb->jb_read_prev(jb);
+    json_prev(jb);
 }
 
 static char
@@ -101,8 +139,8 @@ json_peek(struct json_buffer *jb)
 {
     char c;
 
-    jb->jb_read_next(jb);
-    c = jb->jb_read_prev(jb);
+    json_next(jb);
+    c = json_prev(jb);
 
     return c;
 }
@@ -149,9 +187,485 @@ json_target_address(const struct json_attr_t *cursor,
     return targetaddr;
 }
 
+/*
+ * Number conversion. Plain decimal numbers are converted here without going
+ * through the C library; anything else (hex, octal, out of range values, long
+ * mantissas, inf/nan) falls back to strtoll/strtoull/strtod so the results are
+ * the same as before.
+ */
+#define JSON_NUM_MAX    (64)
+
+static inline bool
+json_num_char(char c)
+{
+    return isalnum((unsigned char) c) || c == '.' || c == '+' || c == '-';
+}
+
+/* Length of the token at s that could be part of a number */
+static int
+json_num_len(const char *s, int len)
+{
+    int n = 0;
+    while (n < len && json_num_char(s[n])) {
+        n++;
+    }
+    return n;
+}
+
+/* Null terminated copy of the token at s, for the library fallbacks */
+static void
+json_num_copy(char *dst, const char *s, int len)
+{
+    len = json_num_len(s, len);
+    if (len > JSON_NUM_MAX - 1) {
+        len = JSON_NUM_MAX - 1;
+    }
+    memcpy(dst, s, len);
+    dst[len] = '\0';
+}
+
+/**
+ * Convert an integer.
+ *
+ * @param s         Start of the number, need not be null terminated.
+ * @param len       Characters available at s.
+ * @param is_signed Store an int64_t rather than a uint64_t.
+ * @param out       Destination.
+ *
+ * @return Characters consumed, 0 if there is no number at s
+ */
+static int
+json_parse_integer(const char *s, int len, bool is_signed, void *out)
+{
+    char buf[JSON_NUM_MAX];
+    uint64_t v = 0;
+    bool neg = false;
+    int i = 0, digits;
+
+    if (i < len && (s[i] == '-' || s[i] == '+')) {
+        neg = (s[i] == '-');
+        i++;
+    }
+    for (digits = 0; i < len && s[i] >= '0' && s[i] <= '9'; i++, digits++) {
+        v = v * 10 + (s[i] - '0');
+    }
+    /* 19 digits cannot overflow, leading zeros mean octal to strtoll */
+    if (digits == 0 || digits > 19 || (digits > 1 && s[i - digits] == '0') ||
+        (neg && !is_signed) || (i < len && (isalnum((unsigned char) s[i]) || s[i] == '.'))) {
+        goto fallback;
+    }
+    if (is_signed) {
+        if (v > (1ULL << 63) - !neg) {
+            goto fallback;
+        }
+        int64_t sv = (neg) ? (int64_t)(0 - v) : (int64_t)v;
+        memcpy(out, &sv, sizeof(sv));
+    } else {
+        memcpy(out, &v, sizeof(v));
+    }
+    return i;
+
+fallback:
+    json_num_copy(buf, s, len);
+#ifdef __KERNEL__
+    if (is_signed) {
+        if (kstrtoll(buf, 0, (long long int *)out)) {
+            return 0;
+        }
+    } else {
+        if (kstrtoull(buf, 0, (long long unsigned int *)out)) {
+            return 0;
+        }
+    }
+    return strlen(buf);
+#else
+    {
+        char *ep;
+        if (is_signed) {
+            long long int tmp = strtoll(buf, &ep, 0);
+            memcpy(out, &tmp, sizeof(tmp));
+        } else {
+            long long unsigned int tmp = strtoull(buf, &ep, 0);
+            memcpy(out, &tmp, sizeof(tmp));
+        }
+        return ep - buf;
+    }
+#endif
+}
+
+#ifdef FLOAT_SUPPORT
+static const double json_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const uint64_t json_pow5[] = {
+    1ULL, 5ULL, 25ULL, 125ULL, 625ULL, 3125ULL, 15625ULL, 78125ULL, 390625ULL,
+    1953125ULL, 9765625ULL, 48828125ULL, 244140625ULL, 1220703125ULL,
+    6103515625ULL, 30517578125ULL, 152587890625ULL, 762939453125ULL,
+    3814697265625ULL, 19073486328125ULL, 95367431640625ULL, 476837158203125ULL,
+    2384185791015625ULL, 11920928955078125ULL, 59604644775390625ULL,
+    298023223876953125ULL, 1490116119384765625ULL, 7450580596923828125ULL
+};
+
+#define JSON_REAL_EXP10_MAX     (27)
+#define JSON_REAL_SIG_MAX       (19)
+
+/**
+ * Round hi:lo * 2^e2 to a double, half to even. sticky is set when bits
+ * below lo were dropped. The caller keeps the result in the normal range.
+ */
+static double
+json_real_pack(uint64_t hi, uint64_t lo, bool sticky, int e2)
+{
+    uint64_t f, rem, bits;
+    int s;
+    double d;
+
+    /* Top 64 bits, the rest folds into sticky */
+    if (hi) {
+        s = __builtin_clzll(hi);
+        f = (s) ? (hi << s) | (lo >> (64 - s)) : hi;
+        sticky |= (lo << s) != 0;
+        e2 += 64 - s;
+    } else {
+        s = __builtin_clzll(lo);
+        f = lo << s;
+        e2 -= s;
+    }
+    rem = f & 0x7FF;
+    f >>= 11;
+    if (rem > 0x400 || (rem == 0x400 && (sticky || (f & 1)))) {
+        f++;
+        if (f >> 53) {
+            f >>= 1;
+            e2++;
+        }
+    }
+    /* f is 1.52 with its top bit at 2^(e2 + 63) */
+    bits = ((uint64_t)(e2 + 63 + 0x3FF) << 52) | (f & 0x000FFFFFFFFFFFFFULL);
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+/**
+ * Exact m * 10^exp10 for m up to 2^64 and |exp10| <= 27, where 10^exp10 is
+ * 5^exp10 * 2^exp10 and 5^27 < 2^63. Up scaling is a 64 x 64 bit product,
+ * down scaling a long division by 5^-exp10 in as many bits as fit.
+ */
+static double
+json_real_scale(uint64_t m, int exp10)
+{
+    const uint64_t M32 = 0xFFFFFFFFULL;
+    uint64_t d = json_pow5[(exp10 < 0) ? -exp10 : exp10];
+
+    if (exp10 >= 0) {
+        uint64_t a = m >> 32, b = m & M32;
+        uint64_t c = d >> 32, e = d & M32;
+        uint64_t bd = b * e, ad = a * e, bc = b * c;
+        uint64_t mid = (bd >> 32) + (ad & M32) + (bc & M32);
+        uint64_t hi = a * c + (ad >> 32) + (bc >> 32) + (mid >> 32);
+        uint64_t lo = (mid << 32) | (bd & M32);
+        return json_real_pack(hi, lo, false, exp10);
+    } else {
+        /* Quotient of (m << z) * 2^t / 5^k lands in [2^62, 2^64) */
+        int z = __builtin_clzll(m);
+        int t = 63 - __builtin_clzll(d);
+        int chunk = __builtin_clzll(d);
+        int pos = 64 + t;
+        uint64_t q = 0, r = 0, n;
+
+        m <<= z;
+        while (pos > 0) {
+            int w = (pos < chunk) ? pos : chunk;
+            pos -= w;
+            /* Bits pos .. pos + w - 1 of m * 2^t */
+            if (pos >= t) {
+                n = m >> (pos - t);
+            } else if (t - pos < 64) {
+                n = m << (t - pos);
+            } else {
+                n = 0;
+            }
+            n &= (1ULL << w) - 1;
+            r = (r << w) | n;
+            q = (q << w) | (r / d);
+            r %= d;
+        }
+        return json_real_pack(0, q, r != 0, exp10 - z - t);
+    }
+}
+
+/**
+ * Convert a real. Mantissas of up to 19 significant digits scaled by up to
+ * 10^27 are converted exactly, trailing zeros fold into the exponent, so
+ * everything json_fmt_float64() and json_fmt_float32() write for values
+ * from about 1e-10 to 1e46 avoids strtod. The result rounds the same way strtod
+ * does.
+ *
+ * @param s     Start of the number, need not be null terminated.
+ * @param len   Characters available at s.
+ * @param out   Destination.
+ *
+ * @return Characters consumed, 0 if there is no number at s
+ */
+static int
+json_parse_real(const char *s, int len, double *out)
+{
+    char buf[JSON_NUM_MAX];
+    char *ep;
+    uint64_t m = 0;
+    bool neg = false, frac = false;
+    int i = 0, digits = 0, sig = 0, zeros = 0, exp10 = 0;
+
+    if (i < len && (s[i] == '-' || s[i] == '+')) {
+        neg = (s[i] == '-');
+        i++;
+    }
+    for (; i < len; i++) {
+        if (s[i] == '.' && !frac) {
+            frac = true;
+            continue;
+        }
+        if (s[i] < '0' || s[i] > '9') {
+            break;
+        }
+        digits++;
+        exp10 -= frac;
+        if (s[i] == '0') {
+            /* Held back until a non zero digit shows they are significant */
+            zeros += (m != 0);
+            continue;
+        }
+        sig += zeros + 1;
+        if (sig > JSON_REAL_SIG_MAX) {
+            goto fallback;
+        }
+        for (; zeros; zeros--) {
+            m *= 10;
+        }
+        m = m * 10 + (s[i] - '0');
+    }
+    exp10 += zeros;
+    if (digits == 0) {
+        goto fallback;
+    }
+    if (i < len && (s[i] == 'e' || s[i] == 'E')) {
+        int j = i + 1, e = 0, edigits = 0;
+        bool eneg = false;
+        if (j < len && (s[j] == '-' || s[j] == '+')) {
+            eneg = (s[j] == '-');
+            j++;
+        }
+        for (; j < len && s[j] >= '0' && s[j] <= '9' && edigits < 4; j++, edigits++) {
+            e = e * 10 + (s[j] - '0');
+        }
+        if (edigits == 0 || (j < len && s[j] >= '0' && s[j] <= '9')) {
+            goto fallback;
+        }
+        exp10 += (eneg) ? -e : e;
+        i = j;
+    }
+    if (i < len && (isalnum((unsigned char) s[i]) || s[i] == '.')) {
+        goto fallback;
+    }
+    if (m == 0) {
+        *out = (neg) ? -0.0 : 0.0;
+        return i;
+    }
+    /* Move excess powers of ten into the mantissa while it stays exact */
+    for (; exp10 > JSON_REAL_EXP10_MAX && m <= UINT64_MAX / 10; exp10--) {
+        m *= 10;
+    }
+    if (exp10 < -JSON_REAL_EXP10_MAX || exp10 > JSON_REAL_EXP10_MAX) {
+        goto fallback;
+    }
+    if (m <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22) {
+        double d = (double) m;
+        d = (exp10 < 0) ? d / json_pow10[-exp10] : d * json_pow10[exp10];
+        *out = (neg) ? -d : d;
+    } else {
+        double d = json_real_scale(m, exp10);
+        *out = (neg) ? -d : d;
+    }
+    return i;
+
+fallback:
+    json_num_copy(buf, s, len);
+    *out = strtod(buf, &ep);
+    return ep - buf;
+}
+#endif
+
+/**
+ * Read one number array element into dst, straight from the input when it is
+ * contiguous, otherwise one character at a time up to the end of the token.
+ *
+ * @return 0 on success, JSON_ERR_* otherwise
+ */
+static int
+json_read_number(struct json_buffer *jb, json_type type, void *dst)
+{
+    char buf[JSON_NUM_MAX];
+    const char *p = buf;
+    int len, n;
+    char c;
+
+    if (json_is_contiguous(jb)) {
+        json_decoder_t *decoder = (json_decoder_t *) jb;
+        p = decoder->start_buf + decoder->current_position;
+        len = (int)(decoder->end_buf - p);
+        if (len < 0) {
+            len = 0;
+        }
+    } else {
+        for (len = 0; len < JSON_NUM_MAX - 1; len++) {
+            c = json_next(jb);
+            if (!json_num_char(c)) {
+                if (c != '\0') {
+                    json_prev(jb);
+                }
+                break;
+            }
+            buf[len] = c;
+        }
+        buf[len] = '\0';
+    }
+
+    switch (type) {
+    case t_integer:
+        n = json_parse_integer(p, len, true, dst);
+        break;
+    case t_uinteger:
+        n = json_parse_integer(p, len, false, dst);
+        break;
+    case t_real:
+#ifdef FLOAT_SUPPORT
+        if (len >= 4 && strncmp(p, "null", 4) == 0) {
+            *(dpl_float64_t *)dst = NAN;
+            n = 4;
+        } else {
+            double tmp;
+            n = json_parse_real(p, len, &tmp);
+            *(dpl_float64_t *)dst = tmp;
+        }
+        break;
+#else
+        return JSON_ERR_MISC;
+#endif
+    default:
+        return JSON_ERR_SUBTYPE;
+    }
+    if (n == 0) {
+        return JSON_ERR_BADNUM;
+    }
+
+    if (json_is_contiguous(jb)) {
+        ((json_decoder_t *) jb)->current_position += n;
+    } else {
+        while (len-- > n) {
+            json_prev(jb);
+        }
+    }
+    return 0;
+}
+
+/* FNV-1a, also computed incrementally while an attribute name is read */
+#define JSON_HASH_INIT          (2166136261u)
+#define JSON_HASH_STEP(h, c)    (((h) ^ (uint8_t)(c)) * 16777619u)
+
+static uint32_t
+json_attr_hash(const char *name)
+{
+    uint32_t h = JSON_HASH_INIT;
+    while (*name) {
+        h = JSON_HASH_STEP(h, *name++);
+    }
+    return h;
+}
+
+/**
+ * Build the lookup index of an attr array. Attributes sharing a name keep
+ * their relative order so the first spec is still found first. The table is
+ * sorted on the stack and published in one go, ji_built last.
+ * json_read_object_indexed() builds and checks it under a critical section.
+ *
+ * @param index     Index to fill.
+ * @param attrs     Attr array, terminated by a NULL attribute.
+ *
+ * @return 0 on success, -1 if attrs has more than JSON_ATTR_INDEX_MAX entries,
+ *         in which case lookups fall back to a linear search
+ */
+int
+json_attr_index_init(struct json_attr_index *index, const struct json_attr_t *attrs)
+{
+    struct json_attr_index tmp;
+    int i, j, rc = 0;
+    uint32_t h;
+
+    tmp.ji_count = 0;
+    for (i = 0; attrs[i].attribute != NULL; i++) {
+        if (i >= JSON_ATTR_INDEX_MAX) {
+            tmp.ji_count = 0;
+            rc = -1;
+            break;
+        }
+        h = json_attr_hash(attrs[i].attribute);
+        for (j = i; j > 0 && tmp.ji_hash[j - 1] > h; j--) {
+            tmp.ji_hash[j] = tmp.ji_hash[j - 1];
+            tmp.ji_idx[j] = tmp.ji_idx[j - 1];
+        }
+        tmp.ji_hash[j] = h;
+        tmp.ji_idx[j] = i;
+        tmp.ji_count = i + 1;
+    }
+
+    memcpy(index->ji_hash, tmp.ji_hash, tmp.ji_count * sizeof(tmp.ji_hash[0]));
+    memcpy(index->ji_idx, tmp.ji_idx, tmp.ji_count * sizeof(tmp.ji_idx[0]));
+    index->ji_count = tmp.ji_count;
+    index->ji_built = 1;
+    return rc;
+}
+
+static const struct json_attr_t *
+json_attr_lookup(const struct json_attr_t *attrs, const struct json_attr_index *index,
+        const char *name, uint32_t hash)
+{
+    const struct json_attr_t *cursor;
+    int lo, hi, mid;
+
+    if (index == NULL || index->ji_count == 0) {
+        for (cursor = attrs; cursor->attribute != NULL; cursor++) {
+            if (strcmp(cursor->attribute, name) == 0) {
+                return cursor;
+            }
+        }
+        return NULL;
+    }
+
+    lo = 0;
+    hi = index->ji_count;
+    while (lo < hi) {
+        mid = (lo + hi) >> 1;
+        if (index->ji_hash[mid] < hash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (; lo < index->ji_count && index->ji_hash[lo] == hash; lo++) {
+        cursor = &attrs[index->ji_idx[lo]];
+        if (strcmp(cursor->attribute, name) == 0) {
+            return cursor;
+        }
+    }
+    return NULL;
+}
+
 static int
 json_internal_read_object(struct json_buffer *jb,
                           const struct json_attr_t *attrs,
+                          const struct json_attr_index *index,
                           const struct json_array_t *parent,
                           int offset)
 {
@@ -169,6 +683,7 @@ json_internal_read_object(struct json_buffer *jb,
     unsigned int u;
     const struct json_enum_t *mp;
     char *lptr;
+    uint32_t hash = JSON_HASH_INIT;
 
 #ifdef S_SPLINT_S
     /* prevents gripes about buffers not being completely defined */
@@ -218,7 +733,7 @@ json_internal_read_object(struct json_buffer *jb,
     }
 
     /* parse input JSON */
-    for (c = jb->jb_read_next(jb); c != '\0'; c = jb->jb_read_next(jb)) {
+    for (c = json_next(jb); c != '\0'; c = json_next(jb)) {
         switch (state) {
         case init:
             if (isspace((unsigned char) c)) {
@@ -235,6 +750,7 @@ json_internal_read_object(struct json_buffer *jb,
             } else if (c == '"') {
                 state = in_attr;
                 pattr = attrbuf;
+                hash = JSON_HASH_INIT;
             } else if (c == '}') {
                 break;
             } else {
@@ -248,12 +764,8 @@ json_internal_read_object(struct json_buffer *jb,
             }
             if (c == '"') {
                 *pattr++ = '\0';
-                for (cursor = attrs; cursor->attribute != NULL; cursor++) {
-                    if (strcmp(cursor->attribute, attrbuf) == 0) {
-                        break;
-                    }
-                }
-                if (cursor->attribute == NULL) {
+                cursor = json_attr_lookup(attrs, index, attrbuf, hash);
+                if (cursor == NULL) {
                     /* don't update end here, leave at attribute start */
                     return JSON_ERR_BADATTR;
                 }
@@ -275,6 +787,7 @@ json_internal_read_object(struct json_buffer *jb,
                 return JSON_ERR_ATTRLEN;
             } else {
                 *pattr++ = c;
+                hash = JSON_HASH_STEP(hash, c);
             }
             break;
         case await_value:
@@ -284,7 +797,7 @@ json_internal_read_object(struct json_buffer *jb,
                 if (cursor->type != t_array) {
                     return JSON_ERR_NOARRAY;
                 }
-                c = jb->jb_read_prev(jb);
+                c = json_prev(jb);
                 substatus = json_read_array(jb, &cursor->addr.array);
                 if (substatus != 0) {
                     return substatus;
@@ -345,10 +858,10 @@ json_internal_read_object(struct json_buffer *jb,
             case 'u':
                 for (n = 0; n < 4 && c != '\0'; n++) {
                     uescape[n] = c;
-                    c = jb->jb_read_next(jb);
+                    c = json_next(jb);
                 }
                 // Scroll back one
-                c = jb->jb_read_prev(jb);
+                c = json_prev(jb);
 #ifdef __KERNEL__
                 int rc = kstrtoul(uescape, 16, (unsigned long *)&u);
                 if (rc){
@@ -374,7 +887,7 @@ json_internal_read_object(struct json_buffer *jb,
                 *pval = '\0';
                 state = post_val;
                 if (c == '}' || c == ',') {
-                    c = jb->jb_read_prev(jb);
+                    c = json_prev(jb);
                 }
             } else if (pval > valbuf + JSON_VAL_MAX - 1) {
                 /* don't update end here, leave at value start */
@@ -443,35 +956,23 @@ json_internal_read_object(struct json_buffer *jb,
             lptr = json_target_address(cursor, parent, offset);
             if (lptr != NULL) {
                 switch (cursor->type) {
-                case t_integer: {
-#ifdef __KERNEL__
-                        int rc = kstrtoll(valbuf, 0, (long long int *)lptr);
-                        if (rc){
-                            return  JSON_ERR_BADSTRING;
-                        }
-#else
-                        long long int tmp =
-                            (long long int)strtoll(valbuf, NULL, 0);
-                        memcpy(lptr, &tmp, sizeof(long long int));
-#endif
-                    }
-                    break;
-                case t_uinteger: {
+                case t_integer:
+                case t_uinteger:
+                    if (json_parse_integer(valbuf, strlen(valbuf),
+                            cursor->type == t_integer, lptr) == 0) {
 #ifdef __KERNEL__
-                        int rc = kstrtoull(valbuf, 0, (long long unsigned int *)lptr);
-                        if (rc){
-                            return  JSON_ERR_BADSTRING;
-                        }
+                        return  JSON_ERR_BADSTRING;
 #else
-                        long long unsigned int tmp =
-                            (long long unsigned int)strtoull(valbuf, NULL, 0);
-                        memcpy(lptr, &tmp, sizeof(long long unsigned int));
+                        memset(lptr, 0, sizeof(long long int));
 #endif
                     }
                     break;
                 case t_real: {
 #ifdef FLOAT_SUPPORT
-                        double tmp = atof(valbuf);
+                        double tmp;
+                        if (json_parse_real(valbuf, strlen(valbuf), &tmp) == 0) {
+                            tmp = 0;
+                        }
                         memcpy(lptr, &tmp, sizeof(double));
 #else
                         return JSON_ERR_MISC;
@@ -542,7 +1043,7 @@ json_read_array(struct json_buffer *jb, const struct json_array_t *arr)
 
     json_skip_ws(jb);
 
-    if (jb->jb_read_next(jb) != '[') {
+    if (json_next(jb) != '[') {
         return JSON_ERR_ARRAYSTART;
     }
 
@@ -558,25 +1059,24 @@ json_read_array(struct json_buffer *jb, const struct json_array_t *arr)
     for (offset = 0; offset < arr->maxlen; offset++) {
         json_skip_ws(jb);
 
-        char *ep = NULL;
         switch (arr->element_type) {
         case t_string:
-            if (jb->jb_read_next(jb) != '"') {
+            if (json_next(jb) != '"') {
                 return JSON_ERR_BADSTRING;
             }
             arr->arr.strings.ptrs[offset] = tp;
             for (; tp - arr->arr.strings.store < arr->arr.strings.storelen;
                  tp++) {
-                c = jb->jb_read_next(jb);
+                c = json_next(jb);
                 if (c == '"') {
-                    c = jb->jb_read_next(jb);
+                    c = json_next(jb);
                     *tp++ = '\0';
                     goto stringend;
                 } else if (c == '\0') {
                     return JSON_ERR_BADSTRING;
                 } else {
                     *tp = c;
-                    c = jb->jb_read_next(jb);
+                    c = json_next(jb);
                 }
             }
             return JSON_ERR_BADSTRING;
@@ -585,93 +1085,29 @@ json_read_array(struct json_buffer *jb, const struct json_array_t *arr)
         case t_object:
         case t_structobject:
             substatus =
-                json_internal_read_object(jb, arr->arr.objects.subtype, arr,
-                                          offset);
+                json_internal_read_object(jb, arr->arr.objects.subtype, NULL,
+                                          arr, offset);
             if (substatus != 0) {
                 return substatus;
             }
             break;
         case t_integer:
-            n = jb->jb_readn(jb, valbuf, sizeof(valbuf)-1);
-            valbuf[n] = '\0';
-#ifdef __KERNEL__
-            ep = valbuf;
-            while(*ep){
-                if ((*ep >= '0' && *ep <= '9') || ((*ep | 0x20) >= 'a' && (*ep | 0x20) <= 'f')){
-                    ep++;
-                }else break;
-            }
-            *ep = '\0';
-            int rc = kstrtoll(valbuf, 0, &arr->arr.integers.store[offset]);
-            if (rc)
-                return  JSON_ERR_BADSTRING;
-#else
-            arr->arr.integers.store[offset] = strtoll(valbuf, &ep, 0);
-#endif
-
-            if (ep == valbuf) {
-                return JSON_ERR_BADNUM;
-            } else {
-                count = n - (ep - valbuf);
-                while (count-- > 0) {
-                    jb->jb_read_prev(jb);
-                }
+            substatus = json_read_number(jb, t_integer, &arr->arr.integers.store[offset]);
+            if (substatus != 0) {
+                return substatus;
             }
             break;
         case t_uinteger:
-            n = jb->jb_readn(jb, valbuf, sizeof(valbuf)-1);
-            valbuf[n] = '\0';
-
-#ifdef __KERNEL__
-            ep = valbuf;
-            while(*ep){
-                if ((*ep >= '0' && *ep <= '9') || ((*ep | 0x20) >= 'a' && (*ep | 0x20) <= 'f')){
-                    ep++;
-                }else break;
-            }
-            *ep = '\0';
-
-            rc = kstrtoull(valbuf, 0, &arr->arr.uintegers.store[offset]);
-            if (rc)
-                return  JSON_ERR_BADSTRING;
-#else
-            arr->arr.uintegers.store[offset] = strtoull(valbuf, &ep, 0);
-#endif
-            if (ep == valbuf) {
-                return JSON_ERR_BADNUM;
-            } else {
-                count = n - (ep - valbuf);
-                while (count-- > 0) {
-                    jb->jb_read_prev(jb);
-                }
+            substatus = json_read_number(jb, t_uinteger, &arr->arr.uintegers.store[offset]);
+            if (substatus != 0) {
+                return substatus;
             }
-
             break;
         case t_real:
-#ifdef FLOAT_SUPPORT
-            n = jb->jb_readn(jb, valbuf, sizeof(valbuf)-1);
-            valbuf[n] = '\0';
-
-            arr->arr.reals.store[offset] = strtod(valbuf, &ep);
-            if (ep == valbuf) {
-                if(strncmp(valbuf,"null",4)==0){
-                     arr->arr.reals.store[offset] = NAN;
-                     count= n - 4;
-                    while (count-- > 0) {
-                        c = jb->jb_read_prev(jb);
-                    }
-                }else{
-                    return JSON_ERR_BADNUM;
-                }
-            } else {
-                count = n - (ep - valbuf);
-                while (count-- > 0) {
-                    c = jb->jb_read_prev(jb);
-                }
+            substatus = json_read_number(jb, t_real, &arr->arr.reals.store[offset]);
+            if (substatus != 0) {
+                return substatus;
             }
-#else
-            return JSON_ERR_MISC;
-#endif
             break;
         case t_boolean:
             n = jb->jb_readn(jb, valbuf, 5);
@@ -689,7 +1125,7 @@ json_read_array(struct json_buffer *jb, const struct json_array_t *arr)
 
             assert(count >= 0);
             while (count-- > 0) {
-                jb->jb_read_prev(jb);
+                json_prev(jb);
             }
             break;
         case t_character:
@@ -701,7 +1137,7 @@ json_read_array(struct json_buffer *jb, const struct json_array_t *arr)
         arrcount++;
         json_skip_ws(jb);
 
-        c = jb->jb_read_next(jb);
+        c = json_next(jb);
         if (c == ']') {
             goto breakout;
         } else if (c != ',') {
@@ -721,6 +1157,32 @@ json_read_object(struct json_buffer *jb, const struct json_attr_t *attrs)
 {
     int st;
 
-    st = json_internal_read_object(jb, attrs, NULL, 0);
+    st = json_internal_read_object(jb, attrs, NULL, NULL, 0);
     return st;
 }
+
+/**
+ * As json_read_object(), looking attribute names up through an index. The
+ * index is built from attrs on first use, so it can be a static that lives
+ * alongside an attr array that is rebuilt on every call.
+ *
+ * @param jb        Input buffer.
+ * @param attrs     Attr array, terminated by a NULL attribute.
+ * @param index     Index for attrs, zero initialised before first use.
+ *
+ * @return 0 on success, JSON_ERR_* otherwise
+ */
+int
+json_read_object_indexed(struct json_buffer *jb, const struct json_attr_t *attrs,
+        struct json_attr_index *index)
+{
+    dpl_sr_t sr;
+
+    /* The index may be a static shared by tasks decoding the same attrs */
+    DPL_ENTER_CRITICAL(sr);
+    if (!index->ji_built) {
+        json_attr_index_init(index, attrs);
+    }
+    DPL_EXIT_CRITICAL(sr);
+    return json_internal_read_object(jb, attrs, index, NULL, 0);
+}
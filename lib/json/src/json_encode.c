@@ -30,56 +30,207 @@
 #include <dpl/dpl_types.h>
 
 #define JSON_ENCODE_OBJECT_START(__e) \
-    (__e)->je_write((__e)->je_arg, "{", sizeof("{")-1);
+    json_out((__e), "{", sizeof("{")-1);
 
 #define JSON_ENCODE_OBJECT_END(__e) \
-    (__e)->je_write((__e)->je_arg, "}", sizeof("}")-1);
+    json_out((__e), "}", sizeof("}")-1);
 
 #define JSON_ENCODE_ARRAY_START(__e) \
-    (__e)->je_write((__e)->je_arg, "[", sizeof("[")-1);
+    json_out((__e), "[", sizeof("[")-1);
 
 #define JSON_ENCODE_ARRAY_END(__e) \
-    (__e)->je_write((__e)->je_arg, "]", sizeof("]")-1);
+    json_out((__e), "]", sizeof("]")-1);
 
+/**
+ * Emit a fragment, either through je_write or appended to the direct buffer.
+ * The direct buffer always keeps one byte spare for the terminating null;
+ * anything that does not fit is dropped and flagged in je_buf_overflow.
+ */
+static inline void
+json_out(struct json_encoder *encoder, const char *data, int len)
+{
+    if (encoder->je_buf == NULL) {
+        encoder->je_write(encoder->je_arg, (char *) data, len);
+        return;
+    }
+    if (encoder->je_buf_len + len >= encoder->je_buf_size) {
+        encoder->je_buf_overflow = 1;
+        len = encoder->je_buf_size - 1 - encoder->je_buf_len;
+    }
+    memcpy(encoder->je_buf + encoder->je_buf_len, data, len);
+    encoder->je_buf_len += len;
+}
+
+/**
+ * Space for a fragment of at most max characters. Points straight into the
+ * direct buffer when it fits, otherwise into je_encode_buf. Returns NULL
+ * if neither can hold it.
+ */
+static inline char *
+json_reserve(struct json_encoder *encoder, int max)
+{
+    if (encoder->je_buf && encoder->je_buf_len + max < encoder->je_buf_size) {
+        return encoder->je_buf + encoder->je_buf_len;
+    }
+    if (max <= (int) sizeof(encoder->je_encode_buf)) {
+        return encoder->je_encode_buf;
+    }
+    return NULL;
+}
+
+/**
+ * Complete a fragment obtained from json_reserve().
+ */
+static inline void
+json_commit(struct json_encoder *encoder, char *dst, int len)
+{
+    if (dst == encoder->je_encode_buf) {
+        json_out(encoder, dst, len);
+    } else {
+        encoder->je_buf_len += len;
+    }
+}
+
+/**
+ * Write the pending comma, if any, followed by "key": as one fragment.
+ */
+static void
+json_encode_key(struct json_encoder *encoder, const char *key)
+{
+    int klen = strlen(key);
+    char *dst = json_reserve(encoder, klen + sizeof(",\"\": ")-1);
+    char *p = dst;
+
+    if (dst == NULL) {
+        if (encoder->je_wr_commas) {
+            json_out(encoder, ",", sizeof(",")-1);
+        }
+        json_out(encoder, "\"", sizeof("\"")-1);
+        json_out(encoder, key, klen);
+        json_out(encoder, "\": ", sizeof("\": ")-1);
+    } else {
+        if (encoder->je_wr_commas) {
+            *p++ = ',';
+        }
+        *p++ = '"';
+        memcpy(p, key, klen);
+        p += klen;
+        *p++ = '"';
+        *p++ = ':';
+        *p++ = ' ';
+        json_commit(encoder, dst, p - dst);
+    }
+    encoder->je_wr_commas = 0;
+}
+
+/**
+ * Start writing into a caller supplied buffer instead of through je_write.
+ * Numbers are formatted in place without printf and floats are written with
+ * the shortest representation that reads back to the same value.
+ *
+ * @param encoder   Encoder, je_write and je_arg are ignored until the next
+ *                  json_encode_buf_init() with a NULL buffer.
+ * @param buf       Output buffer, NULL to return to je_write output.
+ * @param size      Size of buf in bytes, including the terminating null.
+ *
+ * @return void
+ */
+void
+json_encode_buf_init(struct json_encoder *encoder, char *buf, uint16_t size)
+{
+    encoder->je_buf = (size) ? buf : NULL;
+    encoder->je_buf_size = size;
+    encoder->je_buf_len = 0;
+    encoder->je_buf_overflow = 0;
+    encoder->je_wr_commas = 0;
+}
+EXPORT_SYMBOL(json_encode_buf_init);
+
+/**
+ * Null terminate the direct buffer.
+ *
+ * @param encoder   Encoder set up with json_encode_buf_init().
+ *
+ * @return Length of the output excluding the null, or -1 if it was truncated
+ */
+int
+json_encode_buf_finish(struct json_encoder *encoder)
+{
+    if (encoder->je_buf == NULL) {
+        return -1;
+    }
+    encoder->je_buf[encoder->je_buf_len] = '\0';
+    return (encoder->je_buf_overflow) ? -1 : encoder->je_buf_len;
+}
+EXPORT_SYMBOL(json_encode_buf_finish);
 
 int
 json_encode_object_start(struct json_encoder *encoder)
 {
     if (encoder->je_wr_commas) {
-        encoder->je_write(encoder->je_arg, ",", sizeof(",")-1);
-        encoder->je_wr_commas = 0;
+        json_out(encoder, ",{", sizeof(",{")-1);
+    } else {
+        JSON_ENCODE_OBJECT_START(encoder);
     }
-    JSON_ENCODE_OBJECT_START(encoder);
     encoder->je_wr_commas = 0;
 
     return (0);
 }
 EXPORT_SYMBOL(json_encode_object_start);
 
+/**
+ * Encode a value, preceded by the separator sep unless it is 0.
+ */
 static int
-json_encode_value(struct json_encoder *encoder, struct json_value *jv)
+json_encode_value(struct json_encoder *encoder, struct json_value *jv, char sep)
 {
     int rc;
-    int i;
+    int i, j;
     int len;
+    char *dst, *p;
 
     switch (jv->jv_type) {
         case JSON_VALUE_TYPE_BOOL:
-            len = sprintf(encoder->je_encode_buf, "%s",
-                    jv->jv_val.u > 0 ? "true" : "false");
-            encoder->je_write(encoder->je_arg, encoder->je_encode_buf, len);
+            if (sep) {
+                json_out(encoder, &sep, 1);
+            }
+            if (jv->jv_val.u > 0) {
+                json_out(encoder, "true", sizeof("true")-1);
+            } else {
+                json_out(encoder, "false", sizeof("false")-1);
+            }
             break;
         case JSON_VALUE_TYPE_UINT64:
-            len = sprintf(encoder->je_encode_buf, "%" PRIu64,
-                    jv->jv_val.u);
-            encoder->je_write(encoder->je_arg, encoder->je_encode_buf, len);
-            break;
         case JSON_VALUE_TYPE_INT64:
-            len = sprintf(encoder->je_encode_buf, "%" PRIi64,
-                    jv->jv_val.u);
-            encoder->je_write(encoder->je_arg, encoder->je_encode_buf, len);
+            p = dst = json_reserve(encoder, JSON_FMT_INT64_MAX + 1);
+            if (sep) {
+                *p++ = sep;
+            }
+            if (jv->jv_type == JSON_VALUE_TYPE_UINT64) {
+                p += json_fmt_uint64(p, jv->jv_val.u);
+            } else {
+                p += json_fmt_int64(p, (int64_t) jv->jv_val.u);
+            }
+            json_commit(encoder, dst, p - dst);
             break;
         case JSON_VALUE_TYPE_FLOAT64:
+        case JSON_VALUE_TYPE_FLOAT32:
+        if (encoder->je_buf) {
+            p = dst = json_reserve(encoder, JSON_FMT_FLOAT64_MAX + 1);
+            if (sep) {
+                *p++ = sep;
+            }
+            if (jv->jv_type == JSON_VALUE_TYPE_FLOAT32) {
+                p += json_fmt_float32(p, jv->jv_val.fl);
+            } else {
+                p += json_fmt_float64(p, jv->jv_val.fl);
+            }
+            json_commit(encoder, dst, p - dst);
+            break;
+        }
+        if (sep) {
+            json_out(encoder, &sep, 1);
+        }
         if  (DPL_FLOAT64_ISNAN(jv->jv_val.fl)){
             len = sprintf(encoder->je_encode_buf, "null");
         }else{
@@ -96,66 +247,61 @@ json_encode_value(struct json_encoder *encoder, struct json_value *jv)
                     DPL_FLOAT64_PRINTF_VALS(jv->jv_val.fl));
 #endif
         }
-        encoder->je_write(encoder->je_arg, encoder->je_encode_buf, len);
+        json_out(encoder, encoder->je_encode_buf, len);
         break;
 
         case JSON_VALUE_TYPE_STRING:
-            encoder->je_write(encoder->je_arg, "\"", sizeof("\"")-1);
-            for (i = 0; i < jv->jv_len; i++) {
+            if (sep) {
+                json_out(encoder, &sep, 1);
+            }
+            json_out(encoder, "\"", sizeof("\"")-1);
+            /* Runs of characters that need no escaping are written in one go */
+            for (i = 0, j = 0; i < jv->jv_len; i++) {
+                const char *esc;
                 switch (jv->jv_val.str[i]) {
-                    case '"':
-                    case '/':
-                    case '\\':
-                        encoder->je_write(encoder->je_arg, "\\",
-                                sizeof("\\")-1);
-                        encoder->je_write(encoder->je_arg,
-                                (char *) &jv->jv_val.str[i], 1);
-
-                        break;
-                    case '\t':
-                        encoder->je_write(encoder->je_arg, "\\t",
-                                sizeof("\\t")-1);
-                        break;
-                    case '\r':
-                        encoder->je_write(encoder->je_arg, "\\r",
-                                sizeof("\\r")-1);
-                        break;
-                    case '\n':
-                        encoder->je_write(encoder->je_arg, "\\n",
-                                sizeof("\\n")-1);
-                        break;
-                    case '\f':
-                        encoder->je_write(encoder->je_arg, "\\f",
-                                sizeof("\\f")-1);
-                        break;
-                    case '\b':
-                        encoder->je_write(encoder->je_arg, "\\b",
-                                sizeof("\\b")-1);
-                        break;
-                   default:
-                        encoder->je_write(encoder->je_arg,
-                                (char *) &jv->jv_val.str[i], 1);
-                        break;
+                    case '"':  esc = "\\\""; break;
+                    case '/':  esc = "\\/"; break;
+                    case '\\': esc = "\\\\"; break;
+                    case '\t': esc = "\\t"; break;
+                    case '\r': esc = "\\r"; break;
+                    case '\n': esc = "\\n"; break;
+                    case '\f': esc = "\\f"; break;
+                    case '\b': esc = "\\b"; break;
+                    default:   esc = NULL; break;
+                }
+                if (esc) {
+                    if (i > j) {
+                        json_out(encoder, &jv->jv_val.str[j], i - j);
+                    }
+                    json_out(encoder, esc, 2);
+                    j = i + 1;
                 }
-
             }
-            encoder->je_write(encoder->je_arg, "\"", sizeof("\"")-1);
+            if (i > j) {
+                json_out(encoder, &jv->jv_val.str[j], i - j);
+            }
+            json_out(encoder, "\"", sizeof("\"")-1);
             break;
         case JSON_VALUE_TYPE_ARRAY:
+            if (sep) {
+                json_out(encoder, &sep, 1);
+            }
             JSON_ENCODE_ARRAY_START(encoder);
             for (i = 0; i < jv->jv_len; i++) {
-                rc = json_encode_value(encoder, jv->jv_val.composite.values[i]);
+                rc = json_encode_value(encoder, jv->jv_val.composite.values[i],
+                        (i) ? ',' : 0);
                 if (rc != 0) {
                     goto err;
                 }
-                if (i != jv->jv_len - 1) {
-                    encoder->je_write(encoder->je_arg, ",", sizeof(",")-1);
-                }
             }
             JSON_ENCODE_ARRAY_END(encoder);
             break;
         case JSON_VALUE_TYPE_OBJECT:
+            if (sep) {
+                json_out(encoder, &sep, 1);
+            }
             JSON_ENCODE_OBJECT_START(encoder);
+            encoder->je_wr_commas = 0;
             for (i = 0; i < jv->jv_len; i++) {
                 rc = json_encode_object_entry(encoder,
                         jv->jv_val.composite.keys[i],
@@ -176,20 +322,11 @@ json_encode_value(struct json_encoder *encoder, struct json_value *jv)
 err:
     return (rc);
 }
-EXPORT_SYMBOL(json_encode_value);
 
 int
 json_encode_object_key(struct json_encoder *encoder, char *key)
 {
-    if (encoder->je_wr_commas) {
-        encoder->je_write(encoder->je_arg, ",", sizeof(",")-1);
-        encoder->je_wr_commas = 0;
-    }
-
-    /* Write the key entry */
-    encoder->je_write(encoder->je_arg, "\"", sizeof("\"")-1);
-    encoder->je_write(encoder->je_arg, key, strlen(key));
-    encoder->je_write(encoder->je_arg, "\": ", sizeof("\": ")-1);
+    json_encode_key(encoder, key);
 
     return (0);
 }
@@ -201,16 +338,9 @@ json_encode_object_entry(struct json_encoder *encoder, char *key,
 {
     int rc;
 
-    if (encoder->je_wr_commas) {
-        encoder->je_write(encoder->je_arg, ",", sizeof(",")-1);
-        encoder->je_wr_commas = 0;
-    }
-    /* Write the key entry */
-    encoder->je_write(encoder->je_arg, "\"", sizeof("\"")-1);
-    encoder->je_write(encoder->je_arg, key, strlen(key));
-    encoder->je_write(encoder->je_arg, "\": ", sizeof("\": ")-1);
+    json_encode_key(encoder, key);
 
-    rc = json_encode_value(encoder, val);
+    rc = json_encode_value(encoder, val, 0);
     if (rc != 0) {
         goto err;
     }
@@ -255,12 +385,7 @@ json_encode_array_value(struct json_encoder *encoder, struct json_value *jv)
 {
     int rc;
 
-    if (encoder->je_wr_commas) {
-        encoder->je_write(encoder->je_arg, ",", sizeof(",")-1);
-        encoder->je_wr_commas = 0;
-    }
-
-    rc = json_encode_value(encoder, jv);
+    rc = json_encode_value(encoder, jv, (encoder->je_wr_commas) ? ',' : 0);
     if (rc != 0) {
         goto err;
     }
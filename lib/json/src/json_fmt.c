@@ -0,0 +1,565 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file json_fmt.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Number formatting for the json encoder
+ *
+ * @details Integer and floating point formatting without printf. Floats are
+ * printed with the Grisu2 algorithm (F. Loitsch, "Printing Floating-Point Numbers
+ * Quickly and Accurately with Integers", PLDI 2010), which produces the shortest
+ * digit string in the vast majority of cases and always reads back to the same
+ * double. Only 32 and 64 bit integer arithmetic is used, working on the IEEE-754
+ * bit pattern, so this is also safe on softfloat builds.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __KERNEL__
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#else
+#define EXPORT_SYMBOL(__S)
+#endif
+#include <json/json.h>
+
+static const char json_fmt_digits2[200] = {
+    '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+    '1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+    '2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+    '3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+    '4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+    '5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+    '6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+    '7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+    '8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+    '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9'
+};
+
+/**
+ * Write a 32bit value right aligned into dst, two digits at a time.
+ *
+ * @param end  One past the last character to write.
+ * @param v    Value.
+ *
+ * @return Pointer to the first character written
+ */
+static char *
+json_fmt_u32_rev(char *end, uint32_t v)
+{
+    while (v >= 100) {
+        uint32_t i = (v % 100) << 1;
+        v /= 100;
+        *--end = json_fmt_digits2[i + 1];
+        *--end = json_fmt_digits2[i];
+    }
+    if (v >= 10) {
+        *--end = json_fmt_digits2[(v << 1) + 1];
+        *--end = json_fmt_digits2[v << 1];
+    } else {
+        *--end = (char)('0' + v);
+    }
+    return end;
+}
+
+/**
+ * Write exactly 8 digits of v, zero padded, right aligned.
+ */
+static char *
+json_fmt_u32_rev8(char *end, uint32_t v)
+{
+    int i;
+    for (i = 0; i < 4; i++) {
+        uint32_t d = (v % 100) << 1;
+        v /= 100;
+        *--end = json_fmt_digits2[d + 1];
+        *--end = json_fmt_digits2[d];
+    }
+    return end;
+}
+
+static inline uint64_t
+json_fmt_divrem_1e8(uint64_t v, uint32_t *rem)
+{
+#ifdef __KERNEL__
+    return div_u64_rem(v, 100000000, rem);
+#else
+    *rem = (uint32_t)(v % 100000000);
+    return v / 100000000;
+#endif
+}
+
+/**
+ * Format an unsigned 64bit integer.
+ *
+ * @param dst  Destination, at least JSON_FMT_UINT64_MAX bytes. Not null terminated.
+ * @param v    Value.
+ *
+ * @return Number of characters written
+ */
+int
+json_fmt_uint64(char *dst, uint64_t v)
+{
+    char tmp[JSON_FMT_UINT64_MAX];
+    char *end = tmp + sizeof(tmp);
+    char *p;
+    int len;
+
+    if (v >> 32 == 0) {
+        p = json_fmt_u32_rev(end, (uint32_t)v);
+    } else {
+        uint32_t lo, mid;
+        v = json_fmt_divrem_1e8(v, &lo);
+        p = json_fmt_u32_rev8(end, lo);
+        if (v >= 100000000) {
+            v = json_fmt_divrem_1e8(v, &mid);
+            p = json_fmt_u32_rev8(p, mid);
+        }
+        p = json_fmt_u32_rev(p, (uint32_t)v);
+    }
+    len = (int)(end - p);
+    memcpy(dst, p, len);
+    return len;
+}
+EXPORT_SYMBOL(json_fmt_uint64);
+
+/**
+ * Format a signed 64bit integer.
+ *
+ * @param dst  Destination, at least JSON_FMT_INT64_MAX bytes. Not null terminated.
+ * @param v    Value.
+ *
+ * @return Number of characters written
+ */
+int
+json_fmt_int64(char *dst, int64_t v)
+{
+    if (v < 0) {
+        *dst = '-';
+        return 1 + json_fmt_uint64(dst + 1, ~(uint64_t)v + 1);
+    }
+    return json_fmt_uint64(dst, (uint64_t)v);
+}
+EXPORT_SYMBOL(json_fmt_int64);
+
+/* Grisu2 */
+
+typedef struct {
+    uint64_t f;
+    int e;
+} json_fmt_fp_t;
+
+#define JSON_FMT_DP_SIGNIFICAND_MASK (0x000FFFFFFFFFFFFFULL)
+#define JSON_FMT_DP_EXPONENT_MASK    (0x7FF0000000000000ULL)
+#define JSON_FMT_DP_HIDDEN_BIT       (0x0010000000000000ULL)
+#define JSON_FMT_DP_SIGN_MASK        (0x8000000000000000ULL)
+#define JSON_FMT_DP_EXPONENT_BIAS    (0x3FF + 52)
+#define JSON_FMT_SP_HIDDEN_BIT       (0x00800000ULL)
+#define JSON_FMT_SP_EXPONENT_MIN     (-126)
+#define JSON_FMT_SP_EXPONENT_MAX     (127)
+
+/* Normalised 10^k for k = -348, -340, ..., 340 */
+static const uint64_t json_fmt_cached_f[] = {
+    0xfa8fd5a0081c0288, 0xbaaee17fa23ebf76, 0x8b16fb203055ac76,
+    0xcf42894a5dce35ea, 0x9a6bb0aa55653b2d, 0xe61acf033d1a45df,
+    0xab70fe17c79ac6ca, 0xff77b1fcbebcdc4f, 0xbe5691ef416bd60c,
+    0x8dd01fad907ffc3c, 0xd3515c2831559a83, 0x9d71ac8fada6c9b5,
+    0xea9c227723ee8bcb, 0xaecc49914078536d, 0x823c12795db6ce57,
+    0xc21094364dfb5637, 0x9096ea6f3848984f, 0xd77485cb25823ac7,
+    0xa086cfcd97bf97f4, 0xef340a98172aace5, 0xb23867fb2a35b28e,
+    0x84c8d4dfd2c63f3b, 0xc5dd44271ad3cdba, 0x936b9fcebb25c996,
+    0xdbac6c247d62a584, 0xa3ab66580d5fdaf6, 0xf3e2f893dec3f126,
+    0xb5b5ada8aaff80b8, 0x87625f056c7c4a8b, 0xc9bcff6034c13053,
+    0x964e858c91ba2655, 0xdff9772470297ebd, 0xa6dfbd9fb8e5b88f,
+    0xf8a95fcf88747d94, 0xb94470938fa89bcf, 0x8a08f0f8bf0f156b,
+    0xcdb02555653131b6, 0x993fe2c6d07b7fac, 0xe45c10c42a2b3b06,
+    0xaa242499697392d3, 0xfd87b5f28300ca0e, 0xbce5086492111aeb,
+    0x8cbccc096f5088cc, 0xd1b71758e219652c, 0x9c40000000000000,
+    0xe8d4a51000000000, 0xad78ebc5ac620000, 0x813f3978f8940984,
+    0xc097ce7bc90715b3, 0x8f7e32ce7bea5c70, 0xd5d238a4abe98068,
+    0x9f4f2726179a2245, 0xed63a231d4c4fb27, 0xb0de65388cc8ada8,
+    0x83c7088e1aab65db, 0xc45d1df942711d9a, 0x924d692ca61be758,
+    0xda01ee641a708dea, 0xa26da3999aef774a, 0xf209787bb47d6b85,
+    0xb454e4a179dd1877, 0x865b86925b9bc5c2, 0xc83553c5c8965d3d,
+    0x952ab45cfa97a0b3, 0xde469fbd99a05fe3, 0xa59bc234db398c25,
+    0xf6c69a72a3989f5c, 0xb7dcbf5354e9bece, 0x88fcf317f22241e2,
+    0xcc20ce9bd35c78a5, 0x98165af37b2153df, 0xe2a0b5dc971f303a,
+    0xa8d9d1535ce3b396, 0xfb9b7cd9a4a7443c, 0xbb764c4ca7a44410,
+    0x8bab8eefb6409c1a, 0xd01fef10a657842c, 0x9b10a4e5e9913129,
+    0xe7109bfba19c0c9d, 0xac2820d9623bf429, 0x80444b5e7aa7cf85,
+    0xbf21e44003acdd2d, 0x8e679c2f5e44ff8f, 0xd433179d9c8cb841,
+    0x9e19db92b4e31ba9, 0xeb96bf6ebadf77d9, 0xaf87023b9bf0ee6b
+};
+
+static const int16_t json_fmt_cached_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066
+};
+
+static const uint64_t json_fmt_pow10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static inline json_fmt_fp_t
+json_fmt_fp_mul(json_fmt_fp_t x, json_fmt_fp_t y)
+{
+    const uint64_t M32 = 0xFFFFFFFFULL;
+    uint64_t a = x.f >> 32, b = x.f & M32;
+    uint64_t c = y.f >> 32, d = y.f & M32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+    json_fmt_fp_t r;
+
+    tmp += 1ULL << 31;  /* Round */
+    r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+    r.e = x.e + y.e + 64;
+    return r;
+}
+
+static inline json_fmt_fp_t
+json_fmt_fp_normalize(json_fmt_fp_t x)
+{
+    int s = __builtin_clzll(x.f);
+    x.f <<= s;
+    x.e -= s;
+    return x;
+}
+
+/**
+ * Boundaries m- and m+ of the rounding interval of v, both normalised
+ * to the exponent of m+.
+ */
+static void
+json_fmt_boundaries(json_fmt_fp_t v, int lower_closer, json_fmt_fp_t *mminus, json_fmt_fp_t *mplus)
+{
+    json_fmt_fp_t pl, mi;
+
+    pl.f = (v.f << 1) + 1;
+    pl.e = v.e - 1;
+    pl = json_fmt_fp_normalize(pl);
+    if (lower_closer) {
+        mi.f = (v.f << 2) - 1;
+        mi.e = v.e - 2;
+    } else {
+        mi.f = (v.f << 1) - 1;
+        mi.e = v.e - 1;
+    }
+    mi.f <<= mi.e - pl.e;
+    mi.e = pl.e;
+    *mplus = pl;
+    *mminus = mi;
+}
+
+/**
+ * Cached power c = 10^-K such that the exponent of e + c.e lands in [-60, -32].
+ * floor(q * log10(2)) is computed as (q * 78913) >> 18, exact for |q| < 1650.
+ */
+static json_fmt_fp_t
+json_fmt_cached_power(int e, int *K)
+{
+    int q = e + 61;
+    int k, idx;
+    json_fmt_fp_t c;
+
+    /* k = ceil((-61 - e) * log10(2)) */
+    if (q > 0) {
+        k = -((q * 78913) >> 18);
+    } else {
+        k = (((-q) * 78913) >> 18) + (q != 0);
+    }
+    idx = ((k + 347) >> 3) + 1;
+    *K = -(-348 + idx * 8);
+    c.f = json_fmt_cached_f[idx];
+    c.e = json_fmt_cached_e[idx];
+    return c;
+}
+
+static inline void
+json_fmt_grisu_round(char *buf, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buf[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static inline int
+json_fmt_count_digits(uint32_t n)
+{
+    int d = 1;
+    while (d < 10 && n >= (uint32_t)json_fmt_pow10[d]) {
+        d++;
+    }
+    return d;
+}
+
+static void
+json_fmt_digit_gen(json_fmt_fp_t W, json_fmt_fp_t Mp, uint64_t delta, char *buf, int *len, int *K)
+{
+    const int shift = -Mp.e;
+    const uint64_t one = 1ULL << shift;
+    const uint64_t wp_w = Mp.f - W.f;
+    uint32_t p1 = (uint32_t)(Mp.f >> shift);
+    uint64_t p2 = Mp.f & (one - 1);
+    int kappa = json_fmt_count_digits(p1);
+
+    *len = 0;
+    while (kappa > 0) {
+        uint32_t div = (uint32_t)json_fmt_pow10[kappa - 1];
+        uint32_t d = p1 / div;
+        uint64_t tmp;
+
+        p1 %= div;
+        if (d || *len) {
+            buf[(*len)++] = (char)('0' + d);
+        }
+        kappa--;
+        tmp = ((uint64_t)p1 << shift) + p2;
+        if (tmp <= delta) {
+            *K += kappa;
+            json_fmt_grisu_round(buf, *len, delta, tmp, json_fmt_pow10[kappa] << shift, wp_w);
+            return;
+        }
+    }
+    for (;;) {
+        char d;
+        p2 *= 10;
+        delta *= 10;
+        d = (char)(p2 >> shift);
+        if (d || *len) {
+            buf[(*len)++] = (char)('0' + d);
+        }
+        p2 &= one - 1;
+        kappa--;
+        if (p2 < delta) {
+            *K += kappa;
+            json_fmt_grisu_round(buf, *len, delta, p2, one,
+                                 (-kappa < 20) ? wp_w * json_fmt_pow10[-kappa] : 0);
+            return;
+        }
+    }
+}
+
+/**
+ * Lay out the digit string buf[0..len) * 10^k in the shortest of plain or
+ * exponent notation, the same rules javascript uses for Number.toString.
+ */
+static int
+json_fmt_prettify(char *buf, int len, int k)
+{
+    const int kk = len + k;  /* 10^(kk-1) <= v < 10^kk */
+    int i;
+
+    if (k >= 0 && kk <= 21) {
+        /* 1234e7 -> 12340000000.0 */
+        for (i = len; i < kk; i++) {
+            buf[i] = '0';
+        }
+        buf[kk] = '.';
+        buf[kk + 1] = '0';
+        return kk + 2;
+    } else if (0 < kk && kk <= 21) {
+        /* 1234e-2 -> 12.34 */
+        memmove(&buf[kk + 1], &buf[kk], len - kk);
+        buf[kk] = '.';
+        return len + 1;
+    } else if (-6 < kk && kk <= 0) {
+        /* 1234e-6 -> 0.001234 */
+        const int offset = 2 - kk;
+        memmove(&buf[offset], &buf[0], len);
+        buf[0] = '0';
+        buf[1] = '.';
+        for (i = 2; i < offset; i++) {
+            buf[i] = '0';
+        }
+        return len + offset;
+    } else {
+        int exp = kk - 1;
+        char *p;
+        if (len == 1) {
+            /* 1e30 */
+            p = &buf[1];
+        } else {
+            /* 1234e30 -> 1.234e33 */
+            memmove(&buf[2], &buf[1], len - 1);
+            buf[1] = '.';
+            p = &buf[len + 1];
+        }
+        *p++ = 'e';
+        if (exp < 0) {
+            *p++ = '-';
+            exp = -exp;
+        }
+        if (exp >= 100) {
+            *p++ = (char)('0' + exp / 100);
+            exp %= 100;
+            *p++ = json_fmt_digits2[exp << 1];
+            *p++ = json_fmt_digits2[(exp << 1) + 1];
+        } else if (exp >= 10) {
+            *p++ = json_fmt_digits2[exp << 1];
+            *p++ = json_fmt_digits2[(exp << 1) + 1];
+        } else {
+            *p++ = (char)('0' + exp);
+        }
+        return (int)(p - buf);
+    }
+}
+
+/**
+ * Shortest digits for the positive value w, which has a significand of
+ * precision bits. lower_closer is set when w is a power of two above the
+ * smallest normal, where the gap to the next lower value is half as wide.
+ */
+static int
+json_fmt_grisu(char *p, json_fmt_fp_t w, int lower_closer)
+{
+    json_fmt_fp_t mminus, mplus, c, W, Wp, Wm;
+    int len, K;
+
+    json_fmt_boundaries(w, lower_closer, &mminus, &mplus);
+    c = json_fmt_cached_power(mplus.e, &K);
+    W = json_fmt_fp_mul(json_fmt_fp_normalize(w), c);
+    Wp = json_fmt_fp_mul(mplus, c);
+    Wm = json_fmt_fp_mul(mminus, c);
+    Wm.f++;
+    Wp.f--;
+    json_fmt_digit_gen(W, Wp, Wp.f - Wm.f, p, &len, &K);
+
+    return json_fmt_prettify(p, len, K);
+}
+
+/**
+ * Format a double with the shortest digit string that reads back to the same value.
+ * NaN and infinities have no JSON representation and are written as null.
+ *
+ * @param dst  Destination, at least JSON_FMT_FLOAT64_MAX bytes. Not null terminated.
+ * @param v    Value.
+ *
+ * @return Number of characters written
+ */
+int
+json_fmt_float64(char *dst, dpl_float64_t v)
+{
+    uint64_t u;
+    json_fmt_fp_t w;
+    char *p = dst;
+    int biased;
+
+    memcpy(&u, &v, sizeof(u));
+    if ((u & JSON_FMT_DP_EXPONENT_MASK) == JSON_FMT_DP_EXPONENT_MASK) {
+        memcpy(dst, "null", 4);
+        return 4;
+    }
+    if (u & JSON_FMT_DP_SIGN_MASK) {
+        *p++ = '-';
+    }
+    u &= ~JSON_FMT_DP_SIGN_MASK;
+    if (u == 0) {
+        memcpy(p, "0.0", 3);
+        return (int)(p - dst) + 3;
+    }
+
+    biased = (int)(u >> 52);
+    w.f = u & JSON_FMT_DP_SIGNIFICAND_MASK;
+    if (biased) {
+        w.f += JSON_FMT_DP_HIDDEN_BIT;
+        w.e = biased - JSON_FMT_DP_EXPONENT_BIAS;
+    } else {
+        w.e = 1 - JSON_FMT_DP_EXPONENT_BIAS;
+    }
+
+    return (int)(p - dst) + json_fmt_grisu(p, w, w.f == JSON_FMT_DP_HIDDEN_BIT);
+}
+EXPORT_SYMBOL(json_fmt_float64);
+
+/**
+ * Format a double that carries a float32 quantity with the shortest digit
+ * string that reads back to the same float, at most 9 significant digits.
+ * The value is rounded to float precision on the bit pattern, so no float
+ * arithmetic is needed. Values beyond the float range are written as doubles.
+ *
+ * @param dst  Destination, at least JSON_FMT_FLOAT32_MAX bytes. Not null terminated.
+ * @param v    Value.
+ *
+ * @return Number of characters written
+ */
+int
+json_fmt_float32(char *dst, dpl_float64_t v)
+{
+    uint64_t u, rem, half;
+    json_fmt_fp_t w;
+    char *p = dst;
+    int biased, shift;
+
+    memcpy(&u, &v, sizeof(u));
+    biased = (int)((u & JSON_FMT_DP_EXPONENT_MASK) >> 52);
+    if (biased == 0x7FF || biased - 0x3FF > JSON_FMT_SP_EXPONENT_MAX) {
+        return json_fmt_float64(dst, v);
+    }
+    if (u & JSON_FMT_DP_SIGN_MASK) {
+        *p++ = '-';
+    }
+
+    /* Drop the low significand bits, more of them below the normal float range */
+    shift = 52 - 23;
+    if (biased - 0x3FF < JSON_FMT_SP_EXPONENT_MIN) {
+        shift += JSON_FMT_SP_EXPONENT_MIN - (biased - 0x3FF);
+    }
+    if (biased == 0 || shift > 53) {
+        memcpy(p, "0.0", 3);
+        return (int)(p - dst) + 3;
+    }
+    w.f = (u & JSON_FMT_DP_SIGNIFICAND_MASK) + JSON_FMT_DP_HIDDEN_BIT;
+    w.e = biased - JSON_FMT_DP_EXPONENT_BIAS + shift;
+    rem = w.f & ((1ULL << shift) - 1);
+    half = 1ULL << (shift - 1);
+    w.f >>= shift;
+    if (rem > half || (rem == half && (w.f & 1))) {
+        w.f++;
+    }
+    if (w.f == 0) {
+        memcpy(p, "0.0", 3);
+        return (int)(p - dst) + 3;
+    }
+    if (w.f == JSON_FMT_SP_HIDDEN_BIT << 1) {
+        w.f >>= 1;
+        w.e++;
+        if (w.e > JSON_FMT_SP_EXPONENT_MAX - 23) {
+            return json_fmt_float64(dst, v);
+        }
+    }
+
+    return (int)(p - dst) + json_fmt_grisu(p, w, w.f == JSON_FMT_SP_HIDDEN_BIT &&
+                                               w.e > JSON_FMT_SP_EXPONENT_MIN - 23);
+}
+EXPORT_SYMBOL(json_fmt_float32);
@@ -27,6 +27,8 @@
 #include <uwb/uwb.h>
 #include <uwb/uwb_ftypes.h>
 #include <euclid/triad.h>
+#include <euclid/multilat.h>
+#include <euclid/track.h>
 #include <stats/stats.h>
 
 #if MYNEWT_VAL(UWB_RNG_ENABLED)
@@ -110,6 +112,16 @@ typedef union {
     uint8_t array[sizeof(struct _nrng_frame_t)];        //!< Array of size twr_frame
 } nrng_frame_t;
 
+//! Maximum number of responders resolved by one call to nrng_get_ranges_batch
+#define NRNG_BATCH_MAX (32)
+
+//! Packed per responder result of a nrng exchange
+typedef struct _nrng_range_t{
+    uint16_t uid;        //!< Short address of responder
+    uint8_t slot_id;     //!< Slot the responder transmitted in
+    float range;         //!< Range in meters
+}__attribute__((__packed__,aligned(1))) nrng_range_t;
+
 struct nrng_instance{
     struct uwb_dev * dev_inst;
 #if MYNEWT_VAL(NRNG_STATS)
@@ -145,6 +157,13 @@ struct uwb_rng_config * nrng_get_config(struct nrng_instance * nrng, uwb_datafra
 struct uwb_dev_status nrng_listen(struct nrng_instance * nrng, uwb_dev_modes_t mode);
 uint32_t nrng_get_uids(struct nrng_instance * nrng, uint16_t uids[], uint16_t nranges, uint16_t base);
 uint32_t nrng_get_ranges(struct nrng_instance * nrng, dpl_float32_t ranges[], uint16_t nranges, uint16_t base);
+uint32_t nrng_get_ranges_batch(struct nrng_instance * nrng, nrng_range_t ranges[], uint16_t nranges, uint16_t base);
+#if MYNEWT_VAL(TWR_DS_EXT_NRNG_ENABLED)
+int nrng_get_position(struct nrng_instance * nrng, uint16_t nranges, uint16_t base, uint8_t dim,
+                      const triad_t * guess, multilat_result_t * result);
+uint16_t nrng_track(struct nrng_instance * nrng, uint16_t nranges, uint16_t base, uint16_t uid, uint64_t utime,
+                    track_table_t * table);
+#endif
 uint32_t usecs_to_response(struct uwb_dev * inst, uint16_t nslots, struct uwb_rng_config * config, uint32_t duration);
 
 void nrng_append_config(struct nrng_instance * nrng, struct rng_config_list *cfgs);
@@ -18,6 +18,7 @@
  */
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #include <assert.h>
 #include <os/os.h>
 #include <hal/hal_spi.h>
@@ -34,6 +35,7 @@
 #include <cir/cir.h>
 #endif
 #include <uwb_rng/slots.h>
+#include <rng_math/rng_math.h>
 #if MYNEWT_VAL(NRNG_VERBOSE)
 #include <nrng/nrng_encode.h>
 static bool complete_cb(struct uwb_dev * udev, struct uwb_mac_interface * cbs);
@@ -180,21 +182,20 @@ nrng_set_frames(struct nrng_instance * nrng, uint16_t nframes)
 }
 
 /**
- * API to configure dw1000 to start transmission after certain delay.
+ * @fn nrng_valid_mask(struct nrng_instance * nrng, uint16_t nranges, uint16_t base)
+ * @brief Mask of requested slots that returned a final frame for the current sequence number.
  *
- * @param inst          Pointer to struct nrng_instance.
- * @param ranges        []] to return results
- * @param nranges       side of  ranges[]
- * @param code          base address of curcular buffer
+ * @param nrng          Pointer to struct nrng_instance.
+ * @param nranges       Number of slots to consider.
+ * @param base          Base address of circular buffer.
  *
  * @return valid mask
  */
-uint32_t
-nrng_get_ranges(struct nrng_instance * nrng, float ranges[], uint16_t nranges, uint16_t base)
+static uint32_t
+nrng_valid_mask(struct nrng_instance * nrng, uint16_t nranges, uint16_t base)
 {
     uint32_t mask = 0;
 
-    // Which slots responded with a valid frames
     for (uint16_t i=0; i < nranges; i++){
         if (nrng->slot_mask & 1UL << i){
             // the set of all requested slots
@@ -206,13 +207,170 @@ nrng_get_ranges(struct nrng_instance * nrng, float ranges[], uint16_t nranges, u
             }
         }
     }
-    // Construct output vector
-    uint16_t j = 0;
+    return mask;
+}
+
+/**
+ * @fn nrng_get_ranges_batch(struct nrng_instance * nrng, nrng_range_t ranges[], uint16_t nranges, uint16_t base)
+ * @brief API to resolve all single sided responses of a nrng exchange in one pass.
+ *
+ * The timestamps of the responding slots are first gathered into contiguous arrays,
+ * deriving the clock skew once per responder, and the ranges are then computed by
+ * calc_range_ss_batch().
+ *
+ * @param nrng          Pointer to struct nrng_instance.
+ * @param ranges        Packed results, one per valid response in slot order.
+ * @param nranges       Size of ranges[], at most NRNG_BATCH_MAX.
+ * @param base          Base address of circular buffer.
+ *
+ * @return valid mask
+ */
+uint32_t
+nrng_get_ranges_batch(struct nrng_instance * nrng, nrng_range_t ranges[], uint16_t nranges, uint16_t base)
+{
+    uint32_t T1R[NRNG_BATCH_MAX];
+    uint32_t T1r[NRNG_BATCH_MAX];
+    float skew[NRNG_BATCH_MAX];
+    float range[NRNG_BATCH_MAX];
+    uint16_t n = 0;
+
+    assert(nranges <= NRNG_BATCH_MAX);
+    uint32_t mask = nrng_valid_mask(nrng, nranges, base);
+
+    // Gather timestamps of the valid responses
     for (uint16_t i=0; i < nranges; i++){
         if (mask & 1UL << i){
             uint16_t idx = BitIndex(nrng->slot_mask, 1UL << i, SLOT_POSITION);
             nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
-            ranges[j++] = uwb_rng_tof_to_meters(nrng_twr_to_tof_frames(nrng->dev_inst, frame, frame));
+            T1R[n] = frame->response_timestamp - frame->request_timestamp;
+            T1r[n] = frame->transmission_timestamp - frame->reception_timestamp;
+#if MYNEWT_VAL(UWB_WCS_ENABLED)
+            skew[n] = 0;
+#else
+            skew[n] = uwb_calc_clock_offset_ratio(nrng->dev_inst, frame->carrier_integrator,
+                                                  UWB_CR_CARRIER_INTEGRATOR);
+#endif
+            ranges[n].uid = frame->src_address;
+            ranges[n].slot_id = frame->slot_id;
+            n++;
+        }
+    }
+
+    calc_range_ss_batch(T1R, T1r, skew, range, n);
+    for (uint16_t j=0; j < n; j++){
+        ranges[j].range = range[j];
+    }
+    return mask;
+}
+
+#if MYNEWT_VAL(TWR_DS_EXT_NRNG_ENABLED)
+/**
+ * Gather the finite ranges of a nrng exchange together with the coordinates and
+ * range variance each responder reported in its ext frame payload.
+ *
+ * @param nrng          Pointer to struct nrng_instance.
+ * @param nranges       Number of slots requested.
+ * @param base          base address of curcular buffer
+ * @param meas          Output, room for MULTILAT_MAX_MEAS entries.
+ *
+ * @return number of measurements
+ */
+static uint16_t
+nrng_anchor_ranges(struct nrng_instance * nrng, uint16_t nranges, uint16_t base, multilat_meas_t * meas)
+{
+    nrng_range_t ranges[NRNG_BATCH_MAX];
+    uint16_t n = 0, j = 0;
+
+    uint32_t mask = nrng_get_ranges_batch(nrng, ranges, nranges, base);
+    for (uint16_t i=0; i < nranges && n < MULTILAT_MAX_MEAS; i++){
+        if (mask & 1UL << i){
+            uint16_t idx = BitIndex(nrng->slot_mask, 1UL << i, SLOT_POSITION);
+            nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
+            float range = ranges[j++].range;
+            if (!isfinite(range))
+                continue;
+            meas[n].anchor = frame->cartesian;
+            meas[n].range = range;
+            meas[n].variance = frame->spherical_variance.range;
+            n++;
+        }
+    }
+    return n;
+}
+
+/**
+ * API to solve the position of the initiator from the ranges of a nrng exchange. The
+ * responders report their coordinates and range variance in the ext frame payload.
+ *
+ * @param nrng          Pointer to struct nrng_instance.
+ * @param nranges       Number of slots requested.
+ * @param base          base address of curcular buffer
+ * @param dim           2 or 3, see multilat_solve()
+ * @param guess         Optional start point, such as the previous position.
+ * @param result        Solved position.
+ *
+ * @return 0 on success, error code of multilat_solve() otherwise
+ */
+int
+nrng_get_position(struct nrng_instance * nrng, uint16_t nranges, uint16_t base, uint8_t dim,
+                  const triad_t * guess, multilat_result_t * result)
+{
+    multilat_meas_t meas[MULTILAT_MAX_MEAS];
+    uint16_t n = nrng_anchor_ranges(nrng, nranges, base, meas);
+    return multilat_solve(meas, n, dim, guess, result);
+}
+
+/**
+ * API to feed the ranges of a nrng exchange to a tracker one at a time. Unlike
+ * nrng_get_position() this is useful when only one or two responders answered.
+ *
+ * @param nrng          Pointer to struct nrng_instance.
+ * @param nranges       Number of slots requested.
+ * @param base          base address of curcular buffer
+ * @param uid           Track to update, normally the initiator's own address.
+ * @param utime         Time of the exchange (usec).
+ * @param table         Tracks, see track_table_init().
+ *
+ * @return number of ranges applied to the track
+ */
+uint16_t
+nrng_track(struct nrng_instance * nrng, uint16_t nranges, uint16_t base, uint16_t uid, uint64_t utime,
+           track_table_t * table)
+{
+    multilat_meas_t meas[MULTILAT_MAX_MEAS];
+    uint16_t n = nrng_anchor_ranges(nrng, nranges, base, meas);
+    uint16_t applied = 0;
+
+    for (uint16_t i=0; i < n; i++){
+        if (track_range(table, uid, utime, &meas[i].anchor, meas[i].range, meas[i].variance) == 0)
+            applied++;
+    }
+    return applied;
+}
+#endif
+
+/**
+ * API to get the ranges of the valid responses of a nrng exchange.
+ *
+ * @param inst          Pointer to struct nrng_instance.
+ * @param ranges        []] to return results
+ * @param nranges       side of  ranges[]
+ * @param code          base address of curcular buffer
+ *
+ * @return valid mask
+ */
+uint32_t
+nrng_get_ranges(struct nrng_instance * nrng, float ranges[], uint16_t nranges, uint16_t base)
+{
+    nrng_range_t results[NRNG_BATCH_MAX];
+
+    uint32_t mask = nrng_get_ranges_batch(nrng, results, nranges, base);
+    // Construct output vector
+    uint16_t j = 0;
+    for (uint16_t i=0; i < nranges; i++){
+        if (mask & 1UL << i){
+            ranges[j] = results[j].range;
+            j++;
         }
     }
     return mask;
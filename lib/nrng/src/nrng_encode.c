@@ -30,7 +30,7 @@
 void
 nrng_encode(struct nrng_instance * nrng, uint8_t seq_num, uint16_t base){
 
-    uint32_t valid_mask = 0;
+    nrng_range_t results[16];
     nrng_frame_t * frame = nrng->frames[(base)%nrng->nframes];
 
     nrng_json_t json = {
@@ -38,16 +38,8 @@ nrng_encode(struct nrng_instance * nrng, uint8_t seq_num, uint16_t base){
         .seq = seq_num,
         .uid = frame->src_address
     };
-    // Workout which slots responded with a valid frames
-    for (uint16_t i=0; i < 16; i++){
-        if (nrng->slot_mask & 1UL << i){
-            uint16_t idx = BitIndex(nrng->slot_mask, 1UL << i, SLOT_POSITION);
-            nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
-            if (frame->code == UWB_DATA_CODE_SS_TWR_NRNG_FINAL && frame->seq_num == seq_num){
-                valid_mask |= 1UL << i;
-            }
-        }
-    }
+    // Resolve all slots that responded with a valid frame in one pass
+    uint32_t valid_mask = nrng_get_ranges_batch(nrng, results, 16, base);
     // tdoa results are reference to slot 0, so reject it slot 0 did not respond. An alternative approach is needed @Niklas
     if (valid_mask == 0 || (valid_mask & 1) == 0)
        return;
@@ -57,10 +49,8 @@ nrng_encode(struct nrng_instance * nrng, uint8_t seq_num, uint16_t base){
         if (valid_mask & 1UL << i){
             uint16_t idx = BitIndex(nrng->slot_mask, 1UL << i, SLOT_POSITION);
             nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
-            if (frame->code == UWB_DATA_CODE_SS_TWR_NRNG_FINAL && frame->seq_num == seq_num){
-                json.rng[j] = (dpl_float64_t) uwb_rng_tof_to_meters(nrng_twr_to_tof_frames(nrng->dev_inst, frame, frame));
-                json.ouid[j++] = frame->dst_address;
-            }
+            json.rng[j] = (dpl_float64_t) results[j].range;
+            json.ouid[j++] = frame->dst_address;
         }
     }
     json.nsize = j;
@@ -94,6 +94,8 @@ nrng_json_write(nrng_json_t * json){
     return rc;
 }
 
+static struct json_attr_index nrng_json_read_index;
+
 int
 nrng_json_read(nrng_json_t * json, char * line){
 
@@ -157,7 +159,7 @@ nrng_json_read(nrng_json_t * json, char * line){
 
     memset((void *)json + offsetof(nrng_json_t,utime), 0, offsetof(nrng_json_t,iobuf) - offsetof(nrng_json_t,utime));
 
-    int rc = json_read_object(&json->decoder.json_buf, ccp_attr);
+    int rc = json_read_object_indexed(&json->decoder.json_buf, ccp_attr, &nrng_json_read_index);
 
     return rc;
 }
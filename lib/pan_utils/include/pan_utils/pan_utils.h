@@ -30,6 +30,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -54,6 +55,17 @@ STATS_SECT_START(pan_stat_section)
     STATS_SECT_ENTRY(tx_error)
     STATS_SECT_ENTRY(rx_timeout)
     STATS_SECT_ENTRY(reset)
+    STATS_SECT_ENTRY(slotmap_tx)
+    STATS_SECT_ENTRY(slotmap_rx)
+    STATS_SECT_ENTRY(join_backoff)
+    STATS_SECT_ENTRY(join_grant)
+    STATS_SECT_ENTRY(batch_tx)
+    STATS_SECT_ENTRY(batch_grants)
+    STATS_SECT_ENTRY(batch_full)
+    STATS_SECT_ENTRY(batch_rx)
+    STATS_SECT_ENTRY(join_p50_ms)
+    STATS_SECT_ENTRY(join_p90_ms)
+    STATS_SECT_ENTRY(join_p99_ms)
 STATS_SECT_END
 
 extern STATS_SECT_DECL(pan_stat_section) g_stat; //!< Stats instance
@@ -85,6 +97,12 @@ struct pan_req_resp {
             uint16_t padding;
         };
     };
+#if MYNEWT_VAL(UWB_PAN_SLOTMAP)
+    uint16_t demand;                     //!< Reported tx queue depth / granted demand
+#endif
+#if MYNEWT_VAL(UWB_PAN_JOIN_AGE)
+    uint16_t join_age;                   //!< Request: 1 + 10ms units spent joining, 0 when renewing
+#endif
 };
 
 typedef bool (*uwb_pan_request_cb_func_t)(uint64_t euid, struct pan_req_resp *request, struct pan_req_resp *response);
@@ -103,6 +121,88 @@ union pan_frame_t {
     uint8_t array[sizeof(struct _pan_frame_t)];
 };
 
+#define PAN_SLOTMAP_MAX_GRANTS (16)     //!< Max number of grants in one slotmap broadcast
+
+//! Slot grant, the node owns slots [slot, slot+count) in superframes where
+//! (superframe % 2^period) == phase. period 0 is an exclusive grant.
+struct pan_slot_grant {
+    uint16_t addr;                       //!< Short address of the grantee
+    uint8_t slot;                        //!< First tdma slot
+    uint8_t count;                       //!< Number of consecutive slots
+    uint8_t period:4;                    //!< log2 of superframes between uses
+    uint8_t phase:4;                     //!< Superframe phase within the period
+}__attribute__((__packed__, aligned(1)));
+
+//! Union of slotmap broadcast frame format
+union pan_slotmap_frame_t {
+//! Structure containing the slotmap frame format
+    struct _pan_slotmap_frame_t{
+        //! Structure of IEEE blink frame
+        struct _ieee_blink_frame_t;
+        uint8_t rpt_count:4;                 //!< Repeat level
+        uint8_t rpt_max:4;                   //!< Repeat max level
+        uint16_t code;                       //!< Package type code
+        uint8_t map_seq;                     //!< Incremented for each new map
+        uint8_t ngrants;                     //!< Number of valid grants
+        struct pan_slot_grant grants[PAN_SLOTMAP_MAX_GRANTS];
+    }__attribute__((__packed__, aligned(1)));
+    uint8_t array[sizeof(struct _pan_slotmap_frame_t)];
+};
+
+//! Transmitted length of a slotmap frame carrying n grants
+#define PAN_SLOTMAP_FRAME_LEN(n) (offsetof(struct _pan_slotmap_frame_t, grants) + (n) * sizeof(struct pan_slot_grant))
+
+/**
+ * @fn pan_slot_grant_match(const struct pan_slot_grant *grant, uint16_t slot, uint8_t superframe)
+ * @brief Check if a grant covers a tdma slot in a given superframe.
+ *
+ * @param grant       Pointer to the grant.
+ * @param slot        tdma slot index.
+ * @param superframe  Superframe sequence number (ccp seq_num).
+ *
+ * @return true if the slot belongs to the grantee
+ */
+static inline bool
+pan_slot_grant_match(const struct pan_slot_grant *grant, uint16_t slot, uint8_t superframe)
+{
+    if (slot < grant->slot || slot >= (uint16_t)grant->slot + grant->count) {
+        return false;
+    }
+    return (superframe & ((1u << grant->period) - 1)) == grant->phase;
+}
+
+#define PAN_BATCH_MAX_GRANTS (8)        //!< Max number of grants in one batch response
+
+//! Address and slot granted to one requester in a batch response
+struct pan_join_grant {
+    uint64_t euid;                       //!< Requester
+    uint16_t short_address;              //!< Assigned device_id
+    uint16_t slot_id;                    //!< Assigned slot_id
+}__attribute__((__packed__, aligned(1)));
+
+//! Union of batch response frame format
+union pan_batch_frame_t {
+//! Structure containing the batch response frame format
+    struct _pan_batch_frame_t{
+        //! Structure of IEEE blink frame
+        struct _ieee_blink_frame_t;
+        uint8_t rpt_count:4;                 //!< Repeat level
+        uint8_t rpt_max:4;                   //!< Repeat max level
+        uint16_t code;                       //!< Package type code
+        uint16_t pan_id;                     //!< Assigned pan_id
+        uint16_t lease_time;                 //!< Shortest lease granted, in seconds
+        uint8_t ngrants;                     //!< Number of valid grants
+        struct pan_join_grant grants[PAN_BATCH_MAX_GRANTS];
+    }__attribute__((__packed__, aligned(1)));
+    uint8_t array[sizeof(struct _pan_batch_frame_t)];
+};
+
+//! Transmitted length of a batch response carrying n grants
+#define PAN_BATCH_FRAME_LEN(n) (offsetof(struct _pan_batch_frame_t, grants) + (n) * sizeof(struct pan_join_grant))
+
+//! Join latency histogram bins, 4 per octave of join_age
+#define PAN_JOIN_HIST_BINS (60)
+
 //! Pan status parameters
 struct uwb_pan_status_t {
     uint16_t selfmalloc:1;                 //!< Internal flag for memory garbage collection
@@ -110,6 +210,11 @@ struct uwb_pan_status_t {
     uint16_t valid:1;                      //!< Set for valid parameters
     uint16_t start_tx_error:1;             //!< Set for start transmit error
     uint16_t lease_expired:1;              //!< Set when lease has expired
+    uint16_t demand_changed:1;             //!< Demand class differs from the last reported
+    uint16_t has_grant:1;                  //!< Set when a slotmap grant is held
+    uint16_t slotmap_pending:1;            //!< Master has a new slotmap to broadcast
+    uint16_t joining:1;                    //!< Requesting an address or renewal
+    uint16_t batch_pending:1;              //!< Master has grants to send in a batch
 };
 
 //! Pan configure parameters
@@ -139,6 +244,17 @@ struct uwb_pan_instance {
     struct dpl_event postprocess_event;          //!< Structure of postprocess event
     struct dpl_callout pan_lease_callout_expiry; //!< Structure of lease_callout_expiry
     struct uwb_pan_config_t * config;                   //!< Pan config parameters
+    uint16_t demand;                             //!< Current tx queue depth
+    uint16_t demand_reported;                    //!< Demand sent in the last request
+    struct pan_slot_grant grant;                 //!< Own grant from the last slotmap
+    uint8_t map_seq;                             //!< Sequence number of the last slotmap
+    uint16_t slotmap_age;                        //!< Superframes since the slotmap was sent
+    union pan_slotmap_frame_t * slotmap;         //!< Master slotmap broadcast frame
+    union pan_batch_frame_t * batch;             //!< Master batch response frame
+    uint16_t * join_hist;                        //!< Master join latency histogram
+    uint32_t join_start;                         //!< dpl_time when joining started
+    uint16_t join_wait;                          //!< Pan slots to listen before the next request
+    uint8_t join_attempts;                       //!< Requests sent since joining started
     uint16_t nframes;                            //!< Number of buffers defined to store the data
     uint16_t idx;                                //!< Indicates number of DW1000 instances
     union pan_frame_t * frames[];                      //!< Buffers to pan frames
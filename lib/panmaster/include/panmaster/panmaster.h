@@ -22,7 +22,8 @@
 
 #include <inttypes.h>
 #include "pan_utils/pan_utils.h"
-#include "fcb/fcb.h"
+
+struct flash_area;
 
 struct panmaster_node {
     int64_t  first_seen_utc; /*!< When this node was first seen */
@@ -47,8 +48,18 @@ struct panmaster_node_idx {
     int64_t  euid;           /*!< Unique id, 64bit */
     uint8_t role;
     uint16_t has_perm_slot:1; /*!< Has Permanent slot */
-    uint16_t save_needed:1;   /*!< Flash needs updating */
+    uint16_t save_needed:1;   /*!< Queued to be written to storage */
+    uint16_t lease_pushed:1;  /*!< Lease renewed without a request since the last one */
     uint32_t lease_ends;
+    uint16_t lease_time;      /*!< Lease time of the last request, s */
+    uint16_t demand;          /*!< Last reported tx demand */
+    int64_t  first_seen_utc;  /*!< When this node was first seen */
+    struct pan_image_version fw_ver; /*!< Last reported firmware version */
+};
+
+struct panmaster_slot_demand {
+    uint16_t addr;           /*!< Local id, 16bit */
+    uint16_t demand;         /*!< Reported tx queue depth */
 };
 
 struct find_node_s {
@@ -62,7 +73,7 @@ struct find_node_s {
         (N).addr=0xffff;(N).flags=0;(N).has_perm_slot=0;(N).index=0;(N).slot_id=0xffff;(N).role=0; \
         (N).fw_ver.iv_major=0;(N).fw_ver.iv_minor=0;                    \
         (N).fw_ver.iv_revision=0;(N).fw_ver.iv_build_num=0;}
-#define PANMASTER_NODE_IDX_DEFAULT(N)  {(N).addr=0xffff;(N).slot_id=0xffff;(N).role=0;}
+#define PANMASTER_NODE_IDX_DEFAULT(N)  {(N).addr=0xffff;(N).slot_id=0xffff;(N).role=0;(N).demand=0;}
 
 typedef void (*panm_load_cb)(struct panmaster_node *node, void *cb_arg);
 
@@ -75,6 +86,7 @@ bool panrequest_cb(uint64_t euid, struct pan_req_resp *request,
 void postprocess_cb(struct dpl_event * ev);
 
 void panmaster_pkg_init(void);
+void panmaster_set_save_eventq(struct dpl_eventq *eventq);
 int panmaster_idx_find_node(uint64_t euid, uint16_t role, struct panmaster_node **node);
 int panmaster_find_node_general(struct find_node_s *fns);
 
@@ -95,6 +107,10 @@ void panmaster_compress();
 void panmaster_sort();
 uint16_t panmaster_highest_node_addr();
 
+int panmaster_slot_alloc(struct panmaster_slot_demand *demands, int ndemands,
+                         uint8_t first_slot, uint8_t nslots,
+                         struct pan_slot_grant *grants, int max_grants);
+
 #if MYNEWT_VAL(PANMASTER_CBOR_EXPORT)
 struct os_mbuf* panmaster_cbor_nodes_list(struct os_mbuf_pool *mbuf_pool);
 int panmaster_cbor_nodes_list_fa(const struct flash_area *fa, int *fa_offset);
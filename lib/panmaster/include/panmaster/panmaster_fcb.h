@@ -19,6 +19,7 @@
 #ifndef __PANMASTER_FCB_H_
 #define __PANMASTER_FCB_H_
 
+#include "fcb/fcb.h"
 #include "panmaster/panmaster.h"
 
 #ifdef __cplusplus
@@ -33,6 +34,7 @@ int panm_fcb_src(struct panm_fcb *pm);
 int panm_fcb_load_idx(struct panm_fcb *pm, struct panmaster_node_idx *nodes);
 int panm_fcb_find_node(struct panm_fcb *pf, struct find_node_s *fns);
 int panm_fcb_save(struct panm_fcb *pm, struct panmaster_node *node);
+int panm_fcb_save_batch(struct panm_fcb *pm, struct panmaster_node *nodes, int n);
 int panm_fcb_clear(struct panm_fcb *pm);
 int panm_fcb_load(struct panm_fcb *pm, panm_load_cb cb, void *cb_arg);
 void panm_fcb_compress(struct panm_fcb *pm);
@@ -0,0 +1,86 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef __PANMASTER_INDEX_H_
+#define __PANMASTER_INDEX_H_
+
+#include "panmaster/panmaster.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PANM_INDEX_NROLES       (16)            /*!< One slot bitmap per 4 bit role */
+#define PANM_INDEX_NONE         (0xffff)
+#define PANM_INDEX_WHEEL        (256)           /*!< Lease wheel buckets */
+#define PANM_INDEX_TICK_SHIFT   (10)            /*!< Lease wheel tick of 1024 ms */
+
+/* Storage needed by panm_index_init() for a table of N nodes */
+#define PANM_INDEX_BUCKETS(N)   (2 * (N))
+#define PANM_INDEX_WORDS(N)     (((N) + 31) / 32)
+#define PANM_INDEX_U16(N)       (2 * PANM_INDEX_BUCKETS(N) + 3 * (N) + PANM_INDEX_WHEEL)
+#define PANM_INDEX_U32(N)       (PANM_INDEX_NROLES * PANM_INDEX_WORDS(N))
+
+/**
+ * Lookup structures over a panmaster_node_idx table: open addressed hashes from
+ * euid and short address to table index, a bitmap of taken slot ids per role and
+ * a timing wheel of leases hashed on the tick they end in. Unused table entries are
+ * kept on a stack.
+ */
+struct panm_index {
+    struct panmaster_node_idx *nodes;   /*!< Indexed table */
+    uint16_t nnodes;                    /*!< Entries in nodes */
+    uint16_t nbuckets;                  /*!< Entries in each hash */
+    uint16_t nwords;                    /*!< Bitmap words per role */
+    uint16_t nleases;                   /*!< Leases in the wheel */
+    uint16_t nfree;                     /*!< Unused entries on the free stack */
+    uint16_t *euid_hash;
+    uint16_t *addr_hash;
+    uint16_t *wheel;                    /*!< First table index of each bucket */
+    uint16_t *lease_next;               /*!< Next table index in the bucket */
+    uint16_t *lease_prev;               /*!< Previous table index, or 0x8000 | bucket for the first */
+    uint16_t *free;                     /*!< Unused table indices, lowest on top */
+    uint32_t *slots;                    /*!< Set bit = slot id taken */
+    uint16_t free_word[PANM_INDEX_NROLES]; /*!< No free slot below this word */
+    uint32_t wheel_ms;                  /*!< Start of the first bucket not yet walked to its end */
+};
+
+void panm_index_init(struct panm_index *idx, struct panmaster_node_idx *nodes, uint16_t nnodes,
+                     uint16_t *buf16, uint32_t *buf32);
+void panm_index_rebuild(struct panm_index *idx);
+int panm_index_find_euid(struct panm_index *idx, uint64_t euid);
+int panm_index_find_addr(struct panm_index *idx, uint16_t addr);
+int panm_index_alloc(struct panm_index *idx);
+void panm_index_insert(struct panm_index *idx, int i);
+void panm_index_remove(struct panm_index *idx, int i);
+uint16_t panm_index_free_addr(struct panm_index *idx, uint64_t euid);
+uint16_t panm_index_slot_alloc(struct panm_index *idx, int i, uint32_t now_ms);
+void panm_index_slot_release(struct panm_index *idx, int i);
+void panm_index_slot_claim(struct panm_index *idx, int i, uint16_t slot_id);
+void panm_index_set_role(struct panm_index *idx, int i, uint8_t role);
+void panm_index_lease(struct panm_index *idx, int i, uint32_t lease_ends);
+int panm_index_expire(struct panm_index *idx, uint32_t now_ms);
+int panm_index_lease_due(struct panm_index *idx, uint32_t now_ms, uint32_t within_ms,
+                         uint16_t *due, int max_due);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PANMASTER_INDEX_H_ */
@@ -30,6 +30,9 @@ TEST_CASE_DECL(pan_os_lease_time)
 TEST_CASE_DECL(pan_os_slot_id)
 TEST_CASE_DECL(pan_os_same_slot_id)
 TEST_CASE_DECL(pan_os_lease_time_expire)
+TEST_CASE_DECL(pan_os_save_coalesce)
+TEST_CASE_DECL(pan_slot_alloc)
+TEST_CASE_DECL(pan_index)
 
 TEST_SUITE(panmaster_test_all)
 {
@@ -40,6 +43,9 @@ TEST_SUITE(panmaster_test_all)
     pan_os_slot_id();
     pan_os_same_slot_id();
     pan_os_lease_time_expire();
+    pan_os_save_coalesce();
+    pan_slot_alloc();
+    pan_index();
 }
 
 int main(int argc, char **argv)
@@ -0,0 +1,143 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <uwb/uwb.h>
+#include <panmaster/panmaster.h>
+#include <panmaster/panmaster_index.h>
+#include "panmaster_test.h"
+
+#define INDEX_TEST_NODES    (8)
+
+/* Join handling as done by panmaster_idx_find_node() and panrequest_cb() */
+static int
+index_join(struct panm_index *idx, uint64_t euid, uint8_t role, uint32_t now_ms, uint32_t lease_ms)
+{
+    int i = panm_index_find_euid(idx, euid);
+    if (i < 0) {
+        if ((i = panm_index_alloc(idx)) < 0) {
+            return -1;
+        }
+        idx->nodes[i].euid = euid;
+        idx->nodes[i].addr = panm_index_free_addr(idx, euid);
+        idx->nodes[i].role = role;
+        idx->nodes[i].slot_id = 0xffff;
+        panm_index_insert(idx, i);
+    }
+    panm_index_slot_alloc(idx, i, now_ms);
+    panm_index_lease(idx, i, now_ms + lease_ms);
+    return i;
+}
+
+static void
+index_reset(struct panmaster_node_idx *nodes, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        memset(&nodes[i], 0, sizeof(nodes[i]));
+        PANMASTER_NODE_IDX_DEFAULT(nodes[i]);
+    }
+}
+
+TEST_CASE_SELF(pan_index)
+{
+    struct panmaster_node_idx nodes[INDEX_TEST_NODES];
+    uint16_t buf16[PANM_INDEX_U16(INDEX_TEST_NODES)];
+    uint32_t buf32[PANM_INDEX_U32(INDEX_TEST_NODES)];
+    struct panm_index idx;
+    uint16_t due[4];
+    int i, a, b, c;
+
+    index_reset(nodes, INDEX_TEST_NODES);
+    panm_index_init(&idx, nodes, INDEX_TEST_NODES, buf16, buf32);
+
+    /* Entries are handed out lowest first, address is the low bits of the euid */
+    a = index_join(&idx, 0x111100000000029AULL, 1, 1000, 10000);
+    b = index_join(&idx, 0x222200000000029AULL, 1, 1000, 15000);
+    c = index_join(&idx, 0x333300000000029BULL, 2, 1000, 15000);
+    TEST_ASSERT(a == 0 && b == 1 && c == 2);
+    TEST_ASSERT(nodes[a].addr == 0x029A && nodes[b].addr == 0x129A && nodes[c].addr == 0x029B);
+    TEST_ASSERT(panm_index_find_euid(&idx, 0x222200000000029AULL) == b);
+    TEST_ASSERT(panm_index_find_addr(&idx, 0x129A) == b);
+    TEST_ASSERT(panm_index_find_euid(&idx, 0x444400000000029AULL) == -1);
+
+    /* Slot ids are per role, renewing keeps the lowest free slot */
+    TEST_ASSERT(nodes[a].slot_id == 0 && nodes[b].slot_id == 1 && nodes[c].slot_id == 0);
+    index_join(&idx, 0x111100000000029AULL, 1, 2000, 10000);
+    TEST_ASSERT(nodes[a].slot_id == 0);
+
+    /* The earliest lease expires first and its slot is reused */
+    TEST_ASSERT(panm_index_expire(&idx, 12500) == 1);
+    TEST_ASSERT(nodes[a].slot_id == 0xffff && nodes[b].slot_id == 1);
+    i = index_join(&idx, 0x555500000000029CULL, 1, 12500, 10000);
+    TEST_ASSERT(nodes[i].slot_id == 0);
+    index_join(&idx, 0x111100000000029AULL, 1, 12600, 10000);
+    TEST_ASSERT(nodes[a].slot_id == 2);
+
+    /* Permanent slots survive expiry */
+    nodes[c].has_perm_slot = 1;
+    TEST_ASSERT(panm_index_expire(&idx, 100000) == 4);
+    TEST_ASSERT(nodes[c].slot_id == 0 && nodes[b].slot_id == 0xffff);
+
+    /* A role change gives up the slot held under the old role */
+    index_join(&idx, 0x222200000000029AULL, 1, 100000, 10000);
+    TEST_ASSERT(nodes[b].slot_id == 0);
+    panm_index_set_role(&idx, b, 2);
+    TEST_ASSERT(nodes[b].slot_id == 0xffff);
+    index_join(&idx, 0x222200000000029AULL, 2, 100000, 10000);
+    TEST_ASSERT(nodes[b].slot_id == 1);
+
+    /* Removal keeps every other node reachable and recycles the entry */
+    panm_index_remove(&idx, a);
+    nodes[a].addr = 0xffff;
+    TEST_ASSERT(panm_index_find_euid(&idx, 0x111100000000029AULL) == -1);
+    TEST_ASSERT(panm_index_find_addr(&idx, 0x129A) == b);
+    TEST_ASSERT(panm_index_find_euid(&idx, 0x555500000000029CULL) == i);
+    TEST_ASSERT(index_join(&idx, 0x666600000000029AULL, 1, 100000, 10000) == a);
+    TEST_ASSERT(nodes[a].addr == 0x029A);
+
+    /* Table full, then rebuilt from its content */
+    for (i = 0; i < INDEX_TEST_NODES; i++) {
+        index_join(&idx, 0x7777000000000000ULL + i, 1, 100000, 10000);
+    }
+    TEST_ASSERT(idx.nfree == 0);
+    TEST_ASSERT(index_join(&idx, 0x8888000000000000ULL, 1, 100000, 10000) == -1);
+    panm_index_rebuild(&idx);
+    TEST_ASSERT(idx.nfree == 0 && idx.nleases == INDEX_TEST_NODES);
+    for (i = 0; i < INDEX_TEST_NODES; i++) {
+        TEST_ASSERT(panm_index_find_euid(&idx, nodes[i].euid) == i);
+        TEST_ASSERT(panm_index_find_addr(&idx, nodes[i].addr) == i);
+    }
+
+    /* Leases ending soon are listed ahead of expiry, a lease more than one
+     * turn of the wheel away waits for its turn */
+    index_reset(nodes, INDEX_TEST_NODES);
+    panm_index_init(&idx, nodes, INDEX_TEST_NODES, buf16, buf32);
+    a = index_join(&idx, 0x1111000000000001ULL, 1, 1000, 10000);
+    b = index_join(&idx, 0x2222000000000002ULL, 1, 1000, 12000);
+    c = index_join(&idx, 0x3333000000000003ULL, 1, 1000, 400000);
+    TEST_ASSERT(idx.nleases == 3);
+    TEST_ASSERT(panm_index_lease_due(&idx, 8000, 4000, due, 4) == 1 && due[0] == a);
+    TEST_ASSERT(panm_index_lease_due(&idx, 8000, 6000, due, 4) == 2);
+    TEST_ASSERT(panm_index_lease_due(&idx, 8000, 6000, due, 1) == 1);
+    TEST_ASSERT(panm_index_expire(&idx, 300000) == 2 && idx.nleases == 1);
+    TEST_ASSERT(nodes[a].slot_id == 0xffff && nodes[b].slot_id == 0xffff);
+    TEST_ASSERT(panm_index_expire(&idx, 400000) == 0 && nodes[c].slot_id == 2);
+    TEST_ASSERT(panm_index_expire(&idx, 401500) == 1 && nodes[c].slot_id == 0xffff);
+    TEST_ASSERT(idx.nleases == 0);
+}
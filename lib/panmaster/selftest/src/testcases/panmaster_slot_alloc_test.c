@@ -0,0 +1,92 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <uwb/uwb.h>
+#include <panmaster/panmaster.h>
+#include "panmaster_test.h"
+
+/* Count owners of every (slot, superframe) pair over one 8 superframe cycle */
+static int
+slot_alloc_owners(struct pan_slot_grant *grants, int n, uint16_t slot, uint8_t sf)
+{
+    int i, owners = 0;
+    for (i = 0; i < n; i++) {
+        owners += pan_slot_grant_match(&grants[i], slot, sf);
+    }
+    return owners;
+}
+
+TEST_CASE_SELF(pan_slot_alloc)
+{
+    struct panmaster_slot_demand d[6];
+    struct pan_slot_grant g[PAN_SLOTMAP_MAX_GRANTS];
+    int n, i, slot, sf;
+
+    /* No demand, no grants */
+    memset(d, 0, sizeof(d));
+    d[0].addr = 0x1001;
+    n = panmaster_slot_alloc(d, 1, 2, 8, g, PAN_SLOTMAP_MAX_GRANTS);
+    TEST_ASSERT(n == 0);
+
+    /* Single node gets every slot */
+    d[0].demand = 10;
+    n = panmaster_slot_alloc(d, 1, 2, 8, g, PAN_SLOTMAP_MAX_GRANTS);
+    TEST_ASSERT(n == 1);
+    TEST_ASSERT(g[0].addr == 0x1001 && g[0].slot == 2 && g[0].count == 8);
+    TEST_ASSERT(g[0].period == 0 && g[0].phase == 0);
+    TEST_ASSERT(pan_slot_grant_match(&g[0], 9, 123));
+    TEST_ASSERT(!pan_slot_grant_match(&g[0], 10, 123));
+    TEST_ASSERT(!pan_slot_grant_match(&g[0], 1, 123));
+
+    /* Heavy node gets whole slots, light nodes share the remainder */
+    d[0] = (struct panmaster_slot_demand){.addr = 0x1001, .demand = 1};
+    d[1] = (struct panmaster_slot_demand){.addr = 0x1002, .demand = 60};
+    d[2] = (struct panmaster_slot_demand){.addr = 0x1003, .demand = 2};
+    d[3] = (struct panmaster_slot_demand){.addr = 0x1004, .demand = 1};
+    d[4] = (struct panmaster_slot_demand){.addr = 0x1005, .demand = 0};
+    d[5] = (struct panmaster_slot_demand){.addr = 0x1006, .demand = 1};
+    n = panmaster_slot_alloc(d, 6, 2, 4, g, PAN_SLOTMAP_MAX_GRANTS);
+    TEST_ASSERT(n == 5);
+    TEST_ASSERT(g[0].addr == 0x1002 && g[0].period == 0 && g[0].count == 3);
+    for (i = 1; i < n; i++) {
+        TEST_ASSERT(g[i].count == 1 && g[i].period > 0);
+        TEST_ASSERT(g[i].addr != 0x1005);
+    }
+
+    /* No slot is ever granted to two nodes in the same superframe */
+    for (slot = 0; slot < 8; slot++) {
+        for (sf = 0; sf < 8; sf++) {
+            TEST_ASSERT(slot_alloc_owners(g, n, slot, sf) <= 1);
+        }
+    }
+
+    /* More nodes than phases, the excess gets nothing */
+    for (i = 0; i < 6; i++) {
+        d[i] = (struct panmaster_slot_demand){.addr = 0x2000 + i, .demand = 1};
+    }
+    n = panmaster_slot_alloc(d, 6, 0, 1, g, PAN_SLOTMAP_MAX_GRANTS);
+    TEST_ASSERT(n > 0 && n <= 6);
+    for (sf = 0; sf < 8; sf++) {
+        TEST_ASSERT(slot_alloc_owners(g, n, 0, sf) <= 1);
+    }
+
+    /* Output is capped */
+    n = panmaster_slot_alloc(d, 6, 0, 8, g, 2);
+    TEST_ASSERT(n == 2);
+}
@@ -323,6 +323,45 @@ pan_os_lease_time_expire_test_task_handler(void *arg)
     tu_restart();
 }
 
+static void
+pan_os_save_coalesce_test_task_handler(void *arg)
+{
+    int rc, i;
+    struct panmaster_node node;
+    struct find_node_s fns = { .results = &node };
+    struct uwb_pan_instance *test_pan = calloc(sizeof(*test_pan), 1);
+
+    uwb_pan_set_request_cb(test_pan, panrequest_cb);
+    uwb_pan_set_postprocess(test_pan, postprocess_cb);
+
+    struct pan_req_resp *req_1 = calloc(sizeof(*req_1), 1);
+    struct pan_req_resp *rsp_1 = calloc(sizeof(*rsp_1), 1);
+
+    /* A new node reporting a new version on every request */
+    for (i = 1; i <= 3; i++) {
+        req_1->short_address = 0x29D;
+        req_1->fw_ver.iv_major = 1;
+        req_1->fw_ver.iv_build_num = i;
+        rc = test_pan->request_cb(0x1234567829DULL, req_1, rsp_1);
+        TEST_ASSERT(rc);
+    }
+
+    /* Nothing written until the save event or postprocess */
+    PANMASTER_NODE_DEFAULT(fns.find);
+    fns.find.euid = 0x1234567829DULL;
+    panmaster_find_node_general(&fns);
+    TEST_ASSERT(!fns.is_found);
+
+    /* Written once, with the last version */
+    panmaster_postprocess();
+    panmaster_find_node_general(&fns);
+    TEST_ASSERT_FATAL(fns.is_found);
+    TEST_ASSERT(node.addr == rsp_1->short_address);
+    TEST_ASSERT(node.fw_ver.iv_major == 1 && node.fw_ver.iv_build_num == 3);
+
+    tu_restart();
+}
+
 TEST_CASE_SELF(pan_os_add_nodes)
 {
     pan_os_test_misc_init();
@@ -413,3 +452,16 @@ TEST_CASE_SELF(pan_os_lease_time_expire)
 
     os_start();
 }
+
+TEST_CASE_SELF(pan_os_save_coalesce)
+{
+    pan_os_test_misc_init();
+
+    os_task_init(&pan_os_test_task,
+                 "pan_os_test_save_coalesce",
+                 pan_os_save_coalesce_test_task_handler, NULL,
+                 PAN_OS_TEST_TASK_PRIO, OS_WAIT_FOREVER, pan_os_test_stack,
+                 OS_STACK_ALIGN(PAN_OS_TEST_STACK_SIZE));
+
+    os_start();
+}
@@ -6,6 +6,7 @@
 #include <config/config.h>
 
 #include "panmaster/panmaster.h"
+#include "panmaster/panmaster_index.h"
 #include "panmaster_priv.h"
 
 // #define VERBOSE
@@ -14,12 +15,59 @@
 #include <uwb_pan/uwb_pan.h>
 #endif
 
+/* The index of a node is stored in 8 bits, see struct panmaster_node */
+#if MYNEWT_VAL(PANMASTER_MAXNUM_NODES) > 256
+#error "PANMASTER_MAXNUM_NODES must not exceed 256"
+#endif
+
 static struct panmaster_node_idx node_idx[MYNEWT_VAL(PANMASTER_MAXNUM_NODES)];
+static uint16_t pm_index_buf16[PANM_INDEX_U16(MYNEWT_VAL(PANMASTER_MAXNUM_NODES))];
+static uint32_t pm_index_buf32[PANM_INDEX_U32(MYNEWT_VAL(PANMASTER_MAXNUM_NODES))];
+static struct panm_index pm_index;
 static struct dpl_mutex save_mutex;
-static struct panmaster_node nodes_to_save[MYNEWT_VAL(PANMASTER_NODES_TO_SAVE)];
+
+/* Nodes waiting to be written, save_needed is set while a node is queued */
+static uint16_t save_queue[MYNEWT_VAL(PANMASTER_MAXNUM_NODES)];
+static uint16_t save_head = 0;
+static uint16_t save_count = 0;
+static struct dpl_callout save_callout;
+
+/* Runs every tick of the lease wheel */
+static struct dpl_callout lease_callout;
+#if MYNEWT_VAL(UWB_PAN_ENABLED)
+static struct uwb_pan_instance *pm_pan = NULL;
+#endif
+
+/* Lookup results handed out by panmaster_idx_find_node() */
+#define PANM_FIND_RESULTS (4)
+static struct panmaster_node find_results[PANM_FIND_RESULTS];
+static uint8_t find_next = 0;
+
+#if MYNEWT_VAL(PANMASTER_STATS)
+STATS_SECT_DECL(panm_stat_section) g_panm_stat;
+STATS_NAME_START(panm_stat_section)
+    STATS_NAME(panm_stat_section, save_marked)
+    STATS_NAME(panm_stat_section, save_coalesced)
+    STATS_NAME(panm_stat_section, save_appends)
+    STATS_NAME(panm_stat_section, save_records)
+    STATS_NAME(panm_stat_section, save_errors)
+    STATS_NAME(panm_stat_section, compress)
+    STATS_NAME(panm_stat_section, compress_records)
+    STATS_NAME(panm_stat_section, lease_active)
+    STATS_NAME(panm_stat_section, lease_due)
+    STATS_NAME(panm_stat_section, lease_expired)
+    STATS_NAME(panm_stat_section, lease_renew_push)
+    STATS_NAME(panm_stat_section, lease_renew_full)
+STATS_NAME_END(panm_stat_section)
+#endif
 
 static uint16_t pan_id = 0x0000;
 static volatile int nodes_loaded = 0;
+static bool slotmap_dirty = false;
+
+static bool slot_lease_expired(int idx, uint32_t now_ms);
+static uint32_t uptime_ms(void);
+static void save_mark(int i);
 
 #define LOG_MODULE_PAN_MASTER (91)
 #define PM_INFO(...)     LOG_INFO(&_log, LOG_MODULE_PAN_MASTER, __VA_ARGS__)
@@ -140,57 +188,216 @@ bool
 panrequest_cb(uint64_t euid, struct pan_req_resp *request,
                                                 struct pan_req_resp *response)
 {
-    struct dpl_timeval tv;
     struct panmaster_node *node = 0;
+    /* Request and response may share the same frame buffer */
+#if MYNEWT_VAL(UWB_PAN_SLOTMAP)
+    uint16_t demand = request->demand;
+#else
+    uint16_t demand = 0;
+#endif
+    uint16_t lease_time = request->lease_time;
+    uint32_t now_ms = uptime_ms();
 
     panmaster_idx_find_node(euid, request->role, &node);
     if (!node) {
         return false;
     }
 
+    if (node_idx[node->index].demand != demand || slot_lease_expired(node->index, now_ms)) {
+        node_idx[node->index].demand = demand;
+        slotmap_dirty = true;
+    }
+
     /* Copy the fw_version before overwriting the union */
-    memcpy(&node->fw_ver, &request->fw_ver, sizeof(struct pan_image_version));
+    if (memcmp(&node_idx[node->index].fw_ver, &request->fw_ver, sizeof(struct pan_image_version))) {
+        memcpy(&node_idx[node->index].fw_ver, &request->fw_ver, sizeof(struct pan_image_version));
+        save_mark(node->index);
+    }
 
     /* Prepare response */
     response->short_address = node->addr;
     response->slot_id = node_idx[node->index].slot_id;
-    dpl_get_uptime(&tv);
-    if (response->lease_time == 0) {
-        response->lease_time = MYNEWT_VAL(PANMASTER_DEFAULT_LEASE_TIME);
+    /* A request without a lease time gets the default, a batched grant
+     * of 0 would otherwise end the lease as soon as it is taken */
+    if (lease_time == 0) {
+        lease_time = MYNEWT_VAL(PANMASTER_DEFAULT_LEASE_TIME);
     }
-    /* Calculate when this lease ends in ms */
-    node_idx[node->index].lease_ends = tv.tv_sec*1000 + tv.tv_usec/1000 + (uint32_t)request->lease_time*1000;
+    response->lease_time = lease_time;
+    /* Calculate when this lease ends in ms, the node asked itself so it may
+     * be renewed ahead of expiry once more */
+    node_idx[node->index].lease_time = lease_time;
+    node_idx[node->index].lease_pushed = 0;
+    panm_index_lease(&pm_index, node->index, now_ms + (uint32_t)lease_time*1000);
     response->pan_id = pan_id;
     response->role = node->role;
+#if MYNEWT_VAL(UWB_PAN_SLOTMAP)
+    response->demand = demand;
+#endif
+#if MYNEWT_VAL(UWB_PAN_JOIN_AGE)
+    response->join_age = 0;
+#endif
 
     /* PAN Request frame */
     return true;
 }
 
-void
-panmaster_postprocess(void)
+static int
+storage_save(struct panmaster_node *nodes, int n)
 {
-    int i, slots;
-    struct panmaster_node node;
+#if MYNEWT_VAL(PANMASTER_NFFS)
+    return panm_file_save_batch(&panmaster_storage_file, nodes, n);
+#elif MYNEWT_VAL(PANMASTER_FCB)
+    return panm_fcb_save_batch(&pm_init_conf_fcb, nodes, n);
+#endif
+}
 
+/* Storage record of table entry i */
+static void
+node_record(int i, struct panmaster_node *node)
+{
+    PANMASTER_NODE_DEFAULT(*node);
+    node->first_seen_utc = node_idx[i].first_seen_utc;
+    node->euid = node_idx[i].euid;
+    node->addr = node_idx[i].addr;
+    node->role = node_idx[i].role;
+    node->has_perm_slot = node_idx[i].has_perm_slot;
+    node->index = i;
+    node->slot_id = node_idx[i].slot_id;
+    memcpy(&node->fw_ver, &node_idx[i].fw_ver, sizeof(node->fw_ver));
+}
+
+/**
+ * Queue table entry i to be written by the save event. A node changed again
+ * before the event runs is written once.
+ */
+static void
+save_mark(int i)
+{
     if (dpl_mutex_pend(&save_mutex, DPL_WAIT_FOREVER) != DPL_OK) {
         return;
     }
-    slots = sizeof(nodes_to_save)/sizeof(nodes_to_save[0]);
-    for (i=0;i < slots;i++) {
-        if (nodes_to_save[i].euid) {
-            /* Take a tmp copy of this entry and save */
-            memcpy(&node, &nodes_to_save[i], sizeof(node));
-            dpl_mutex_release(&save_mutex);
-            panmaster_update_node(node.euid, &node);
-            if (dpl_mutex_pend(&save_mutex, DPL_WAIT_FOREVER) != DPL_OK) {
-                return;
-            }
-            memset(&nodes_to_save[i], 0, sizeof(node));
-        }
+    if (node_idx[i].save_needed) {
+        PANM_STATS_INC(save_coalesced);
+    } else {
+        node_idx[i].save_needed = 1;
+        save_queue[(save_head + save_count++) % MYNEWT_VAL(PANMASTER_MAXNUM_NODES)] = i;
+        PANM_STATS_INC(save_marked);
+    }
+    dpl_mutex_release(&save_mutex);
+
+    if (!dpl_callout_is_active(&save_callout)) {
+        dpl_callout_reset(&save_callout, dpl_time_ms_to_ticks32(MYNEWT_VAL(PANMASTER_SAVE_INTERVAL_MS)));
     }
+}
 
+/**
+ * Write up to PANMASTER_NODES_TO_SAVE queued nodes as one storage append.
+ *
+ * @return number of records written, 0 when the queue is empty, <0 on error
+ */
+static int
+save_batch(void)
+{
+    struct panmaster_node batch[MYNEWT_VAL(PANMASTER_NODES_TO_SAVE)];
+    int i, n = 0, rc;
+
+    if (dpl_mutex_pend(&save_mutex, DPL_WAIT_FOREVER) != DPL_OK) {
+        return -1;
+    }
+    while (save_count && n < MYNEWT_VAL(PANMASTER_NODES_TO_SAVE)) {
+        i = save_queue[save_head];
+        save_head = (save_head + 1) % MYNEWT_VAL(PANMASTER_MAXNUM_NODES);
+        save_count--;
+        node_idx[i].save_needed = 0;
+        /* Deleted nodes are written when deleted */
+        if (node_idx[i].addr != 0xffff) {
+            node_record(i, &batch[n++]);
+        }
+    }
     dpl_mutex_release(&save_mutex);
+
+    if (n == 0) {
+        return 0;
+    }
+    rc = storage_save(batch, n);
+    if (rc) {
+        PANM_STATS_INC(save_errors);
+        for (i = 0; i < n; i++) {
+            save_mark(batch[i].index);
+        }
+        return -1;
+    }
+    PANM_STATS_INC(save_appends);
+    PANM_STATS_INCN(save_records, n);
+    return n;
+}
+
+static void
+save_ev_cb(struct dpl_event * ev)
+{
+    /* One append per event, other work on the queue runs in between */
+    if (save_batch() > 0 && save_count) {
+        dpl_callout_reset(&save_callout, 0);
+    }
+}
+
+/**
+ * @fn panmaster_set_save_eventq(struct dpl_eventq *eventq)
+ * @brief Run the write-behind of node records on the given event queue. By
+ * default the records are written from the default event queue.
+ *
+ * @param eventq  Event queue, normally served by a low priority task.
+ *
+ * @return void
+ */
+void
+panmaster_set_save_eventq(struct dpl_eventq *eventq)
+{
+    dpl_callout_stop(&save_callout);
+    dpl_callout_init(&save_callout, eventq, save_ev_cb, NULL);
+    if (save_count) {
+        dpl_callout_reset(&save_callout, 0);
+    }
+}
+
+/**
+ * @fn panmaster_postprocess(void)
+ * @brief Write all queued node records now instead of waiting for the save event.
+ *
+ * @return void
+ */
+void
+panmaster_postprocess(void)
+{
+    while (save_batch() > 0) {
+    }
+}
+
+static void
+slotmap_update(struct uwb_pan_instance * pan)
+{
+#if MYNEWT_VAL(UWB_PAN_SLOTMAP) && MYNEWT_VAL(PANMASTER_SLOTMAP_NSLOTS) > 0
+    if (slotmap_dirty) {
+        /* Too large for the event task stack at a few thousand nodes */
+        static struct panmaster_slot_demand demands[MYNEWT_VAL(PANMASTER_MAXNUM_NODES)];
+        struct pan_slot_grant grants[PAN_SLOTMAP_MAX_GRANTS];
+        uint32_t now_ms = uptime_ms();
+        int i, n = 0;
+
+        slotmap_dirty = false;
+        for (i = 0; i < MYNEWT_VAL(PANMASTER_MAXNUM_NODES); i++) {
+            if (node_idx[i].addr == 0xffff || !node_idx[i].demand || slot_lease_expired(i, now_ms)) {
+                continue;
+            }
+            demands[n].addr = node_idx[i].addr;
+            demands[n].demand = node_idx[i].demand;
+            n++;
+        }
+        n = panmaster_slot_alloc(demands, n, MYNEWT_VAL(PANMASTER_SLOTMAP_FIRST_SLOT),
+                                 MYNEWT_VAL(PANMASTER_SLOTMAP_NSLOTS), grants, PAN_SLOTMAP_MAX_GRANTS);
+        uwb_pan_set_slotmap(pan, grants, n);
+    }
+#endif
 }
 
 void
@@ -204,7 +411,84 @@ postprocess_cb(struct dpl_event * ev)
     if (pan->config->role != UWB_PAN_ROLE_MASTER) {
         return;
     }
-    panmaster_postprocess();
+    slotmap_update(pan);
+}
+
+#if MYNEWT_VAL(UWB_PAN_JOIN_BATCH) && MYNEWT_VAL(PANMASTER_LEASE_RENEW_MS) > 0
+/**
+ * Queue renewals of the leases ending within PANMASTER_LEASE_RENEW_MS in the
+ * next batch response, so these nodes need not request again. A node gets at
+ * most one renewal between requests of its own, nodes that left the pan lose
+ * their slot when the pushed lease ends.
+ */
+static void
+lease_renew(struct uwb_pan_instance * pan, uint32_t now_ms)
+{
+    static uint16_t due[MYNEWT_VAL(PANMASTER_MAXNUM_NODES)];
+    struct pan_req_resp grant = {0};
+    struct panmaster_node_idx *n;
+    int i, ndue;
+    dpl_sr_t sr;
+
+    DPL_ENTER_CRITICAL(sr);
+    ndue = panm_index_lease_due(&pm_index, now_ms, MYNEWT_VAL(PANMASTER_LEASE_RENEW_MS),
+                                due, MYNEWT_VAL(PANMASTER_MAXNUM_NODES));
+    DPL_EXIT_CRITICAL(sr);
+    PANM_STATS_SET(lease_due, ndue);
+
+    for (i = 0; i < ndue; i++) {
+        n = &node_idx[due[i]];
+        if (n->lease_pushed || n->slot_id == 0xffff) {
+            continue;
+        }
+        grant.short_address = n->addr;
+        grant.slot_id = n->slot_id;
+        grant.pan_id = pan_id;
+        grant.lease_time = n->lease_time;
+        if (!uwb_pan_batch_grant(pan, n->euid, &grant)) {
+            PANM_STATS_INCN(lease_renew_full, ndue - i);
+            break;
+        }
+        /* The batch goes out in a later pan slot, allow one tick for it */
+        DPL_ENTER_CRITICAL(sr);
+        n->lease_pushed = 1;
+        panm_index_lease(&pm_index, due[i], now_ms + (uint32_t)n->lease_time*1000 +
+                         (1UL << PANM_INDEX_TICK_SHIFT));
+        DPL_EXIT_CRITICAL(sr);
+        PANM_STATS_INC(lease_renew_push);
+    }
+}
+#endif
+
+/**
+ * Reclaim the slots of expired leases, one tick of the lease wheel at a time,
+ * and push renewals of leases about to end.
+ */
+static void
+lease_ev_cb(struct dpl_event * ev)
+{
+    uint32_t now_ms = uptime_ms();
+    int n;
+    dpl_sr_t sr;
+
+    DPL_ENTER_CRITICAL(sr);
+    n = panm_index_expire(&pm_index, now_ms);
+    DPL_EXIT_CRITICAL(sr);
+    if (n) {
+        PANM_STATS_INCN(lease_expired, n);
+        slotmap_dirty = true;
+    }
+
+#if MYNEWT_VAL(UWB_PAN_ENABLED)
+    if (pm_pan && pm_pan->config->role == UWB_PAN_ROLE_MASTER) {
+#if MYNEWT_VAL(UWB_PAN_JOIN_BATCH) && MYNEWT_VAL(PANMASTER_LEASE_RENEW_MS) > 0
+        lease_renew(pm_pan, now_ms);
+#endif
+        slotmap_update(pm_pan);
+    }
+#endif
+    PANM_STATS_SET(lease_active, pm_index.nleases);
+    dpl_callout_reset(&lease_callout, dpl_time_ms_to_ticks32(1UL << PANM_INDEX_TICK_SHIFT));
 }
 
 void
@@ -232,6 +516,7 @@ panmaster_clear_list()
     {
         PANMASTER_NODE_IDX_DEFAULT(node_idx[i]);
     }
+    panm_index_rebuild(&pm_index);
 #if MYNEWT_VAL(PANMASTER_NFFS)
     return fs_unlink(panmaster_storage_file.pf_name);
 #elif MYNEWT_VAL(PANMASTER_FCB)
@@ -240,108 +525,20 @@ panmaster_clear_list()
     return 0;
 }
 
-static uint16_t
-first_free_short_addr(uint64_t euid)
-{
-    int i, j;
-    uint16_t addr = euid&0xffff;
-    for (i=0;i<MYNEWT_VAL(PANMASTER_MAXNUM_NODES);i++)
-    {
-        if (i>0) {
-            addr = (i<<12) | (euid&0x0fff);
-        }
-
-        for (j=0;j<MYNEWT_VAL(PANMASTER_MAXNUM_NODES);j++)
-        {
-            if (addr == node_idx[j].addr)
-            {
-                addr = 0;
-                break;
-            }
-        }
-
-        if (addr) {
-            return addr;
-        }
-    }
-
-    return addr;
-}
-
-static bool
-short_addr_is_free(uint16_t addr)
-{
-    int j;
-    for (j=0;j<MYNEWT_VAL(PANMASTER_MAXNUM_NODES);j++)
-    {
-        if (addr == node_idx[j].addr)
-        {
-            return false;
-        }
-    }
-    return true;
-}
-
-static bool
-slot_lease_expired(int idx)
+static uint32_t
+uptime_ms(void)
 {
     struct dpl_timeval tv;
     dpl_get_uptime(&tv);
-    int32_t le_ms = node_idx[idx].lease_ends;
-    if (le_ms==0) return false;
-    int32_t now_ms = tv.tv_sec*1000 + tv.tv_usec/1000;
-    return now_ms > le_ms;
-}
-
-static uint16_t
-first_free_slot_id(uint16_t node_addr, uint16_t role)
-{
-    int j;
-    uint16_t slot_id=0;
-    while (slot_id < 0xffff)
-    {
-        for (j=0;j<MYNEWT_VAL(PANMASTER_MAXNUM_NODES);j++)
-        {
-            if (node_idx[j].addr == 0xffff || role != node_idx[j].role) {
-                continue;
-            }
-
-            if (slot_id == node_idx[j].slot_id &&
-                node_addr != node_idx[j].addr &&
-                (slot_lease_expired(j) == false || node_idx[j].has_perm_slot)
-                )
-            {
-                goto next_slot;
-            }
-        }
-
-        return slot_id;
-    next_slot:
-        slot_id++;
-    }
-
-    return 0xffff;
+    return tv.tv_sec*1000 + tv.tv_usec/1000;
 }
 
 static bool
-find_first_empty_nodes_to_save(uint64_t euid, struct panmaster_node **results)
+slot_lease_expired(int idx, uint32_t now_ms)
 {
-    int i, slots;
-    if (dpl_mutex_pend(&save_mutex, 0) != DPL_OK) {
-        return false;
-    }
-    slots = sizeof(nodes_to_save)/sizeof(nodes_to_save[0]);
-    for (i=0;i < slots;i++) {
-        if (!nodes_to_save[i].euid) {
-            nodes_to_save[i].euid = euid;
-            *results = &nodes_to_save[i];
-            break;
-        }
-    }
-
-    dpl_mutex_release(&save_mutex);
-    /* If i == slots then we failed to find a free slot */
-    return (i!=slots) ? true : false;
+    int32_t le_ms = node_idx[idx].lease_ends;
+    if (le_ms==0) return false;
+    return (int32_t)(now_ms - le_ms) > 0;
 }
 
 int
@@ -349,72 +546,40 @@ panmaster_idx_find_node(uint64_t euid, uint16_t role, struct panmaster_node **re
 {
     int i;
     struct dpl_timeval utctime;
-    struct panmaster_node *node;
-    bool node_is_found = false;
-
-    if (!find_first_empty_nodes_to_save(euid, &node)) {
-        return 1;
-    }
 
     /* Look for an existing node */
-    for (i=0;i<MYNEWT_VAL(PANMASTER_MAXNUM_NODES);i++) {
-        if (node_idx[i].addr == 0xffff) {
-            continue;
+    i = panm_index_find_euid(&pm_index, euid);
+    if (i >= 0) {
+        /* Only check role if given, slot ids are allocated per role */
+        if (node_idx[i].role != role && role > 0) {
+            panm_index_set_role(&pm_index, i, role);
+            save_mark(i);
         }
-        if (euid == node_idx[i].euid) {
-            node_is_found = true;
-            node->index = i;
-            break;
+        if (!node_idx[i].has_perm_slot) {
+            panm_index_slot_alloc(&pm_index, i, uptime_ms());
         }
-    }
-
-    if (node_is_found) {
-        *results = node;
-
-        node->addr = node_idx[i].addr;
-        node->euid = node_idx[i].euid;
-        node->role = node_idx[i].role;
-        node->has_perm_slot = node_idx[i].has_perm_slot;
-        node->slot_id = node_idx[node->index].slot_id;
-        if (!node->has_perm_slot) {
-            node->slot_id = first_free_slot_id(node->addr, role);
-            node_idx[node->index].slot_id = node->slot_id;
+    } else {
+        /* This node is unknown, find a free spot for it */
+        i = panm_index_alloc(&pm_index);
+        if (i < 0) {
+            return 0;
         }
-
-        /* Only check role if given */
-        if (node->role != role && role > 0) {
-            node->role = role;
-            node_idx[i].save_needed = 1;
-        }
-        return 0;
-    }
-
-    /* This node is unknown, find a free spot for it */
-    for (i=0;i<MYNEWT_VAL(PANMASTER_MAXNUM_NODES);i++)
-    {
-        if (node_idx[i].addr != 0xffff) {
-            continue;
-        }
-
-        PANMASTER_NODE_DEFAULT(*node);
         dpl_gettimeofday(&utctime, 0);
-        node->euid = euid;
-        node->addr = first_free_short_addr(euid);
-        node_idx[i].addr = node->addr;
-        node_idx[i].euid = node->euid;
+        node_idx[i].euid = euid;
+        node_idx[i].addr = panm_index_free_addr(&pm_index, euid);
         node_idx[i].role = role;
-        node->role = role;
         /* New-node, default is non-permanent slot */
-        node->slot_id = first_free_slot_id(node->addr, role);
-        node_idx[i].slot_id = node->slot_id;
-        node->first_seen_utc = utctime.tv_sec;
-        node->index = i;
-
-        *results = node;
-        node_idx[i].save_needed = 1;
-        break;
+        node_idx[i].has_perm_slot = 0;
+        node_idx[i].slot_id = 0xffff;
+        node_idx[i].first_seen_utc = utctime.tv_sec;
+        memset(&node_idx[i].fw_ver, 0, sizeof(node_idx[i].fw_ver));
+        panm_index_insert(&pm_index, i);
+        panm_index_slot_alloc(&pm_index, i, uptime_ms());
+        save_mark(i);
     }
 
+    *results = &find_results[find_next++ % PANM_FIND_RESULTS];
+    node_record(i, *results);
     return 0;
 }
 
@@ -431,28 +596,14 @@ panmaster_load(panm_load_cb cb, void *cb_arg)
 void
 panmaster_add_version(uint64_t euid, struct pan_image_version *ver)
 {
-    struct panmaster_node node;
-    struct find_node_s fns = { .results = &node };
-
-    PANMASTER_NODE_DEFAULT(fns.find);
-    fns.find.euid = euid;
-    panmaster_find_node_general(&fns);
+    int i = panm_index_find_euid(&pm_index, euid);
 
-    if (fns.is_found)
-    {
-        if (ver->iv_major     == node.fw_ver.iv_major &&
-            ver->iv_minor     == node.fw_ver.iv_minor &&
-            ver->iv_revision  == node.fw_ver.iv_revision &&
-            ver->iv_build_num == node.fw_ver.iv_build_num) {
-            return;
-        }
-
-        memcpy(&node.fw_ver, ver, sizeof(*ver));
-        panmaster_save_node(&node);
+    /* Node not found or version unchanged, just return */
+    if (i < 0 || !memcmp(&node_idx[i].fw_ver, ver, sizeof(*ver))) {
         return;
     }
-    /* Node not found, just return */
-    return;
+    memcpy(&node_idx[i].fw_ver, ver, sizeof(*ver));
+    save_mark(i);
 }
 
 void
@@ -536,26 +687,23 @@ panmaster_add_node(uint16_t short_addr, uint16_t role, uint8_t *euid_u8)
     PANMASTER_NODE_DEFAULT(node);
 
     /* This node is unknown, find a free spot for it */
-    for (i=0;i<MYNEWT_VAL(PANMASTER_MAXNUM_NODES);i++)
-    {
-        if (node_idx[i].addr != 0xffff) {
-            continue;
-        }
-
+    i = panm_index_alloc(&pm_index);
+    if (i >= 0) {
         dpl_gettimeofday(&utctime, 0);
         node.euid = euid;
 
-        if (!short_addr_is_free(short_addr)) {
+        if (panm_index_find_addr(&pm_index, short_addr) >= 0) {
             PM_ERR("Dupl short addr %x\n", short_addr);
         }
         node.addr = short_addr;
         node_idx[i].addr = node.addr;
+        node_idx[i].euid = node.euid;
+        panm_index_insert(&pm_index, i);
         node.first_seen_utc = utctime.tv_sec;
         node.index = i;
 
         panmaster_save_node(&node);
         PM_DEBUG("panm: node added\n");
-        return;
     }
 
     return;
@@ -584,13 +732,15 @@ panmaster_delete_node(uint64_t euid)
         return;
     }
 
+    panm_index_remove(&pm_index, node.index);
     node.addr = 0xFFFF;
     node_idx[node.index].addr = 0xFFFF;
     node_idx[node.index].euid = 0xFFFFFFFFFFFFFFFFULL;
     node_idx[node.index].slot_id = 0xFFFF;
     node_idx[node.index].has_perm_slot = 0;
 
-    panmaster_save_node(&node);
+    /* Written now, the entry may be reused before the next batch */
+    storage_save(&node, 1);
     PM_DEBUG("panmaster_delete_node: node deleted\n");
 
     return;
@@ -599,15 +749,24 @@ panmaster_delete_node(uint64_t euid)
 int
 panmaster_save_node(struct panmaster_node *node)
 {
-    /* Make sure index is up to date */
-    node_idx[node->index].role = node->role;
-    node_idx[node->index].has_perm_slot = node->has_perm_slot;
+    int i = node->index;
 
-#if MYNEWT_VAL(PANMASTER_NFFS)
-    return panm_file_save(&panmaster_storage_file, node);
-#elif MYNEWT_VAL(PANMASTER_FCB)
-    return panm_fcb_save(&pm_init_conf_fcb, node);
-#endif
+    if (i >= MYNEWT_VAL(PANMASTER_MAXNUM_NODES)) {
+        return DPL_EINVAL;
+    }
+
+    /* Make sure index is up to date, it is what gets written */
+    panm_index_set_role(&pm_index, i, node->role);
+    node_idx[i].has_perm_slot = node->has_perm_slot;
+    if (node->has_perm_slot && node->slot_id != node_idx[i].slot_id) {
+        panm_index_slot_claim(&pm_index, i, node->slot_id);
+    }
+    if (node->first_seen_utc) {
+        node_idx[i].first_seen_utc = node->first_seen_utc;
+    }
+    memcpy(&node_idx[i].fw_ver, &node->fw_ver, sizeof(node->fw_ver));
+    save_mark(i);
+    return 0;
 }
 
 uint16_t
@@ -647,6 +806,7 @@ panmaster_sort()
 #elif MYNEWT_VAL(PANMASTER_FCB)
     panm_fcb_sort(&pm_init_conf_fcb);
     panm_fcb_load_idx(&pm_init_conf_fcb, node_idx);
+    panm_index_rebuild(&pm_index);
 #endif
 }
 
@@ -669,9 +829,21 @@ panmaster_pkg_init(void)
     for (i=0;i<MYNEWT_VAL(PANMASTER_MAXNUM_NODES);i++) {
         PANMASTER_NODE_IDX_DEFAULT(node_idx[i]);
     }
+    panm_index_init(&pm_index, node_idx, MYNEWT_VAL(PANMASTER_MAXNUM_NODES), pm_index_buf16, pm_index_buf32);
     rc = dpl_mutex_init(&save_mutex);
     assert(rc == DPL_OK);
-    memset(&nodes_to_save, 0, sizeof(nodes_to_save));
+    dpl_callout_init(&save_callout, dpl_eventq_dflt_get(), save_ev_cb, NULL);
+    dpl_callout_init(&lease_callout, dpl_eventq_dflt_get(), lease_ev_cb, NULL);
+
+#if MYNEWT_VAL(PANMASTER_STATS)
+    rc = stats_init(
+        STATS_HDR(g_panm_stat),
+        STATS_SIZE_INIT_PARMS(g_panm_stat, STATS_SIZE_32),
+        STATS_NAME_INIT_PARMS(panm_stat_section)
+    );
+    rc |= stats_register("panm", STATS_HDR(g_panm_stat));
+    assert(rc == DPL_OK);
+#endif
 
 #if MYNEWT_VAL(UWB_PAN_ENABLED)
 
@@ -680,6 +852,7 @@ panmaster_pkg_init(void)
     assert(pan);
     uwb_pan_set_postprocess(pan, postprocess_cb);
     uwb_pan_set_request_cb(pan, panrequest_cb);
+    pm_pan = pan;
 #endif
 
 #endif
@@ -705,4 +878,6 @@ panmaster_pkg_init(void)
 #endif
     panm_fcb_load_idx(&pm_init_conf_fcb, node_idx);
 #endif
+    panm_index_rebuild(&pm_index);
+    dpl_callout_reset(&lease_callout, dpl_time_ms_to_ticks32(1UL << PANM_INDEX_TICK_SHIFT));
 }
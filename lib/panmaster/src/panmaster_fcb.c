@@ -24,6 +24,7 @@
 #include <fcb/fcb.h>
 #include <string.h>
 #include <stdio.h>
+#include <stddef.h>
 
 #include "panmaster/panmaster.h"
 #include "panmaster/panmaster_fcb.h"
@@ -66,27 +67,46 @@ panm_fcb_src(struct panm_fcb *pm)
 }
 
 
+/**
+ * Number of node records in an entry. Entries hold one or more records,
+ * entries from before fw_ver was added hold one record without it.
+ */
+static int
+entry_records(struct fcb_entry *loc, int *reclen)
+{
+    if (loc->fe_data_len == sizeof(struct panmaster_node) - sizeof(struct pan_image_version)) {
+        *reclen = loc->fe_data_len;
+        return 1;
+    }
+    if (loc->fe_data_len == 0 || loc->fe_data_len % sizeof(struct panmaster_node)) {
+        return 0;
+    }
+    *reclen = sizeof(struct panmaster_node);
+    return loc->fe_data_len / sizeof(struct panmaster_node);
+}
+
 static int
 fcb_load_cb(struct fcb_entry *loc, void *arg)
 {
     struct panm_fcb_load_cb_arg *argp;
     struct panmaster_node tmpnode;
-    int rc;
-    memset(&tmpnode,0,sizeof(struct panmaster_node));
+    int rc, i, n, reclen;
 
     argp = (struct panm_fcb_load_cb_arg *)arg;
 
-    if (loc->fe_data_len != sizeof(struct panmaster_node) &&
-        loc->fe_data_len != sizeof(struct panmaster_node) - sizeof(struct pan_image_version)) {
+    n = entry_records(loc, &reclen);
+    if (n == 0) {
         return 1;
     }
 
-    rc = flash_area_read(loc->fe_area, loc->fe_data_off, &tmpnode, loc->fe_data_len);
-    if (rc) {
-        return 0;
+    for (i = 0; i < n; i++) {
+        memset(&tmpnode, 0, sizeof(struct panmaster_node));
+        rc = flash_area_read(loc->fe_area, loc->fe_data_off + i * reclen, &tmpnode, reclen);
+        if (rc) {
+            return 0;
+        }
+        argp->cb(&tmpnode, argp->cb_arg);
     }
-
-    argp->cb(&tmpnode, argp->cb_arg);
     return 0;
 }
 
@@ -110,11 +130,13 @@ node_idx_load_cb(struct panmaster_node *node, void *cb_arg)
 {
     struct panmaster_node_idx *nodes = (struct panmaster_node_idx*)cb_arg;
 
-    if (node->index <= MYNEWT_VAL(PANMASTER_MAXNUM_NODES)) {
+    if (node->index < MYNEWT_VAL(PANMASTER_MAXNUM_NODES)) {
         nodes[node->index].addr = node->addr;
         nodes[node->index].euid = node->euid;
         nodes[node->index].role = node->role;
         nodes[node->index].has_perm_slot = node->has_perm_slot;
+        nodes[node->index].first_seen_utc = node->first_seen_utc;
+        memcpy(&nodes[node->index].fw_ver, &node->fw_ver, sizeof(node->fw_ver));
         if (node->has_perm_slot) {
             nodes[node->index].slot_id = node->slot_id;
             nodes[node->index].lease_ends = 0;
@@ -149,15 +171,21 @@ panm_fcb_find_node(struct panm_fcb *pf, struct find_node_s *fns)
 }
 
 
+/**
+ * Frees the oldest sector. Records in it not superseded by a later record of
+ * the same euid are copied forward, up to PANMASTER_NODES_TO_SAVE records per
+ * appended entry, with one walk over the later entries for each such group.
+ */
 void
 panm_fcb_compress(struct panm_fcb *pm)
 {
-    int rc;
-    struct panmaster_node buf1;
-    struct panmaster_node buf2;
+    struct panmaster_node batch[MYNEWT_VAL(PANMASTER_NODES_TO_SAVE)];
+    bool keep[MYNEWT_VAL(PANMASTER_NODES_TO_SAVE)];
     struct fcb_entry loc1;
     struct fcb_entry loc2;
-    int copy;
+    uint64_t euid;
+    int rc, i, j, n, first, live;
+    int nrec, reclen, nrec2, reclen2;
 
     rc = fcb_append_to_scratch(&pm->pm_fcb);
     if (rc) {
@@ -170,55 +198,68 @@ panm_fcb_compress(struct panm_fcb *pm)
         if (loc1.fe_area != pm->pm_fcb.f_oldest) {
             break;
         }
-        rc = flash_area_read(loc1.fe_area, loc1.fe_data_off, &buf1,
-                             loc1.fe_data_len);
-        if (rc) {
-            continue;
-        }
-        loc2 = loc1;
-        copy = 1;
-        while (fcb_getnext(&pm->pm_fcb, &loc2) == 0) {
-            if (loc2.fe_area == pm->pm_fcb.f_oldest) {
+        nrec = entry_records(&loc1, &reclen);
+        for (first = 0; first < nrec; first += n) {
+            n = nrec - first;
+            if (n > MYNEWT_VAL(PANMASTER_NODES_TO_SAVE)) {
+                n = MYNEWT_VAL(PANMASTER_NODES_TO_SAVE);
+            }
+            live = 0;
+            for (i = 0; i < n; i++) {
+                memset(&batch[i], 0, sizeof(struct panmaster_node));
+                rc = flash_area_read(loc1.fe_area, loc1.fe_data_off + (first + i) * reclen,
+                                     &batch[i], reclen);
+                keep[i] = (rc == 0);
+                live += keep[i];
+            }
+
+            /* Drop records written again later, only the euid is needed */
+            loc2 = loc1;
+            while (live && fcb_getnext(&pm->pm_fcb, &loc2) == 0) {
+                nrec2 = entry_records(&loc2, &reclen2);
+                for (j = 0; j < nrec2 && live; j++) {
+                    rc = flash_area_read(loc2.fe_area, loc2.fe_data_off + j * reclen2 +
+                                         offsetof(struct panmaster_node, euid), &euid, sizeof(euid));
+                    if (rc) {
+                        continue;
+                    }
+                    for (i = 0; i < n; i++) {
+                        if (keep[i] && batch[i].euid == euid) {
+                            keep[i] = false;
+                            live--;
+                        }
+                    }
+                }
+            }
+            if (!live) {
                 continue;
             }
-            rc = flash_area_read(loc2.fe_area, loc2.fe_data_off, &buf2,
-                                 loc2.fe_data_len);
+
+            /* Must copy the rest */
+            for (i = 0, j = 0; i < n; i++) {
+                if (keep[i]) {
+                    batch[j++] = batch[i];
+                }
+            }
+            rc = fcb_append(&pm->pm_fcb, j * sizeof(struct panmaster_node), &loc2);
             if (rc) {
                 continue;
             }
-            if (buf1.euid == buf2.euid) {
-                copy = 0;
-                break;
+            rc = flash_area_write(loc2.fe_area, loc2.fe_data_off, batch,
+                                  j * sizeof(struct panmaster_node));
+            if (rc) {
+                continue;
             }
+            fcb_append_finish(&pm->pm_fcb, &loc2);
+            PANM_STATS_INCN(compress_records, j);
         }
-        if (!copy) {
-            continue;
-        }
-
-        /*
-         * Can't find one. Must copy.
-         */
-        rc = flash_area_read(loc1.fe_area, loc1.fe_data_off, &buf1,
-                             loc1.fe_data_len);
-        if (rc) {
-            continue;
-        }
-        rc = fcb_append(&pm->pm_fcb, sizeof(struct panmaster_node), &loc2);
-        if (rc) {
-            continue;
-        }
-        rc = flash_area_write(loc2.fe_area, loc2.fe_data_off, &buf1,
-                              sizeof(struct panmaster_node));
-        if (rc) {
-            continue;
-        }
-        fcb_append_finish(&pm->pm_fcb, &loc2);
     }
     rc = fcb_rotate(&pm->pm_fcb);
     if (rc) {
         /* XXXX */
         ;
     }
+    PANM_STATS_INC(compress);
 }
 
 static int
@@ -249,11 +290,18 @@ panm_fcb_append(struct panm_fcb *pm, uint8_t *buf, int len)
 int
 panm_fcb_save(struct panm_fcb *pm, struct panmaster_node *node)
 {
-    if (!node) {
+    return panm_fcb_save_batch(pm, node, 1);
+}
+
+/* Writes n records as one entry */
+int
+panm_fcb_save_batch(struct panm_fcb *pm, struct panmaster_node *nodes, int n)
+{
+    if (!nodes || n <= 0) {
         return OS_INVALID_PARM;
     }
 
-    return panm_fcb_append(pm, (uint8_t*)node, sizeof(struct panmaster_node));
+    return panm_fcb_append(pm, (uint8_t*)nodes, n * sizeof(struct panmaster_node));
 }
 
 int
@@ -203,9 +203,14 @@ node_idx_load_cb(struct panmaster_node *node, void *cb_arg)
 {
     struct panmaster_node_idx *nodes = (struct panmaster_node_idx*)cb_arg;
 
-    if (node->index <= MYNEWT_VAL(PANMASTER_MAXNUM_NODES) &&
+    if (node->index < MYNEWT_VAL(PANMASTER_MAXNUM_NODES) &&
         node->addr != 0xffff) {
         nodes[node->index].addr = node->addr;
+        nodes[node->index].euid = node->euid;
+        nodes[node->index].role = node->role;
+        nodes[node->index].has_perm_slot = node->has_perm_slot;
+        nodes[node->index].first_seen_utc = node->first_seen_utc;
+        memcpy(&nodes[node->index].fw_ver, &node->fw_ver, sizeof(node->fw_ver));
     }
 }
 
@@ -238,31 +243,38 @@ panm_file_find_node(struct panm_file *pf, struct find_node_s *fns)
 
 int
 panm_file_save(struct panm_file *pf, struct panmaster_node *node)
+{
+    return panm_file_save_batch(pf, node, 1);
+}
+
+/* Appends n node lines with the file opened once */
+int
+panm_file_save_batch(struct panm_file *pf, struct panmaster_node *nodes, int n)
 {
     struct fs_file *file;
     char buf[PANM_MAX_ROW_LEN+32];
     int len;
-    int rc;
+    int rc = 0;
+    int i;
 
-    if (!node) {
+    if (!nodes || n <= 0) {
         return OS_INVALID_PARM;
     }
 
-    len = panm_line_make(buf, sizeof(buf), node);
-    if (len < 0 || len + 2 > sizeof(buf)) {
-        return OS_INVALID_PARM;
-    }
-    buf[len++] = '\n';
-    /*
-     * Open the file to add this one value.
-     */
     if (fs_open(pf->pf_name, FS_ACCESS_WRITE | FS_ACCESS_APPEND, &file)) {
         return OS_EINVAL;
     }
-    if (fs_write(file, buf, len)) {
-        rc = OS_EINVAL;
-    } else {
-        rc = 0;
+    for (i = 0; i < n; i++) {
+        len = panm_line_make(buf, sizeof(buf), &nodes[i]);
+        if (len < 0 || len + 2 > sizeof(buf)) {
+            rc = OS_INVALID_PARM;
+            break;
+        }
+        buf[len++] = '\n';
+        if (fs_write(file, buf, len)) {
+            rc = OS_EINVAL;
+            break;
+        }
         pf->pf_lines++;
     }
     fs_close(file);
@@ -0,0 +1,552 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file panmaster_index.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Constant time lookups for the panmaster node table
+ *
+ * @details Node lookups by euid and short address go through open addressed
+ * hashes with linear probing, removal uses backward shift so no tombstones
+ * build up. Taken slot ids are kept as one bitmap per role, the first free slot
+ * is the first clear bit at or after a per role hint. Leases are kept in a
+ * hashed timing wheel, one bucket per tick of lease_ends, so expiry only walks
+ * the buckets of the ticks passed since the last call and expired slots are
+ * returned to the bitmap without scanning the table. Leases more than one turn
+ * of the wheel away are skipped until their turn. All storage is provided by
+ * the caller.
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "panmaster/panmaster.h"
+#include "panmaster/panmaster_index.h"
+
+#define NONE    PANM_INDEX_NONE
+
+static inline uint16_t
+euid_home(const struct panm_index *idx, uint64_t euid)
+{
+    uint32_t h = (uint32_t)(euid ^ (euid >> 32)) * 0x9E3779B1u;
+    return (h ^ (h >> 16)) % idx->nbuckets;
+}
+
+static inline uint16_t
+addr_home(const struct panm_index *idx, uint16_t addr)
+{
+    uint32_t h = addr * 0x9E3779B1u;
+    return (h >> 16) % idx->nbuckets;
+}
+
+static inline uint16_t
+home(const struct panm_index *idx, const uint16_t *hash, uint16_t i)
+{
+    return (hash == idx->euid_hash) ? euid_home(idx, idx->nodes[i].euid) : addr_home(idx, idx->nodes[i].addr);
+}
+
+static void
+hash_insert(struct panm_index *idx, uint16_t *hash, uint16_t i)
+{
+    uint16_t b = home(idx, hash, i);
+    while (hash[b] != NONE) {
+        b = (b + 1) % idx->nbuckets;
+    }
+    hash[b] = i;
+}
+
+static void
+hash_delete(struct panm_index *idx, uint16_t *hash, uint16_t i)
+{
+    uint16_t b = home(idx, hash, i), j, k;
+
+    while (hash[b] != i) {
+        if (hash[b] == NONE) {
+            return;
+        }
+        b = (b + 1) % idx->nbuckets;
+    }
+
+    /* Move later entries of the probe sequence into the hole */
+    hash[b] = NONE;
+    for (j = (b + 1) % idx->nbuckets; hash[j] != NONE; j = (j + 1) % idx->nbuckets) {
+        k = home(idx, hash, hash[j]);
+        if ((b <= j) ? (b < k && k <= j) : (b < k || k <= j)) {
+            continue;
+        }
+        hash[b] = hash[j];
+        hash[j] = NONE;
+        b = j;
+    }
+}
+
+#define LEASE_HEAD      (0x8000)
+#define TICK_MASK       ((1UL << PANM_INDEX_TICK_SHIFT) - 1)
+
+static inline uint16_t
+lease_bucket(uint32_t ms)
+{
+    return (ms >> PANM_INDEX_TICK_SHIFT) % PANM_INDEX_WHEEL;
+}
+
+static void
+lease_unlink(struct panm_index *idx, uint16_t i)
+{
+    uint16_t prev = idx->lease_prev[i], next = idx->lease_next[i];
+
+    if (prev == NONE) {
+        return;
+    }
+    if (prev & LEASE_HEAD) {
+        idx->wheel[prev & ~LEASE_HEAD] = next;
+    } else {
+        idx->lease_next[prev] = next;
+    }
+    if (next != NONE) {
+        idx->lease_prev[next] = prev;
+    }
+    idx->lease_prev[i] = NONE;
+    idx->nleases--;
+}
+
+/* Leases already due go in the bucket walked next */
+static void
+lease_link(struct panm_index *idx, uint16_t i)
+{
+    uint32_t ends = idx->nodes[i].lease_ends;
+    uint16_t b;
+
+    b = lease_bucket(((int32_t)(ends - idx->wheel_ms) < 0) ? idx->wheel_ms : ends);
+    idx->lease_next[i] = idx->wheel[b];
+    idx->lease_prev[i] = LEASE_HEAD | b;
+    if (idx->wheel[b] != NONE) {
+        idx->lease_prev[idx->wheel[b]] = i;
+    }
+    idx->wheel[b] = i;
+    idx->nleases++;
+}
+
+static inline void
+slot_set(struct panm_index *idx, uint8_t role, uint16_t slot_id)
+{
+    if (slot_id < idx->nwords * 32) {
+        idx->slots[role * idx->nwords + slot_id / 32] |= 1UL << (slot_id % 32);
+    }
+}
+
+/**
+ * @fn panm_index_init(struct panm_index *idx, struct panmaster_node_idx *nodes, uint16_t nnodes,
+ *     uint16_t *buf16, uint32_t *buf32)
+ * @brief Attach an index to a node table and build it from the current content.
+ *
+ * @param idx     Index to initialise.
+ * @param nodes   Node table.
+ * @param nnodes  Entries in the node table.
+ * @param buf16   Storage of PANM_INDEX_U16(nnodes) entries.
+ * @param buf32   Storage of PANM_INDEX_U32(nnodes) entries.
+ *
+ * @return void
+ */
+void
+panm_index_init(struct panm_index *idx, struct panmaster_node_idx *nodes, uint16_t nnodes,
+                uint16_t *buf16, uint32_t *buf32)
+{
+    idx->nodes = nodes;
+    idx->nnodes = nnodes;
+    idx->nbuckets = PANM_INDEX_BUCKETS(nnodes);
+    idx->nwords = PANM_INDEX_WORDS(nnodes);
+    idx->euid_hash = buf16;
+    idx->addr_hash = idx->euid_hash + idx->nbuckets;
+    idx->wheel = idx->addr_hash + idx->nbuckets;
+    idx->lease_next = idx->wheel + PANM_INDEX_WHEEL;
+    idx->lease_prev = idx->lease_next + nnodes;
+    idx->free = idx->lease_prev + nnodes;
+    idx->slots = buf32;
+    idx->wheel_ms = 0;
+    panm_index_rebuild(idx);
+}
+
+/**
+ * @fn panm_index_rebuild(struct panm_index *idx)
+ * @brief Rebuild the index after the node table was changed behind its back,
+ * such as after loading it from storage.
+ *
+ * @param idx     Index.
+ *
+ * @return void
+ */
+void
+panm_index_rebuild(struct panm_index *idx)
+{
+    int i;
+
+    memset(idx->euid_hash, 0xff, 2 * idx->nbuckets * sizeof(uint16_t));
+    memset(idx->wheel, 0xff, PANM_INDEX_WHEEL * sizeof(uint16_t));
+    memset(idx->lease_prev, 0xff, idx->nnodes * sizeof(uint16_t));
+    memset(idx->slots, 0, PANM_INDEX_NROLES * idx->nwords * sizeof(uint32_t));
+    memset(idx->free_word, 0, sizeof(idx->free_word));
+    idx->nleases = 0;
+    idx->nfree = 0;
+
+    for (i = idx->nnodes - 1; i >= 0; i--) {
+        struct panmaster_node_idx *n = &idx->nodes[i];
+        if (n->addr == 0xffff) {
+            idx->free[idx->nfree++] = i;
+            continue;
+        }
+        hash_insert(idx, idx->euid_hash, i);
+        hash_insert(idx, idx->addr_hash, i);
+        slot_set(idx, n->role & 0xf, n->slot_id);
+        if (n->lease_ends) {
+            lease_link(idx, i);
+        }
+    }
+}
+
+/**
+ * @fn panm_index_find_euid(struct panm_index *idx, uint64_t euid)
+ * @brief Find the table entry of a node by euid.
+ *
+ * @param idx     Index.
+ * @param euid    Unique id of the node.
+ *
+ * @return table index, -1 if not found
+ */
+int
+panm_index_find_euid(struct panm_index *idx, uint64_t euid)
+{
+    uint16_t b = euid_home(idx, euid);
+
+    for (; idx->euid_hash[b] != NONE; b = (b + 1) % idx->nbuckets) {
+        if (idx->nodes[idx->euid_hash[b]].euid == euid) {
+            return idx->euid_hash[b];
+        }
+    }
+    return -1;
+}
+
+/**
+ * @fn panm_index_find_addr(struct panm_index *idx, uint16_t addr)
+ * @brief Find the table entry of a node by short address.
+ *
+ * @param idx     Index.
+ * @param addr    Short address of the node.
+ *
+ * @return table index, -1 if not found
+ */
+int
+panm_index_find_addr(struct panm_index *idx, uint16_t addr)
+{
+    uint16_t b = addr_home(idx, addr);
+
+    for (; idx->addr_hash[b] != NONE; b = (b + 1) % idx->nbuckets) {
+        if (idx->nodes[idx->addr_hash[b]].addr == addr) {
+            return idx->addr_hash[b];
+        }
+    }
+    return -1;
+}
+
+/**
+ * @fn panm_index_alloc(struct panm_index *idx)
+ * @brief Take an unused table entry. The caller fills in addr and euid and
+ * then calls panm_index_insert().
+ *
+ * @param idx     Index.
+ *
+ * @return table index, -1 if the table is full
+ */
+int
+panm_index_alloc(struct panm_index *idx)
+{
+    return (idx->nfree) ? idx->free[--idx->nfree] : -1;
+}
+
+/**
+ * @fn panm_index_insert(struct panm_index *idx, int i)
+ * @brief Make the euid and short address of table entry i searchable.
+ *
+ * @param idx     Index.
+ * @param i       Table index from panm_index_alloc().
+ *
+ * @return void
+ */
+void
+panm_index_insert(struct panm_index *idx, int i)
+{
+    hash_insert(idx, idx->euid_hash, i);
+    hash_insert(idx, idx->addr_hash, i);
+}
+
+/**
+ * @fn panm_index_remove(struct panm_index *idx, int i)
+ * @brief Drop table entry i from the index and release its slot and lease.
+ * Must be called before the euid or address of the entry is changed.
+ *
+ * @param idx     Index.
+ * @param i       Table index.
+ *
+ * @return void
+ */
+void
+panm_index_remove(struct panm_index *idx, int i)
+{
+    hash_delete(idx, idx->euid_hash, i);
+    hash_delete(idx, idx->addr_hash, i);
+    lease_unlink(idx, i);
+    panm_index_slot_release(idx, i);
+    idx->nodes[i].lease_ends = 0;
+    idx->free[idx->nfree++] = i;
+}
+
+/**
+ * @fn panm_index_free_addr(struct panm_index *idx, uint64_t euid)
+ * @brief Pick an unused short address for a node. The low 16 bits of the euid
+ * are tried first, then the low 12 bits with each possible top nibble, and
+ * finally the addresses following the low 16 bits.
+ *
+ * @param idx     Index.
+ * @param euid    Unique id of the node.
+ *
+ * @return short address
+ */
+uint16_t
+panm_index_free_addr(struct panm_index *idx, uint64_t euid)
+{
+    uint16_t addr = euid & 0xffff;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        if (i > 0) {
+            addr = (i << 12) | (euid & 0x0fff);
+        }
+        if (addr != 0 && addr != 0xffff && panm_index_find_addr(idx, addr) < 0) {
+            return addr;
+        }
+    }
+    /* At most nnodes addresses are taken */
+    for (addr = (euid & 0xffff) + 1; ; addr++) {
+        if (addr != 0 && addr != 0xffff && panm_index_find_addr(idx, addr) < 0) {
+            return addr;
+        }
+    }
+}
+
+/**
+ * @fn panm_index_slot_alloc(struct panm_index *idx, int i, uint32_t now_ms)
+ * @brief Give table entry i the lowest slot id not taken by another node of
+ * the same role. Expired leases are returned first, the slot held by the node
+ * itself counts as free.
+ *
+ * @param idx     Index.
+ * @param i       Table index.
+ * @param now_ms  Uptime in ms.
+ *
+ * @return slot id, also stored in the table entry
+ */
+uint16_t
+panm_index_slot_alloc(struct panm_index *idx, int i, uint32_t now_ms)
+{
+    uint8_t role = idx->nodes[i].role & 0xf;
+    uint32_t *map = &idx->slots[role * idx->nwords];
+    uint16_t w;
+
+    panm_index_expire(idx, now_ms);
+    panm_index_slot_release(idx, i);
+
+    for (w = idx->free_word[role]; w < idx->nwords; w++) {
+        if (map[w] != 0xffffffffUL) {
+            break;
+        }
+    }
+    idx->free_word[role] = w;
+    if (w == idx->nwords) {
+        return NONE;
+    }
+    idx->nodes[i].slot_id = w * 32 + __builtin_ctzl(~map[w]);
+    map[w] |= 1UL << (idx->nodes[i].slot_id % 32);
+    return idx->nodes[i].slot_id;
+}
+
+/**
+ * @fn panm_index_slot_release(struct panm_index *idx, int i)
+ * @brief Return the slot of table entry i to its role.
+ *
+ * @param idx     Index.
+ * @param i       Table index.
+ *
+ * @return void
+ */
+void
+panm_index_slot_release(struct panm_index *idx, int i)
+{
+    uint16_t slot_id = idx->nodes[i].slot_id;
+    uint8_t role = idx->nodes[i].role & 0xf;
+
+    if (slot_id < idx->nwords * 32) {
+        idx->slots[role * idx->nwords + slot_id / 32] &= ~(1UL << (slot_id % 32));
+        if (slot_id / 32 < idx->free_word[role]) {
+            idx->free_word[role] = slot_id / 32;
+        }
+    }
+    idx->nodes[i].slot_id = NONE;
+}
+
+/**
+ * @fn panm_index_slot_claim(struct panm_index *idx, int i, uint16_t slot_id)
+ * @brief Give table entry i a chosen slot id, such as a permanent slot set by
+ * the operator. The slot is taken even if another node of the role holds it.
+ *
+ * @param idx     Index.
+ * @param i       Table index.
+ * @param slot_id Slot id.
+ *
+ * @return void
+ */
+void
+panm_index_slot_claim(struct panm_index *idx, int i, uint16_t slot_id)
+{
+    panm_index_slot_release(idx, i);
+    idx->nodes[i].slot_id = slot_id;
+    slot_set(idx, idx->nodes[i].role & 0xf, slot_id);
+}
+
+/**
+ * @fn panm_index_set_role(struct panm_index *idx, int i, uint8_t role)
+ * @brief Change the role of table entry i. Slot ids are per role, so the slot
+ * held under the old role is released.
+ *
+ * @param idx     Index.
+ * @param i       Table index.
+ * @param role    New role.
+ *
+ * @return void
+ */
+void
+panm_index_set_role(struct panm_index *idx, int i, uint8_t role)
+{
+    if (idx->nodes[i].role == role) {
+        return;
+    }
+    panm_index_slot_release(idx, i);
+    idx->nodes[i].role = role;
+}
+
+/**
+ * @fn panm_index_lease(struct panm_index *idx, int i, uint32_t lease_ends)
+ * @brief Set or renew the lease of table entry i.
+ *
+ * @param idx         Index.
+ * @param i           Table index.
+ * @param lease_ends  Uptime in ms when the lease ends, 0 for no lease.
+ *
+ * @return void
+ */
+void
+panm_index_lease(struct panm_index *idx, int i, uint32_t lease_ends)
+{
+    lease_unlink(idx, i);
+    idx->nodes[i].lease_ends = lease_ends;
+    if (lease_ends) {
+        lease_link(idx, i);
+    }
+}
+
+/**
+ * @fn panm_index_expire(struct panm_index *idx, uint32_t now_ms)
+ * @brief Release the slots of all leases that ended before now_ms. Nodes with
+ * a permanent slot keep it. The lease_ends of expired nodes is left as is.
+ * Only the buckets of the ticks passed since the last call are walked, at
+ * most one turn of the wheel.
+ *
+ * @param idx     Index.
+ * @param now_ms  Uptime in ms.
+ *
+ * @return Number of leases expired
+ */
+int
+panm_index_expire(struct panm_index *idx, uint32_t now_ms)
+{
+    uint32_t t, ticks;
+    uint16_t b, i, next;
+    int n = 0;
+
+    if ((int32_t)(now_ms - idx->wheel_ms) < 0) {
+        return 0;
+    }
+    ticks = (now_ms - idx->wheel_ms) >> PANM_INDEX_TICK_SHIFT;
+    if (ticks >= PANM_INDEX_WHEEL) {
+        ticks = PANM_INDEX_WHEEL - 1;
+    }
+
+    for (t = 0; t <= ticks; t++) {
+        b = (lease_bucket(idx->wheel_ms) + t) % PANM_INDEX_WHEEL;
+        for (i = idx->wheel[b]; i != NONE; i = next) {
+            next = idx->lease_next[i];
+            if ((int32_t)(now_ms - idx->nodes[i].lease_ends) <= 0) {
+                continue;
+            }
+            lease_unlink(idx, i);
+            if (!idx->nodes[i].has_perm_slot) {
+                panm_index_slot_release(idx, i);
+            }
+            n++;
+        }
+    }
+    /* The bucket of now may still hold leases ending later in this tick */
+    idx->wheel_ms = now_ms & ~TICK_MASK;
+    return n;
+}
+
+/**
+ * @fn panm_index_lease_due(struct panm_index *idx, uint32_t now_ms, uint32_t within_ms,
+ *     uint16_t *due, int max_due)
+ * @brief List the leases that end within within_ms from now, roughly earliest
+ * first. Only the buckets of the ticks up to now_ms + within_ms are walked.
+ *
+ * @param idx        Index.
+ * @param now_ms     Uptime in ms.
+ * @param within_ms  How far ahead to look, less than one turn of the wheel.
+ * @param due        Table indices found.
+ * @param max_due    Entries in due.
+ *
+ * @return Number of table indices in due
+ */
+int
+panm_index_lease_due(struct panm_index *idx, uint32_t now_ms, uint32_t within_ms,
+                     uint16_t *due, int max_due)
+{
+    uint32_t t, ticks = ((now_ms & TICK_MASK) + within_ms) >> PANM_INDEX_TICK_SHIFT;
+    uint16_t b, i;
+    int32_t left;
+    int n = 0;
+
+    for (t = 0; t <= ticks && t < PANM_INDEX_WHEEL && n < max_due; t++) {
+        b = (lease_bucket(now_ms) + t) % PANM_INDEX_WHEEL;
+        for (i = idx->wheel[b]; i != NONE && n < max_due; i = idx->lease_next[i]) {
+            left = idx->nodes[i].lease_ends - now_ms;
+            if (left > 0 && left <= (int32_t)within_ms) {
+                due[n++] = i;
+            }
+        }
+    }
+    return n;
+}
@@ -22,6 +22,9 @@
 
 #include <stdint.h>
 #include "syscfg/syscfg.h"
+#if MYNEWT_VAL(PANMASTER_STATS)
+#include <stats/stats.h>
+#endif
 
 #define PANM_MAX_ROW_LEN     (32*3+4+4+2+5) /* max length for panm node-row */
 #define PANM_FILE_NAME_MAX   (32)           /* max length for panm filename */
@@ -37,6 +40,33 @@ struct panm_file {
 
 struct panmaster_node;
 
+#if MYNEWT_VAL(PANMASTER_STATS)
+/* Write amplification is save_records / save_marked */
+STATS_SECT_START(panm_stat_section)
+    STATS_SECT_ENTRY(save_marked)       /* Node changes queued for writing */
+    STATS_SECT_ENTRY(save_coalesced)    /* Changes to a node already queued */
+    STATS_SECT_ENTRY(save_appends)
+    STATS_SECT_ENTRY(save_records)
+    STATS_SECT_ENTRY(save_errors)
+    STATS_SECT_ENTRY(compress)
+    STATS_SECT_ENTRY(compress_records)  /* Records copied by compaction */
+    STATS_SECT_ENTRY(lease_active)      /* Leases held, updated every wheel tick */
+    STATS_SECT_ENTRY(lease_due)         /* Leases ending within PANMASTER_LEASE_RENEW_MS */
+    STATS_SECT_ENTRY(lease_expired)
+    STATS_SECT_ENTRY(lease_renew_push)  /* Renewals sent without a request */
+    STATS_SECT_ENTRY(lease_renew_full)  /* Renewals left for the next batch */
+STATS_SECT_END
+
+extern STATS_SECT_DECL(panm_stat_section) g_panm_stat;
+#define PANM_STATS_INC(__X) STATS_INC(g_panm_stat, __X)
+#define PANM_STATS_INCN(__X, __N) STATS_INCN(g_panm_stat, __X, __N)
+#define PANM_STATS_SET(__X, __N) {STATS_CLEAR(g_panm_stat, __X);STATS_INCN(g_panm_stat, __X, __N);}
+#else
+#define PANM_STATS_INC(__X) {}
+#define PANM_STATS_INCN(__X, __N) {}
+#define PANM_STATS_SET(__X, __N) {}
+#endif
+
 struct list_nodes_extract {
     struct panmaster_node *nodes;
     int index_off;
@@ -50,6 +80,7 @@ extern "C" {
 int panmaster_cli_register(void);
 
 int panm_file_save(struct panm_file *pf, struct panmaster_node *node);
+int panm_file_save_batch(struct panm_file *pf, struct panmaster_node *nodes, int n);
 int panm_file_load_idx(struct panm_file *pf, struct panmaster_node_idx *nodes);
 int panm_file_find_node(struct panm_file *pf, struct find_node_s *fns);
 void panm_nffs_load(struct panm_file *file, struct panmaster_node_idx *node_idx);
@@ -0,0 +1,193 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file panmaster_slots.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Demand based tdma slot allocation
+ *
+ * @details Shares a range of tdma slots between nodes in proportion to the
+ * demand they report in their pan requests. Each slot is tracked as an 8 bit
+ * bitmap of superframe phases (superframe seq_num modulo 8). Nodes entitled to
+ * one or more whole slots get a contiguous run of free slots, the rest get a
+ * fractional grant of one slot every 2, 4 or 8 superframes, packed into slots
+ * that are already partially used.
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "panmaster/panmaster.h"
+
+#define PHASE_FULL  (0xff)
+
+/* Phases used by a grant of one slot every 2^period superframes */
+static uint8_t
+phase_mask(uint8_t period, uint8_t phase)
+{
+    static const uint8_t pattern[] = {0xff, 0x55, 0x11, 0x01};
+    return pattern[period] << phase;
+}
+
+static void
+sort_by_demand(struct panmaster_slot_demand *d, int n)
+{
+    int i, j;
+    struct panmaster_slot_demand tmp;
+
+    /* Insertion sort, descending demand with ties broken on address */
+    for (i = 1; i < n; i++) {
+        tmp = d[i];
+        for (j = i; j > 0; j--) {
+            if (d[j-1].demand > tmp.demand ||
+                (d[j-1].demand == tmp.demand && d[j-1].addr < tmp.addr)) {
+                break;
+            }
+            d[j] = d[j-1];
+        }
+        d[j] = tmp;
+    }
+}
+
+static int
+find_free_run(const uint8_t *used, int nslots, int count)
+{
+    int i, run = 0;
+    for (i = 0; i < nslots; i++) {
+        run = (used[i]) ? 0 : run + 1;
+        if (run == count) {
+            return i - count + 1;
+        }
+    }
+    return -1;
+}
+
+static int
+find_free_phase(const uint8_t *used, int nslots, uint8_t period, uint8_t *phase)
+{
+    int i, pass;
+    uint8_t p;
+
+    /* Prefer slots already shared, keep empty slots for whole-slot grants */
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < nslots; i++) {
+            if (used[i] == PHASE_FULL || (pass == 0) != (used[i] != 0)) {
+                continue;
+            }
+            for (p = 0; p < (1 << period); p++) {
+                if ((used[i] & phase_mask(period, p)) == 0) {
+                    *phase = p;
+                    return i;
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+/**
+ * @fn panmaster_slot_alloc(struct panmaster_slot_demand *demands, int ndemands,
+ *     uint8_t first_slot, uint8_t nslots, struct pan_slot_grant *grants, int max_grants)
+ * @brief Share nslots tdma slots starting at first_slot between nodes by demand.
+ * Nodes with the highest demand are served first. Each node gets at most one
+ * grant, nodes with zero demand and nodes that do not fit get none.
+ *
+ * @param demands     Array of node demands, sorted in place.
+ * @param ndemands    Number of entries in demands.
+ * @param first_slot  First tdma slot to hand out.
+ * @param nslots      Number of tdma slots to hand out.
+ * @param grants      Output array of grants.
+ * @param max_grants  Size of the grants array.
+ *
+ * @return Number of grants written
+ */
+int
+panmaster_slot_alloc(struct panmaster_slot_demand *demands, int ndemands,
+                     uint8_t first_slot, uint8_t nslots,
+                     struct pan_slot_grant *grants, int max_grants)
+{
+    uint8_t used[UINT8_MAX + 1];
+    uint32_t free8 = (uint32_t)nslots * 8;
+    uint32_t remaining = 0;
+    int i, s, count, ngrants = 0;
+    uint8_t period, phase;
+
+    if (nslots > UINT8_MAX + 1 - first_slot) {
+        nslots = UINT8_MAX + 1 - first_slot;
+    }
+    memset(used, 0, nslots);
+    sort_by_demand(demands, ndemands);
+    for (i = 0; i < ndemands; i++) {
+        remaining += demands[i].demand;
+    }
+
+    for (i = 0; i < ndemands && ngrants < max_grants && free8 > 0; i++) {
+        uint32_t demand = demands[i].demand;
+        if (demand == 0) {
+            break;
+        }
+        /* Fair share of what is left, in eighths of a slot per superframe */
+        uint32_t share = demand * free8 / remaining;
+        remaining -= demand;
+        if (share == 0) {
+            share = 1;
+        }
+
+        if (share >= 8) {
+            count = (share / 8 > UINT8_MAX) ? UINT8_MAX : share / 8;
+            for (s = -1; count > 0; count--) {
+                if ((s = find_free_run(used, nslots, count)) >= 0) {
+                    break;
+                }
+            }
+            if (s >= 0) {
+                memset(&used[s], PHASE_FULL, count);
+                free8 -= count * 8;
+                period = phase = 0;
+                goto granted;
+            }
+            /* No empty slot left, fall back to the largest fraction */
+            share = 4;
+        }
+
+        count = 1;
+        period = (share >= 4) ? 1 : (share >= 2) ? 2 : 3;
+        for (; period < 4; period++) {
+            if ((s = find_free_phase(used, nslots, period, &phase)) >= 0) {
+                break;
+            }
+        }
+        if (s < 0) {
+            continue;
+        }
+        used[s] |= phase_mask(period, phase);
+        free8 -= (free8 < (8u >> period)) ? free8 : (8u >> period);
+
+    granted:
+        grants[ngrants].addr = demands[i].addr;
+        grants[ngrants].slot = first_slot + s;
+        grants[ngrants].count = count;
+        grants[ngrants].period = period;
+        grants[ngrants].phase = phase;
+        ngrants++;
+    }
+    return ngrants;
+}
@@ -64,6 +64,8 @@ uint32_t calc_tof_sym_ds(uint32_t first_response_timestamp,
                                 uint32_t request_timestamp,
                                 uint64_t transmission_timestamp,
                                 uint64_t reception_timestamp);
+uint16_t calc_range_ss_batch(const uint32_t T1R[], const uint32_t T1r[],
+                                const float skew[], float range[], uint16_t n);
 float uwb_rng_path_loss(float Pt, float G, float fc, float R);
 
 #ifdef __cplusplus
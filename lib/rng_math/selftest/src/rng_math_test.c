@@ -38,12 +38,14 @@ TEST_CASE_DECL(path_loss_test)
 TEST_CASE_DECL(calc_tof_test)
 TEST_CASE_DECL(calc_tof_sym_test)
 TEST_CASE_DECL(calc_tof_to_meters_test)
+TEST_CASE_DECL(calc_range_ss_batch_test)
 
 TEST_SUITE(rng_math_test_all)
 {
     path_loss_test();
     calc_tof_test();
     calc_tof_to_meters_test();
+    calc_range_ss_batch_test();
 }
 
 int main(int argc, char **argv)
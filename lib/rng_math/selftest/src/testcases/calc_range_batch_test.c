@@ -0,0 +1,59 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "rng_math_test.h"
+
+#define BATCH_MAX_RESPONDERS (64)
+
+static uint32_t T1R[BATCH_MAX_RESPONDERS];
+static uint32_t T1r[BATCH_MAX_RESPONDERS];
+static float skew[BATCH_MAX_RESPONDERS];
+static float range[BATCH_MAX_RESPONDERS];
+
+/* Synthetic responders between 1m and ~64m with a few ppm of clock offset each */
+static void
+batch_fill(uint16_t n)
+{
+    for (uint16_t i = 0; i < n; i++) {
+        uint32_t tof = (uint32_t)((1.0 + i) / 0.00469030);
+        skew[i] = (float)((int16_t)(i * 37 % 21) - 10) * 1e-6f;
+        T1r[i] = 78593653 + i * 1003;
+        T1R[i] = (uint32_t)(T1r[i] * (1.0 - skew[i])) + 2 * tof;
+    }
+}
+
+/* SS-TWR BATCH RANGE TEST */
+TEST_CASE_SELF(calc_range_ss_batch_test)
+{
+    batch_fill(BATCH_MAX_RESPONDERS);
+    TEST_ASSERT(calc_range_ss_batch(T1R, T1r, skew, range, BATCH_MAX_RESPONDERS) == BATCH_MAX_RESPONDERS);
+    for (uint16_t i = 0; i < BATCH_MAX_RESPONDERS; i++) {
+        /* Agree with the scalar path and with the synthetic distance to within a cm */
+        dpl_float64_t ref = uwb_rng_tof_to_meters(calc_tof_ss(T1R[i], 0, T1r[i], 0, skew[i]));
+        TEST_ASSERT(fabs(range[i] - ref) < 0.01);
+        TEST_ASSERT(fabs(range[i] - (1.0 + i)) < 0.01);
+    }
+
+    /* Initiator timestamps wrapping through zero */
+    T1R[0] = 0x0000F000 - 0xFFFFF000;
+    T1r[0] = 0x1000;
+    skew[0] = 0;
+    calc_range_ss_batch(T1R, T1r, skew, range, 1);
+    TEST_ASSERT(fabs(range[0] - uwb_rng_tof_to_meters(0xF000 / 2)) < 0.01);
+}
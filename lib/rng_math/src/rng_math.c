@@ -90,6 +90,38 @@ calc_tof_ds(uint32_t first_response_timestamp, uint32_t first_request_timestamp,
     return ToF;
 }
 
+/**
+ * @fn calc_range_ss_batch(const uint32_t T1R[], const uint32_t T1r[], const float skew[], float range[], uint16_t n)
+ * @brief Single sided ranges for a batch of responders in one pass.
+ *
+ * Inputs are laid out as contiguous arrays indexed by responder so the loop carries
+ * no dependencies and no per element calls; the clock skew of each responder is
+ * expected to have been derived once by the caller.
+ *
+ * @param T1R     Round trip interval at the initiator, response_timestamp - request_timestamp.
+ * @param T1r     Reply interval at the responder, transmission_timestamp - reception_timestamp.
+ * @param skew    Clock offset ratio of each responder, 0 when timestamps are already in a common timescale.
+ * @param range   Output ranges in meters.
+ * @param n       Number of responders.
+ *
+ * @return number of ranges computed
+ */
+uint16_t
+calc_range_ss_batch(const uint32_t T1R[], const uint32_t T1r[],
+                    const float skew[], float range[], uint16_t n)
+{
+    /* 0.5 * (299792458.0l/1.000293l) * (1.0/499.2e6/128.0) */
+    const float scale = (float)(0.5 * (299792458.0l/1.000293l) * (1.0/499.2e6/128.0));
+
+    for (uint16_t i = 0; i < n; i++) {
+        /* Take the difference in integer ticks first so that only the small skew term
+         * is subject to float rounding */
+        int32_t diff = (int32_t)(T1R[i] - T1r[i]);
+        range[i] = ((float)diff + (float)T1r[i] * skew[i]) * scale;
+    }
+    return n;
+}
+
 /**
  * @fn uwb_rng_twr_to_tof_sym(twr_frame_t twr[], uwb_dataframe_code_t code)
  * @brief API to calculate time of flight for symmetric type of ranging.
@@ -115,6 +115,8 @@ struct rtdoa_instance{
     rtdoa_frame_t * frames[];
 };
 
+#define RTDOA_BATCH_MAX (16)  //!< Responses converted per pass by rtdoa_tdoa_batch()
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -129,6 +131,14 @@ struct uwb_dev_status rtdoa_listen(struct rtdoa_instance * rtdoa, uwb_dev_modes_
 uint32_t rtdoa_usecs_to_response(struct uwb_dev * inst, rtdoa_request_frame_t * req,
                                  uint16_t nslots, struct uwb_rng_config * config, uint32_t duration);
 uint64_t rtdoa_local_to_master64(struct uwb_dev * inst, uint64_t dtu_time, rtdoa_frame_t *req_frame);
+void rtdoa_local_to_master64_batch(struct uwb_dev * inst, const rtdoa_frame_t *req_frame,
+                                   const uint64_t * restrict rx_local, uint64_t * restrict rx_master, uint16_t n);
+struct uwb_wcs_instance;
+uint64_t rtdoa_wcs_local_to_master64(struct uwb_wcs_instance * wcs, uint64_t dtu_time, const rtdoa_frame_t *req_frame);
+void rtdoa_wcs_local_to_master64_batch(struct uwb_wcs_instance * wcs, const rtdoa_frame_t *req_frame,
+                                       const uint64_t * restrict rx_local, uint64_t * restrict rx_master, uint16_t n);
+uint16_t rtdoa_tdoa_batch(struct rtdoa_instance *rtdoa, rtdoa_frame_t *req_frame, rtdoa_frame_t **resp_frames,
+                          uint64_t *rx_master, float *tdoa_m, uint16_t n);
 
 #ifdef __cplusplus
 }
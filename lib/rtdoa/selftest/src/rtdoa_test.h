@@ -0,0 +1,33 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _RTDOA_TEST_H
+#define _RTDOA_TEST_H
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "os/mynewt.h"
+#include "testutil/testutil.h"
+#include "syscfg/syscfg.h"
+#include "uwb_wcs/uwb_wcs.h"
+#include "rtdoa/rtdoa.h"
+
+#endif /* _RTDOA_TEST_H */
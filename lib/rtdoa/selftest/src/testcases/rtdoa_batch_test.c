@@ -0,0 +1,97 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "rtdoa_test.h"
+
+#define BATCH_N     (RTDOA_BATCH_MAX + 3)
+
+static uint32_t seed = 0x9E3779B9;
+
+static uint64_t
+rand40(void)
+{
+    uint64_t v;
+    seed = seed * 1664525 + 1013904223;
+    v = seed;
+    seed = seed * 1664525 + 1013904223;
+    return ((v << 32) | seed) & 0x0FFFFFFFFFFULL;
+}
+
+static int off_by_one;
+
+/* Max difference between the batch and the scalar conversion */
+static uint64_t
+batch_vs_scalar(struct uwb_wcs_instance * wcs, const rtdoa_frame_t * req)
+{
+    uint64_t rx_local[BATCH_N], rx_master[BATCH_N];
+    uint64_t max = 0;
+    int i;
+
+    for (i = 0; i < BATCH_N; i++) {
+        rx_local[i] = rand40();
+    }
+    /* Shortest and longest delta from the request */
+    rx_local[0] = req->rx_timestamp & 0x0FFFFFFFFFFULL;
+    rx_local[1] = (req->rx_timestamp - 1) & 0x0FFFFFFFFFFULL;
+
+    rtdoa_wcs_local_to_master64_batch(wcs, req, rx_local, rx_master, BATCH_N);
+    for (i = 0; i < BATCH_N; i++) {
+        uint64_t scalar = rtdoa_wcs_local_to_master64(wcs, rx_local[i], req);
+        uint64_t d = (rx_master[i] > scalar) ? rx_master[i] - scalar : scalar - rx_master[i];
+        max = (d > max) ? d : max;
+        off_by_one += (d == 1);
+    }
+    return max;
+}
+
+/* RTDOA BATCH CONVERSION TEST */
+TEST_CASE_SELF(rtdoa_batch_test)
+{
+    const double skews[] = {0, 12e-6, -37.5e-6, 1e-4, -4e-4};
+    struct uwb_wcs_instance wcs;
+    rtdoa_frame_t req;
+    int k, r;
+
+    memset(&wcs, 0, sizeof(wcs));
+    memset(&req, 0, sizeof(req));
+
+    for (r = 0; r < 64; r++) {
+        /* Request close to the 40 bit wrap on the local and the master timeline */
+        req.rx_timestamp = 0x0FFFFFFFFFFULL - (rand40() >> 8);
+        req.tx_timestamp = (0x2AULL << 40) | (0x0FFFFFFFFFFULL - (rand40() >> 8));
+
+        /* No wcs, the deltas are added as they are */
+        wcs.status.valid = 0;
+        TEST_ASSERT(batch_vs_scalar(&wcs, &req) == 0);
+
+        /* Q40 skew agrees with the double form to within a DTU, rounded the same
+         * way so mostly exactly */
+        wcs.status.valid = 1;
+        off_by_one = 0;
+        for (k = 0; k < sizeof(skews) / sizeof(skews[0]); k++) {
+            wcs.fractional_skew = skews[k];
+            TEST_ASSERT(batch_vs_scalar(&wcs, &req) <= 1);
+        }
+        TEST_ASSERT(off_by_one < (sizeof(skews) / sizeof(skews[0])) * BATCH_N / 4);
+
+        /* Beyond the Q40 range the batch uses the double form */
+        wcs.fractional_skew = 0.01;
+        TEST_ASSERT(batch_vs_scalar(&wcs, &req) == 0);
+    }
+}
@@ -31,9 +31,15 @@ extern "C" {
 
 #include <uwb/uwb.h>
 #include <rtdoa/rtdoa.h>
+#include <euclid/tdoa.h>
+#include <euclid/track.h>
 
 void rtdoa_tag_free(struct uwb_dev * inst);
 struct uwb_rng_config * rtdoa_tag_config(struct uwb_dev * inst);
+int rtdoa_tag_position(struct rtdoa_instance * rtdoa, const tdoa_registry_t * reg, uint8_t dim,
+                       const triad_t * guess, tdoa_result_t * result);
+uint16_t rtdoa_tag_track(struct rtdoa_instance * rtdoa, const tdoa_registry_t * reg, track_table_t * table,
+                         uint64_t utime);
 
 #ifdef __cplusplus
 }
@@ -103,6 +103,127 @@ rtdoa_tag_free(struct uwb_dev * inst)
 }
 
 
+#if MYNEWT_VAL(RTDOA_TAG_TRACE)
+/**
+ * Output one arrival of a round, in the JSON form of uwb_telemetry_tdoa_t
+ * "{\"utime\": 0,\"seq\": 1,\"uid\": 4660,\"ouid\": 4661,\"tdoa\": 1.234567}".
+ *
+ * @param rtdoa     Pointer to struct rtdoa_instance.
+ * @param frame     Response frame of the anchor.
+ * @param tdoa      Arrival less transmit time in the master timebase (m).
+ *
+ * @return void
+ */
+static void
+rtdoa_tag_trace(struct rtdoa_instance * rtdoa, rtdoa_frame_t * frame, float tdoa)
+{
+    printf("{\"utime\": %llu,\"seq\": %u,\"uid\": %u,\"ouid\": %u,\"tdoa\": %f}\n",
+           (unsigned long long)uwb_wcs_read_systime_master64(rtdoa->dev_inst), rtdoa->req_frame->seq_num,
+           rtdoa->dev_inst->my_short_address, frame->src_address, tdoa);
+}
+#endif
+
+/**
+ * Gather the arrivals of the last rtdoa round from anchors present in the registry.
+ * The responses gathered are marked UWB_DATA_CODE_TWR_INVALID by rtdoa_tdoa_batch(),
+ * so a round can only be gathered once.
+ *
+ * @param rtdoa     Pointer to struct rtdoa_instance.
+ * @param reg       Anchor positions by short address, responses from other anchors are skipped.
+ * @param meas      Output, room for RTDOA_BATCH_MAX entries.
+ *
+ * @return number of measurements
+ */
+static uint16_t
+rtdoa_tag_arrivals(struct rtdoa_instance * rtdoa, const tdoa_registry_t * reg, tdoa_meas_t * meas)
+{
+    rtdoa_frame_t * frames[RTDOA_BATCH_MAX];
+    float tdoa_m[RTDOA_BATCH_MAX];
+    uint16_t i, n = 0, nmeas = 0;
+
+    if (rtdoa->req_frame == NULL) {
+        return 0;
+    }
+
+    /* The responses of this round are the frames stored after its request */
+    for (i = 0; i < rtdoa->nframes && n < RTDOA_BATCH_MAX; i++) {
+        rtdoa_frame_t * frame = rtdoa->frames[(uint16_t)(rtdoa->idx - i)%rtdoa->nframes];
+        if (frame == rtdoa->req_frame) {
+            break;
+        }
+        if (frame->code == UWB_DATA_CODE_RTDOA_RESP && tdoa_registry_get(reg, frame->src_address)) {
+            frames[n++] = frame;
+        }
+    }
+
+    rtdoa_tdoa_batch(rtdoa, rtdoa->req_frame, frames, NULL, tdoa_m, n);
+    for (i = 0; i < n; i++) {
+        if (isnan(tdoa_m[i])) {
+            continue;
+        }
+#if MYNEWT_VAL(RTDOA_TAG_TRACE)
+        rtdoa_tag_trace(rtdoa, frames[i], tdoa_m[i]);
+#endif
+        meas[nmeas].anchor = *tdoa_registry_get(reg, frames[i]->src_address);
+        meas[nmeas].tdoa = tdoa_m[i];
+        meas[nmeas].variance = 0;
+        nmeas++;
+    }
+    return nmeas;
+}
+
+/**
+ * API to solve the position of the tag from the responses of the last rtdoa round.
+ * This consumes the round: rtdoa_tag_track() called after it on the same round finds
+ * no responses, and the other way around. Use one or the other per round.
+ *
+ * @param rtdoa     Pointer to struct rtdoa_instance.
+ * @param reg       Anchor positions by short address, responses from other anchors are skipped.
+ * @param dim       2 to solve x and y only, 3 for x, y and z.
+ * @param guess     Optional start point, such as the previous position of the tag.
+ * @param result    Solved position.
+ *
+ * @return 0 on success, -1 for too few usable responses, -2 if the anchor geometry does not define a position
+ */
+int
+rtdoa_tag_position(struct rtdoa_instance * rtdoa, const tdoa_registry_t * reg, uint8_t dim,
+                   const triad_t * guess, tdoa_result_t * result)
+{
+    tdoa_meas_t meas[RTDOA_BATCH_MAX];
+    uint16_t n = rtdoa_tag_arrivals(rtdoa, reg, meas);
+    return tdoa_solve(meas, n, dim, guess, result);
+}
+
+/**
+ * API to feed the responses of the last rtdoa round to a tracker. Each round shares one
+ * unknown offset, so a round heard from only two or three anchors still refines the track.
+ * This consumes the round: rtdoa_tag_position() called after it on the same round finds
+ * no responses, and the other way around. The position of a tracked tag is read with
+ * track_position() instead.
+ *
+ * @param rtdoa     Pointer to struct rtdoa_instance.
+ * @param reg       Anchor positions by short address, responses from other anchors are skipped.
+ * @param table     Tracks, see track_table_init().
+ * @param utime     Time of the round (usec).
+ *
+ * @return number of arrivals applied to the track of this tag
+ */
+uint16_t
+rtdoa_tag_track(struct rtdoa_instance * rtdoa, const tdoa_registry_t * reg, track_table_t * table, uint64_t utime)
+{
+    tdoa_meas_t meas[RTDOA_BATCH_MAX];
+    uint16_t n = rtdoa_tag_arrivals(rtdoa, reg, meas);
+    uint16_t i, applied = 0;
+
+    for (i = 0; i < n; i++) {
+        if (track_tdoa(table, rtdoa->dev_inst->my_short_address, utime, rtdoa->req_frame->seq_num,
+                       &meas[i].anchor, meas[i].tdoa, meas[i].variance) == 0) {
+            applied++;
+        }
+    }
+    return applied;
+}
+
 /**
  * API for receive error callback.
  *
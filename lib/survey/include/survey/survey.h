@@ -26,6 +26,9 @@
  * @details The site survey process involves constructing a matrix of (n * n -1) ranges between n node.
  * For this, we designate a slot in the superframe that performs a nrng_requst to all other nodes.
  * We use the ccp->seq number to determine what node make use of this slot.
+ * Only the ranges that were measured are stored and broadcast, as 16 bit fixed point values
+ * tagged with the slot of the responding node, so memory and airtime follow the number of
+ * node pairs in range rather than nnodes^2.
  *
  */
 
@@ -34,6 +37,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <uwb/uwb.h>
 #include <uwb/uwb_ftypes.h>
 
@@ -43,28 +47,69 @@ extern "C" {
 #include <uwb_rng/slots.h>
 #include <stats/stats.h>
 
-typedef struct survey_nrng{
-    uint16_t mask;              //!< slot bitmask, the bit position in the mask decodes as the node slot_id
-    dpl_float32_t rng[MYNEWT_VAL(SURVEY_NNODES)];      //!< Ranging corresponding to above slot mask. When broadcasting the survey results we one transmit sucessful range requests.
-    uint16_t uid[MYNEWT_VAL(SURVEY_NNODES)];
-}survey_nrng_t;
+#define SURVEY_RANGE_MAX (0xFFFE)      //!< Largest stored range in units of SURVEY_RANGE_UNIT
 
-typedef struct survey_nrngs{
-    uint16_t mask;              //!< slot bitmask, the bit position in the mask decodes as the node slot_id
-    survey_nrng_t nrng[MYNEWT_VAL(SURVEY_NNODES)];     //!< Ranging corresponding to above slot mask. When broadcasting the survey results we one transmit sucessful range requests.
+//! One surveyed range, kept in the row of the node that requested it
+typedef struct _survey_edge_t{
+    uint8_t slot_id;            //!< Slot of the responding node
+    uint16_t range;             //!< Range in units of MYNEWT_VAL(SURVEY_RANGE_UNIT) mm
+}__attribute__((__packed__,aligned(1))) survey_edge_t;
+
+//! Survey results of one sequence, only the ranges that were measured are stored.
+//! The edges of each requesting slot are contiguous, rows are appended as results arrive.
+typedef struct _survey_nrngs_t{
+    uint32_t mask;                                      //!< slot bitmask of the rows present
+    uint16_t nedges;                                    //!< Edges in use
+    uint16_t row[MYNEWT_VAL(SURVEY_NNODES)];            //!< Index of the first edge of each slot
+    uint8_t len[MYNEWT_VAL(SURVEY_NNODES)];             //!< Number of edges of each slot
+    survey_edge_t edges[MYNEWT_VAL(SURVEY_NEDGES)];     //!< Edge pool shared by all rows
 }survey_nrngs_t;
 
-//! N-Ranges request frame
+//! Survey broadcast frame, only the first nedges edges are transmitted
 typedef union {
     struct _survey_broadcast_frame_t{
         struct _ieee_rng_request_frame_t;
         uint16_t slot_id;
         uint16_t cell_id;
-        struct survey_nrng;
+        uint8_t nedges;                                 //!< Number of valid edges
+        survey_edge_t edges[MYNEWT_VAL(SURVEY_NNODES)]; //!< Ranges measured by slot_id
     }__attribute__((__packed__,aligned(1)));
     uint8_t array[sizeof(struct _survey_broadcast_frame_t)];
 }survey_broadcast_frame_t;
 
+//! Length of a broadcast frame carrying n edges
+#define SURVEY_BROADCAST_LEN(n) (offsetof(struct _survey_broadcast_frame_t, edges) + (n) * sizeof(survey_edge_t))
+
+/**
+ * @fn survey_range_encode(float range)
+ * @brief Convert a range to the stored fixed point format, negative ranges saturate at 0.
+ *
+ * @param range  Range (m)
+ * @return range in units of MYNEWT_VAL(SURVEY_RANGE_UNIT) mm
+ */
+static inline uint16_t
+survey_range_encode(float range)
+{
+    float units = range * (1000.0f / MYNEWT_VAL(SURVEY_RANGE_UNIT)) + 0.5f;
+    if (!(units > 0)) {
+        return 0;
+    }
+    return (units < SURVEY_RANGE_MAX) ? (uint16_t)units : SURVEY_RANGE_MAX;
+}
+
+/**
+ * @fn survey_range_decode(uint16_t range)
+ * @brief Convert a stored range back to meters.
+ *
+ * @param range  Range in units of MYNEWT_VAL(SURVEY_RANGE_UNIT) mm
+ * @return range (m)
+ */
+static inline float
+survey_range_decode(uint16_t range)
+{
+    return range * (MYNEWT_VAL(SURVEY_RANGE_UNIT) / 1000.0f);
+}
+
 STATS_SECT_START(survey_stat_section)
     STATS_SECT_ENTRY(request)
     STATS_SECT_ENTRY(listen)
@@ -75,6 +120,8 @@ STATS_SECT_START(survey_stat_section)
     STATS_SECT_ENTRY(receiver)
     STATS_SECT_ENTRY(rx_timeout)
     STATS_SECT_ENTRY(reset)
+    STATS_SECT_ENTRY(edge_overflow)
+    STATS_SECT_ENTRY(rx_malformed)
 STATS_SECT_END
 
 //! Status parameters of ccp.
@@ -109,12 +156,14 @@ typedef struct _survey_instance_t{
     survey_broadcast_frame_t * frame;           //!< Frame to broadcast results back between nodes
     uint16_t nframes;                           //!< nrngs[] is cicrular buffer of size nframes
     uint16_t idx;                               //!< idx is cicrular buffer of size nframes
+    uint16_t uid[MYNEWT_VAL(SURVEY_NNODES)];    //!< Short address of each slot, as last seen
     survey_nrngs_t * nrngs[];                   //!< Array containing survey results, indexed by slot_id
 }survey_instance_t;
 
 
 survey_instance_t * survey_init(struct uwb_dev * inst, uint16_t nnodes, uint16_t nframes);
 void survey_free(survey_instance_t * inst);
+uint16_t survey_get_row(survey_instance_t * survey, uint16_t idx, uint16_t slot_id, const survey_edge_t ** edges);
 void survey_slot_range_cb(struct dpl_event *ev);
 void survey_slot_broadcast_cb(struct dpl_event *ev);
 survey_status_t survey_receiver(survey_instance_t * survey, uint64_t dx_time);
@@ -81,6 +81,8 @@ STATS_NAME_START(survey_stat_section)
     STATS_NAME(survey_stat_section, receiver)
     STATS_NAME(survey_stat_section, rx_timeout)
     STATS_NAME(survey_stat_section, reset)
+    STATS_NAME(survey_stat_section, edge_overflow)
+    STATS_NAME(survey_stat_section, rx_malformed)
 STATS_NAME_END(survey_stat_section)
 
 survey_status_t survey_request(survey_instance_t * survey, uint64_t dx_time);
@@ -101,21 +103,14 @@ survey_init(struct uwb_dev * inst, uint16_t nnodes, uint16_t nframes){
         survey = (survey_instance_t *) malloc(sizeof(survey_instance_t) + nframes * sizeof(survey_nrngs_t * ));
         assert(survey);
         memset(survey, 0, sizeof(survey_instance_t) + nframes * sizeof(survey_nrngs_t * ));
-/*
+        assert(nnodes <= MYNEWT_VAL(SURVEY_NNODES));
         for (uint16_t j = 0; j < nframes; j++){
-            survey->nrngs[j] = (survey_nrngs_t *) malloc(sizeof(survey_nrngs_t) + nnodes * sizeof(survey_nrng_t * )); // Variable array alloc
+            survey->nrngs[j] = (survey_nrngs_t *) malloc(sizeof(survey_nrngs_t));
             assert(survey->nrngs[j]);
-            memset(survey->nrngs[j], 0, sizeof(survey_nrngs_t) + nnodes * sizeof(survey_nrng_t * ));
-
-            for (uint16_t i = 0; i < nnodes; i++){
-                survey->nrngs[j]->nrng[i] = (survey_nrng_t * ) malloc(sizeof(survey_nrng_t) + nnodes * sizeof(dpl_float32_t));
-                assert(survey->nrngs[j]->nrng[i]);
-                memset(survey->nrngs[j]->nrng[i], 0, sizeof(survey_nrng_t) + nnodes * sizeof(dpl_float32_t));
-            }
+            memset(survey->nrngs[j], 0, sizeof(survey_nrngs_t));
         }
-*/
-//        survey->frame = (survey_broadcast_frame_t *) malloc(sizeof(survey_broadcast_frame_t) + nnodes * sizeof(dpl_float32_t));
-//        assert(survey->frame);
+        survey->frame = (survey_broadcast_frame_t *) malloc(sizeof(survey_broadcast_frame_t));
+        assert(survey->frame);
         memset(survey->frame, 0, sizeof(survey_broadcast_frame_t));
         survey_broadcast_frame_t frame = {
             .PANID = 0xDECA,
@@ -185,6 +180,9 @@ survey_free(survey_instance_t * survey)
     uwb_mac_remove_interface(survey->dev_inst, survey->cbs.id);
 
     if (survey->status.selfmalloc){
+        for (uint16_t j = 0; j < survey->nframes; j++){
+            free(survey->nrngs[j]);
+        }
         free(survey->frame);
         free(survey);
     }else{
@@ -229,6 +227,14 @@ survey_slot_range_cb(struct dpl_event *ev)
     survey_instance_t * survey = (survey_instance_t *)slot->arg;
     survey->seq_num = (ccp->seq_num & ((uint32_t)~0UL << MYNEWT_VAL(SURVEY_MASK))) >> MYNEWT_VAL(SURVEY_MASK);
 
+    if(ccp->seq_num % survey->nnodes == 0){
+        // advance the nrngs idx at begining of sequence, results are collected from empty.
+        survey->idx++;
+        survey_nrngs_t * nrngs = survey->nrngs[survey->idx%survey->nframes];
+        nrngs->mask = 0;
+        nrngs->nedges = 0;
+    }
+
     if(ccp->seq_num % survey->nnodes == tdma->dev_inst->slot_id){
         uint64_t dx_time = tdma_tx_slot_start(tdma, slot->idx) & 0xFFFFFFFE00UL;
         survey_request(survey, dx_time);
@@ -274,6 +280,69 @@ survey_slot_broadcast_cb(struct dpl_event *ev)
     }
 }
 
+/**
+ * Store the ranges reported by a node as its row of the current sequence.
+ *
+ * @param survey    Pointer to survey_instance_t.
+ * @param nrngs     Results of the sequence.
+ * @param slot_id   Slot of the node that measured the ranges.
+ * @param edges     Ranges.
+ * @param n         Number of ranges.
+ * @return void
+ */
+static void
+survey_store(survey_instance_t * survey, survey_nrngs_t * nrngs, uint16_t slot_id, const survey_edge_t * edges, uint16_t n)
+{
+    // A repeated report reuses its row when it fits. A longer one gives its row back, the rows
+    // after it move down, and it is appended to the pool like a new row.
+    if ((nrngs->mask & 1UL << slot_id) && nrngs->len[slot_id] < n){
+        uint16_t start = nrngs->row[slot_id], len = nrngs->len[slot_id];
+        memmove(&nrngs->edges[start], &nrngs->edges[start + len],
+                (nrngs->nedges - start - len) * sizeof(survey_edge_t));
+        for (uint16_t i = 0; i < survey->nnodes; i++){
+            if ((nrngs->mask & 1UL << i) && nrngs->row[i] > start){
+                nrngs->row[i] -= len;
+            }
+        }
+        nrngs->nedges -= len;
+        nrngs->mask &= ~(1UL << slot_id);
+    }
+    if (!(nrngs->mask & 1UL << slot_id)){
+        if (n > MYNEWT_VAL(SURVEY_NEDGES) - nrngs->nedges){
+            STATS_INC(survey->stat, edge_overflow);
+            n = MYNEWT_VAL(SURVEY_NEDGES) - nrngs->nedges;
+        }
+        nrngs->row[slot_id] = nrngs->nedges;
+        nrngs->nedges += n;
+    }
+    memcpy(&nrngs->edges[nrngs->row[slot_id]], edges, n * sizeof(survey_edge_t));
+    nrngs->len[slot_id] = n;
+    nrngs->mask |= 1UL << slot_id;
+}
+
+/**
+ * API to read the ranges a node measured during a survey sequence.
+ *
+ * @param survey    Pointer to survey_instance_t.
+ * @param idx       Sequence index, survey->idx is the current sequence.
+ * @param slot_id   Slot of the node that measured the ranges.
+ * @param edges     Returns the first range of the row, the slot_id of each edge is the responding node.
+ * @return number of ranges, 0 if the node has not reported
+ */
+uint16_t
+survey_get_row(survey_instance_t * survey, uint16_t idx, uint16_t slot_id, const survey_edge_t ** edges)
+{
+    assert(survey);
+    survey_nrngs_t * nrngs = survey->nrngs[idx%survey->nframes];
+
+    if (slot_id >= survey->nnodes || !(nrngs->mask & 1UL << slot_id)){
+        *edges = NULL;
+        return 0;
+    }
+    *edges = &nrngs->edges[nrngs->row[slot_id]];
+    return nrngs->len[slot_id];
+}
+
 /**
  * API to initiaate a nrng request from a node to node survey
  *
@@ -294,23 +363,22 @@ survey_request(survey_instance_t * survey, uint64_t dx_time)
     nrng_request_delay_start(survey->nrng, 0xffff, dx_time, UWB_DATA_CODE_SS_TWR_NRNG, slot_mask, 0);
 
     survey_nrngs_t * nrngs = survey->nrngs[(survey->idx)%survey->nframes];
-    dpl_float32_t range[survey->nnodes];
-    uint16_t uid[survey->nnodes];
-
-    nrngs->nrng[slot_id].mask = nrng_get_ranges(survey->nrng,
-                                range,
-                                survey->nnodes,
-                                survey->nrng->idx
-        );
-    nrng_get_uids(survey->nrng,
-                                uid,
-                                survey->nnodes,
-                                survey->nrng->idx
-        );
-    for (uint16_t i = 0;i < survey->nnodes; i++){
-        nrngs->nrng[slot_id].rng[i] = range[i];
-        nrngs->nrng[slot_id].uid[i] = uid[i];
+    nrng_range_t results[NRNG_BATCH_MAX];
+    survey_edge_t edges[MYNEWT_VAL(SURVEY_NNODES)];
+    uint16_t n = 0;
+
+    assert(survey->nnodes <= NRNG_BATCH_MAX);
+    uint32_t mask = nrng_get_ranges_batch(survey->nrng, results, survey->nnodes, survey->nrng->idx);
+    for (uint16_t j = 0; j < NumberOfBits(mask); j++){
+        if (!isfinite(results[j].range) || results[j].slot_id >= survey->nnodes)
+            continue;
+        survey->uid[results[j].slot_id] = results[j].uid;
+        edges[n++] = (survey_edge_t){
+            .slot_id = results[j].slot_id,
+            .range = survey_range_encode(results[j].range)
+        };
     }
+    survey_store(survey, nrngs, slot_id, edges, n);
 
     return survey->status;
 }
@@ -350,29 +418,26 @@ survey_broadcaster(survey_instance_t * survey, uint64_t dx_time){
     STATS_INC(survey->stat, broadcaster);
 
     struct uwb_dev * inst = survey->dev_inst;
-    survey_nrngs_t * nrngs = survey->nrngs[survey->idx%survey->nframes];
+    const survey_edge_t * edges;
+    uint16_t nedges = survey_get_row(survey, survey->idx, inst->slot_id, &edges);
 
-    survey->frame->mask = nrngs->nrng[inst->slot_id].mask;
     survey->frame->seq_num = survey->seq_num;
     survey->frame->slot_id = inst->slot_id;
+    survey->frame->cell_id = inst->cell_id;
 
-    uint16_t nnodes = NumberOfBits(survey->frame->mask);
-    survey->status.empty = nnodes == 0;
+    survey->status.empty = nedges == 0;
     if (survey->status.empty){
         err = dpl_sem_release(&survey->sem);
         assert(err == DPL_OK);
         return survey->status;
     }
 
-    assert(nnodes < survey->nnodes);
+    assert(nedges < survey->nnodes);
 
-//    memcpy(survey->frame->rng, nrngs->nrng[inst->slot_id].rng, nnodes * sizeof(dpl_float32_t));
-//    memcpy(survey->frame->uid, nrngs->nrng[inst->slot_id].uid, nnodes * sizeof(uint16_t));
-
-    uint16_t n = sizeof(struct _survey_broadcast_frame_t)
-        + sizeof(uint16_t)
-        + nnodes * sizeof(dpl_float32_t)
-        + nnodes * sizeof(uint16_t);
+    // Only the measured ranges go on air
+    survey->frame->nedges = nedges;
+    memcpy(survey->frame->edges, edges, nedges * sizeof(survey_edge_t));
+    uint16_t n = SURVEY_BROADCAST_LEN(nedges);
 
     uwb_write_tx(inst, survey->frame->array, 0, n);
     uwb_write_tx_fctrl(inst, n, 0);
@@ -409,7 +474,7 @@ survey_receiver(survey_instance_t * survey, uint64_t dx_time){
     assert(err == DPL_OK);
     STATS_INC(survey->stat, receiver);
 
-    uint16_t n = sizeof(struct _survey_broadcast_frame_t) + sizeof(struct survey_nrng);
+    uint16_t n = sizeof(struct _survey_broadcast_frame_t);
     uint16_t timeout = uwb_phy_frame_duration(inst, n)
                         + survey->config.rx_timeout_delay;
     uwb_set_rx_timeout(inst, timeout);
@@ -448,15 +513,13 @@ rx_complete_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
         return false;
     }
 
-    if(inst->frame_len < sizeof(survey_broadcast_frame_t))
+    if(inst->frame_len < SURVEY_BROADCAST_LEN(0))
        return false;
 
     survey_broadcast_frame_t * frame = ((survey_broadcast_frame_t * ) inst->rxbuf);
 
     if(frame->dst_address != 0xffff)
         return false;
-    if(survey->ccp->seq_num % survey->nnodes == 0)
-        survey->idx++;  // advance the nrngs idx at begining of sequence.
 
     switch(frame->code) {
         case UWB_DATA_CODE_SURVEY_BROADCAST:
@@ -465,23 +528,15 @@ rx_complete_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
                     return false;
                 if (frame->seq_num != survey->seq_num)
                     break;
-           //     uint16_t n = sizeof(survey_broadcast_frame_t) + survey->nnodes * sizeof(float);
-           //     if (inst->frame_len > n || frame->slot_id > survey->nnodes - 1) {
-           //         return false;
-           //     }
-                survey_nrngs_t * nrngs = survey->nrngs[survey->idx%survey->nframes];
-                uint16_t nnodes = NumberOfBits(frame->mask);
-                survey->status.empty = nnodes == 0;
-                if(survey->status.empty == 0){
-                    nrngs->mask |= 1U << frame->slot_id;
-//                    nrngs->nrng[frame->slot_id].mask = frame->mask;
-//                    memcpy(nrngs->nrng[frame->slot_id].rng, frame->rng, nnodes * sizeof(dpl_float32_t));
-//                    memcpy(nrngs->nrng[frame->slot_id].uid, frame->uid, nnodes * sizeof(uint16_t));
-                    break;
-                }else{
-                    nrngs->nrng[frame->slot_id].mask = 0;
+                if (frame->slot_id >= survey->nnodes || frame->nedges >= survey->nnodes
+                    || inst->frame_len < SURVEY_BROADCAST_LEN(frame->nedges)) {
+                    STATS_INC(survey->stat, rx_malformed);
                     break;
                 }
+                survey_nrngs_t * nrngs = survey->nrngs[survey->idx%survey->nframes];
+                survey->status.empty = frame->nedges == 0;
+                survey->uid[frame->slot_id] = frame->src_address;
+                survey_store(survey, nrngs, frame->slot_id, frame->edges, frame->nedges);
             }
             break;
         default:
@@ -40,28 +40,23 @@ survey_encode(survey_instance_t * survey, uint16_t seq, uint16_t idx){
     uint32_t utime = os_cputime_ticks_to_usecs(os_cputime_get32());
     survey_nrngs_t * nrngs = survey->nrngs[idx%survey->nframes];
 
-    uint16_t mask = 0;
-    // Workout which node responded to the request
-    for (uint16_t i=0; i < survey->nnodes; i++){
-        if (nrngs->nrng[i].mask){
-                mask |= 1UL << i;
-        }
-    }
-
-    survey->status.empty = NumberOfBits(mask) == 0;
+    survey->status.empty = NumberOfBits(nrngs->mask) == 0;
     if (survey->status.empty)
        return;
 
     for (uint16_t i=0; i < survey->nnodes; i++){
-        if (nrngs->nrng[i].mask){
+        const survey_edge_t * edges;
+        uint16_t nedges = survey_get_row(survey, idx, i, &edges);
+        if (nedges){
             nrng_json_t json={
                 .utime = utime,
                 .seq = seq,
-                .nsize = NumberOfBits(nrngs->nrng[i].mask)
+                .uid = survey->uid[i],
+                .nsize = nedges
                 };
             for (uint16_t j=0; j < json.nsize; j++){
-                json.rng[j] = nrngs->nrng[i].rng[j];
-                json.ouid[j] = nrngs->nrng[i].uid[j];
+                json.rng[j] = survey_range_decode(edges[j].range);
+                json.ouid[j] = survey->uid[edges[j].slot_id];
             }
             nrng_json_write(&json);
             printf("%s\n", json.iobuf);
@@ -36,6 +36,7 @@ extern "C" {
 #endif
 
 #include <dpl/dpl.h>
+#include <dpl/dpl_cputime.h>
 #include <hal/hal_timer.h>
 #include <stats/stats.h>
 #include <uwb/uwb.h>
@@ -50,6 +51,51 @@ STATS_SECT_START(tdma_stat_section)
     STATS_SECT_ENTRY(superframe_cnt)
     STATS_SECT_ENTRY(superframe_miss)
     STATS_SECT_ENTRY(dropped_slots)
+    STATS_SECT_ENTRY(superframe_proc_us)
+    STATS_SECT_ENTRY(superframe_proc_max_us)
+STATS_SECT_END
+#endif
+
+#if MYNEWT_VAL(TDMA_LATENCY_HIST)
+/*
+ * Slot lateness histograms, relative to cputime_slot_start, at the slot timer
+ * (fire), when the slot event is taken off the tdma eventq (deq) and when the
+ * slot's first delayed radio operation is computed (radio). Buckets are powers
+ * of two in usec, lt8 = [0,8) ... ge2048 = [2048,inf), early counts as lt8.
+ */
+#define TDMA_LAT_NBUCKETS (10)
+STATS_SECT_START(tdma_lat_stat_section)
+    STATS_SECT_ENTRY(fire_lt8)
+    STATS_SECT_ENTRY(fire_lt16)
+    STATS_SECT_ENTRY(fire_lt32)
+    STATS_SECT_ENTRY(fire_lt64)
+    STATS_SECT_ENTRY(fire_lt128)
+    STATS_SECT_ENTRY(fire_lt256)
+    STATS_SECT_ENTRY(fire_lt512)
+    STATS_SECT_ENTRY(fire_lt1024)
+    STATS_SECT_ENTRY(fire_lt2048)
+    STATS_SECT_ENTRY(fire_ge2048)
+    STATS_SECT_ENTRY(deq_lt8)
+    STATS_SECT_ENTRY(deq_lt16)
+    STATS_SECT_ENTRY(deq_lt32)
+    STATS_SECT_ENTRY(deq_lt64)
+    STATS_SECT_ENTRY(deq_lt128)
+    STATS_SECT_ENTRY(deq_lt256)
+    STATS_SECT_ENTRY(deq_lt512)
+    STATS_SECT_ENTRY(deq_lt1024)
+    STATS_SECT_ENTRY(deq_lt2048)
+    STATS_SECT_ENTRY(deq_ge2048)
+    STATS_SECT_ENTRY(radio_lt8)
+    STATS_SECT_ENTRY(radio_lt16)
+    STATS_SECT_ENTRY(radio_lt32)
+    STATS_SECT_ENTRY(radio_lt64)
+    STATS_SECT_ENTRY(radio_lt128)
+    STATS_SECT_ENTRY(radio_lt256)
+    STATS_SECT_ENTRY(radio_lt512)
+    STATS_SECT_ENTRY(radio_lt1024)
+    STATS_SECT_ENTRY(radio_lt2048)
+    STATS_SECT_ENTRY(radio_ge2048)
+    STATS_SECT_ENTRY(radio_late)
 STATS_SECT_END
 #endif
 
@@ -58,6 +104,7 @@ typedef struct _tdma_status_t{
     uint16_t selfmalloc:1;            //!< Internal flag for memory garbage collection
     uint16_t initialized:1;           //!< Instance allocated
     uint16_t awaiting_superframe:1;   //!< Superframe of tdma
+    uint16_t slots_armed:1;           //!< Slot timer is walking the current superframe
 }tdma_status_t;
 
 //! Structure of tdma_slot
@@ -65,7 +112,6 @@ typedef struct _tdma_slot_t{
     uint16_t idx;                      //!< Slot number
     uint32_t cputime_slot_start;       //!< When this slot should start
     struct _tdma_instance_t * parent;  //!< Pointer to _tdma_instance_t
-    struct hal_timer timer;            //!< Timer
     struct dpl_event event;            //!< Structure of event
     void * arg;                        //!< Optional argument
 }tdma_slot_t;
@@ -78,6 +124,10 @@ typedef struct _tdma_instance_t{
 #endif
 #if MYNEWT_VAL(TDMA_STATS)
     STATS_SECT_DECL(tdma_stat_section) stat;  //!< Stats instance
+#endif
+#if MYNEWT_VAL(TDMA_LATENCY_HIST)
+    STATS_SECT_DECL(tdma_lat_stat_section) lat_stat;  //!< Slot lateness histograms
+    struct _tdma_slot_t * running_slot;      //!< Slot whose callback is running, until its first radio operation
 #endif
     tdma_status_t status;                    //!< Status of tdma
     struct uwb_mac_interface cbs;            //!< MAC Layer Callbacks
@@ -85,7 +135,13 @@ typedef struct _tdma_instance_t{
     uint16_t idx;                            //!< Slot number
     uint16_t nslots;                         //!< Number of slots
     uint32_t os_epoch;                       //!< Epoch timestamp
+    uint32_t slot_period_us;                 //!< Slot period of the current superframe
     struct _tdma_slot_t superframe_slot;     //!< Slot for superframe
+    struct hal_timer superframe_timer;       //!< Only expires if ccp misses a superframe
+    struct hal_timer slot_timer;             //!< Single timer armed for the next due slot
+    uint16_t nactive;                        //!< Number of assigned slots in slot_table
+    uint16_t next_slot;                      //!< Position in slot_table of the next slot to run
+    uint16_t * slot_table;                   //!< Assigned slot numbers in ascending (start time) order
 #ifdef TDMA_TASKS_ENABLE
     struct dpl_eventq eventq;                //!< Structure of events
     struct dpl_task task_str;                //!< Structure of tasks
@@ -108,6 +164,44 @@ void tdma_stop(struct _tdma_instance_t * tdma);
 uint64_t tdma_tx_slot_start(struct _tdma_instance_t * tdma, dpl_float32_t idx);
 uint64_t tdma_rx_slot_start(struct _tdma_instance_t * tdma, dpl_float32_t idx);
 
+bool tdma_slot_table_add(struct _tdma_instance_t * tdma, tdma_slot_t * slot, uint32_t now);
+bool tdma_slot_table_del(struct _tdma_instance_t * tdma, uint16_t idx);
+tdma_slot_t * tdma_slot_table_due(struct _tdma_instance_t * tdma, uint32_t now);
+
+/**
+ * @fn tdma_slot_start(struct _tdma_instance_t * tdma, uint16_t idx)
+ * @brief Cputime at which a slot's event should be queued in the current superframe.
+ *
+ * @param tdma  Pointer to _tdma_instance_t.
+ * @param idx   Slot number.
+ *
+ * @return cputime ticks
+ */
+static inline uint32_t
+tdma_slot_start(struct _tdma_instance_t * tdma, uint16_t idx)
+{
+    return tdma->os_epoch
+        + dpl_cputime_usecs_to_ticks((uint32_t) (idx * tdma->slot_period_us) - MYNEWT_VAL(OS_LATENCY));
+}
+
+/**
+ * @fn tdma_slot_late_usecs(uint32_t now, uint32_t slot_start)
+ * @brief Lateness of a slot taken off the tdma eventq at cputime now. A slot
+ * dequeued ahead of its start is on time and runs, TDMA_MAX_SLOT_DELAY_US only
+ * drops slots that are late.
+ *
+ * @param now         Cputime when the slot was dequeued.
+ * @param slot_start  cputime_slot_start of the slot.
+ *
+ * @return usec late, 0 if on time or early
+ */
+static inline int32_t
+tdma_slot_late_usecs(uint32_t now, uint32_t slot_start)
+{
+    int32_t late = now - slot_start;
+    return (late > 0) ? (int32_t) dpl_cputime_ticks_to_usecs(late) : 0;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,40 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "tdma_test.h"
+
+/* SLOT LATENESS AT DEQUEUE TEST */
+TEST_CASE_SELF(tdma_slot_late_test)
+{
+    uint32_t start = 0xFFFFFF00;
+    uint32_t ticks = dpl_cputime_usecs_to_ticks(500);
+
+    /* On time and late, also across the wrap of cputime */
+    TEST_ASSERT(tdma_slot_late_usecs(start, start) == 0);
+    TEST_ASSERT(tdma_slot_late_usecs(start + ticks, start) == dpl_cputime_ticks_to_usecs(ticks));
+    TEST_ASSERT(tdma_slot_late_usecs(start + ticks, start) > 0);
+
+    /* A slot taken off the eventq ahead of its start is on time and runs. The
+     * early delay used to wrap to a large unsigned value and the slot was dropped */
+    TEST_ASSERT(tdma_slot_late_usecs(start - 1, start) == 0);
+    TEST_ASSERT(tdma_slot_late_usecs(start - ticks, start) == 0);
+#if MYNEWT_VAL(TDMA_MAX_SLOT_DELAY_US) > 0
+    TEST_ASSERT(tdma_slot_late_usecs(start - ticks, start) <= MYNEWT_VAL(TDMA_MAX_SLOT_DELAY_US));
+#endif
+}
@@ -0,0 +1,143 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "tdma_test.h"
+
+#define TEST_NSLOTS (16)
+
+static tdma_instance_t *
+test_tdma(uint32_t os_epoch)
+{
+    tdma_instance_t * tdma = (tdma_instance_t *) calloc(1, sizeof(tdma_instance_t)
+            + TEST_NSLOTS * (sizeof(tdma_slot_t *) + sizeof(uint16_t)));
+    tdma->slot_table = (uint16_t *) &tdma->slot[TEST_NSLOTS];
+    tdma->nslots = TEST_NSLOTS;
+    tdma->os_epoch = os_epoch;
+    tdma->slot_period_us = 1000;
+    return tdma;
+}
+
+static bool
+test_sorted(tdma_instance_t * tdma)
+{
+    for (uint16_t i = 1; i < tdma->nactive; i++) {
+        if (tdma->slot_table[i - 1] >= tdma->slot_table[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* SORTED SLOT TABLE AND ROLLING SLOT TIMER CURSOR TEST */
+TEST_CASE_SELF(tdma_slot_table_test)
+{
+    static tdma_slot_t slots[TEST_NSLOTS];
+    tdma_instance_t * tdma;
+    tdma_slot_t * slot;
+    uint32_t now;
+
+    for (uint16_t i = 0; i < TEST_NSLOTS; i++) {
+        slots[i].idx = i;
+    }
+
+    /* Slots assigned out of order before the first superframe */
+    tdma = test_tdma(0x1000000);
+    TEST_ASSERT(tdma_slot_table_add(tdma, &slots[5], 0) == true);
+    TEST_ASSERT(tdma_slot_table_add(tdma, &slots[2], 0) == true);
+    TEST_ASSERT(tdma_slot_table_add(tdma, &slots[8], 0) == false);
+    TEST_ASSERT(tdma_slot_table_add(tdma, &slots[0], 0) == true);
+    TEST_ASSERT(tdma->nactive == 4 && tdma->next_slot == 0);
+    TEST_ASSERT(tdma->slot_table[0] == 0 && tdma->slot_table[1] == 2 &&
+                tdma->slot_table[2] == 5 && tdma->slot_table[3] == 8);
+    TEST_ASSERT(tdma->slot[5] == &slots[5]);
+    TEST_ASSERT(slots[5].cputime_slot_start == tdma_slot_start(tdma, 5));
+
+    /* Superframe running, the timer has queued slots 0 and 2 */
+    tdma->status.slots_armed = 1;
+    now = slots[2].cputime_slot_start + 1;
+    TEST_ASSERT(tdma_slot_table_due(tdma, now) == &slots[0]);
+    TEST_ASSERT(tdma_slot_table_due(tdma, now) == &slots[2]);
+    TEST_ASSERT(tdma_slot_table_due(tdma, now) == NULL);
+    TEST_ASSERT(tdma->next_slot == 2);
+
+    /* Inserted behind the cursor, it waits for the next superframe */
+    TEST_ASSERT(tdma_slot_table_add(tdma, &slots[1], now) == false);
+    TEST_ASSERT(tdma->next_slot == 3 && tdma->slot_table[tdma->next_slot] == 5);
+    /* At the cursor but already started, also next superframe */
+    now = tdma_slot_start(tdma, 3) + 1;
+    TEST_ASSERT(tdma_slot_table_add(tdma, &slots[3], now) == false);
+    TEST_ASSERT(tdma->next_slot == 4 && tdma->slot_table[tdma->next_slot] == 5);
+    /* At the cursor and still ahead, the timer moves to it */
+    TEST_ASSERT(tdma_slot_table_add(tdma, &slots[4], now) == true);
+    TEST_ASSERT(tdma->slot_table[tdma->next_slot] == 4);
+    TEST_ASSERT(test_sorted(tdma) && tdma->nactive == 7);
+
+    /* Removing a slot before the cursor keeps the cursor on the same slot */
+    TEST_ASSERT(tdma_slot_table_del(tdma, 1) == false);
+    TEST_ASSERT(tdma->slot_table[tdma->next_slot] == 4 && tdma->slot[1] == NULL);
+    /* Removing the slot at the cursor moves the timer to the following slot */
+    TEST_ASSERT(tdma_slot_table_del(tdma, 4) == true);
+    TEST_ASSERT(tdma->slot_table[tdma->next_slot] == 5);
+    /* Behind the cursor again, down to an empty table */
+    TEST_ASSERT(tdma_slot_table_del(tdma, 0) == false);
+    TEST_ASSERT(tdma_slot_table_del(tdma, 8) == false);
+    TEST_ASSERT(tdma->slot_table[tdma->next_slot] == 5 && test_sorted(tdma));
+    TEST_ASSERT(tdma_slot_table_due(tdma, slots[5].cputime_slot_start) == &slots[5]);
+    TEST_ASSERT(tdma_slot_table_due(tdma, UINT32_MAX) == NULL);
+    TEST_ASSERT(tdma_slot_table_del(tdma, 2) == false);
+    TEST_ASSERT(tdma_slot_table_del(tdma, 3) == false);
+    TEST_ASSERT(tdma_slot_table_del(tdma, 5) == false);
+    TEST_ASSERT(tdma->nactive == 0 && tdma->next_slot == 0);
+    TEST_ASSERT(tdma_slot_table_due(tdma, now) == NULL);
+    free(tdma);
+
+    /* Superframe across the wrap of cputime, slots 0 to 3 start before it */
+    tdma = test_tdma(UINT32_MAX - dpl_cputime_usecs_to_ticks(3500)
+                     + dpl_cputime_usecs_to_ticks(MYNEWT_VAL(OS_LATENCY)));
+    for (uint16_t i = 0; i < 8; i++) {
+        tdma_slot_table_add(tdma, &slots[i], 0);
+    }
+    tdma->status.slots_armed = 1;
+    TEST_ASSERT(slots[3].cputime_slot_start > slots[4].cputime_slot_start);
+    now = slots[5].cputime_slot_start;
+    for (uint16_t i = 0; i <= 5; i++) {
+        slot = tdma_slot_table_due(tdma, now);
+        TEST_ASSERT_FATAL(slot == &slots[i]);
+        TEST_ASSERT(tdma_slot_late_usecs(now, slot->cputime_slot_start) ==
+                    dpl_cputime_ticks_to_usecs(now - slot->cputime_slot_start));
+        TEST_ASSERT(tdma_slot_late_usecs(now, slot->cputime_slot_start) <= 5 * 1000 + 1);
+    }
+    TEST_ASSERT(tdma_slot_table_due(tdma, now) == NULL);
+    /* Released and assigned again after the wrap, slot 4 has started */
+    TEST_ASSERT(tdma_slot_table_del(tdma, 4) == false);
+    TEST_ASSERT(tdma_slot_table_add(tdma, &slots[4], now) == false);
+    TEST_ASSERT(tdma->slot_table[tdma->next_slot] == 6);
+    TEST_ASSERT(tdma_slot_table_due(tdma, slots[6].cputime_slot_start) == &slots[6]);
+
+    /* Slot 3 at the cursor, assigned after the wrap when it has already started */
+    TEST_ASSERT(tdma_slot_table_del(tdma, 2) == false);
+    TEST_ASSERT(tdma_slot_table_del(tdma, 3) == false);
+    tdma->next_slot = 0;
+    TEST_ASSERT(tdma_slot_table_due(tdma, slots[1].cputime_slot_start) == &slots[0]);
+    TEST_ASSERT(tdma_slot_table_due(tdma, slots[1].cputime_slot_start) == &slots[1]);
+    TEST_ASSERT(tdma_slot_table_due(tdma, slots[1].cputime_slot_start) == NULL);
+    TEST_ASSERT(tdma_slot_table_add(tdma, &slots[3], now) == false);
+    TEST_ASSERT(tdma->slot_table[tdma->next_slot] == 4);
+    free(tdma);
+}
@@ -62,11 +62,69 @@ STATS_NAME_START(tdma_stat_section)
     STATS_NAME(tdma_stat_section, superframe_cnt)
     STATS_NAME(tdma_stat_section, superframe_miss)
     STATS_NAME(tdma_stat_section, dropped_slots)
+    STATS_NAME(tdma_stat_section, superframe_proc_us)
+    STATS_NAME(tdma_stat_section, superframe_proc_max_us)
 STATS_NAME_END(tdma_stat_section)
 
 #define TDMA_STATS_INC(__X) STATS_INC(tdma->stat, __X)
+#define TDMA_STATS_SET(__X, __N) {STATS_CLEAR(tdma->stat, __X);STATS_INCN(tdma->stat, __X, __N);}
 #else
 #define TDMA_STATS_INC(__X) {}
+#define TDMA_STATS_SET(__X, __N) {}
+#endif
+
+#if MYNEWT_VAL(TDMA_LATENCY_HIST)
+STATS_NAME_START(tdma_lat_stat_section)
+    STATS_NAME(tdma_lat_stat_section, fire_lt8)
+    STATS_NAME(tdma_lat_stat_section, fire_lt16)
+    STATS_NAME(tdma_lat_stat_section, fire_lt32)
+    STATS_NAME(tdma_lat_stat_section, fire_lt64)
+    STATS_NAME(tdma_lat_stat_section, fire_lt128)
+    STATS_NAME(tdma_lat_stat_section, fire_lt256)
+    STATS_NAME(tdma_lat_stat_section, fire_lt512)
+    STATS_NAME(tdma_lat_stat_section, fire_lt1024)
+    STATS_NAME(tdma_lat_stat_section, fire_lt2048)
+    STATS_NAME(tdma_lat_stat_section, fire_ge2048)
+    STATS_NAME(tdma_lat_stat_section, deq_lt8)
+    STATS_NAME(tdma_lat_stat_section, deq_lt16)
+    STATS_NAME(tdma_lat_stat_section, deq_lt32)
+    STATS_NAME(tdma_lat_stat_section, deq_lt64)
+    STATS_NAME(tdma_lat_stat_section, deq_lt128)
+    STATS_NAME(tdma_lat_stat_section, deq_lt256)
+    STATS_NAME(tdma_lat_stat_section, deq_lt512)
+    STATS_NAME(tdma_lat_stat_section, deq_lt1024)
+    STATS_NAME(tdma_lat_stat_section, deq_lt2048)
+    STATS_NAME(tdma_lat_stat_section, deq_ge2048)
+    STATS_NAME(tdma_lat_stat_section, radio_lt8)
+    STATS_NAME(tdma_lat_stat_section, radio_lt16)
+    STATS_NAME(tdma_lat_stat_section, radio_lt32)
+    STATS_NAME(tdma_lat_stat_section, radio_lt64)
+    STATS_NAME(tdma_lat_stat_section, radio_lt128)
+    STATS_NAME(tdma_lat_stat_section, radio_lt256)
+    STATS_NAME(tdma_lat_stat_section, radio_lt512)
+    STATS_NAME(tdma_lat_stat_section, radio_lt1024)
+    STATS_NAME(tdma_lat_stat_section, radio_lt2048)
+    STATS_NAME(tdma_lat_stat_section, radio_ge2048)
+    STATS_NAME(tdma_lat_stat_section, radio_late)
+STATS_NAME_END(tdma_lat_stat_section)
+
+/* Count usec in the power of two bucket of the histogram starting at hist */
+static inline void
+tdma_lat_record(uint32_t * hist, int32_t usec)
+{
+    uint32_t b = 0;
+    if (usec >= 8) {
+        b = 29 - __builtin_clz((uint32_t) usec);
+        if (b >= TDMA_LAT_NBUCKETS) {
+            b = TDMA_LAT_NBUCKETS - 1;
+        }
+    }
+    hist[b]++;
+}
+
+#define TDMA_LAT_RECORD(__P, __US) tdma_lat_record(&tdma->lat_stat.STATS_SECT_VAR(__P ## _lt8), __US)
+#else
+#define TDMA_LAT_RECORD(__P, __US) {}
 #endif
 
 //#define DIAGMSG(s,u) printf(s,u)
@@ -76,6 +134,7 @@ STATS_NAME_END(tdma_stat_section)
 
 static void tdma_superframe_slot_cb(struct dpl_event * ev);
 static void slot_timer_cb(void * arg);
+static void tdma_slot_timer_cb(void * arg);
 static bool superframe_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs);
 
 #ifdef TDMA_TASKS_ENABLE
@@ -100,9 +159,11 @@ tdma_init(struct uwb_dev *dev, uint16_t nslots)
     tdma_instance_t * tdma = (tdma_instance_t*)uwb_mac_find_cb_inst_ptr(dev, UWBEXT_TDMA);
 
     if (tdma == NULL) {
-        tdma = (tdma_instance_t *) calloc(1, sizeof(struct _tdma_instance_t) + nslots * sizeof(struct _tdma_slot_t *));
+        tdma = (tdma_instance_t *) calloc(1, sizeof(struct _tdma_instance_t)
+                + nslots * (sizeof(struct _tdma_slot_t *) + sizeof(uint16_t)));
         assert(tdma);
         tdma->status.selfmalloc = 1;
+        tdma->slot_table = (uint16_t *) &tdma->slot[nslots];
         dpl_error_t err = dpl_mutex_init(&tdma->mutex);
         assert(err == DPL_OK);
         tdma->nslots = nslots;
@@ -122,8 +183,11 @@ tdma_init(struct uwb_dev *dev, uint16_t nslots)
     tdma->ccp = (struct uwb_ccp_instance*)uwb_mac_find_cb_inst_ptr(dev, UWBEXT_CCP);
     assert(tdma->ccp);
 
+#if MYNEWT_VAL(TDMA_STATS) || MYNEWT_VAL(TDMA_LATENCY_HIST)
+    int rc;
+#endif
 #if MYNEWT_VAL(TDMA_STATS)
-    int rc = stats_init(
+    rc = stats_init(
                 STATS_HDR(tdma->stat),
                 STATS_SIZE_INIT_PARMS(tdma->stat, STATS_SIZE_32),
                 STATS_NAME_INIT_PARMS(tdma_stat_section)
@@ -140,11 +204,30 @@ tdma_init(struct uwb_dev *dev, uint16_t nslots)
 #endif
     assert(rc == 0);
 #endif
+#if MYNEWT_VAL(TDMA_LATENCY_HIST)
+    rc = stats_init(
+                STATS_HDR(tdma->lat_stat),
+                STATS_SIZE_INIT_PARMS(tdma->lat_stat, STATS_SIZE_32),
+                STATS_NAME_INIT_PARMS(tdma_lat_stat_section)
+            );
+    assert(rc == 0);
+
+#if  MYNEWT_VAL(UWB_DEVICE_0) && !MYNEWT_VAL(UWB_DEVICE_1)
+    rc = stats_register("tdma_lat", STATS_HDR(tdma->lat_stat));
+#elif  MYNEWT_VAL(UWB_DEVICE_0) && MYNEWT_VAL(UWB_DEVICE_1)
+    if (dev->idx == 0)
+        rc |= stats_register("tdma0_lat", STATS_HDR(tdma->lat_stat));
+    else
+        rc |= stats_register("tdma1_lat", STATS_HDR(tdma->lat_stat));
+#endif
+    assert(rc == 0);
+#endif
 
     tdma->superframe_slot.parent = tdma;
     tdma->superframe_slot.idx = 0;
-    dpl_cputime_timer_init(&tdma->superframe_slot.timer, slot_timer_cb, (void *) &tdma->superframe_slot);
+    dpl_cputime_timer_init(&tdma->superframe_timer, slot_timer_cb, (void *) &tdma->superframe_slot);
     dpl_event_init(&tdma->superframe_slot.event, tdma_superframe_slot_cb, (void *) &tdma->superframe_slot);
+    dpl_cputime_timer_init(&tdma->slot_timer, tdma_slot_timer_cb, (void *) tdma);
     tdma->status.initialized = true;
 
     tdma->os_epoch = dpl_cputime_get32();
@@ -242,8 +325,8 @@ tdma_tasks_init(struct _tdma_instance_t * inst)
 static void *
 tdma_task(void *arg)
 {
-#if MYNEWT_VAL(TDMA_MAX_SLOT_DELAY_US) > 0
-    uint32_t ticks, delay;
+#if MYNEWT_VAL(TDMA_MAX_SLOT_DELAY_US) > 0 || MYNEWT_VAL(TDMA_LATENCY_HIST)
+    int32_t delay;
     tdma_slot_t * slot;
 #endif
     struct dpl_event *ev;
@@ -251,7 +334,7 @@ tdma_task(void *arg)
 
     while (1) {
         ev = dpl_eventq_get(&tdma->eventq);
-#if MYNEWT_VAL(TDMA_MAX_SLOT_DELAY_US) == 0
+#if MYNEWT_VAL(TDMA_MAX_SLOT_DELAY_US) == 0 && !MYNEWT_VAL(TDMA_LATENCY_HIST)
         dpl_event_run(ev);
 
 #else
@@ -263,15 +346,27 @@ tdma_task(void *arg)
 #endif
         /* Assume all other events are tdma_slots */
         slot = (tdma_slot_t *) dpl_event_get_arg(ev);
-        ticks = dpl_cputime_get32();
-        delay = dpl_cputime_ticks_to_usecs(ticks - slot->cputime_slot_start);
+        if (slot == &tdma->superframe_slot) {
+            dpl_event_run(ev);
+            continue;
+        }
+        delay = tdma_slot_late_usecs(dpl_cputime_get32(), slot->cputime_slot_start);
+        TDMA_LAT_RECORD(deq, delay);
 
+#if MYNEWT_VAL(TDMA_MAX_SLOT_DELAY_US) > 0
         /* Ignore slots if we're too late in to run them */
         if (slot->idx!=0 && delay > MYNEWT_VAL(TDMA_MAX_SLOT_DELAY_US)) {
             TDMA_STATS_INC(dropped_slots);
-        } else{
-            dpl_event_run(ev);
+            continue;
         }
+#endif
+#if MYNEWT_VAL(TDMA_LATENCY_HIST)
+        tdma->running_slot = slot;
+        dpl_event_run(ev);
+        tdma->running_slot = NULL;
+#else
+        dpl_event_run(ev);
+#endif
 #endif
     }
     return NULL;
@@ -309,6 +404,67 @@ superframe_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
     return false;
 }
 
+/**
+ * @fn tdma_slot_timer_arm(struct _tdma_instance_t * tdma)
+ * @brief (Re)arm the slot timer for the slot at next_slot in the slot table.
+ * Must be called with interrupts disabled.
+ *
+ * @param tdma  Pointer to _tdma_instance_t.
+ *
+ * @return void
+ */
+static void
+tdma_slot_timer_arm(struct _tdma_instance_t * tdma)
+{
+    dpl_cputime_timer_stop(&tdma->slot_timer);
+    if (tdma->status.slots_armed && tdma->next_slot < tdma->nactive) {
+        tdma_slot_t * slot = tdma->slot[tdma->slot_table[tdma->next_slot]];
+        dpl_cputime_timer_start(&tdma->slot_timer, slot->cputime_slot_start);
+    }
+}
+
+/**
+ * @fn tdma_slot_table_insert(struct _tdma_instance_t * tdma, tdma_slot_t * slot)
+ * @brief Add a newly assigned slot to the slot table, see tdma_slot_table_add().
+ *
+ * @param tdma  Pointer to _tdma_instance_t.
+ * @param slot  Slot, not yet in tdma->slot[].
+ *
+ * @return void
+ */
+static void
+tdma_slot_table_insert(struct _tdma_instance_t * tdma, tdma_slot_t * slot)
+{
+    dpl_sr_t sr;
+
+    DPL_ENTER_CRITICAL(sr);
+    if (tdma_slot_table_add(tdma, slot, dpl_cputime_get32())) {
+        tdma_slot_timer_arm(tdma);
+    }
+    DPL_EXIT_CRITICAL(sr);
+}
+
+/**
+ * @fn tdma_slot_table_remove(struct _tdma_instance_t * tdma, uint16_t idx)
+ * @brief Remove a slot from the slot table, see tdma_slot_table_del().
+ *
+ * @param tdma  Pointer to _tdma_instance_t.
+ * @param idx   Slot number.
+ *
+ * @return void
+ */
+static void
+tdma_slot_table_remove(struct _tdma_instance_t * tdma, uint16_t idx)
+{
+    dpl_sr_t sr;
+
+    DPL_ENTER_CRITICAL(sr);
+    if (tdma_slot_table_del(tdma, idx)) {
+        tdma_slot_timer_arm(tdma);
+    }
+    DPL_EXIT_CRITICAL(sr);
+}
+
 /**
  * @fn tdma_assign_slot(struct _tdma_instance_t * inst, void (* call_back )(struct dpl_event *), uint16_t idx, void * arg)
  * @brief API to intialise slot instance for the slot.Also initialise a timer and assigns callback for each slot.
@@ -329,18 +485,20 @@ tdma_assign_slot(struct _tdma_instance_t * inst, void (* call_back )(struct dpl_
        return;
 
     if (inst->slot[idx] == NULL){
-        inst->slot[idx] = (tdma_slot_t  *) calloc(1, sizeof(struct _tdma_slot_t));
-        assert(inst->slot[idx]);
+        tdma_slot_t * slot = (tdma_slot_t  *) calloc(1, sizeof(struct _tdma_slot_t));
+        assert(slot);
+        slot->idx = idx;
+        slot->parent = inst;
+        slot->arg = arg;
+        dpl_event_init(&slot->event, call_back, (void *) slot);
+        tdma_slot_table_insert(inst, slot);
     }else{
-        memset(inst->slot[idx], 0, sizeof(struct _tdma_slot_t));
+        dpl_sr_t sr;
+        DPL_ENTER_CRITICAL(sr);
+        inst->slot[idx]->arg = arg;
+        dpl_event_init(&inst->slot[idx]->event, call_back, (void *) inst->slot[idx]);
+        DPL_EXIT_CRITICAL(sr);
     }
-
-    inst->slot[idx]->idx = idx;
-    inst->slot[idx]->parent = inst;
-    inst->slot[idx]->arg = arg;
-
-    dpl_event_init(&inst->slot[idx]->event, call_back, (void *) inst->slot[idx]);
-    dpl_cputime_timer_init(&inst->slot[idx]->timer, slot_timer_cb, (void *) inst->slot[idx]);
 }
 EXPORT_SYMBOL(tdma_assign_slot);
 
@@ -359,9 +517,9 @@ tdma_release_slot(struct _tdma_instance_t * inst, uint16_t idx)
 {
     assert(idx < inst->nslots);
     if (inst->slot[idx]) {
-        dpl_cputime_timer_stop(&inst->slot[idx]->timer);
-        free(inst->slot[idx]);
-        inst->slot[idx] =  NULL;
+        tdma_slot_t * slot = inst->slot[idx];
+        tdma_slot_table_remove(inst, idx);
+        free(slot);
     }
 }
 EXPORT_SYMBOL(tdma_release_slot);
@@ -370,6 +528,7 @@ EXPORT_SYMBOL(tdma_release_slot);
  * @fn tdma_superframe_slot_cb(struct dpl_event * ev)
  * @brief This event is generated by ccp/clkcal complete event. This event defines the start of an superframe epoch.
  * The event also schedules a tdma_superframe_timer_cb which turns on the receiver in advance of the next superframe epoch.
+ * Slot start times are recomputed into the slot table, but only the first due slot is put on a timer.
  *
  * @param ev   Pointer to dpl_event.
  *
@@ -380,9 +539,13 @@ tdma_superframe_slot_cb(struct dpl_event * ev)
 {
     uint16_t i;
     uint32_t slot_period_us;
+#if MYNEWT_VAL(TDMA_STATS)
+    uint32_t proc_us, ticks = dpl_cputime_get32();
+#endif
     struct _tdma_slot_t *slot;
     tdma_instance_t * tdma;
     struct uwb_ccp_instance * ccp;
+    dpl_sr_t sr;
     assert(ev != NULL);
     assert(dpl_event_get_arg(ev) != NULL);
 
@@ -394,37 +557,45 @@ tdma_superframe_slot_cb(struct dpl_event * ev)
 
     TDMA_STATS_INC(superframe_cnt);
 
-    /* Make sure all timers are stopped */
-    dpl_cputime_timer_stop(&slot->timer);
-    for (i = 0; i < tdma->nslots; i++) {
-        if (tdma->slot[i]){
-            dpl_cputime_timer_stop(&tdma->slot[i]->timer);
-        }
-    }
+    dpl_cputime_timer_stop(&tdma->superframe_timer);
 #if __KERNEL__
     slot_period_us = uwb_dwt_usecs_to_usecs(div64_s64(ccp->period, tdma->nslots));
 #else
     slot_period_us = uwb_dwt_usecs_to_usecs(ccp->period / tdma->nslots);
 #endif
-    for (i = 0; i < tdma->nslots; i++) {
-        if (tdma->slot[i]){
-            tdma->slot[i]->cputime_slot_start = tdma->os_epoch
-                + dpl_cputime_usecs_to_ticks((uint32_t) (i * slot_period_us) - MYNEWT_VAL(OS_LATENCY));
-            hal_timer_start_at(&tdma->slot[i]->timer, tdma->slot[i]->cputime_slot_start);
-        }
+
+    /* Rebuild the slot start table and arm the slot timer for the first slot only,
+     * tdma_slot_timer_cb walks the rest of the table */
+    DPL_ENTER_CRITICAL(sr);
+    tdma->slot_period_us = slot_period_us;
+    for (i = 0; i < tdma->nactive; i++) {
+        uint16_t idx = tdma->slot_table[i];
+        tdma->slot[idx]->cputime_slot_start = tdma_slot_start(tdma, idx);
     }
+    tdma->next_slot = 0;
+    tdma->status.slots_armed = 1;
+    tdma_slot_timer_arm(tdma);
+    DPL_EXIT_CRITICAL(sr);
 
     /* Next superframe slot estimate */
     slot->cputime_slot_start = tdma->os_epoch
         + dpl_cputime_usecs_to_ticks(
             (uint32_t)uwb_dwt_usecs_to_usecs(ccp->period) + slot_period_us);
-    hal_timer_start_at(&slot->timer, slot->cputime_slot_start);
+    hal_timer_start_at(&tdma->superframe_timer, slot->cputime_slot_start);
+
+#if MYNEWT_VAL(TDMA_STATS)
+    proc_us = dpl_cputime_ticks_to_usecs(dpl_cputime_get32() - ticks);
+    TDMA_STATS_SET(superframe_proc_us, proc_us);
+    if (proc_us > tdma->stat.STATS_SECT_VAR(superframe_proc_max_us)) {
+        TDMA_STATS_SET(superframe_proc_max_us, proc_us);
+    }
+#endif
 }
 
 /**
  * @fn slot_timer_cb(void * arg)
- * @brief API for each slot. This function then puts
- * the callback provided by the user in the tdma event queue.
+ * @brief Superframe slot timer. Only expires if the next superframe was not
+ * received from ccp in time.
  *
  * @param arg    A void type argument.
  *
@@ -436,10 +607,6 @@ slot_timer_cb(void * arg)
     assert(arg);
 
     tdma_slot_t * slot = (tdma_slot_t *) arg;
-    /* No point in continuing if this slot is NULL */
-    if (slot == NULL) {
-        return;
-    }
     tdma_instance_t * tdma = slot->parent;
 
     DIAGMSG("{\"utime\": %"PRIu32",\"msg\": \"slot_timer_cb\"}\n",
@@ -447,17 +614,46 @@ slot_timer_cb(void * arg)
 
     TDMA_STATS_INC(slot_timer_cnt);
 
-    if (slot == &tdma->superframe_slot) {
-        /* Superframe must have been missed by ccp */
-        TDMA_STATS_INC(superframe_miss);
-        return;
-    }
+    /* Superframe must have been missed by ccp */
+    TDMA_STATS_INC(superframe_miss);
+}
+
+/**
+ * @fn tdma_slot_timer_cb(void * arg)
+ * @brief Rolling slot timer. Puts the callback of every slot that is due in the
+ * tdma event queue and re-arms itself for the next slot in the slot table.
+ *
+ * @param arg    Pointer to _tdma_instance_t.
+ *
+ * @return void
+ */
+static void
+tdma_slot_timer_cb(void * arg)
+{
+    assert(arg);
 
+    tdma_instance_t * tdma = (tdma_instance_t *) arg;
+    uint32_t now = dpl_cputime_get32();
+    tdma_slot_t * slot;
+
+    DIAGMSG("{\"utime\": %"PRIu32",\"msg\": \"tdma_slot_timer_cb\"}\n",
+            dpl_cputime_ticks_to_usecs(now));
+
+    TDMA_STATS_INC(slot_timer_cnt);
+
+    while ((slot = tdma_slot_table_due(tdma, now)) != NULL) {
+        TDMA_LAT_RECORD(fire, (int32_t)(now - slot->cputime_slot_start) > 0 ?
+                        (int32_t) dpl_cputime_ticks_to_usecs(now - slot->cputime_slot_start) : 0);
 #ifdef TDMA_TASKS_ENABLE
-    dpl_eventq_put(&tdma->eventq, &slot->event);
+        dpl_eventq_put(&tdma->eventq, &slot->event);
 #else
-    dpl_eventq_put(&tdma->dev_inst->eventq, &slot->event);
+        dpl_eventq_put(&tdma->dev_inst->eventq, &slot->event);
 #endif
+    }
+    if (tdma->next_slot < tdma->nactive) {
+        slot = tdma->slot[tdma->slot_table[tdma->next_slot]];
+        dpl_cputime_timer_start(&tdma->slot_timer, slot->cputime_slot_start);
+    }
 }
 
 /**
@@ -472,9 +668,14 @@ void
 tdma_stop(struct _tdma_instance_t * tdma)
 {
     uint16_t i;
+    dpl_sr_t sr;
+
+    DPL_ENTER_CRITICAL(sr);
+    tdma->status.slots_armed = 0;
+    dpl_cputime_timer_stop(&tdma->slot_timer);
+    DPL_EXIT_CRITICAL(sr);
     for (i = 0; i < tdma->nslots; i++) {
         if (tdma->slot[i]){
-            dpl_cputime_timer_stop(&tdma->slot[i]->timer);
             tdma_release_slot(tdma, i);
         }
     }
@@ -513,6 +714,20 @@ tdma_rx_slot_start(struct _tdma_instance_t * tdma, dpl_float32_t idx)
 #else
     dx_time = ccp->local_epoch + slot_offset;
 #endif
+
+#if MYNEWT_VAL(TDMA_LATENCY_HIST)
+    /* First delayed start computed by a running slot, see how much of the
+     * OS_LATENCY lead it has used up since the slot timer fired. Cputime is a
+     * register read, the radio clock would cost an spi transfer on this path */
+    if (tdma->running_slot) {
+        int32_t used = tdma_slot_late_usecs(dpl_cputime_get32(), tdma->running_slot->cputime_slot_start);
+        tdma->running_slot = NULL;
+        TDMA_LAT_RECORD(radio, used);
+        if (used >= MYNEWT_VAL(OS_LATENCY)) {
+            STATS_INC(tdma->lat_stat, radio_late);
+        }
+    }
+#endif
     return dx_time;
 }
 EXPORT_SYMBOL(tdma_rx_slot_start);
@@ -0,0 +1,137 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file tdma_slots.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Sorted slot table of the tdma rolling slot timer
+ *
+ * @details The assigned slots are kept in slot_table in ascending slot number,
+ * which is also start time order within a superframe. next_slot is the cursor
+ * of the slot timer, the slots before it have been queued in the current
+ * superframe. These functions only keep the table and cursor consistent, the
+ * caller holds the critical section and (re)arms the slot timer, see tdma.c.
+ */
+
+#include <string.h>
+#include <stdbool.h>
+#include <dpl/dpl.h>
+#include <tdma/tdma.h>
+
+/**
+ * @fn tdma_slot_table_add(struct _tdma_instance_t * tdma, tdma_slot_t * slot, uint32_t now)
+ * @brief Add a newly assigned slot. A slot added to a running superframe is
+ * scheduled in it if its start is still ahead of the cursor and of now,
+ * otherwise it first runs in the next superframe.
+ *
+ * @param tdma  Pointer to _tdma_instance_t.
+ * @param slot  Slot, not yet in tdma->slot[].
+ * @param now   Current cputime.
+ *
+ * @return true if the slot at the cursor changed and the slot timer must be re-armed
+ */
+bool
+tdma_slot_table_add(struct _tdma_instance_t * tdma, tdma_slot_t * slot, uint32_t now)
+{
+    uint16_t lo = 0, hi = tdma->nactive, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (tdma->slot_table[mid] < slot->idx) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    memmove(&tdma->slot_table[lo + 1], &tdma->slot_table[lo],
+            (tdma->nactive - lo) * sizeof(tdma->slot_table[0]));
+    tdma->slot_table[lo] = slot->idx;
+    tdma->nactive++;
+    slot->cputime_slot_start = tdma_slot_start(tdma, slot->idx);
+    tdma->slot[slot->idx] = slot;
+
+    if (lo < tdma->next_slot) {
+        tdma->next_slot++;
+    } else if (lo == tdma->next_slot) {
+        if (tdma->status.slots_armed && (int32_t)(slot->cputime_slot_start - now) <= 0) {
+            /* Too late for this superframe, the timer stays on the following slot */
+            tdma->next_slot++;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @fn tdma_slot_table_del(struct _tdma_instance_t * tdma, uint16_t idx)
+ * @brief Remove a slot, the cursor keeps pointing at the same following slot.
+ *
+ * @param tdma  Pointer to _tdma_instance_t.
+ * @param idx   Slot number.
+ *
+ * @return true if the slot at the cursor was removed and the slot timer must be re-armed
+ */
+bool
+tdma_slot_table_del(struct _tdma_instance_t * tdma, uint16_t idx)
+{
+    bool rearm = false;
+    uint16_t pos;
+
+    for (pos = 0; pos < tdma->nactive && tdma->slot_table[pos] != idx; pos++);
+    if (pos < tdma->nactive) {
+        memmove(&tdma->slot_table[pos], &tdma->slot_table[pos + 1],
+                (tdma->nactive - pos - 1) * sizeof(tdma->slot_table[0]));
+        tdma->nactive--;
+        if (pos < tdma->next_slot) {
+            tdma->next_slot--;
+        } else if (pos == tdma->next_slot) {
+            rearm = true;
+        }
+    }
+    tdma->slot[idx] = NULL;
+    return rearm;
+}
+
+/**
+ * @fn tdma_slot_table_due(struct _tdma_instance_t * tdma, uint32_t now)
+ * @brief Take the slot at the cursor if it has started by now. Start times are
+ * compared as signed differences so this holds across the wrap of cputime.
+ *
+ * @param tdma  Pointer to _tdma_instance_t.
+ * @param now   Current cputime.
+ *
+ * @return The due slot, NULL if the next slot is still ahead or the superframe is done
+ */
+tdma_slot_t *
+tdma_slot_table_due(struct _tdma_instance_t * tdma, uint32_t now)
+{
+    tdma_slot_t * slot;
+
+    if (tdma->next_slot >= tdma->nactive) {
+        return NULL;
+    }
+    slot = tdma->slot[tdma->slot_table[tdma->next_slot]];
+    if ((int32_t)(slot->cputime_slot_start - now) > 0) {
+        return NULL;
+    }
+    tdma->next_slot++;
+    return slot;
+}
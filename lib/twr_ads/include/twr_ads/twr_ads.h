@@ -0,0 +1,69 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file twr_ads.h
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Range
+ *
+ * @details Asymmetric double sided TWR using three frames; poll, response and a final
+ * carrying the initiator's timestamps. The range is computed on the responder.
+ *
+ */
+
+#ifndef _TWR_ADS_H_
+#define _TWR_ADS_H_
+
+#if MYNEWT_VAL(TWR_ADS_ENABLED)
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <uwb/uwb.h>
+#include <uwb/uwb_ftypes.h>
+#include <uwb_rng/uwb_rng.h>
+
+//! Only the header, reception, transmission and request timestamps of the final frame are sent
+#define TWR_ADS_FINAL_FRAME_SIZE (offsetof(twr_frame_final_t, response_timestamp))
+
+//! On-air cost of one complete ranging exchange
+struct twr_ads_airtime {
+    uint16_t nframes;               //!< Number of frames exchanged
+    uint16_t nbytes;                //!< Sum of frame lengths, excluding CRC
+    uint32_t airtime;               //!< Sum of frame durations (usec)
+    uint32_t duration;              //!< First tx to last rx, including holdoffs (usec)
+};
+
+void twr_ads_pkg_init(void);
+int twr_ads_pkg_down(int reason);
+void twr_ads_free(struct uwb_dev * inst);
+void twr_ads_airtime(struct uwb_dev * inst, uwb_dataframe_code_t code, struct twr_ads_airtime * ret);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TWR_ADS_ENABLED
+#endif //_TWR_ADS_H_
@@ -0,0 +1,427 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file twr_ads.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Range
+ *
+ * @details Asymmetric double sided TWR. The initiator sends a poll, the responder answers and
+ * the initiator closes with a final frame carrying its poll tx, response rx and (predicted)
+ * final tx timestamps. That is all the responder needs to compute the double sided ToF, so
+ * compared to twr_ds the exchange saves the FINAL report frame and shortens the last frame.
+ * When TWR_ADS_REPORT is set the responder sends the result back to the initiator.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <dpl/dpl.h>
+#include <dpl/dpl_cputime.h>
+#include <hal/hal_spi.h>
+#include <hal/hal_gpio.h>
+
+#include <stats/stats.h>
+#include <uwb/uwb.h>
+#include <uwb_rng/uwb_rng.h>
+#include <twr_ads/twr_ads.h>
+
+#if MYNEWT_VAL(TWR_ADS_STATS)
+STATS_SECT_START(twr_ads_stat_section)
+    STATS_SECT_ENTRY(complete)
+    STATS_SECT_ENTRY(report)
+    STATS_SECT_ENTRY(start_tx_error)
+STATS_SECT_END
+
+STATS_NAME_START(twr_ads_stat_section)
+    STATS_NAME(twr_ads_stat_section, complete)
+    STATS_NAME(twr_ads_stat_section, report)
+    STATS_NAME(twr_ads_stat_section, start_tx_error)
+STATS_NAME_END(twr_ads_stat_section)
+
+static STATS_SECT_DECL(twr_ads_stat_section) g_twr_ads_stat;
+#define ADS_STATS_INC(__X) STATS_INC(g_twr_ads_stat, __X)
+#else
+#define ADS_STATS_INC(__X) {}
+#endif
+
+static bool rx_complete_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs);
+
+static struct uwb_mac_interface g_cbs[] = {
+        [0] = {
+            .id = UWBEXT_RNG_ADS,
+            .rx_complete_cb = rx_complete_cb,
+        },
+#if MYNEWT_VAL(UWB_DEVICE_1) || MYNEWT_VAL(UWB_DEVICE_2)
+        [1] = {
+            .id = UWBEXT_RNG_ADS,
+            .rx_complete_cb = rx_complete_cb,
+        },
+#endif
+#if MYNEWT_VAL(UWB_DEVICE_2)
+        [2] = {
+            .id = UWBEXT_RNG_ADS,
+            .rx_complete_cb = rx_complete_cb,
+        }
+#endif
+};
+
+static struct uwb_rng_config g_config = {
+    .tx_holdoff_delay = MYNEWT_VAL(TWR_ADS_TX_HOLDOFF),         // Send Time delay in usec.
+    .rx_timeout_delay = MYNEWT_VAL(TWR_ADS_RX_TIMEOUT)          // Receive response timeout in usec
+};
+
+static struct rng_config_list g_rng_cfgs[] = {
+    [0] = {
+        .rng_code = UWB_DATA_CODE_ADS_TWR,
+        .name = "twr_ads",
+        .config = &g_config
+    },
+#if MYNEWT_VAL(UWB_DEVICE_1) ||  MYNEWT_VAL(UWB_DEVICE_2)
+    [1] = {
+        .rng_code = UWB_DATA_CODE_ADS_TWR,
+        .name = "twr_ads",
+        .config = &g_config
+    },
+#endif
+#if MYNEWT_VAL(UWB_DEVICE_2)
+    [2] = {
+        .rng_code = UWB_DATA_CODE_ADS_TWR,
+        .name = "twr_ads",
+        .config = &g_config
+    },
+#endif
+};
+
+/**
+ * API to initialise the twr_ads package.
+ *
+ *
+ * @return void
+ */
+void
+twr_ads_pkg_init(void)
+{
+    int i, rc;
+    struct uwb_dev *udev;
+#if MYNEWT_VAL(UWB_PKG_INIT_LOG)
+    printf("{\"utime\": %"PRIu32",\"msg\": \"twr_ads_pkg_init\"}\n",
+           dpl_cputime_ticks_to_usecs(dpl_cputime_get32()));
+#endif
+
+    for (i=0;i < sizeof(g_cbs)/sizeof(g_cbs[0]);i++) {
+        udev = uwb_dev_idx_lookup(i);
+        if (!udev) {
+            continue;
+        }
+        g_cbs[i].inst_ptr = (struct uwb_rng_instance*)uwb_mac_find_cb_inst_ptr(udev, UWBEXT_RNG);
+        uwb_mac_append_interface(udev, &g_cbs[i]);
+        uwb_rng_append_config(g_cbs[i].inst_ptr, &g_rng_cfgs[i]);
+    }
+
+#if MYNEWT_VAL(TWR_ADS_STATS)
+    rc = stats_init(
+        STATS_HDR(g_twr_ads_stat),
+        STATS_SIZE_INIT_PARMS(g_twr_ads_stat, STATS_SIZE_32),
+        STATS_NAME_INIT_PARMS(twr_ads_stat_section));
+    assert(rc == 0);
+
+    rc = stats_register("twr_ads", STATS_HDR(g_twr_ads_stat));
+    assert(rc == 0);
+#endif
+}
+
+/**
+ * API to free the allocated resources.
+ *
+ * @param inst  Pointer to struct uwb_dev.
+ *
+ * @return void
+ */
+void
+twr_ads_free(struct uwb_dev * inst){
+    assert(inst);
+    uwb_mac_remove_interface(inst, UWBEXT_RNG_ADS);
+}
+
+int
+twr_ads_pkg_down(int reason)
+{
+    int i;
+    struct uwb_rng_instance * rng;
+
+    for (i=0;i < sizeof(g_cbs)/sizeof(g_cbs[0]);i++) {
+        rng = (struct uwb_rng_instance *)g_cbs[i].inst_ptr;
+        if (!rng) continue;
+        uwb_rng_remove_config(g_cbs[i].inst_ptr, g_rng_cfgs[i].rng_code);
+        twr_ads_free(rng->dev_inst);
+    }
+    return 0;
+}
+
+/**
+ * API to calculate the on-air cost of one ranging exchange with the current phy settings.
+ * Use with UWB_DATA_CODE_DS_TWR and UWB_DATA_CODE_ADS_TWR to compare classic and
+ * three message double sided ranging; 1e6/duration is the upper bound on ranges/sec.
+ *
+ * @param inst  Pointer to struct uwb_dev.
+ * @param code  UWB_DATA_CODE_DS_TWR or UWB_DATA_CODE_ADS_TWR.
+ * @param ret   Pointer to struct twr_ads_airtime which will contain the results.
+ *
+ * @return void
+ */
+void
+twr_ads_airtime(struct uwb_dev * inst, uwb_dataframe_code_t code, struct twr_ads_airtime * ret)
+{
+    static const uint16_t ds_lens[] = {
+        sizeof(ieee_rng_request_frame_t), sizeof(ieee_rng_response_frame_t),
+        sizeof(twr_frame_final_t), sizeof(twr_frame_final_t)
+    };
+    static const uint16_t ads_lens[] = {
+        sizeof(ieee_rng_request_frame_t), sizeof(ieee_rng_response_frame_t),
+        TWR_ADS_FINAL_FRAME_SIZE, sizeof(twr_frame_final_t)
+    };
+    const uint16_t * lens;
+    uint16_t i;
+    uint32_t holdoff = g_config.tx_holdoff_delay;
+    struct uwb_rng_instance * rng = (struct uwb_rng_instance*)uwb_mac_find_cb_inst_ptr(inst, UWBEXT_RNG);
+
+    assert(ret);
+    if (rng) {
+        holdoff = uwb_rng_get_config(rng, code)->tx_holdoff_delay;
+    }
+
+    if (code == UWB_DATA_CODE_ADS_TWR) {
+        lens = ads_lens;
+        ret->nframes = (MYNEWT_VAL(TWR_ADS_REPORT)) ? 4 : 3;
+    } else {
+        lens = ds_lens;
+        ret->nframes = 4;
+    }
+
+    ret->nbytes = 0;
+    ret->airtime = 0;
+    for (i = 0; i < ret->nframes; i++) {
+        ret->nbytes += lens[i];
+        ret->airtime += uwb_phy_frame_duration(inst, lens[i]);
+    }
+    ret->duration = ret->airtime + (ret->nframes - 1) * (uint32_t)uwb_dwt_usecs_to_usecs(holdoff);
+}
+
+/**
+ * API for receive complete callback.
+ *
+ * @param inst  Pointer to struct uwb_dev.
+ *
+ * @return true on sucess
+ */
+static bool
+rx_complete_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
+{
+    struct uwb_rng_txd txd;
+    if (inst->fctrl != FCNTL_IEEE_RANGE_16)
+        return false;
+
+    struct uwb_rng_instance * rng = (struct uwb_rng_instance *)cbs->inst_ptr;
+    assert(rng);
+    if(dpl_sem_get_count(&rng->sem) == 1) {
+        // unsolicited inbound
+        return false;
+    }
+
+    switch(rng->code){
+        case UWB_DATA_CODE_ADS_TWR:
+            {
+                // This code executes on the device that is responding to a original request
+                twr_frame_t * frame = rng->frames[(rng->idx)%rng->nframes];  // Frame already read within loader layers.
+
+                if (inst->frame_len != sizeof(ieee_rng_request_frame_t))
+                    break;
+
+                uint64_t request_timestamp = inst->rxtimestamp;
+                uwb_rng_calc_rel_tx(rng, &txd, &g_config, request_timestamp, inst->frame_len);
+
+                frame->reception_timestamp =  (uint32_t) (request_timestamp & 0xFFFFFFFFUL);
+                frame->transmission_timestamp =  (uint32_t) (txd.response_timestamp & 0xFFFFFFFFUL);
+
+                frame->dst_address = frame->src_address;
+                frame->src_address = inst->my_short_address;
+#if MYNEWT_VAL(UWB_WCS_ENABLED)
+                frame->carrier_integrator  = 0.0l;
+#else
+                frame->carrier_integrator  = - inst->carrier_integrator;
+#endif
+                frame->code = UWB_DATA_CODE_ADS_TWR_T1;
+
+                uwb_write_tx(inst, frame->array, 0, sizeof(ieee_rng_response_frame_t));
+                uwb_write_tx_fctrl(inst, sizeof(ieee_rng_response_frame_t), 0);
+                uwb_set_wait4resp(inst, true);
+
+                uwb_set_delay_start(inst, txd.response_tx_delay);
+                // Disable default behavor, do not RXENAB on RXFCG thereby avoiding rx timeout events
+                uwb_set_rxauto_disable(inst, true);
+
+                if (uwb_start_tx(inst).start_tx_error){
+                    ADS_STATS_INC(start_tx_error);
+                    dpl_sem_release(&rng->sem);
+                }
+
+                /* Setup when to listen for the final, relative the end of our transmitted frame */
+                uwb_set_wait4resp_delay(inst, g_config.tx_holdoff_delay -
+                                        inst->config.rx.timeToRxStable);
+                uwb_set_rx_timeout(inst, uwb_usecs_to_dwt_usecs(uwb_phy_frame_duration(inst, TWR_ADS_FINAL_FRAME_SIZE)) +
+                                   g_config.rx_timeout_delay + inst->config.rx.timeToRxStable);
+                break;
+            }
+        case UWB_DATA_CODE_ADS_TWR_T1:
+            {
+                // This code executes on the device that initiated the original request. The final
+                // carries all three initiator timestamps so no further frame is needed from the responder.
+                if(inst->status.lde_error)
+                    break;
+                if (inst->frame_len != sizeof(ieee_rng_response_frame_t))
+                    break;
+
+                twr_frame_t * frame = rng->frames[(rng->idx)%rng->nframes];
+                twr_frame_t * next_frame = rng->frames[(rng->idx+1)%rng->nframes];
+
+                uint64_t response_timestamp = inst->rxtimestamp;
+                frame->request_timestamp = next_frame->request_timestamp = uwb_read_txtime_lo32(inst); // This corresponds to when the original request was actually sent
+                frame->response_timestamp = next_frame->response_timestamp = (uint32_t)(response_timestamp & 0xFFFFFFFFUL); // This corresponds to the response just received
+
+                uint16_t src_address = frame->src_address;
+                uint8_t seq_num = frame->seq_num;
+
+#if MYNEWT_VAL(UWB_WCS_ENABLED)
+                frame->carrier_integrator  = 0.0l;
+#else
+                frame->carrier_integrator  = inst->carrier_integrator;
+#endif
+                // Note:: Advance to next frame
+                frame = next_frame;
+                frame->dst_address = src_address;
+                frame->src_address = inst->my_short_address;
+                frame->seq_num = seq_num + 1;
+                frame->code = UWB_DATA_CODE_ADS_TWR_FINAL;
+
+                uwb_rng_calc_rel_tx(rng, &txd, &g_config, response_timestamp, inst->frame_len);
+
+                frame->reception_timestamp =  (uint32_t) (response_timestamp & 0xFFFFFFFFUL);
+                frame->transmission_timestamp =  (uint32_t) (txd.response_timestamp & 0xFFFFFFFFUL);
+
+                uwb_write_tx(inst, frame->array, 0, TWR_ADS_FINAL_FRAME_SIZE);
+                uwb_write_tx_fctrl(inst, TWR_ADS_FINAL_FRAME_SIZE, 0);
+                uwb_set_wait4resp(inst, MYNEWT_VAL(TWR_ADS_REPORT));
+                uwb_set_delay_start(inst, txd.response_tx_delay);
+
+                // Disable default behavor, do not RXENAB on RXFCG thereby avoiding rx timeout events on sucess
+                uwb_set_rxauto_disable(inst, true);
+
+                if (uwb_start_tx(inst).start_tx_error){
+                    ADS_STATS_INC(start_tx_error);
+                    dpl_sem_release(&rng->sem);
+                    break;
+                }
+#if MYNEWT_VAL(TWR_ADS_REPORT)
+                /* Setup when to listen for the report, relative the end of our transmitted frame */
+                uwb_set_wait4resp_delay(inst, g_config.tx_holdoff_delay -
+                                        inst->config.rx.timeToRxStable);
+                uwb_set_rx_timeout(inst, uwb_usecs_to_dwt_usecs(uwb_phy_frame_duration(inst, sizeof(twr_frame_final_t))) +
+                                   g_config.rx_timeout_delay + inst->config.rx.timeToRxStable);
+#else
+                /* The range is only known to the responder, exchange ends once the final is out */
+                rng->control.release_after_tx = 1;
+#endif
+                break;
+            }
+        case UWB_DATA_CODE_ADS_TWR_FINAL:
+            {
+                // This code executes on the device that responded to the original request. The final
+                // completes both round trips so the range can be calculated here.
+                if(inst->status.lde_error)
+                    break;
+                if (inst->frame_len != TWR_ADS_FINAL_FRAME_SIZE)
+                    break;
+
+                twr_frame_t * previous_frame = rng->frames[(uint16_t)(rng->idx-1)%rng->nframes];
+                twr_frame_t * frame = rng->frames[(rng->idx)%rng->nframes];
+
+                // First round trip; poll tx and response rx as seen by the initiator
+                previous_frame->request_timestamp = frame->request_timestamp;
+                previous_frame->response_timestamp = frame->reception_timestamp;
+
+                // Second round trip; response tx and final rx as seen by us
+                frame->request_timestamp = uwb_read_txtime_lo32(inst);
+                frame->response_timestamp = (uint32_t) (inst->rxtimestamp & 0xFFFFFFFFUL);
+
+                frame->dst_address = frame->src_address;
+                frame->src_address = inst->my_short_address;
+#if MYNEWT_VAL(UWB_WCS_ENABLED)
+                frame->carrier_integrator  = 0.0l;
+#else
+                frame->carrier_integrator  = - inst->carrier_integrator;
+#endif
+
+#if MYNEWT_VAL(TWR_ADS_REPORT)
+                frame->code = UWB_DATA_CODE_ADS_TWR_REPORT;
+
+                // Transmit timestamp report so the initiator can calculate the range too
+                uwb_write_tx(inst, frame->array, 0, sizeof(twr_frame_final_t));
+                uwb_write_tx_fctrl(inst, sizeof(twr_frame_final_t), 0);
+
+                uwb_rng_calc_rel_tx(rng, &txd, &g_config, inst->rxtimestamp, inst->frame_len);
+                uwb_set_delay_start(inst, txd.response_tx_delay);
+
+                if (uwb_start_tx(inst).start_tx_error) {
+                    ADS_STATS_INC(start_tx_error);
+                    dpl_sem_release(&rng->sem);
+                    rng_issue_complete(inst);
+                } else {
+                    ADS_STATS_INC(report);
+                    ADS_STATS_INC(complete);
+                    rng->control.complete_after_tx = 1;
+                }
+#else
+                ADS_STATS_INC(complete);
+                dpl_sem_release(&rng->sem);
+                rng_issue_complete(inst);
+#endif
+                break;
+            }
+        case UWB_DATA_CODE_ADS_TWR_REPORT:
+            {
+                // This code executes on the device that initiated the original request, and has now received the
+                // responder's timestamps. This marks the completion of the exchange with report-back.
+                if (inst->frame_len != sizeof(twr_frame_final_t))
+                    break;
+
+                ADS_STATS_INC(complete);
+                dpl_sem_release(&rng->sem);
+                rng_issue_complete(inst);
+                break;
+            }
+        default:
+                return false;
+                break;
+    }
+    return true;
+}
@@ -51,7 +51,6 @@ typedef struct _ccp_json{
         uint64_t ppm_uint64;
     };
     char iobuf[MYNEWT_VAL(UWB_CCP_JSON_BUFSIZE)];
-    uint16_t idx;
 }ccp_json_t;
 
 ccp_json_t * ccp_json_init(ccp_json_t * json);
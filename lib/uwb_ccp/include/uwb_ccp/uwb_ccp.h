@@ -59,9 +59,21 @@ STATS_SECT_START(uwb_ccp_stat_section)
 #if MYNEWT_VAL(UWB_CCP_TOLERATE_MISSED_FRAMES) > 0
     STATS_SECT_ENTRY(err_tolerated)
 #endif
+#if MYNEWT_VAL(UWB_CCP_HOLDOVER_FRAMES) > 0
+    STATS_SECT_ENTRY(holdover_enter)
+    STATS_SECT_ENTRY(holdover_frames)
+    STATS_SECT_ENTRY(holdover_exit)
+    STATS_SECT_ENTRY(holdover_timeout)
+    STATS_SECT_ENTRY(holdover_err_ns)
+#endif
+    STATS_SECT_ENTRY(tx_buf_full)
+    STATS_SECT_ENTRY(tx_buf_patch)
+    STATS_SECT_ENTRY(tx_buf_bytes)
     STATS_SECT_ENTRY(tx_start_error)
     STATS_SECT_ENTRY(tx_relay_error)
     STATS_SECT_ENTRY(tx_relay_ok)
+    STATS_SECT_ENTRY(rx_relay_error)
+    STATS_SECT_ENTRY(rx_relay_depth)
     STATS_SECT_ENTRY(irq_latency)
     STATS_SECT_ENTRY(os_lat_behind)
     STATS_SECT_ENTRY(os_lat_margin)
@@ -101,7 +113,7 @@ typedef union {
         uint16_t short_address;                 //!< Short Address
         union {
             struct _transmission_interval_struct{
-                uint64_t transmission_interval:40; //!< Transmission interval. Also used to correct transmission timestamp in relays
+                uint64_t transmission_interval:40; //!< Transmission interval
             };
             uint8_t ti_array[sizeof(struct _transmission_interval_struct)];
         }__attribute__((__packed__, aligned(1)));
@@ -109,6 +121,12 @@ typedef union {
         uint8_t rpt_count;                      //!< Repeat level
         uint8_t rpt_max;                        //!< Repeat max level
         uint16_t epoch_to_rm_us;                //!< How many uus before the rmarker the epoch is
+        union {
+            struct _rpt_delay_struct{
+                uint64_t rpt_delay:40;          //!< Master time from the master's rmarker to this frame's rmarker, 0 from the master
+            };
+            uint8_t rd_array[sizeof(struct _rpt_delay_struct)];
+        }__attribute__((__packed__, aligned(1)));
     }__attribute__((__packed__, aligned(1)));
     uint8_t array[sizeof(struct _uwb_ccp_blink_frame_t)];
 }uwb_ccp_blink_frame_t;
@@ -138,6 +156,7 @@ struct uwb_ccp_status {
     uint16_t timer_enabled:1;         //!< Indicates timer is enabled
     uint16_t timer_restarted:1;       //!< Indicates timer has been restarted
     uint16_t enabled:1;               //!< Current state of ccp
+    uint16_t holdover:1;              //!< Superframes are predicted from wcs, no ccp received
 };
 
 //! Extension ids for services.
@@ -154,7 +173,7 @@ typedef uint32_t (*uwb_ccp_tof_compensation_cb_t)(uint16_t short_addr);
 struct uwb_ccp_config {
     uint16_t postprocess:1;           //!< CCP postprocess
     uint16_t role:4;                  //!< ccp_role_t
-    uint16_t tx_holdoff_dly;          //!< Relay nodes holdoff
+    uint16_t tx_holdoff_dly;          //!< Relay nodes holdoff, ahead of each relay tier
 };
 
 //! uwb_ccp instance parameters.
@@ -181,6 +200,9 @@ struct uwb_ccp_instance {
     uint16_t idx;                                   //!< Circular buffer index pointer
     uint8_t seq_num;                                //!< Clock Master reported sequence number
     uint8_t missed_frames;                          //!< Num missed ccp-frames since last sync
+    uint32_t holdover_err;                          //!< Error bound of the predicted epochs in holdover, ns
+    uwb_ccp_blink_frame_t tx_shadow;                //!< Copy of the ccp frame held in the tx buffer
+    uint16_t tx_shadow_seq;                         //!< Device txbuf_seq after tx_shadow was written
     struct hal_timer timer;                         //!< Timer structure
     struct dpl_eventq eventq;                       //!< Event queues
     struct dpl_event timer_event;                   //!< Event callback
@@ -32,6 +32,7 @@
 #include <linux/sched/signal.h>
 #endif
 #include <linux/kfifo.h>
+#include <uwb/uwb_telemetry.h>
 #include <syscfg/syscfg.h>
 
 
@@ -48,6 +49,7 @@ struct ccp_encode_data {
     struct mutex write_lock;
     local_record_fifo_t fifo;
     int have_init;
+    uint32_t format;                    //!< uwb_telemetry_format_t of this device
 	struct device *dev;
 	struct cdev cdev;
 	struct class *class;
@@ -139,6 +141,29 @@ ccp_poll(struct file *filp, struct poll_table_struct *wait)
 	return mask;
 }
 
+static long
+ccp_chrdev_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    uint32_t format;
+    struct ccp_encode_data *ed = file->private_data;
+
+    switch (cmd) {
+    case UWB_TELEMETRY_IOC_SET_FORMAT:
+        if (get_user(format, (uint32_t __user *)arg)) {
+            return -EFAULT;
+        }
+        if (format > UWB_TELEMETRY_FORMAT_BINARY) {
+            return -EINVAL;
+        }
+        ed->format = format;
+        return 0;
+    case UWB_TELEMETRY_IOC_GET_FORMAT:
+        return put_user(ed->format, (uint32_t __user *)arg);
+    default:
+        return -ENOTTY;
+    }
+}
+
 static const struct file_operations ccp_chrdev_fops = {
     .owner   = THIS_MODULE,
     .open    = ccp_chrdev_open,
@@ -146,6 +171,7 @@ static const struct file_operations ccp_chrdev_fops = {
     .read    = ccp_chrdev_read,
     .write   = NULL,
     .poll    = ccp_poll,
+    .unlocked_ioctl = ccp_chrdev_ioctl,
 };
 
 static char*
@@ -210,6 +236,7 @@ ccp_chrdev_create(int idx)
     INIT_KFIFO(ed->fifo);
     init_waitqueue_head(&ed->wait);
 
+    ed->format = MYNEWT_VAL(UWB_TELEMETRY_FORMAT);
     ed->have_init = 1;
     return 0;
 
@@ -243,6 +270,15 @@ ccp_chrdev_destroy(int idx)
     unregister_chrdev_region(MKDEV(ed->major, 0), 1);
 }
 
+int
+ccp_chrdev_format(int idx)
+{
+    if (idx >= ARRAY_SIZE(ccp_encode_inst) || !ccp_encode_inst[idx].have_init) {
+        return UWB_TELEMETRY_FORMAT_JSON;
+    }
+    return ccp_encode_inst[idx].format;
+}
+
 int
 ccp_chrdev_output(int idx, char *buf, size_t len)
 {
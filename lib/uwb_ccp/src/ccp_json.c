@@ -31,8 +31,6 @@
 #include <uwb_ccp/ccp_json.h>
 
 
-static int ccp_write_line(void *buf, char* data, int len);
-
 ccp_json_t * ccp_json_init(ccp_json_t * json){
 
     if (json == NULL){
@@ -52,22 +50,6 @@ void ccp_json_free(ccp_json_t * json){
         free(json);
 }
 
-int
-ccp_write_line(void *buf, char* data, int len)
-{
-    ccp_json_t * json = buf;
-    for (uint16_t i=0; i < len; i++){
-        json->iobuf[(json->idx++)%MYNEWT_VAL(UWB_CCP_JSON_BUFSIZE)] = data[i];
-        if (data[i]=='\0'){
-            break;
-        }
-    }
-    if (json->iobuf[json->idx-1]=='\0')
-        json->idx = 0;
-
-    return len;
-}
-
 
 int
 ccp_json_write(ccp_json_t * json){
@@ -75,8 +57,7 @@ ccp_json_write(ccp_json_t * json){
     struct json_value value;
     int rc;
 
-    json->encoder.je_write = ccp_write_line;
-    json->encoder.je_arg = (void *)json;
+    json_encode_buf_init(&json->encoder, json->iobuf, sizeof(json->iobuf));
     json->decoder.json_buf.jb_read_next = json_read_next;
     json->decoder.json_buf.jb_read_prev = json_read_prev;
     json->decoder.json_buf.jb_readn = json_readn;
@@ -106,7 +87,9 @@ ccp_json_write(ccp_json_t * json){
     json->encoder.je_wr_commas = 0;
     assert(rc == 0);
 
-    ccp_write_line(json->encoder.je_arg, "\0", 1);
+    if (json_encode_buf_finish(&json->encoder) < 0) {
+        rc = -1;
+    }
     return rc;
 }
 
@@ -117,8 +100,7 @@ ccp_json_write_uint64(ccp_json_t * json){
     struct json_value value;
     int rc;
 
-    json->encoder.je_write = ccp_write_line;
-    json->encoder.je_arg = (void *) json;
+    json_encode_buf_init(&json->encoder, json->iobuf, sizeof(json->iobuf));
     json->decoder.json_buf.jb_read_next = json_read_next;
     json->decoder.json_buf.jb_read_prev = json_read_prev;
     json->decoder.json_buf.jb_readn = json_readn;
@@ -148,11 +130,15 @@ ccp_json_write_uint64(ccp_json_t * json){
     json->encoder.je_wr_commas = 0;
     assert(rc == 0);
 
-    ccp_write_line(json->encoder.je_arg, "\0", 1);
+    if (json_encode_buf_finish(&json->encoder) < 0) {
+        rc = -1;
+    }
     return rc;
 }
 
 #ifdef FLOAT_SUPPORT
+static struct json_attr_index ccp_json_read_index;
+
 int
 ccp_json_read(ccp_json_t * json, char * line){
 
@@ -202,8 +188,6 @@ ccp_json_read(ccp_json_t * json, char * line){
         }
     };
 
-    json->encoder.je_write = ccp_write_line;
-    json->encoder.je_arg = NULL;
     json->decoder.json_buf.jb_read_next = json_read_next;
     json->decoder.json_buf.jb_read_prev = json_read_prev;
     json->decoder.json_buf.jb_readn = json_readn;
@@ -212,13 +196,15 @@ ccp_json_read(ccp_json_t * json, char * line){
     json->decoder.end_buf = line + strlen(line);
     json->decoder.current_position = 0;
 
-    int rc = json_read_object(&json->decoder.json_buf, ccp_attr);
+    int rc = json_read_object_indexed(&json->decoder.json_buf, ccp_attr, &ccp_json_read_index);
 
     return rc;
 }
 
 #endif
 
+static struct json_attr_index ccp_json_read_uint64_index;
+
 int
 ccp_json_read_uint64(ccp_json_t * json, char * line){
 
@@ -265,8 +251,6 @@ ccp_json_read_uint64(ccp_json_t * json, char * line){
     };
 
 
-    json->encoder.je_write = ccp_write_line;
-    json->encoder.je_arg = NULL;
     json->decoder.json_buf.jb_read_next = json_read_next;
     json->decoder.json_buf.jb_read_prev = json_read_prev;
     json->decoder.json_buf.jb_readn = json_readn;
@@ -277,7 +261,7 @@ ccp_json_read_uint64(ccp_json_t * json, char * line){
 
     memset((void *)json + offsetof(ccp_json_t,utime), 0, offsetof(ccp_json_t,ppm) - offsetof(ccp_json_t,utime) + sizeof(json->ppm));
 
-    int rc = json_read_object(&json->decoder.json_buf, ccp_attr);
+    int rc = json_read_object_indexed(&json->decoder.json_buf, ccp_attr, &ccp_json_read_uint64_index);
 
     return rc;
 }
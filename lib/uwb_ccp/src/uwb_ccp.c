@@ -67,9 +67,21 @@ STATS_NAME_START(uwb_ccp_stat_section)
 #if MYNEWT_VAL(UWB_CCP_TOLERATE_MISSED_FRAMES) > 0
     STATS_NAME(uwb_ccp_stat_section, err_tolerated)
 #endif
+#if MYNEWT_VAL(UWB_CCP_HOLDOVER_FRAMES) > 0
+    STATS_NAME(uwb_ccp_stat_section, holdover_enter)
+    STATS_NAME(uwb_ccp_stat_section, holdover_frames)
+    STATS_NAME(uwb_ccp_stat_section, holdover_exit)
+    STATS_NAME(uwb_ccp_stat_section, holdover_timeout)
+    STATS_NAME(uwb_ccp_stat_section, holdover_err_ns)
+#endif
+    STATS_NAME(uwb_ccp_stat_section, tx_buf_full)
+    STATS_NAME(uwb_ccp_stat_section, tx_buf_patch)
+    STATS_NAME(uwb_ccp_stat_section, tx_buf_bytes)
     STATS_NAME(uwb_ccp_stat_section, tx_start_error)
     STATS_NAME(uwb_ccp_stat_section, tx_relay_error)
     STATS_NAME(uwb_ccp_stat_section, tx_relay_ok)
+    STATS_NAME(uwb_ccp_stat_section, rx_relay_error)
+    STATS_NAME(uwb_ccp_stat_section, rx_relay_depth)
     STATS_NAME(uwb_ccp_stat_section, irq_latency)
     STATS_NAME(uwb_ccp_stat_section, os_lat_behind)
     STATS_NAME(uwb_ccp_stat_section, os_lat_margin)
@@ -80,11 +92,17 @@ STATS_NAME_END(uwb_ccp_stat_section)
 
 #define CCP_STATS_INC(__X) STATS_INC(ccp->stat, __X)
 #define CCP_STATS_SET(__X, __N) {STATS_CLEAR(ccp->stat, __X);STATS_INCN(ccp->stat, __X, __N);}
+#define CCP_STATS_INCN(__X, __N) STATS_INCN(ccp->stat, __X, __N)
 #else
 #define CCP_STATS_INC(__X) {}
 #define CCP_STATS_SET(__X, __N) {}
+#define CCP_STATS_INCN(__X, __N) {}
 #endif
 
+/* Missed frames are answered with a predicted superframe */
+#define CCP_ISSUE_MISSED_SUPERFRAMES \
+    (MYNEWT_VAL(UWB_CCP_TOLERATE_MISSED_FRAMES) > 0 || MYNEWT_VAL(UWB_CCP_HOLDOVER_FRAMES) > 0)
+
 static bool rx_complete_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs);
 static bool tx_complete_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs);
 static bool rx_timeout_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs);
@@ -107,12 +125,125 @@ int ccp_chrdev_create(int idx);
 void ccp_sysfs_init(struct uwb_ccp_instance *ccp);
 void ccp_sysfs_deinit(int idx);
 int ccp_chrdev_output(int idx, char *buf, size_t len);
+int ccp_chrdev_format(int idx);
+#include <uwb/uwb_telemetry.h>
 #endif  /* __KERNEL__ */
 
 #if MYNEWT_VAL(UWB_CCP_VERBOSE)
 static void ccp_postprocess(struct dpl_event * ev);
 #endif
 
+/**
+ * @fn ccp_local_period(struct uwb_ccp_instance *ccp, uint32_t elapsed_us)
+ * @brief Local duration of one ccp period, predicted from the wcs skew and, when
+ * elapsed_us is non zero, the drift of the skew since the last received frame.
+ *
+ * @param ccp         Pointer to struct uwb_ccp_instance.
+ * @param elapsed_us  Time from the last received frame to the start of the period.
+ * @return period in dwt units (dtu)
+ */
+static uint64_t
+ccp_local_period(struct uwb_ccp_instance *ccp, uint32_t elapsed_us)
+{
+    uint64_t period = (uint64_t)ccp->period << 16;
+#if MYNEWT_VAL(UWB_WCS_ENABLED)
+    struct uwb_wcs_instance * wcs = ccp->wcs;
+    if (wcs) {
+        dpl_float64_t skew = wcs->normalized_skew;
+        if (wcs->status.valid && elapsed_us) {
+            /* states.drift is the rate of change of states.skew, per second */
+            skew = DPL_FLOAT64_ADD(skew, DPL_FLOAT64_MUL(
+                        DPL_FLOAT64_DIV(wcs->states.drift, DPL_FLOAT64_INIT(MYNEWT_VAL(UWB_WCS_DTU))),
+                        DPL_FLOAT64_MUL(DPL_FLOAT64_U64_TO_F64((uint64_t)elapsed_us), DPL_FLOAT64_INIT(1e-6l))));
+        }
+        period = DPL_FLOAT64_F64_TO_U64(DPL_FLOAT64_MUL(DPL_FLOAT64_U64_TO_F64(period), skew));
+    }
+#endif
+    return period;
+}
+
+/**
+ * @fn ccp_relay_tier_len(struct uwb_ccp_instance *ccp)
+ * @brief Duration of one relay tier, the holdoff followed by UWB_CCP_RELAY_TIER_SLOTS relay slots.
+ *
+ * @param ccp  Pointer to struct uwb_ccp_instance.
+ * @return tier length in dwt usec
+ */
+static uint32_t
+ccp_relay_tier_len(struct uwb_ccp_instance *ccp)
+{
+    uint32_t slot_len = ccp->blink_frame_duration + MYNEWT_VAL(UWB_CCP_RELAY_SLOT_GUARD);
+    return ccp->config.tx_holdoff_dly + MYNEWT_VAL(UWB_CCP_RELAY_TIER_SLOTS) * slot_len;
+}
+
+/**
+ * @fn ccp_relay_offset(struct uwb_ccp_instance *ccp, uint8_t tier, uint16_t slot)
+ * @brief Start of a relay slot relative to the master epoch. Tier n, n >= 1, holds the
+ * frames repeated n times and starts once the master frame and n-1 full tiers are over.
+ *
+ * @param ccp   Pointer to struct uwb_ccp_instance.
+ * @param tier  Repeat level of the frame to send.
+ * @param slot  Slot within the tier.
+ * @return offset in master dwt units (dtu)
+ */
+static uint64_t
+ccp_relay_offset(struct uwb_ccp_instance *ccp, uint8_t tier, uint16_t slot)
+{
+    uint32_t slot_len = ccp->blink_frame_duration + MYNEWT_VAL(UWB_CCP_RELAY_SLOT_GUARD);
+    uint32_t offset = ccp->blink_frame_duration + (tier - 1) * ccp_relay_tier_len(ccp)
+        + ccp->config.tx_holdoff_dly + slot * slot_len;
+    return (uint64_t)offset << 16;
+}
+
+/**
+ * @fn ccp_write_tx(struct uwb_ccp_instance *ccp, uwb_ccp_blink_frame_t *frame)
+ * @brief Load a ccp frame into the tx buffer. If nothing else has touched the tx buffer
+ * since the previous ccp frame, only the bytes that differ from it are written, which between
+ * two superframes is the sequence number and the low bytes of the timestamps. The frame
+ * control is always written, drivers can rewrite it internally without bumping txbuf_seq.
+ *
+ * @param ccp    Pointer to struct uwb_ccp_instance.
+ * @param frame  Frame to send.
+ * @return void
+ */
+static void
+ccp_write_tx(struct uwb_ccp_instance *ccp, uwb_ccp_blink_frame_t *frame)
+{
+    struct uwb_dev * inst = ccp->dev_inst;
+    uint8_t *shadow = ccp->tx_shadow.array;
+    uint16_t i, start, end;
+
+    if (MYNEWT_VAL(UWB_CCP_TX_PATCH_GAP) == 0 || inst->txbuf_seq != ccp->tx_shadow_seq) {
+        memcpy(shadow, frame->array, sizeof(uwb_ccp_blink_frame_t));
+        uwb_write_tx(inst, frame->array, 0, sizeof(uwb_ccp_blink_frame_t));
+        uwb_write_tx_fctrl(inst, sizeof(uwb_ccp_blink_frame_t), 0);
+        ccp->tx_shadow_seq = inst->txbuf_seq;
+        CCP_STATS_INC(tx_buf_full);
+        CCP_STATS_INCN(tx_buf_bytes, sizeof(uwb_ccp_blink_frame_t));
+        return;
+    }
+
+    for (i = 0; i < sizeof(uwb_ccp_blink_frame_t); i++) {
+        if (frame->array[i] == shadow[i]) {
+            continue;
+        }
+        /* Take in further changes until an unchanged stretch longer than the gap */
+        start = end = i;
+        for (i = start + 1; i < sizeof(uwb_ccp_blink_frame_t) && i - end <= MYNEWT_VAL(UWB_CCP_TX_PATCH_GAP); i++) {
+            if (frame->array[i] != shadow[i]) {
+                end = i;
+            }
+        }
+        memcpy(&shadow[start], &frame->array[start], end - start + 1);
+        uwb_write_tx(inst, &frame->array[start], start, end - start + 1);
+        CCP_STATS_INC(tx_buf_patch);
+        CCP_STATS_INCN(tx_buf_bytes, end - start + 1);
+        i = end;
+    }
+    uwb_write_tx_fctrl(inst, sizeof(uwb_ccp_blink_frame_t), 0);
+    ccp->tx_shadow_seq = inst->txbuf_seq;
+}
+
 /**
  * @fn ccp_timer_init(struct uwb_ccp_instance *ccp, uwb_ccp_role_t role)
  * @brief API to initiate timer for ccp.
@@ -242,22 +373,22 @@ ccp_slave_timer_ev_cb(struct dpl_event *ev)
 
     /* Calculate when to expect the ccp packet */
     dx_time = ccp->local_epoch;
-#if MYNEWT_VAL(UWB_WCS_ENABLED)
-    if (ccp->wcs) {
-        struct uwb_wcs_instance * wcs = ccp->wcs;
-        dx_time += DPL_FLOAT64_F64_TO_U64(DPL_FLOAT64_MUL(DPL_FLOAT64_U64_TO_F64((uint64_t)ccp->period << 16),
-                                                          wcs->normalized_skew));
-    }
-#else
-    dx_time += ((uint64_t)ccp->period << 16);
-#endif
+    dx_time += ccp_local_period(ccp, (uint32_t)ccp->missed_frames * ccp->period);
     dx_time -= ((uint64_t)ceilf(uwb_usecs_to_dwt_usecs(uwb_phy_SHR_duration(inst) +
                                                        inst->config.rx.timeToRxStable)) << 16);
 
     timeout = ccp->blink_frame_duration + MYNEWT_VAL(XTALT_GUARD);
 #if MYNEWT_VAL(UWB_CCP_MAX_CASCADE_RPTS) != 0
-    /* Adjust timeout if we're using cascading ccp in anchors */
-    timeout += (ccp->config.tx_holdoff_dly + ccp->blink_frame_duration) * MYNEWT_VAL(UWB_CCP_MAX_CASCADE_RPTS);
+    /* Adjust timeout if we're using cascading ccp in anchors, keep listening until the last tier is over */
+    timeout += ccp_relay_tier_len(ccp) * MYNEWT_VAL(UWB_CCP_MAX_CASCADE_RPTS);
+#endif
+#if MYNEWT_VAL(UWB_CCP_HOLDOVER_FRAMES) > 0
+    if (ccp->status.holdover) {
+        /* Open the window either side of the predicted epoch by the error bound */
+        uint16_t err_us = (ccp->holdover_err + 999) / 1000;
+        dx_time -= (uint64_t)err_us << 16;
+        timeout += 2 * err_us;
+    }
 #endif
     uwb_set_rx_timeout(inst, timeout);
 
@@ -277,7 +408,7 @@ reset_timer:
     /* Ensure timer isn't active */
     dpl_cputime_timer_stop(&ccp->timer);
 
-    if (ccp->status.rx_timeout_error &&
+    if (ccp->status.rx_timeout_error && !ccp->status.holdover &&
         ccp->missed_frames > MYNEWT_VAL(UWB_CCP_TOLERATE_MISSED_FRAMES)) {
         /* No ccp received, reschedule immediately */
         rc = dpl_cputime_timer_relative(&ccp->timer, 0);
@@ -521,6 +652,21 @@ ccp_postprocess(struct dpl_event * ev)
     delta = delta & ((uint64_t)1<<63)?delta & 0xFFFFFFFFFF :delta;
 
     dpl_float64_t carrier_integrator = uwb_calc_clock_offset_ratio(ccp->dev_inst, frame->carrier_integrator, UWB_CR_CARRIER_INTEGRATOR);
+#ifdef __KERNEL__
+    if (ccp_chrdev_format(ccp->dev_inst->idx) == UWB_TELEMETRY_FORMAT_BINARY) {
+        dpl_float32_t ppm = DPL_FLOAT32_FROM_F64(DPL_FLOAT64_MUL(carrier_integrator, DPL_FLOAT64_INIT(1e6l)));
+        uwb_telemetry_ccp_t rec = {
+            .utime = ccp->master_epoch.timestamp,
+            .timestamp = frame->transmission_timestamp.timestamp,
+            .delta = delta,
+            .seq = frame->seq_num,
+            .ppm = uwb_telemetry_f32(&ppm)
+        };
+        uwb_telemetry_hdr_init(&rec.hdr, UWB_TELEMETRY_CCP, ccp->dev_inst->idx, sizeof(rec));
+        ccp_chrdev_output(ccp->dev_inst->idx, (char *)&rec, sizeof(rec));
+        return;
+    }
+#endif
     ccp_json_t json = {
         .utime = ccp->master_epoch.timestamp,
         .seq = frame->seq_num,
@@ -550,28 +696,103 @@ adjust_for_epoch_to_rm(struct uwb_ccp_instance * ccp, uint16_t epoch_to_rm_us)
     ccp->os_epoch -= dpl_cputime_usecs_to_ticks(uwb_dwt_usecs_to_usecs(epoch_to_rm_us));
 }
 
-#if MYNEWT_VAL(UWB_CCP_TOLERATE_MISSED_FRAMES) > 0
+#if MYNEWT_VAL(UWB_CCP_HOLDOVER_FRAMES) > 0
+/**
+ * @fn ccp_holdover_err_ns(struct uwb_ccp_instance * ccp)
+ * @brief Bound on the error of an epoch predicted missed_frames periods after the last
+ * received frame, a residual skew term growing linearly plus a drift term growing with
+ * the square of the elapsed time.
+ *
+ * @param ccp  Pointer to struct uwb_ccp_instance.
+ * @return error bound in ns
+ */
+static uint32_t
+ccp_holdover_err_ns(struct uwb_ccp_instance * ccp)
+{
+    uint64_t elapsed_us = (uint64_t)ccp->missed_frames * ccp->period;
+    uint64_t elapsed_ms = elapsed_us / 1000;
+    uint64_t err = elapsed_us * MYNEWT_VAL(UWB_CCP_HOLDOVER_SKEW_PPB) / 1000000
+                 + elapsed_ms * elapsed_ms * MYNEWT_VAL(UWB_CCP_HOLDOVER_DRIFT_PPB) / 2000000;
+    return (err > UINT32_MAX) ? UINT32_MAX : (uint32_t)err;
+}
+
+/**
+ * @fn ccp_holdover(struct uwb_ccp_instance * ccp)
+ * @brief Advance the epochs to the predicted time of the missed frame while the error
+ * bound allows it.
+ *
+ * @param ccp  Pointer to struct uwb_ccp_instance.
+ * @return true if the epochs were advanced and a superframe should be issued
+ */
+static bool
+ccp_holdover(struct uwb_ccp_instance * ccp)
+{
+    uint32_t err;
+
+    if (!ccp->status.holdover) {
+#if MYNEWT_VAL(UWB_WCS_ENABLED)
+        /* Holdover needs a skew estimate to predict from */
+        if (ccp->missed_frames != 1 || !ccp->wcs || !ccp->wcs->status.valid) {
+            return false;
+        }
+#else
+        return false;
+#endif
+        ccp->status.holdover = 1;
+        CCP_STATS_INC(holdover_enter);
+    }
+
+    err = ccp_holdover_err_ns(ccp);
+    if (ccp->missed_frames > MYNEWT_VAL(UWB_CCP_HOLDOVER_FRAMES) ||
+        err > MYNEWT_VAL(UWB_CCP_HOLDOVER_MAX_ERR_NS)) {
+        ccp->status.holdover = 0;
+        CCP_STATS_INC(holdover_timeout);
+        return false;
+    }
+
+    ccp->holdover_err = err;
+    ccp->os_epoch += dpl_cputime_usecs_to_ticks(uwb_dwt_usecs_to_usecs(ccp->period));
+    ccp->master_epoch.timestamp += ((uint64_t)ccp->period)<<16;
+    ccp->local_epoch += ccp_local_period(ccp, (uint32_t)(ccp->missed_frames - 1) * ccp->period);
+    ccp->local_epoch &= UWB_DTU_40BMASK;
+    CCP_STATS_INC(holdover_frames);
+    CCP_STATS_SET(holdover_err_ns, err);
+    return true;
+}
+#endif
+
+#if CCP_ISSUE_MISSED_SUPERFRAMES
 static void
 issue_superframe(struct uwb_ccp_instance * ccp)
 {
     struct uwb_dev * inst = ccp->dev_inst;
     struct uwb_mac_interface * lcbs = NULL;
 
-    if (ccp->status.valid &&
-        ccp->missed_frames <= MYNEWT_VAL(UWB_CCP_TOLERATE_MISSED_FRAMES)
-        ) {
+    if (!ccp->status.valid) {
+        return;
+    }
+
+#if MYNEWT_VAL(UWB_CCP_HOLDOVER_FRAMES) > 0
+    if (!ccp_holdover(ccp))
+#endif
+    {
+        if (ccp->missed_frames > MYNEWT_VAL(UWB_CCP_TOLERATE_MISSED_FRAMES)) {
+            return;
+        }
         /* Tolerating a (few) missed ccp-frame. Update time */
         ccp->os_epoch += dpl_cputime_usecs_to_ticks(uwb_dwt_usecs_to_usecs(ccp->period));
         ccp->master_epoch.timestamp += ((uint64_t)ccp->period)<<16;
         ccp->local_epoch += ((uint64_t)ccp->period)<<16;
+#if MYNEWT_VAL(UWB_CCP_TOLERATE_MISSED_FRAMES) > 0
         CCP_STATS_INC(err_tolerated);
+#endif
+    }
 
-        /* Call all available superframe callbacks */
-        if(!(SLIST_EMPTY(&inst->interface_cbs))) {
-            SLIST_FOREACH(lcbs, &inst->interface_cbs, next) {
-                if (lcbs != NULL && lcbs->superframe_cb) {
-                    if(lcbs->superframe_cb((struct uwb_dev*)inst, lcbs)) continue;
-                }
+    /* Call all available superframe callbacks */
+    if(!(SLIST_EMPTY(&inst->interface_cbs))) {
+        SLIST_FOREACH(lcbs, &inst->interface_cbs, next) {
+            if (lcbs != NULL && lcbs->superframe_cb) {
+                if(lcbs->superframe_cb((struct uwb_dev*)inst, lcbs)) continue;
             }
         }
     }
@@ -639,6 +860,12 @@ rx_complete_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
     ccp->idx++; // confirmed frame advance
     ccp->seq_num = frame->seq_num;
     ccp->missed_frames = 0;
+#if MYNEWT_VAL(UWB_CCP_HOLDOVER_FRAMES) > 0
+    if (ccp->status.holdover) {
+        ccp->status.holdover = 0;
+        CCP_STATS_INC(holdover_exit);
+    }
+#endif
 
     /* Read os_time and correct for interrupt latency */
     uint32_t delta_0 = 0xffffffffU&(uwb_read_systime_lo32(inst) - (uint32_t)(inst->rxtimestamp&0xFFFFFFFFUL));
@@ -686,17 +913,15 @@ rx_complete_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
     }
 
     /* Compensate if not receiving the master ccp packet directly */
+    CCP_STATS_SET(rx_relay_depth, frame->rpt_count);
     if (frame->rpt_count != 0) {
         CCP_STATS_INC(rx_relayed);
-        /* Assume ccp intervals are a multiple of 0x10000 dwt usec -> 0x100000000 dwunits */
-        uint64_t master_interval = ((frame->transmission_interval/0x100000000UL+1)*0x100000000UL);
-        ccp->period = master_interval>>16;
-        uint64_t repeat_dly = master_interval - frame->transmission_interval;
+        /* Each relay carries the master time elapsed since the master's rmarker */
+        uint64_t repeat_dly = frame->rpt_delay;
         ccp->master_epoch.timestamp = (ccp->master_epoch.timestamp - repeat_dly);
         repeat_dly = uwb_ccp_skew_compensation_ui64(ccp, repeat_dly);
         ccp->local_epoch = (ccp->local_epoch - repeat_dly) & 0x0FFFFFFFFFFUL;
         frame->reception_timestamp = ccp->local_epoch;
-        /* master_interval and transmission_interval are expressed as dwt_usecs */
         ccp->os_epoch -= dpl_cputime_usecs_to_ticks(uwb_dwt_usecs_to_usecs((repeat_dly >> 16)));
         /* Carrier integrator is only valid if direct from the master */
         frame->carrier_integrator = 0;
@@ -705,34 +930,32 @@ rx_complete_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
 
     /* Cascade relay of ccp packet */
     if (ccp->config.role == CCP_ROLE_RELAY && ccp->status.valid && frame->rpt_count < frame->rpt_max) {
-        uwb_ccp_frame_t tx_frame;
-        memcpy(tx_frame.array, frame->array, sizeof(uwb_ccp_frame_t));
+        uwb_ccp_blink_frame_t tx_frame;
+        memcpy(tx_frame.array, frame->array, sizeof(uwb_ccp_blink_frame_t));
 
         /* Only replace the short id, retain the euid to know which master this originates from */
         tx_frame.short_address = inst->my_short_address;
         tx_frame.rpt_count++;
-        uint64_t tx_timestamp = frame->reception_timestamp;
-        tx_timestamp += tx_frame.rpt_count*((uint64_t)ccp->config.tx_holdoff_dly<<16);
 
-        /* Shift frames so as to reduce risk of frames corrupting each other */
-        tx_timestamp += (inst->slot_id%4)*(((uint64_t)ccp->blink_frame_duration)<<16);
+        /* Relays at the same depth share a tier, the slot in it follows from the address */
+        uint64_t offset = ccp_relay_offset(ccp, tx_frame.rpt_count,
+                                           inst->my_short_address % MYNEWT_VAL(UWB_CCP_RELAY_TIER_SLOTS));
+        offset += (uint64_t)frame->epoch_to_rm_us << 16;
+        uint64_t tx_timestamp = ccp->local_epoch + uwb_ccp_skew_compensation_ui64(ccp, offset);
         tx_timestamp &= 0x0FFFFFFFE00UL;
         uwb_set_delay_start(inst, tx_timestamp);
 
         /* Need to add antenna delay */
         tx_timestamp += inst->tx_antenna_delay;
 
-        /* Calculate the transmission time of our packet in the masters reference */
-        uint64_t tx_delay = (tx_timestamp - frame->reception_timestamp);
-        tx_delay = uwb_ccp_skew_compensation_ui64(ccp, tx_delay);
-        tx_frame.transmission_timestamp.timestamp += tx_delay;
+        /* Master time from the master's epoch to our rmarker, the residual from masking
+         * and antenna delay is small enough to take as master time */
+        offset += ((tx_timestamp - ccp->local_epoch) & 0x0FFFFFFFFFFUL)
+                - uwb_ccp_skew_compensation_ui64(ccp, offset);
+        tx_frame.transmission_timestamp.timestamp = ccp->master_epoch.timestamp + offset;
+        tx_frame.rpt_delay = offset - ((uint64_t)frame->epoch_to_rm_us << 16);
 
-        /* Adjust the transmission interval so listening units can calculate the
-         * original master's timestamp */
-        tx_frame.transmission_interval = frame->transmission_interval - tx_delay;
-
-        uwb_write_tx(inst, tx_frame.array, 0, sizeof(uwb_ccp_blink_frame_t));
-        uwb_write_tx_fctrl(inst, sizeof(uwb_ccp_blink_frame_t), 0);
+        ccp_write_tx(ccp, &tx_frame);
         ccp->status.start_tx_error = uwb_start_tx(inst).start_tx_error;
         if (ccp->status.start_tx_error){
             CCP_STATS_INC(tx_relay_error);
@@ -852,7 +1075,11 @@ error_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
         if (ccp->config.role != CCP_ROLE_MASTER) {
             ccp->status.rx_error = 1;
             ccp->missed_frames++;
-#if MYNEWT_VAL(UWB_CCP_TOLERATE_MISSED_FRAMES) > 0
+#if MYNEWT_VAL(UWB_CCP_MAX_CASCADE_RPTS) != 0
+            /* Mostly relayed frames overlapping each other, compare with rx_relayed */
+            CCP_STATS_INC(rx_relay_error);
+#endif
+#if CCP_ISSUE_MISSED_SUPERFRAMES
             issue_superframe(ccp);
 #endif
         }
@@ -881,7 +1108,7 @@ rx_timeout_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
     if (dpl_sem_get_count(&ccp->sem) == 0){
         ccp->status.rx_timeout_error = 1;
         ccp->missed_frames++;
-#if MYNEWT_VAL(UWB_CCP_TOLERATE_MISSED_FRAMES) > 0
+#if CCP_ISSUE_MISSED_SUPERFRAMES
         issue_superframe(ccp);
 #endif
         DIAGMSG("{\"utime\": %"PRIu32",\"msg\": \"ccp:rx_timeout_cb\"}\n",
@@ -944,6 +1171,7 @@ ccp_send(struct uwb_ccp_instance *ccp, uwb_dev_modes_t mode)
     uwb_ccp_frame_t * frame = ccp->frames[(ccp->idx+1)%ccp->nframes];
     frame->rpt_count = 0;
     frame->rpt_max = MYNEWT_VAL(UWB_CCP_MAX_CASCADE_RPTS);
+    frame->rpt_delay = 0;
     frame->epoch_to_rm_us = uwb_phy_SHR_duration(inst);
 
     uint64_t timestamp = previous_frame->transmission_timestamp.timestamp
@@ -959,8 +1187,7 @@ ccp_send(struct uwb_ccp_instance *ccp, uwb_dev_modes_t mode)
     frame->short_address = inst->my_short_address;
     frame->transmission_interval = ((uint64_t)ccp->period << 16);
 
-    uwb_write_tx(inst, frame->array, 0, sizeof(uwb_ccp_blink_frame_t));
-    uwb_write_tx_fctrl(inst, sizeof(uwb_ccp_blink_frame_t), 0);
+    ccp_write_tx(ccp, (uwb_ccp_blink_frame_t *)frame);
     uwb_set_wait4resp(inst, false);
     ccp->status.start_tx_error = uwb_start_tx(inst).start_tx_error;
     if (ccp->status.start_tx_error) {
@@ -1086,7 +1313,9 @@ uwb_ccp_start(struct uwb_ccp_instance *ccp, uwb_ccp_role_t role)
     assert(ccp);
     ccp->idx = 0x0;
     ccp->status.valid = false;
+    ccp->status.holdover = 0;
     ccp->master_euid = 0x0;
+    ccp->tx_shadow_seq = inst->txbuf_seq - 1;
     uwb_ccp_frame_t * frame = ccp->frames[(ccp->idx)%ccp->nframes];
     ccp->config.role = role;
     ccp->status.enabled = 1;
@@ -55,8 +55,48 @@ typedef enum _uwb_pan_modes_t{
     DWT_PAN_REQ,                     //!< Pan request
     DWT_PAN_RESP,                    //!< Pan response
     DWT_PAN_RESET,                   //!< Pan reset, in case of master restart
+    DWT_PAN_SLOTMAP,                 //!< Pan slotmap broadcast
+    DWT_PAN_BATCH,                   //!< Pan responses to several requests
 }uwb_pan_code_t;
 
+/**
+ * @fn uwb_pan_join_hist_bin(uint16_t age)
+ * @brief Log-linear join latency histogram bin, 4 bins per octave.
+ *
+ * @param age     Time spent joining, in 10ms units.
+ *
+ * @return uint8_t bin, below PAN_JOIN_HIST_BINS
+ */
+static inline uint8_t
+uwb_pan_join_hist_bin(uint16_t age)
+{
+    uint8_t e;
+
+    if (age < 4) {
+        return age;
+    }
+    e = 31 - __builtin_clz((uint32_t) age);
+    return 4 * (e - 1) + ((age >> (e - 2)) & 3);
+}
+
+/**
+ * @fn uwb_pan_join_hist_top(uint8_t bin)
+ * @brief Largest age falling in a join latency histogram bin.
+ *
+ * @param bin     Histogram bin.
+ *
+ * @return uint32_t age, in 10ms units
+ */
+static inline uint32_t
+uwb_pan_join_hist_top(uint8_t bin)
+{
+    bin++;
+    if (bin < 4) {
+        return bin - 1;
+    }
+    return ((uint32_t)(4 + (bin & 3)) << (bin / 4 - 1)) - 1;
+}
+
 struct uwb_pan_instance * uwb_pan_init(struct uwb_dev * inst,  struct uwb_pan_config_t * config, uint16_t nframes);
 void uwb_pan_free(struct uwb_pan_instance *pan);
 void uwb_pan_set_postprocess(struct uwb_pan_instance *pan, dpl_event_fn * postprocess);
@@ -68,6 +108,14 @@ struct uwb_pan_status_t uwb_pan_blink(struct uwb_pan_instance * pan, uint16_t ro
 struct uwb_pan_status_t uwb_pan_reset(struct uwb_pan_instance * pan, uint64_t delay);
 uint32_t uwb_pan_lease_remaining(struct uwb_pan_instance * pan);
 
+void uwb_pan_set_demand(struct uwb_pan_instance * pan, uint16_t demand);
+bool uwb_pan_slot_granted(struct uwb_pan_instance * pan, uint16_t slot, uint8_t superframe);
+void uwb_pan_set_slotmap(struct uwb_pan_instance * pan, const struct pan_slot_grant * grants, uint16_t ngrants);
+struct uwb_pan_status_t uwb_pan_slotmap_tx(struct uwb_pan_instance * pan, uint64_t delay);
+struct uwb_pan_status_t uwb_pan_batch_tx(struct uwb_pan_instance * pan, uint64_t delay, uint16_t rx_timeout);
+bool uwb_pan_batch_grant(struct uwb_pan_instance * pan, uint64_t euid, const struct pan_req_resp * response);
+void uwb_pan_join_percentiles(const uint16_t * hist, const uint8_t * pct, uint32_t * ms, uint8_t n);
+
 void uwb_pan_slot_timer_cb(struct dpl_event * ev);
 
 #ifdef __cplusplus
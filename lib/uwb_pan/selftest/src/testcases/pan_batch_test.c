@@ -0,0 +1,78 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "uwb_pan_test.h"
+
+static void
+batch_response(struct pan_req_resp * response, uint16_t addr, uint16_t slot_id, uint16_t lease_time)
+{
+    memset(response, 0, sizeof(*response));
+    response->short_address = addr;
+    response->slot_id = slot_id;
+    response->lease_time = lease_time;
+    response->pan_id = 0xDECA;
+}
+
+/* BATCHED GRANTS TEST */
+TEST_CASE_SELF(pan_batch_test)
+{
+    struct uwb_pan_instance pan;
+    struct pan_req_resp response;
+    uint8_t i;
+
+    memset(&pan, 0, sizeof(pan));
+
+    /* The first grant sets up the batch frame */
+    batch_response(&response, 0x1001, 1, 10);
+    TEST_ASSERT_FATAL(uwb_pan_batch_grant(&pan, 0x0101010101010101ULL, &response));
+    TEST_ASSERT_FATAL(pan.batch != NULL);
+    TEST_ASSERT(pan.batch->code == DWT_PAN_BATCH && pan.status.batch_pending);
+    batch_response(&response, 0x1002, 2, 5);
+    TEST_ASSERT(uwb_pan_batch_grant(&pan, 0x0202020202020202ULL, &response));
+    TEST_ASSERT(pan.batch->ngrants == 2);
+    TEST_ASSERT(pan.batch->pan_id == 0xDECA);
+
+    /* The batch carries the shortest lease of its grants */
+    TEST_ASSERT(pan.batch->lease_time == 5);
+
+    /* A repeated request replaces the grant already queued, in place */
+    batch_response(&response, 0x1001, 7, 20);
+    TEST_ASSERT(uwb_pan_batch_grant(&pan, 0x0101010101010101ULL, &response));
+    TEST_ASSERT(pan.batch->ngrants == 2);
+    TEST_ASSERT(pan.batch->grants[0].euid == 0x0101010101010101ULL);
+    TEST_ASSERT(pan.batch->grants[0].slot_id == 7);
+    TEST_ASSERT(pan.batch->grants[1].slot_id == 2);
+    TEST_ASSERT(pan.batch->lease_time == 5);
+
+    /* A full batch refuses new nodes, queued nodes can still be replaced */
+    for (i = 2; i < MYNEWT_VAL(UWB_PAN_JOIN_BATCH); i++) {
+        batch_response(&response, 0x1000 + i + 1, i + 1, 10);
+        TEST_ASSERT(uwb_pan_batch_grant(&pan, 0x1000000000000000ULL + i, &response));
+    }
+    TEST_ASSERT(pan.batch->ngrants == MYNEWT_VAL(UWB_PAN_JOIN_BATCH));
+    batch_response(&response, 0x10ff, 9, 10);
+    TEST_ASSERT(!uwb_pan_batch_grant(&pan, 0x0303030303030303ULL, &response));
+    TEST_ASSERT(pan.batch->ngrants == MYNEWT_VAL(UWB_PAN_JOIN_BATCH));
+    batch_response(&response, 0x1002, 3, 10);
+    TEST_ASSERT(uwb_pan_batch_grant(&pan, 0x0202020202020202ULL, &response));
+    TEST_ASSERT(pan.batch->grants[1].slot_id == 3);
+    TEST_ASSERT(pan.batch->ngrants == MYNEWT_VAL(UWB_PAN_JOIN_BATCH));
+
+    free(pan.batch);
+}
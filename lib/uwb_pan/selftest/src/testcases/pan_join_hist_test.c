@@ -0,0 +1,72 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "uwb_pan_test.h"
+
+/* JOIN LATENCY HISTOGRAM TEST */
+TEST_CASE_SELF(pan_join_hist_test)
+{
+    uint16_t hist[PAN_JOIN_HIST_BINS];
+    const uint8_t pct[] = {50, 90, 99};
+    uint32_t ms[3];
+    uint32_t age;
+    uint8_t bin;
+
+    /* Exact below 4, then 4 bins per octave */
+    TEST_ASSERT(uwb_pan_join_hist_bin(0) == 0 && uwb_pan_join_hist_bin(3) == 3);
+    TEST_ASSERT(uwb_pan_join_hist_bin(4) == 4 && uwb_pan_join_hist_bin(7) == 7);
+    TEST_ASSERT(uwb_pan_join_hist_bin(8) == 8 && uwb_pan_join_hist_bin(9) == 8);
+    TEST_ASSERT(uwb_pan_join_hist_top(8) == 9 && uwb_pan_join_hist_top(20) == 79);
+
+    /* Every age lands in a bin whose range holds it, the bins are contiguous */
+    for (age = 0; age <= UINT16_MAX; age++) {
+        bin = uwb_pan_join_hist_bin(age);
+        TEST_ASSERT_FATAL(bin < PAN_JOIN_HIST_BINS);
+        TEST_ASSERT_FATAL(age <= uwb_pan_join_hist_top(bin));
+        TEST_ASSERT_FATAL(bin == 0 || age > uwb_pan_join_hist_top(bin - 1));
+    }
+
+    /* An empty histogram reports the first bin */
+    memset(hist, 0, sizeof(hist));
+    uwb_pan_join_percentiles(hist, pct, ms, 3);
+    TEST_ASSERT(ms[0] == 0 && ms[1] == 0 && ms[2] == 0);
+
+    /* A single bin holds every percentile */
+    hist[10] = 100;
+    uwb_pan_join_percentiles(hist, pct, ms, 3);
+    TEST_ASSERT(ms[0] == 10 * uwb_pan_join_hist_top(10));
+    TEST_ASSERT(ms[1] == ms[0] && ms[2] == ms[0]);
+
+    /* Each percentile stops at the bin where the count reaches its share,
+     * including a share reached exactly at the end of a bin */
+    memset(hist, 0, sizeof(hist));
+    hist[2] = 50;
+    hist[5] = 40;
+    hist[20] = 10;
+    uwb_pan_join_percentiles(hist, pct, ms, 3);
+    TEST_ASSERT(ms[0] == 20);
+    TEST_ASSERT(ms[1] == 50);
+    TEST_ASSERT(ms[2] == 790);
+
+    /* The last bin takes what is left */
+    memset(hist, 0, sizeof(hist));
+    hist[PAN_JOIN_HIST_BINS - 1] = 1;
+    uwb_pan_join_percentiles(hist, pct, ms, 3);
+    TEST_ASSERT(ms[2] == 10 * uwb_pan_join_hist_top(PAN_JOIN_HIST_BINS - 1));
+}
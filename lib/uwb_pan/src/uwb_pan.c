@@ -104,8 +104,21 @@ STATS_NAME_START(pan_stat_section)
     STATS_NAME(pan_stat_section, tx_error)
     STATS_NAME(pan_stat_section, rx_timeout)
     STATS_NAME(pan_stat_section, reset)
+    STATS_NAME(pan_stat_section, slotmap_tx)
+    STATS_NAME(pan_stat_section, slotmap_rx)
+    STATS_NAME(pan_stat_section, join_backoff)
+    STATS_NAME(pan_stat_section, join_grant)
+    STATS_NAME(pan_stat_section, batch_tx)
+    STATS_NAME(pan_stat_section, batch_grants)
+    STATS_NAME(pan_stat_section, batch_full)
+    STATS_NAME(pan_stat_section, batch_rx)
+    STATS_NAME(pan_stat_section, join_p50_ms)
+    STATS_NAME(pan_stat_section, join_p90_ms)
+    STATS_NAME(pan_stat_section, join_p99_ms)
 STATS_NAME_END(pan_stat_section)
 
+#define PAN_STATS_SET(__X, __N) {STATS_CLEAR(g_stat, __X);STATS_INCN(g_stat, __X, __N);}
+
 static struct uwb_pan_config_t g_config = {
     .tx_holdoff_delay = MYNEWT_VAL(UWB_PAN_TX_HOLDOFF),         // Send Time delay in usec.
     .rx_timeout_period = MYNEWT_VAL(UWB_PAN_RX_TIMEOUT),        // Receive response timeout in usec.
@@ -331,6 +344,7 @@ lease_expiry_cb(struct dpl_event * ev)
     STATS_INC(g_stat, lease_expiry);
     pan->status.valid = false;
     pan->status.lease_expired = true;
+    pan->status.has_grant = false;
     pan->dev_inst->slot_id = 0xffff;
 
     DIAGMSG("{\"utime\": %lu,\"msg\": \"pan_lease_expired\"}\n",dpl_cputime_ticks_to_usecs(dpl_cputime_get32()));
@@ -339,10 +353,390 @@ lease_expiry_cb(struct dpl_event * ev)
     }
 }
 
+/**
+ * @fn demand_class(uint16_t demand)
+ * @brief Coarse log2 class of a demand. Nodes only re-request when the
+ * class changes, so small queue fluctuations do not cause pan traffic.
+ *
+ * @param demand  Queue depth.
+ *
+ * @return uint8_t class, 0 for no demand
+ */
+static inline uint8_t
+demand_class(uint16_t demand)
+{
+    return (demand) ? 32 - __builtin_clz((uint32_t) demand) : 0;
+}
+
+/**
+ * @fn join_begin(struct uwb_pan_instance * pan)
+ * @brief Start timing a request for an address or a renewal.
+ *
+ * @param pan     Pointer to struct uwb_pan_instance.
+ *
+ * @return void
+ */
+static void
+join_begin(struct uwb_pan_instance * pan)
+{
+    pan->status.joining = true;
+    pan->join_start = dpl_time_get();
+    pan->join_attempts = 0;
+    pan->join_wait = 0;
+}
+
+#if MYNEWT_VAL(UWB_PAN_JOIN_BACKOFF)
+/**
+ * @fn join_hash(uint64_t euid, uint32_t seed)
+ * @brief Well mixed 32 bit value per node, so that nodes powered up together
+ * still pick different pan slots.
+ */
+static uint32_t
+join_hash(uint64_t euid, uint32_t seed)
+{
+    uint64_t x = euid + (seed + 1) * 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return (uint32_t)(x ^ (x >> 31));
+}
+
+/**
+ * @fn join_backoff(struct uwb_pan_instance * pan)
+ * @brief Called before sending a request. Sets the number of pan slots to
+ * listen before the next one, drawn from a window that doubles with every
+ * attempt, and picks the subslot for this one.
+ *
+ * @param pan     Pointer to struct uwb_pan_instance.
+ *
+ * @return uint8_t subslot, in 1/16 of the pan slot
+ */
+static uint8_t
+join_backoff(struct uwb_pan_instance * pan)
+{
+    uint32_t h = join_hash(pan->dev_inst->euid, pan->join_start + pan->join_attempts);
+    uint32_t window = MYNEWT_VAL(UWB_PAN_JOIN_BACKOFF);
+
+    if (pan->join_attempts < 16) {
+        window = (uint32_t)MYNEWT_VAL(UWB_PAN_JOIN_WINDOW) << pan->join_attempts;
+        if (window > MYNEWT_VAL(UWB_PAN_JOIN_BACKOFF)) {
+            window = MYNEWT_VAL(UWB_PAN_JOIN_BACKOFF);
+        }
+    }
+    if (pan->join_attempts < UINT8_MAX) {
+        pan->join_attempts++;
+    }
+    /* Always listen in the next pan slot, a batch response comes there */
+    pan->join_wait = 1 + (h & 0xffff) % window;
+    STATS_INC(g_stat, join_backoff);
+    return 1 + (h >> 16) % MYNEWT_VAL(UWB_PAN_JOIN_SUBSLOTS);
+}
+#endif
+
+#if MYNEWT_VAL(UWB_PAN_JOIN_AGE)
+#define REQ_JOIN_AGE(_req) ((_req).join_age)
+
+/**
+ * @fn join_age(struct uwb_pan_instance * pan)
+ * @brief Value for the join_age field of a request.
+ *
+ * @param pan     Pointer to struct uwb_pan_instance.
+ *
+ * @return uint16_t 1 + 10ms units since joining started, 0 while the lease is valid
+ */
+static uint16_t
+join_age(struct uwb_pan_instance * pan)
+{
+    uint32_t age;
+
+    if (pan->status.valid || !pan->status.joining) {
+        return 0;
+    }
+    age = dpl_time_ticks_to_ms32(dpl_time_get() - pan->join_start) / 10 + 1;
+    return (age > 0xffff) ? 0xffff : age;
+}
+#else
+#define REQ_JOIN_AGE(_req) (0)
+#endif
+
+/**
+ * @fn uwb_pan_join_percentiles(const uint16_t * hist, const uint8_t * pct, uint32_t * ms, uint8_t n)
+ * @brief Percentiles of a join latency histogram, each the top of the first
+ * bin where the running count reaches that share of the total.
+ *
+ * @param hist    PAN_JOIN_HIST_BINS counts, see uwb_pan_join_hist_bin().
+ * @param pct     n percentiles, ascending.
+ * @param ms      Output, n latencies in ms.
+ * @param n       Number of percentiles.
+ *
+ * @return void
+ */
+void
+uwb_pan_join_percentiles(const uint16_t * hist, const uint8_t * pct, uint32_t * ms, uint8_t n)
+{
+    uint32_t total = 0, sum = 0;
+    uint8_t bin, i;
+
+    for (bin = 0; bin < PAN_JOIN_HIST_BINS; bin++) {
+        total += hist[bin];
+    }
+    for (i = 0, bin = 0; i < n; i++) {
+        while (bin < PAN_JOIN_HIST_BINS - 1 && (sum + hist[bin]) * 100 < pct[i] * total) {
+            sum += hist[bin++];
+        }
+        ms[i] = 10 * uwb_pan_join_hist_top(bin);
+    }
+}
+
+#if MYNEWT_VAL(UWB_PAN_JOIN_AGE)
+/**
+ * @fn join_latency(struct uwb_pan_instance * pan, uint16_t age)
+ * @brief Master side, add the join_age of a granted request to the latency
+ * histogram and refresh the percentile stats. Renewals (age 0) are skipped.
+ *
+ * @param pan     Pointer to struct uwb_pan_instance.
+ * @param age     join_age field of the request.
+ *
+ * @return void
+ */
+static void
+join_latency(struct uwb_pan_instance * pan, uint16_t age)
+{
+    const uint8_t pct[] = {50, 90, 99};
+    uint32_t ms[3];
+    uint8_t bin, i;
+
+    if (age == 0) {
+        return;
+    }
+    if (pan->join_hist == NULL) {
+        pan->join_hist = (uint16_t *) calloc(PAN_JOIN_HIST_BINS, sizeof(uint16_t));
+        assert(pan->join_hist);
+    }
+    bin = uwb_pan_join_hist_bin(age - 1);
+    if (pan->join_hist[bin] == UINT16_MAX) {
+        /* Keep the shape, forget the oldest half */
+        for (i = 0; i < PAN_JOIN_HIST_BINS; i++) {
+            pan->join_hist[i] /= 2;
+        }
+    }
+    pan->join_hist[bin]++;
+
+    uwb_pan_join_percentiles(pan->join_hist, pct, ms, sizeof(pct));
+    PAN_STATS_SET(join_p50_ms, ms[0]);
+    PAN_STATS_SET(join_p90_ms, ms[1]);
+    PAN_STATS_SET(join_p99_ms, ms[2]);
+}
+#else
+/* Without join_age in the requests there is no latency to keep */
+#define join_latency(_pan, _age) ((void)(_age))
+#endif
+
+#if MYNEWT_VAL(UWB_PAN_JOIN_BATCH)
+#if MYNEWT_VAL(UWB_PAN_JOIN_BATCH) > PAN_BATCH_MAX_GRANTS
+#error "UWB_PAN_JOIN_BATCH must not exceed PAN_BATCH_MAX_GRANTS"
+#endif
+
+/**
+ * @fn batch_alloc(struct uwb_pan_instance * pan)
+ * @brief Master side, allocate the next batch response on first use.
+ *
+ * @param pan      Pointer to struct uwb_pan_instance.
+ *
+ * @return void
+ */
+static void
+batch_alloc(struct uwb_pan_instance * pan)
+{
+    if (pan->batch == NULL) {
+        pan->batch = (union pan_batch_frame_t *) calloc(1, sizeof(union pan_batch_frame_t));
+        assert(pan->batch);
+        pan->batch->fctrl = FCNTL_IEEE_BLINK_TAG_64;
+        pan->batch->code = DWT_PAN_BATCH;
+    }
+}
+
+/**
+ * @fn batch_find(const union pan_batch_frame_t * batch, uint64_t euid)
+ * @brief Master side, find where the grant for euid goes in the next batch
+ * response. A node already in the batch keeps its place. Call with
+ * interrupts disabled.
+ *
+ * @param batch    Batch response being collected.
+ * @param euid     Unique id of the node.
+ *
+ * @return uint8_t place in the batch, UWB_PAN_JOIN_BATCH when the batch is full
+ */
+static uint8_t
+batch_find(const union pan_batch_frame_t * batch, uint64_t euid)
+{
+    uint8_t i;
+
+    for (i = 0; i < batch->ngrants && batch->grants[i].euid != euid; i++) {
+    }
+    return i;
+}
+
+/**
+ * @fn batch_room(struct uwb_pan_instance * pan, uint64_t euid)
+ * @brief Master side, check that a grant for euid would be taken before
+ * handing out an address for it.
+ *
+ * @param pan      Pointer to struct uwb_pan_instance.
+ * @param euid     Unique id of the node.
+ *
+ * @return bool false when the batch is full
+ */
+static bool
+batch_room(struct uwb_pan_instance * pan, uint64_t euid)
+{
+    bool room;
+    dpl_sr_t sr;
+
+    batch_alloc(pan);
+    DPL_ENTER_CRITICAL(sr);
+    room = batch_find(pan->batch, euid) < MYNEWT_VAL(UWB_PAN_JOIN_BATCH);
+    DPL_EXIT_CRITICAL(sr);
+    if (!room) {
+        STATS_INC(g_stat, batch_full);
+    }
+    return room;
+}
+
+/**
+ * @fn batch_put(struct uwb_pan_instance * pan, uint64_t euid, const struct pan_req_resp * response)
+ * @brief Master side, queue the grant for euid in the next batch response,
+ * replacing one already queued for the same node.
+ *
+ * @param pan      Pointer to struct uwb_pan_instance.
+ * @param euid     Unique id of the node.
+ * @param response Grant, as filled in by the request callback.
+ *
+ * @return int places left in the batch, -1 when the batch is full
+ */
+static int
+batch_put(struct uwb_pan_instance * pan, uint64_t euid, const struct pan_req_resp * response)
+{
+    union pan_batch_frame_t * batch;
+    uint8_t i, n;
+    dpl_sr_t sr;
+
+    batch_alloc(pan);
+    batch = pan->batch;
+    DPL_ENTER_CRITICAL(sr);
+    n = batch->ngrants;
+    i = batch_find(batch, euid);
+    if (i == MYNEWT_VAL(UWB_PAN_JOIN_BATCH)) {
+        DPL_EXIT_CRITICAL(sr);
+        STATS_INC(g_stat, batch_full);
+        return -1;
+    }
+    batch->grants[i].euid = euid;
+    batch->grants[i].short_address = response->short_address;
+    batch->grants[i].slot_id = response->slot_id;
+    if (n == 0 || response->lease_time < batch->lease_time) {
+        batch->lease_time = response->lease_time;
+    }
+    batch->pan_id = response->pan_id;
+    if (i == n) {
+        batch->ngrants = ++n;
+    }
+    pan->status.batch_pending = true;
+    DPL_EXIT_CRITICAL(sr);
+    return MYNEWT_VAL(UWB_PAN_JOIN_BATCH) - n;
+}
+
+/**
+ * @fn batch_restore(struct uwb_pan_instance * pan, const union pan_batch_frame_t * frame)
+ * @brief Master side, queue the grants of a batch response that was not sent
+ * again. Grants queued since for the same nodes are newer and are kept.
+ *
+ * @param pan      Pointer to struct uwb_pan_instance.
+ * @param frame    Batch response taken by uwb_pan_batch_tx().
+ *
+ * @return void
+ */
+static void
+batch_restore(struct uwb_pan_instance * pan, const union pan_batch_frame_t * frame)
+{
+    union pan_batch_frame_t * batch = pan->batch;
+    uint8_t i, j, lost = 0;
+    dpl_sr_t sr;
+
+    DPL_ENTER_CRITICAL(sr);
+    if (batch->ngrants == 0 || frame->lease_time < batch->lease_time) {
+        batch->lease_time = frame->lease_time;
+    }
+    for (i = 0; i < frame->ngrants; i++) {
+        j = batch_find(batch, frame->grants[i].euid);
+        if (j == MYNEWT_VAL(UWB_PAN_JOIN_BATCH)) {
+            lost++;
+        } else if (j == batch->ngrants) {
+            batch->grants[batch->ngrants++] = frame->grants[i];
+        }
+    }
+    pan->status.batch_pending = true;
+    DPL_EXIT_CRITICAL(sr);
+    STATS_INCN(g_stat, batch_full, lost);
+}
+
+/**
+ * @fn batch_add(struct uwb_pan_instance * pan, union pan_frame_t * request)
+ * @brief Master side, handle a request and queue its grant for the next
+ * batch response instead of answering it directly.
+ *
+ * @param pan      Pointer to struct uwb_pan_instance.
+ * @param request  Received request frame.
+ *
+ * @return bool false when the batch is full
+ */
+static bool
+batch_add(struct uwb_pan_instance * pan, union pan_frame_t * request)
+{
+    struct pan_req_resp response = {0};
+    uint16_t age = REQ_JOIN_AGE(request->req);
+    int left;
+
+    if (!pan->request_cb) {
+        return true;
+    }
+    /* A repeated request replaces the grant already queued */
+    if (!batch_room(pan, request->long_address)) {
+        return false;
+    }
+    if (!pan->request_cb(request->long_address, &request->req, &response)) {
+        return true;
+    }
+    if ((left = batch_put(pan, request->long_address, &response)) < 0) {
+        return false;
+    }
+    join_latency(pan, age);
+    return left > 0;
+}
+
+/**
+ * @fn uwb_pan_batch_grant(struct uwb_pan_instance * pan, uint64_t euid, const struct pan_req_resp * response)
+ * @brief Master side, queue a grant for the next batch response that no
+ * request asked for, such as a lease renewed ahead of its expiry. Nodes
+ * holding a lease listen in every pan slot and take the grant as an answer.
+ *
+ * @param pan      Pointer to struct uwb_pan_instance.
+ * @param euid     Unique id of the node.
+ * @param response Grant, as filled in by the request callback.
+ *
+ * @return bool false when the batch is full
+ */
+bool
+uwb_pan_batch_grant(struct uwb_pan_instance * pan, uint64_t euid, const struct pan_req_resp * response)
+{
+    return batch_put(pan, euid, response) >= 0;
+}
+#endif
 
 static void
 handle_pan_request(struct uwb_pan_instance * pan, union pan_frame_t * request)
 {
+    uint16_t age = REQ_JOIN_AGE(request->req);
+
     if (!pan->request_cb) {
         return;
     }
@@ -351,6 +745,7 @@ handle_pan_request(struct uwb_pan_instance * pan, union pan_frame_t * request)
     response->code = DWT_PAN_RESP;
 
     if (pan->request_cb(request->long_address, &request->req, &response->req)) {
+        join_latency(pan, age);
         uwb_set_wait4resp(pan->dev_inst, false);
         uwb_write_tx_fctrl(pan->dev_inst, sizeof(union pan_frame_t), 0);
         uwb_write_tx(pan->dev_inst, response->array, 0, sizeof(union pan_frame_t));
@@ -358,6 +753,131 @@ handle_pan_request(struct uwb_pan_instance * pan, union pan_frame_t * request)
     }
 }
 
+#if MYNEWT_VAL(UWB_PAN_SLOTMAP)
+/**
+ * @fn slotmap_rx(struct uwb_pan_instance * pan, struct uwb_dev * inst)
+ * @brief Pick our own grant out of a slotmap broadcast. Nodes not listed
+ * in the map lose any grant they held.
+ *
+ * @param pan     Pointer to struct uwb_pan_instance.
+ * @param inst    Pointer to struct uwb_dev.
+ *
+ * @return bool
+ */
+static bool
+slotmap_rx(struct uwb_pan_instance * pan, struct uwb_dev * inst)
+{
+    union pan_slotmap_frame_t * map = (union pan_slotmap_frame_t *)inst->rxbuf;
+
+    if (pan->config->role == UWB_PAN_ROLE_MASTER || !pan->status.valid ||
+        map->ngrants > PAN_SLOTMAP_MAX_GRANTS ||
+        inst->frame_len < PAN_SLOTMAP_FRAME_LEN(map->ngrants)) {
+        return false;
+    }
+    STATS_INC(g_stat, slotmap_rx);
+
+    if (map->map_seq != pan->map_seq || !pan->status.has_grant) {
+        pan->map_seq = map->map_seq;
+        pan->status.has_grant = false;
+        for (uint8_t i = 0; i < map->ngrants; i++) {
+            if (map->grants[i].addr == inst->uid) {
+                memcpy(&pan->grant, &map->grants[i], sizeof(struct pan_slot_grant));
+                pan->status.has_grant = true;
+                break;
+            }
+        }
+    }
+
+    if (dpl_sem_get_count(&pan->sem) == 0) {
+        dpl_error_t err = dpl_sem_release(&pan->sem);
+        assert(err == DPL_OK);
+    }
+    return true;
+}
+#endif
+
+/**
+ * @fn lease_accept(struct uwb_pan_instance * pan, struct uwb_dev * inst, const struct pan_req_resp * resp)
+ * @brief TAG/ANCHOR side, take the address and slot granted by the master
+ * and arm the lease expiry.
+ *
+ * @param pan     Pointer to struct uwb_pan_instance.
+ * @param inst    Pointer to struct uwb_dev.
+ * @param resp    Grant from a response or batch response.
+ *
+ * @return void
+ */
+static void
+lease_accept(struct uwb_pan_instance * pan, struct uwb_dev * inst, const struct pan_req_resp * resp)
+{
+    inst->uid = resp->short_address;
+    inst->pan_id = resp->pan_id;
+    inst->slot_id = resp->slot_id;
+    pan->status.valid = true;
+    pan->status.lease_expired = false;
+    pan->status.demand_changed = demand_class(pan->demand) != demand_class(pan->demand_reported);
+    pan->status.joining = false;
+    pan->join_wait = 0;
+    pan->join_attempts = 0;
+    STATS_INC(g_stat, join_grant);
+    dpl_callout_stop(&pan->pan_lease_callout_expiry);
+    if (resp->lease_time > 0) {
+        /* Calculate when our lease expires */
+        uint32_t exp_tics;
+        uint32_t lease_us = 1000000;
+        lease_us = (uint32_t)(resp->lease_time)*1000000;
+#if MYNEWT_VAL(UWB_CCP_ENABLED)
+        struct uwb_ccp_instance *ccp = (struct uwb_ccp_instance*)uwb_mac_find_cb_inst_ptr(inst, UWBEXT_CCP);
+        lease_us -= (inst->rxtimestamp>>16) - (ccp->local_epoch>>16);
+#endif
+        dpl_time_ms_to_ticks(lease_us/1000, &exp_tics);
+        dpl_callout_reset(&pan->pan_lease_callout_expiry, exp_tics);
+    }
+}
+
+/**
+ * @fn batch_rx(struct uwb_pan_instance * pan, struct uwb_dev * inst)
+ * @brief Look for our own grant in a batch response.
+ *
+ * @param pan     Pointer to struct uwb_pan_instance.
+ * @param inst    Pointer to struct uwb_dev.
+ *
+ * @return bool
+ */
+static bool
+batch_rx(struct uwb_pan_instance * pan, struct uwb_dev * inst)
+{
+    union pan_batch_frame_t * batch = (union pan_batch_frame_t *)inst->rxbuf;
+    struct pan_req_resp resp = {0};
+
+    if (pan->config->role == UWB_PAN_ROLE_MASTER ||
+        batch->ngrants > PAN_BATCH_MAX_GRANTS ||
+        inst->frame_len < PAN_BATCH_FRAME_LEN(batch->ngrants)) {
+        return false;
+    }
+    STATS_INC(g_stat, batch_rx);
+
+    for (uint8_t i = 0; i < batch->ngrants; i++) {
+        if (batch->grants[i].euid == inst->my_long_address) {
+            resp.pan_id = batch->pan_id;
+            resp.short_address = batch->grants[i].short_address;
+            resp.slot_id = batch->grants[i].slot_id;
+            resp.lease_time = batch->lease_time;
+            lease_accept(pan, inst, &resp);
+            if (pan->control.postprocess) {
+                dpl_eventq_put(&inst->eventq, &pan->postprocess_event);
+            }
+            break;
+        }
+    }
+
+    if (dpl_sem_get_count(&pan->sem) == 0) {
+        dpl_error_t err = dpl_sem_release(&pan->sem);
+        assert(err == DPL_OK);
+    }
+    return true;
+}
+
 /**
  * @fn rx_complete_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
  * @brief This is an internal static function that executes on both the pan_master Node and the TAG/ANCHOR
@@ -392,6 +912,18 @@ rx_complete_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
     STATS_INC(g_stat, rx_complete);
     union pan_frame_t * frame = pan->frames[(pan->idx)%pan->nframes];
 
+#if MYNEWT_VAL(UWB_PAN_SLOTMAP)
+    /* Slotmaps are longer than other pan frames, pick them up first */
+    if (inst->frame_len >= PAN_SLOTMAP_FRAME_LEN(0) &&
+        ((union pan_slotmap_frame_t *)inst->rxbuf)->code == DWT_PAN_SLOTMAP) {
+        return slotmap_rx(pan, inst);
+    }
+#endif
+    if (inst->frame_len >= PAN_BATCH_FRAME_LEN(0) &&
+        ((union pan_batch_frame_t *)inst->rxbuf)->code == DWT_PAN_BATCH) {
+        return batch_rx(pan, inst);
+    }
+
     /* Ignore frames that are too long */
     if (inst->frame_len > sizeof(union pan_frame_t)) {
         return false;
@@ -413,9 +945,21 @@ rx_complete_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
     case DWT_PAN_REQ:
         STATS_INC(g_stat, pan_request);
         if (pan->config->role == UWB_PAN_ROLE_MASTER) {
+#if MYNEWT_VAL(UWB_PAN_JOIN_BATCH)
+            /* Grants go out together in the next pan slot, keep listening until
+             * the end of this one unless the batch is full */
+            if (batch_add(pan, frame) && !uwb_start_rx(inst).start_rx_error) {
+                if (pan->control.postprocess) {
+                    dpl_eventq_put(&inst->eventq, &pan->postprocess_event);
+                }
+                return true;
+            }
+            uwb_stop_rx(inst);
+#else
             /* Prevent another request coming in whilst processing this one */
             uwb_stop_rx(inst);
             handle_pan_request(pan, frame);
+#endif
         } else {
             return true;
         }
@@ -423,24 +967,7 @@ rx_complete_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
     case DWT_PAN_RESP:
         if(frame->long_address == inst->my_long_address){
             /* TAG/ANCHOR side */
-            inst->uid = frame->req.short_address;
-            inst->pan_id = frame->req.pan_id;
-            inst->slot_id = frame->req.slot_id;
-            pan->status.valid = true;
-            pan->status.lease_expired = false;
-            dpl_callout_stop(&pan->pan_lease_callout_expiry);
-            if (frame->req.lease_time > 0) {
-                /* Calculate when our lease expires */
-                uint32_t exp_tics;
-                uint32_t lease_us = 1000000;
-                lease_us = (uint32_t)(frame->req.lease_time)*1000000;
-#if MYNEWT_VAL(UWB_CCP_ENABLED)
-                struct uwb_ccp_instance *ccp = (struct uwb_ccp_instance*)uwb_mac_find_cb_inst_ptr(inst, UWBEXT_CCP);
-                lease_us -= (inst->rxtimestamp>>16) - (ccp->local_epoch>>16);
-#endif
-                dpl_time_ms_to_ticks(lease_us/1000, &exp_tics);
-                dpl_callout_reset(&pan->pan_lease_callout_expiry, exp_tics);
-            }
+            lease_accept(pan, inst, &frame->req);
         } else {
             return true;
         }
@@ -450,8 +977,12 @@ rx_complete_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
         if (pan->config->role != UWB_PAN_ROLE_MASTER) {
             pan->status.valid = false;
             pan->status.lease_expired = true;
+            pan->status.has_grant = false;
             inst->slot_id = 0xffff;
             dpl_callout_stop(&pan->pan_lease_callout_expiry);
+            /* Everyone rejoins now, start over with a fresh spread */
+            pan->status.joining = false;
+            pan->join_wait = 0;
         } else {
             return false;
         }
@@ -600,6 +1131,16 @@ uwb_pan_blink(struct uwb_pan_instance *pan, uint16_t role,
     frame->rpt_max = MYNEWT_VAL(UWB_PAN_RPT_MAX);
     frame->req.role = role;
     frame->req.lease_time = pan->config->lease_time;
+#if MYNEWT_VAL(UWB_PAN_SLOTMAP)
+    frame->req.demand = pan->demand;
+#endif
+    if (!pan->status.joining) {
+        join_begin(pan);
+    }
+#if MYNEWT_VAL(UWB_PAN_JOIN_AGE)
+    frame->req.join_age = join_age(pan);
+#endif
+    pan->demand_reported = pan->demand;
 
 #if MYNEWT_VAL(UWB_PAN_VERSION_ENABLED)
     struct image_version iv;
@@ -713,6 +1254,185 @@ uwb_pan_lease_remaining(struct uwb_pan_instance * pan)
     return dpl_time_ticks_to_ms32(rt);
 }
 
+/**
+ * @fn uwb_pan_set_demand(struct uwb_pan_instance * pan, uint16_t demand)
+ * @brief Update the tx queue depth reported to the pan master. A new pan
+ * request is sent in the next pan slot when the coarse demand class changes.
+ *
+ * @param pan     Pointer to struct uwb_pan_instance.
+ * @param demand  Number of frames waiting for a tx slot.
+ *
+ * @return void
+ */
+void
+uwb_pan_set_demand(struct uwb_pan_instance * pan, uint16_t demand)
+{
+    pan->demand = demand;
+    if (demand_class(demand) != demand_class(pan->demand_reported)) {
+        pan->status.demand_changed = true;
+    }
+}
+
+/**
+ * @fn uwb_pan_slot_granted(struct uwb_pan_instance * pan, uint16_t slot, uint8_t superframe)
+ * @brief Check if the last slotmap granted us a tdma slot in a superframe.
+ *
+ * @param pan         Pointer to struct uwb_pan_instance.
+ * @param slot        tdma slot index.
+ * @param superframe  Superframe sequence number, ccp->seq_num.
+ *
+ * @return true if the slot is ours to transmit in
+ */
+bool
+uwb_pan_slot_granted(struct uwb_pan_instance * pan, uint16_t slot, uint8_t superframe)
+{
+    if (!pan->status.has_grant) {
+        return false;
+    }
+    return pan_slot_grant_match(&pan->grant, slot, superframe);
+}
+
+/**
+ * @fn uwb_pan_set_slotmap(struct uwb_pan_instance * pan, const struct pan_slot_grant * grants, uint16_t ngrants)
+ * @brief Replace the slotmap broadcast by the master. The new map is sent
+ * in the next pan slot and repeated every UWB_PAN_SLOTMAP_REFRESH pan slots.
+ *
+ * @param pan      Pointer to struct uwb_pan_instance.
+ * @param grants   Array of grants.
+ * @param ngrants  Number of grants, at most PAN_SLOTMAP_MAX_GRANTS are sent.
+ *
+ * @return void
+ */
+void
+uwb_pan_set_slotmap(struct uwb_pan_instance * pan, const struct pan_slot_grant * grants, uint16_t ngrants)
+{
+    dpl_sr_t sr;
+
+    if (pan->slotmap == NULL) {
+        pan->slotmap = (union pan_slotmap_frame_t *) calloc(1, sizeof(union pan_slotmap_frame_t));
+        assert(pan->slotmap);
+        pan->slotmap->fctrl = FCNTL_IEEE_BLINK_TAG_64;
+        pan->slotmap->code = DWT_PAN_SLOTMAP;
+    }
+    if (ngrants > PAN_SLOTMAP_MAX_GRANTS) {
+        ngrants = PAN_SLOTMAP_MAX_GRANTS;
+    }
+
+    DPL_ENTER_CRITICAL(sr);
+    pan->slotmap->map_seq++;
+    pan->slotmap->ngrants = ngrants;
+    memcpy(pan->slotmap->grants, grants, ngrants * sizeof(struct pan_slot_grant));
+    pan->status.slotmap_pending = true;
+    DPL_EXIT_CRITICAL(sr);
+}
+
+/**
+ * @fn uwb_pan_slotmap_tx(struct uwb_pan_instance * pan, uint64_t delay)
+ * @brief Broadcast the current slotmap. Only the used part of the grant
+ * table is sent.
+ *
+ * @param pan      Pointer to struct uwb_pan_instance.
+ * @param delay    When to send the slotmap
+ *
+ * @return uwb_pan_status_t
+ */
+struct uwb_pan_status_t
+uwb_pan_slotmap_tx(struct uwb_pan_instance * pan, uint64_t delay)
+{
+    union pan_slotmap_frame_t frame;
+    uint16_t len;
+    dpl_sr_t sr;
+
+    assert(pan->slotmap);
+    /* Snapshot, the map may be replaced from the postprocess event */
+    DPL_ENTER_CRITICAL(sr);
+    len = PAN_SLOTMAP_FRAME_LEN(pan->slotmap->ngrants);
+    memcpy(frame.array, pan->slotmap->array, len);
+    pan->status.slotmap_pending = false;
+    DPL_EXIT_CRITICAL(sr);
+    pan->slotmap_age = 0;
+
+    frame.seq_num = ++pan->slotmap->seq_num;
+    frame.long_address = pan->dev_inst->euid;
+
+    uwb_set_delay_start(pan->dev_inst, delay);
+    uwb_write_tx_fctrl(pan->dev_inst, len, 0);
+    uwb_write_tx(pan->dev_inst, frame.array, 0, len);
+    uwb_set_wait4resp(pan->dev_inst, false);
+    pan->status.start_tx_error = uwb_start_tx(pan->dev_inst).start_tx_error;
+
+    if (pan->status.start_tx_error){
+        STATS_INC(g_stat, tx_error);
+        pan->status.slotmap_pending = true;
+    } else {
+        STATS_INC(g_stat, slotmap_tx);
+    }
+    return pan->status;
+}
+
+
+/**
+ * @fn uwb_pan_batch_tx(struct uwb_pan_instance * pan, uint64_t delay, uint16_t rx_timeout)
+ * @brief Send the grants collected since the last batch response in one
+ * frame, then listen for new requests until rx_timeout usec after delay.
+ * Blocks until the listen ends.
+ *
+ * @param pan         Pointer to struct uwb_pan_instance.
+ * @param delay       When to send the batch response
+ * @param rx_timeout  End of the listen, in usec after delay
+ *
+ * @return uwb_pan_status_t
+ */
+struct uwb_pan_status_t
+uwb_pan_batch_tx(struct uwb_pan_instance * pan, uint64_t delay, uint16_t rx_timeout)
+{
+    union pan_batch_frame_t frame;
+    uint16_t len;
+    uint8_t n;
+    dpl_sr_t sr;
+
+    assert(pan->batch);
+    dpl_error_t err = dpl_sem_pend(&pan->sem, DPL_TIMEOUT_NEVER);
+    assert(err == DPL_OK);
+
+    /* Take the grants, those queued from here on go in the next batch */
+    DPL_ENTER_CRITICAL(sr);
+    n = pan->batch->ngrants;
+    len = PAN_BATCH_FRAME_LEN(n);
+    memcpy(frame.array, pan->batch->array, len);
+    pan->batch->ngrants = 0;
+    pan->status.batch_pending = false;
+    DPL_EXIT_CRITICAL(sr);
+
+    frame.seq_num = ++pan->batch->seq_num;
+    frame.long_address = pan->dev_inst->euid;
+
+    uwb_set_delay_start(pan->dev_inst, delay);
+    uwb_write_tx_fctrl(pan->dev_inst, len, 0);
+    uwb_write_tx(pan->dev_inst, frame.array, 0, len);
+    uwb_set_wait4resp(pan->dev_inst, true);
+    uwb_set_rx_timeout(pan->dev_inst, rx_timeout);
+    uwb_set_abs_timeout(pan->dev_inst, (delay + ((uint64_t)rx_timeout << 16)) & UWB_DTU_40BMASK);
+    pan->status.start_tx_error = uwb_start_tx(pan->dev_inst).start_tx_error;
+
+    if (pan->status.start_tx_error){
+        /* Grants go back in the queue for the next pan slot */
+        STATS_INC(g_stat, tx_error);
+#if MYNEWT_VAL(UWB_PAN_JOIN_BATCH)
+        batch_restore(pan, &frame);
+#endif
+        dpl_sem_release(&pan->sem);
+        return pan->status;
+    }
+    STATS_INC(g_stat, batch_tx);
+    STATS_INCN(g_stat, batch_grants, n);
+
+    err = dpl_sem_pend(&pan->sem, DPL_TIMEOUT_NEVER);
+    assert(err == DPL_OK);
+    err = dpl_sem_release(&pan->sem);
+    assert(err == DPL_OK);
+    return pan->status;
+}
 
 #if MYNEWT_VAL(TDMA_ENABLED)
 /**
@@ -743,24 +1463,67 @@ uwb_pan_slot_timer_cb(struct dpl_event * ev)
         if (_pan_cycles < 8) {
             _pan_cycles++;
             uwb_pan_reset(pan, tdma_tx_slot_start(tdma, idx));
+#if MYNEWT_VAL(UWB_PAN_JOIN_BATCH)
+        } else if (pan->status.batch_pending) {
+            /* Grants for the requests heard in the last pan slot, then listen on */
+            uwb_set_on_error_continue(tdma->dev_inst, true);
+            uwb_pan_batch_tx(pan, tdma_tx_slot_start(tdma, idx), 3*ccp->period/tdma->nslots/4);
+#endif
+#if MYNEWT_VAL(UWB_PAN_SLOTMAP)
+        } else if (pan->slotmap && (pan->status.slotmap_pending ||
+                   ++pan->slotmap_age >= MYNEWT_VAL(UWB_PAN_SLOTMAP_REFRESH))) {
+            /* Requests arriving in this slot are retried by the nodes */
+            uwb_pan_slotmap_tx(pan, tdma_tx_slot_start(tdma, idx));
+#endif
         } else {
             uint64_t dx_time = tdma_rx_slot_start(tdma, idx);
-            uwb_set_rx_timeout(tdma->dev_inst, 3*ccp->period/tdma->nslots/4);
+            uint16_t timeout = 3*ccp->period/tdma->nslots/4;
+            uwb_set_rx_timeout(tdma->dev_inst, timeout);
+#if MYNEWT_VAL(UWB_PAN_JOIN_BATCH)
+            /* Rx is restarted after each request, keep the end of the slot */
+            uwb_set_abs_timeout(tdma->dev_inst, (dx_time + ((uint64_t)timeout << 16)) & UWB_DTU_40BMASK);
+#endif
             uwb_set_delay_start(tdma->dev_inst, dx_time);
             uwb_set_on_error_continue(tdma->dev_inst, true);
             uwb_pan_listen(pan, UWB_BLOCKING);
         }
     } else {
         /* Act as a slave Node in the network */
-        if (pan->status.valid && uwb_pan_lease_remaining(pan)>MYNEWT_VAL(UWB_PAN_LEASE_EXP_MARGIN)) {
-            /* Our lease is still valid - just listen */
+        uint8_t subslot = 1;
+        bool request = !pan->status.valid || pan->status.demand_changed ||
+            uwb_pan_lease_remaining(pan) <= MYNEWT_VAL(UWB_PAN_LEASE_EXP_MARGIN);
+#if MYNEWT_VAL(UWB_PAN_JOIN_BACKOFF)
+        if (request && !pan->status.joining) {
+            join_begin(pan);
+            if (!pan->status.valid) {
+                /* Spread the first requests of nodes starting together */
+                pan->join_wait = join_hash(pan->dev_inst->euid, pan->join_start) % MYNEWT_VAL(UWB_PAN_JOIN_WINDOW);
+            }
+        }
+        if (pan->join_wait) {
+            pan->join_wait--;
+            request = false;
+        } else if (request) {
+            subslot = join_backoff(pan);
+        }
+#endif
+        if (!request) {
+            /* Our lease is still valid, or we are backing off - just listen */
             uint16_t timeout;
             if (pan->config->role == UWB_PAN_ROLE_RELAY) {
                 timeout = 3*ccp->period/tdma->nslots/4;
             } else {
-                /* Only listen long enough to get any resets from master */
-                timeout = uwb_phy_frame_duration(tdma->dev_inst, sizeof(sizeof(union pan_frame_t)))
-                    + MYNEWT_VAL(XTALT_GUARD);
+                /* Only listen long enough to get any resets, slotmaps or batch responses from master */
+                uint16_t len = sizeof(union pan_frame_t);
+#if MYNEWT_VAL(UWB_PAN_SLOTMAP)
+                len = sizeof(union pan_slotmap_frame_t);
+#endif
+#if MYNEWT_VAL(UWB_PAN_JOIN_BACKOFF)
+                if (len < sizeof(union pan_batch_frame_t)) {
+                    len = sizeof(union pan_batch_frame_t);
+                }
+#endif
+                timeout = uwb_phy_frame_duration(tdma->dev_inst, len) + MYNEWT_VAL(XTALT_GUARD);
             }
             uwb_set_rx_timeout(tdma->dev_inst, timeout);
             uwb_set_delay_start(tdma->dev_inst, tdma_rx_slot_start(tdma, idx));
@@ -769,8 +1532,8 @@ uwb_pan_slot_timer_cb(struct dpl_event * ev)
                 STATS_INC(g_stat, rx_error);
             }
         } else {
-            /* Subslot 0 is for master reset, subslot 1 is for sending requests */
-            uint64_t dx_time = tdma_tx_slot_start(tdma, (float)idx+1.0f/16);
+            /* Subslot 0 is for master reset, later subslots are for sending requests */
+            uint64_t dx_time = tdma_tx_slot_start(tdma, (float)idx+(float)subslot/16);
             uwb_pan_blink(pan, pan->config->network_role, UWB_BLOCKING, dx_time);
         }
     }
@@ -34,6 +34,20 @@
 #include <dpl/dpl_types.h>
 #include <euclid/triad.h>
 
+/*
+ * Longest record rng_json_write() can produce: five integers, raz and braz
+ * as doubles, rssi and los at float precision, ppm and sts, plus the keys
+ * and punctuation. The line buffer also needs room for a newline and the null.
+ */
+#define RNG_JSON_WRITE_MAX (2 + 5 * (JSON_FMT_UINT64_MAX + 10) \
+            + 2 * (10 + 3 * (JSON_FMT_FLOAT64_MAX + 1))           \
+            + 2 * (10 + 3 * (JSON_FMT_FLOAT32_MAX + 1))           \
+            + 2 * (10 + JSON_FMT_FLOAT64_MAX))
+
+#if MYNEWT_VAL(UWB_RNG_JSON_BUFSIZE) < RNG_JSON_WRITE_MAX + 2
+#error "UWB_RNG_JSON_BUFSIZE is too small for the longest rng record"
+#endif
+
 typedef struct rng_json{
     /* json_decoder must be first element in the structure */
     struct json_decoder decoder;
@@ -65,7 +79,6 @@ typedef struct rng_json{
     };
     dpl_float64_t sts;
     char iobuf[MYNEWT_VAL(UWB_RNG_JSON_BUFSIZE)];
-    uint16_t idx;
 }rng_json_t;
 
 rng_json_t * rng_json_init(rng_json_t * json);
@@ -78,6 +78,7 @@ struct uwb_rng_config{
 typedef struct _uwb_rng_control_t{
     uint16_t delay_start_enabled:1;  //!< Set for enabling delayed start
     uint16_t complete_after_tx:1;    //!< Set by ranging state machine to say that exchange is complete after next tx
+    uint16_t release_after_tx:1;     //!< Set by ranging state machine to say that exchange ends after next tx without a local result
 }uwb_rng_control_t;
 
 //! Range status parameters
@@ -23,10 +23,10 @@
 TEST_CASE_SELF(uwb_rng_json_test_write)
 {
     int rc;
-    char *output1 = "{\"utime\": 1,\"seq\": 2,\"c\": 3,\"uid\": 4,\"ouid\": 5,\"raz\": [1.000,2.000,3.000],\"braz\": [1.000,2.000,3.000],\"rssi\": [1.000,2.000,3.000],\"los\": [1.000,2.000,3.000],\"ppm\": 6.000,\"sts\": 7.000}";
+    char *output1 = "{\"utime\": 1,\"seq\": 2,\"c\": 3,\"uid\": 4,\"ouid\": 5,\"raz\": [1.0,2.0,3.0],\"braz\": [1.0,2.0,3.0],\"rssi\": [1.0,2.0,3.0],\"los\": [1.0,2.0,3.0],\"ppm\": 6.0,\"sts\": 7.0}";
     char *output2 = "{\"utime\": 0,\"raz\": [null]}";
-    char *output3 = "{\"utime\": 1,\"seq\": 2,\"c\": 3,\"uid\": 4,\"raz\": [0.000,0.000,0.000],\"braz\": [1.000,2.000,3.000],\"rssi\": [1.000,2.000,3.000],\"los\": [0.000,0.000,0.000]}";
-    char *output4 = "{\"utime\": 0,\"raz\": [0.000,0.000,0.000],\"braz\": [0.000,0.000,0.000],\"rssi\": [0.000,0.000,0.000],\"los\": [0.000,0.000,0.000],\"ppm\": 0.000,\"sts\": 0.000}";
+    char *output3 = "{\"utime\": 1,\"seq\": 2,\"c\": 3,\"uid\": 4,\"raz\": [0.0,0.0,0.0],\"braz\": [1.0,2.0,3.0],\"rssi\": [1.0,2.0,3.0],\"los\": [0.0,0.0,0.0]}";
+    char *output4 = "{\"utime\": 0,\"raz\": [0.0,0.0,0.0],\"braz\": [0.0,0.0,0.0],\"rssi\": [0.0,0.0,0.0],\"los\": [0.0,0.0,0.0],\"ppm\": 0.0,\"sts\": 0.0}";
 
     //
     /**
@@ -102,4 +102,25 @@ TEST_CASE_SELF(uwb_rng_json_test_write)
 
     rc = strcmp(json4.iobuf, output4);
     TEST_ASSERT(rc == 0);
+
+    /**
+     * Test case 5 float32 fields at float precision, longest record fits
+     */
+    rng_json_t json5 = {
+        .utime = UINT64_MAX,
+        .seq   = UINT64_MAX,
+        .code  = UINT64_MAX,
+        .uid   = UINT64_MAX,
+        .ouid  = UINT64_MAX,
+        .ppm   = -1.2345678901234567e-100,
+        .sts   = -1.2345678901234567e-100,
+        .raz   = {{-0.0000012345678901234567, -0.0000012345678901234567, -0.0000012345678901234567}},
+        .braz  = {{-0.0000012345678901234567, -0.0000012345678901234567, -0.0000012345678901234567}},
+        .los   = {(double)-1.00000003e20f, (double)-1.00000003e20f, (double)-1.00000003e20f},
+        .rssi  = {(double)-81.123456f, (double)-81.123456f, (double)-81.123456f},
+    };
+    rc = rng_json_write(&json5);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(strlen(json5.iobuf) <= RNG_JSON_WRITE_MAX);
+    TEST_ASSERT(strstr(json5.iobuf, "\"rssi\": [-81.12346,-81.12346,-81.12346]") != NULL);
 }
@@ -15,6 +15,7 @@
 #endif
 #include <dpl/dpl_mbuf.h>
 #include <linux/kfifo.h>
+#include <uwb/uwb_telemetry.h>
 #include <uwbcore.h>
 
 #define slog(fmt, ...)                                                  \
@@ -30,6 +31,7 @@ struct uwbrng_encode_data {
     struct mutex write_lock;
     local_record_fifo_t fifo;
     int have_init;
+    uint32_t format;                    //!< uwb_telemetry_format_t of this device
 
     struct device *dev;
     struct cdev cdev;
@@ -126,6 +128,29 @@ rng_poll(struct file *filp, struct poll_table_struct *wait)
 }
 
 
+static long
+rng_chrdev_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    uint32_t format;
+    struct uwbrng_encode_data *ed = file->private_data;
+
+    switch (cmd) {
+    case UWB_TELEMETRY_IOC_SET_FORMAT:
+        if (get_user(format, (uint32_t __user *)arg)) {
+            return -EFAULT;
+        }
+        if (format > UWB_TELEMETRY_FORMAT_BINARY) {
+            return -EINVAL;
+        }
+        ed->format = format;
+        return 0;
+    case UWB_TELEMETRY_IOC_GET_FORMAT:
+        return put_user(ed->format, (uint32_t __user *)arg);
+    default:
+        return -ENOTTY;
+    }
+}
+
 static const struct file_operations rng_chrdev_fops = {
     .owner   = THIS_MODULE,
     .open    = rng_chrdev_open,
@@ -133,6 +158,7 @@ static const struct file_operations rng_chrdev_fops = {
     .read    = rng_chrdev_read,
     .write   = NULL,
     .poll    = rng_poll,
+    .unlocked_ioctl = rng_chrdev_ioctl,
 };
 
 static char*
@@ -198,6 +224,7 @@ rng_chrdev_create(int idx)
     INIT_KFIFO(ed->fifo);
     init_waitqueue_head(&ed->wait);
 
+    ed->format = MYNEWT_VAL(UWB_TELEMETRY_FORMAT);
     ed->have_init = 1;
     return 0;
 
@@ -232,6 +259,15 @@ rng_chrdev_destroy(int idx)
     slog("");
 }
 
+int
+rng_encode_format(int idx)
+{
+    if (idx >= ARRAY_SIZE(uwbrng_encode_inst) || !uwbrng_encode_inst[idx].have_init) {
+        return UWB_TELEMETRY_FORMAT_JSON;
+    }
+    return uwbrng_encode_inst[idx].format;
+}
+
 int
 rng_encode_output(int idx, char *buf, size_t len)
 {
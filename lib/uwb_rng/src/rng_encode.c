@@ -32,11 +32,153 @@
 #include <uwb_wcs/uwb_wcs.h>
 #endif
 
+#if defined(__KERNEL__) || MYNEWT_VAL(RNG_TRACE)
+#include <uwb/uwb_telemetry.h>
+#endif
 #ifdef __KERNEL__
 int rng_encode_output(int idx, char *buf, size_t len);
+int rng_encode_format(int idx);
 #endif
 
 #if MYNEWT_VAL(RNG_VERBOSE)
+#ifdef __KERNEL__
+/*!
+ * @fn rng_encode_binary(struct uwb_rng_instance * rng, twr_frame_t * frame)
+ *
+ * @brief Binary encoding of range, see uwb_telemetry_rng_t
+ *
+ * input parameters
+ * @param rng     Pointer of struct uwb_rng_instance.
+ * @param frame   Frame holding the completed range.
+ * output parameters
+ * returns void
+ */
+static void
+rng_encode_binary(struct uwb_rng_instance * rng, twr_frame_t * frame)
+{
+    dpl_float32_t tmp;
+    dpl_float64_t nan = DPL_FLOAT64_NAN();
+    uwb_telemetry_rng_t rec = {
+#if MYNEWT_VAL(UWB_WCS_ENABLED)
+        .utime = uwb_wcs_read_systime_master64(rng->dev_inst),
+#else
+        .utime = dpl_cputime_ticks_to_usecs(dpl_cputime_get32()),
+#endif
+        .uid = frame->src_address,
+        .ouid = frame->dst_address,
+        .code = frame->code,
+        .seq = frame->seq_num,
+        .flags = (frame->local.flags.has_sts ? UWB_TELEMETRY_RNG_HAS_STS : 0) |
+                 (frame->local.flags.has_valid_sts ? UWB_TELEMETRY_RNG_VALID_STS : 0)
+    };
+    uwb_telemetry_hdr_init(&rec.hdr, UWB_TELEMETRY_RNG, rng->dev_inst->idx, sizeof(rec));
+
+    tmp = DPL_FLOAT32_FROM_F64(nan);
+    rec.los = uwb_telemetry_f32(&tmp);
+    for (uint8_t i = 0; i < sizeof(rec.raz)/sizeof(rec.raz[0]); i++){
+        rec.braz[i] = rec.rssi[i] = rec.los;
+        tmp = DPL_FLOAT32_FROM_F64(frame->local.spherical.array[i]);
+        rec.raz[i] = uwb_telemetry_f32(&tmp);
+    }
+
+    switch(frame->code){
+        case UWB_DATA_CODE_SS_TWR_EXT_FINAL:
+        case UWB_DATA_CODE_DS_TWR_EXT_FINAL:
+        for (uint8_t i = 0; i < sizeof(rec.braz)/sizeof(rec.braz[0]); i++){
+            tmp = DPL_FLOAT32_FROM_F64(frame->remote.spherical.array[i]);
+            rec.braz[i] = uwb_telemetry_f32(&tmp);
+        }
+        rec.flags |= UWB_TELEMETRY_RNG_HAS_REMOTE;
+        break;
+        default: break;
+    }
+
+    rec.pdoa = uwb_telemetry_f32(&frame->local.pdoa);
+    if(rng->dev_inst->config.rxdiag_enable){
+        for (uint8_t i = 0; i < sizeof(rec.rssi)/sizeof(rec.rssi[0]); i++)
+            rec.rssi[i] = uwb_telemetry_f32(&frame->local.vrssi[i]);
+        tmp = uwb_estimate_los(rng->dev_inst, frame->local.rssi, frame->local.fppl);
+        rec.los = uwb_telemetry_f32(&tmp);
+        rec.flags |= UWB_TELEMETRY_RNG_HAS_DIAG;
+    }
+
+    rng_encode_output(rng->dev_inst->idx, (char *)&rec, sizeof(rec));
+}
+#endif
+
+#if MYNEWT_VAL(RNG_TRACE)
+/*!
+ * @fn rng_encode_twr(struct uwb_rng_instance * rng, twr_frame_t * first_frame, twr_frame_t * frame)
+ *
+ * @brief Raw timestamps of a range, for offline replay of the time of flight calculation.
+ * Written as a uwb_telemetry_twr_t record in binary mode, otherwise as a JSON line
+ * "{\"utime\": 0,\"twr\": [code,uid,ouid,seq,flags],\"ts\": [8 x u32],\"ci\": 0,\"skew_ppt\": 0}"
+ * with the skew in parts per trillion.
+ *
+ * input parameters
+ * @param rng          Pointer of struct uwb_rng_instance.
+ * @param first_frame  Frame of the first exchange (double sided ranging).
+ * @param frame        Frame holding the completed range.
+ * output parameters
+ * returns void
+ */
+static void
+rng_encode_twr(struct uwb_rng_instance * rng, twr_frame_t * first_frame, twr_frame_t * frame)
+{
+    dpl_float64_t skew = uwb_calc_clock_offset_ratio(rng->dev_inst,
+                            frame->carrier_integrator, UWB_CR_CARRIER_INTEGRATOR);
+    uint64_t utime;
+    uint8_t flags = 0;
+    char buf[256];
+    int n;
+
+#if MYNEWT_VAL(UWB_WCS_ENABLED)
+    utime = uwb_wcs_read_systime_master64(rng->dev_inst);
+    flags |= UWB_TELEMETRY_TWR_WCS;
+#else
+    utime = dpl_cputime_ticks_to_usecs(dpl_cputime_get32());
+#endif
+
+#ifdef __KERNEL__
+    if (rng_encode_format(rng->dev_inst->idx) == UWB_TELEMETRY_FORMAT_BINARY) {
+        uwb_telemetry_twr_t rec = {
+            .utime = utime,
+            .uid = frame->src_address,
+            .ouid = frame->dst_address,
+            .code = frame->code,
+            .seq = frame->seq_num,
+            .flags = flags,
+            .ts = {{first_frame->request_timestamp, first_frame->response_timestamp,
+                    first_frame->reception_timestamp, first_frame->transmission_timestamp},
+                   {frame->request_timestamp, frame->response_timestamp,
+                    frame->reception_timestamp, frame->transmission_timestamp}},
+            .carrier_integrator = frame->carrier_integrator,
+            .skew = uwb_telemetry_f64(&skew)
+        };
+        uwb_telemetry_hdr_init(&rec.hdr, UWB_TELEMETRY_TWR, rng->dev_inst->idx, sizeof(rec));
+        rng_encode_output(rng->dev_inst->idx, (char *)&rec, sizeof(rec));
+        return;
+    }
+#endif
+    n = snprintf(buf, sizeof(buf), "{\"utime\": %llu,\"twr\": [%u,%u,%u,%u,%u],"
+                 "\"ts\": [%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu],\"ci\": %ld,\"skew_ppt\": %lld}\n",
+                 (unsigned long long)utime, frame->code, frame->src_address, frame->dst_address,
+                 frame->seq_num, flags,
+                 (unsigned long)first_frame->request_timestamp, (unsigned long)first_frame->response_timestamp,
+                 (unsigned long)first_frame->reception_timestamp, (unsigned long)first_frame->transmission_timestamp,
+                 (unsigned long)frame->request_timestamp, (unsigned long)frame->response_timestamp,
+                 (unsigned long)frame->reception_timestamp, (unsigned long)frame->transmission_timestamp,
+                 (long)frame->carrier_integrator,
+                 (long long)DPL_FLOAT64_INT(DPL_FLOAT64_MUL(skew, DPL_FLOAT64_INIT(1e12l))));
+#ifdef __KERNEL__
+    rng_encode_output(rng->dev_inst->idx, buf, n);
+#else
+    (void)n;
+    printf("%s", buf);
+#endif
+}
+#endif
+
 /*!
  * @fn rng_encode(struct uwb_rng_instance * rng)
  *
@@ -56,6 +198,17 @@ rng_encode(struct uwb_rng_instance * rng)
     dpl_float64_t time_of_flight = uwb_rng_twr_to_tof(rng, rng->idx_current);
     frame->local.spherical.range = uwb_rng_tof_to_meters(time_of_flight);
 
+#if MYNEWT_VAL(RNG_TRACE)
+    rng_encode_twr(rng, rng->frames[(uint16_t)(rng->idx_current-1)%rng->nframes], frame);
+#endif
+
+#ifdef __KERNEL__
+    if (rng_encode_format(rng->dev_inst->idx) == UWB_TELEMETRY_FORMAT_BINARY) {
+        rng_encode_binary(rng, frame);
+        return;
+    }
+#endif
+
     rng_json_t json = {
 #if MYNEWT_VAL(UWB_WCS_ENABLED)
         .utime = uwb_wcs_read_systime_master64(rng->dev_inst),
@@ -66,7 +219,6 @@ rng_encode(struct uwb_rng_instance * rng)
         .ouid = frame->dst_address,
         .ppm = DPL_FLOAT64_NAN(),
         .sts = DPL_FLOAT64_NAN(),
-        .idx =0
     };
 
     for (uint8_t i = 0;i< sizeof(json.raz)/sizeof(json.raz.array[0]);i++)
@@ -82,6 +234,8 @@ rng_encode(struct uwb_rng_instance * rng)
         case UWB_DATA_CODE_SS_TWR_FINAL:
         case UWB_DATA_CODE_SS_TWR_ACK_FINAL:
         case UWB_DATA_CODE_DS_TWR_FINAL:
+        case UWB_DATA_CODE_ADS_TWR_FINAL:
+        case UWB_DATA_CODE_ADS_TWR_REPORT:
         for (uint8_t i = 0; i < sizeof(json.raz)/sizeof(json.raz.array[0]);i++){
             json.raz.array[i] = frame->local.spherical.array[i];
         }
@@ -101,14 +255,19 @@ rng_encode(struct uwb_rng_instance * rng)
     }
 
     rc = rng_json_write(&json);
-    assert(rc == 0);
+    if (rc != 0) {
+        /* Truncated, the buffer is sized for the longest record so this is a bug */
+        return;
+    }
 
 #ifdef __KERNEL__
     /* This should probably not advance the pointer */
     size_t n = strlen(json.iobuf);
-    json.iobuf[n]='\n';
-    json.iobuf[n+1]='\0';
-    rng_encode_output(rng->dev_inst->idx, json.iobuf, strlen(json.iobuf));
+    if (n + 1 < sizeof(json.iobuf)) {
+        json.iobuf[n++] = '\n';
+        json.iobuf[n] = '\0';
+    }
+    rng_encode_output(rng->dev_inst->idx, json.iobuf, n);
 #else
     printf("%s\n",json.iobuf);
 #endif
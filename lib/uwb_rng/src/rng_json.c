@@ -30,8 +30,6 @@
 #include <assert.h>
 #include <uwb_rng/rng_json.h>
 
-static int rng_write_line(void *buf, char* data, int len);
-
 rng_json_t * rng_json_init(rng_json_t * json){
 
     if (json == NULL){
@@ -52,20 +50,6 @@ rng_json_free(rng_json_t * json){
         free(json);
 }
 
-static int
-rng_write_line(void *buf, char* data, int len)
-{
-    rng_json_t * json = buf;
-    for (uint16_t i=0; i < len; i++){
-        json->iobuf[(json->idx++)%MYNEWT_VAL(UWB_RNG_JSON_BUFSIZE)] = data[i];
-        if (data[i]=='\0'){
-            break;
-        }
-    }
-    if (json->iobuf[json->idx-1]=='\0')
-        json->idx = 0;
-    return len;
-}
 
 int
 rng_json_write(rng_json_t * json){
@@ -73,8 +57,7 @@ rng_json_write(rng_json_t * json){
     struct json_value value;
     int rc;
 
-    json->encoder.je_write = rng_write_line;
-    json->encoder.je_arg = (void *)json;
+    json_encode_buf_init(&json->encoder, json->iobuf, sizeof(json->iobuf));
     json->decoder.json_buf.jb_read_next = json_read_next;
     json->decoder.json_buf.jb_read_prev = json_read_prev;
     json->decoder.json_buf.jb_readn = json_readn;
@@ -137,7 +120,7 @@ rng_json_write(rng_json_t * json){
 
     if(!DPL_FLOAT64_ISNAN(json->rssi[0])){
         if(!DPL_FLOAT64_ISNAN(json->rssi[0]) && DPL_FLOAT64_ISNAN(json->rssi[1]) && DPL_FLOAT64_ISNAN(json->rssi[2])){
-                JSON_VALUE_FLOAT64(&value, json->rssi[0]);
+                JSON_VALUE_FLOAT32(&value, json->rssi[0]);
                 rc |= json_encode_array_name(&json->encoder, "rssi");
                 rc |= json_encode_array_start(&json->encoder);
                 rc |= json_encode_array_value(&json->encoder, &value);
@@ -146,7 +129,7 @@ rng_json_write(rng_json_t * json){
                 rc |= json_encode_array_name(&json->encoder, "rssi");
                 rc |= json_encode_array_start(&json->encoder);
                 for (uint8_t i = 0; i< sizeof(json->rssi)/sizeof(dpl_float64_t); i++){
-                    JSON_VALUE_FLOAT64(&value, json->rssi[i]);
+                    JSON_VALUE_FLOAT32(&value, json->rssi[i]);
                     rc |= json_encode_array_value(&json->encoder, &value);
                 }
                 rc |= json_encode_array_finish(&json->encoder);
@@ -155,7 +138,7 @@ rng_json_write(rng_json_t * json){
 
     if(!DPL_FLOAT64_ISNAN(json->los[0])){
         if(!DPL_FLOAT64_ISNAN(json->los[0]) && DPL_FLOAT64_ISNAN(json->los[1]) && DPL_FLOAT64_ISNAN(json->los[2])){
-                JSON_VALUE_FLOAT64(&value, json->los[0]);
+                JSON_VALUE_FLOAT32(&value, json->los[0]);
                 rc |= json_encode_array_name(&json->encoder, "los");
                 rc |= json_encode_array_start(&json->encoder);
                 rc |= json_encode_array_value(&json->encoder, &value);
@@ -164,7 +147,7 @@ rng_json_write(rng_json_t * json){
                 rc |= json_encode_array_name(&json->encoder, "los");
                 rc |= json_encode_array_start(&json->encoder);
                 for (uint8_t i = 0; i< sizeof(json->los)/sizeof(dpl_float64_t); i++){
-                    JSON_VALUE_FLOAT64(&value, json->los[i]);
+                    JSON_VALUE_FLOAT32(&value, json->los[i]);
                     rc |= json_encode_array_value(&json->encoder, &value);
                 }
                 rc |= json_encode_array_finish(&json->encoder);
@@ -182,15 +165,18 @@ rng_json_write(rng_json_t * json){
     }
     rc |= json_encode_object_finish(&json->encoder);
     json->encoder.je_wr_commas = 0;
-    assert(rc == 0);
 
-    rng_write_line(json->encoder.je_arg, "\0", 1);
+    if (json_encode_buf_finish(&json->encoder) < 0) {
+        rc = -1;
+    }
 
     return rc;
 }
 
 
 #ifdef FLOAT_SUPPORT
+static struct json_attr_index rng_json_read_index;
+
 int
 rng_json_read(rng_json_t * json, char * line){
 
@@ -284,8 +270,6 @@ rng_json_read(rng_json_t * json, char * line){
         }
     };
 
-    json->encoder.je_write = rng_write_line;
-    json->encoder.je_arg = NULL;
     json->decoder.json_buf.jb_read_next = json_read_next;
     json->decoder.json_buf.jb_read_prev = json_read_prev;
     json->decoder.json_buf.jb_readn = json_readn;
@@ -294,7 +278,7 @@ rng_json_read(rng_json_t * json, char * line){
     json->decoder.end_buf = line + strlen(line);
     json->decoder.current_position = 0;
 
-    int rc = json_read_object(&json->decoder.json_buf, ccp_attr);
+    int rc = json_read_object_indexed(&json->decoder.json_buf, ccp_attr, &rng_json_read_index);
 
     return rc;
 }
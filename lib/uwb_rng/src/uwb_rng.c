@@ -707,6 +707,7 @@ uwb_rng_twr_to_tof(struct uwb_rng_instance * rng, uint16_t idx)
             break;
         case UWB_DATA_CODE_DS_TWR ... UWB_DATA_CODE_DS_TWR_END:
         case UWB_DATA_CODE_DS_TWR_EXT ... UWB_DATA_CODE_DS_TWR_EXT_END:
+        case UWB_DATA_CODE_ADS_TWR ... UWB_DATA_CODE_ADS_TWR_END:
             ToF = calc_tof_ds(first_frame->response_timestamp, first_frame->request_timestamp,
                               first_frame->transmission_timestamp, first_frame->reception_timestamp,
                               frame->response_timestamp, frame->request_timestamp,
@@ -737,7 +738,7 @@ rx_timeout_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
         assert(err == DPL_OK);
         RNG_STATS_INC(rx_timeout);
         switch(rng->code){
-            case UWB_DATA_CODE_SS_TWR ... UWB_DATA_CODE_DS_TWR_EXT_FINAL:
+            case UWB_DATA_CODE_SS_TWR ... UWB_DATA_CODE_ADS_TWR_END:
                 {
                     RNG_STATS_INC(rx_timeout);
                     return true;
@@ -839,7 +840,7 @@ rx_complete_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
     req_frame = (ieee_rng_request_frame_t * ) inst->rxbuf;
     rng->code = req_frame->code;
     switch(rng->code) {
-        case UWB_DATA_CODE_SS_TWR ... UWB_DATA_CODE_DS_TWR_EXT_END:
+        case UWB_DATA_CODE_SS_TWR ... UWB_DATA_CODE_ADS_TWR_END:
             {
                 twr_frame_t * frame = rng->frames[(rng->idx+1)%rng->nframes]; // speculative frame advance
                 /* Clear meta and angle-information */
@@ -911,13 +912,16 @@ tx_complete_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
     }
 
     switch(rng->code) {
-        case UWB_DATA_CODE_SS_TWR ... UWB_DATA_CODE_DS_TWR_EXT_END:
+        case UWB_DATA_CODE_SS_TWR ... UWB_DATA_CODE_ADS_TWR_END:
             RNG_STATS_INC(tx_complete);
             if (rng->control.complete_after_tx) {
                 dpl_sem_release(&rng->sem);
                 rng_issue_complete(inst);
+            } else if (rng->control.release_after_tx) {
+                dpl_sem_release(&rng->sem);
             }
             rng->control.complete_after_tx = 0;
+            rng->control.release_after_tx = 0;
             return true;
             break;
         default:
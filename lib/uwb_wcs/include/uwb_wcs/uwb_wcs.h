@@ -28,6 +28,9 @@
 #if MYNEWT_VAL(TIMESCALE_ENABLED)
 #include <timescale/timescale.h>
 #endif
+#if MYNEWT_VAL(UWB_WCS_FILTER)
+#include <uwb_wcs/wcs_filter.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -42,6 +45,17 @@ typedef union {
     dpl_float64_t array[3];
 }uwb_wcs_states_t;
 
+/**
+ * Fixed point form of uwb_wcs_prediction() for a delta in local DTU:
+ * master = offset + delta + skew * delta + drift * delta^2
+ */
+typedef struct uwb_wcs_affine {
+    int64_t offset;                                /**< Master time at local epoch, Q16 DTU */
+    int32_t skew;                                  /**< Fractional skew, Q40 */
+    int32_t drift;                                 /**< Half drift per DTU^2, Q80 */
+    uint16_t valid:1;                              /**< Coefficients fit, else use the float path */
+}uwb_wcs_affine_t;
+
 typedef struct uwb_wcs_status{
     uint16_t selfmalloc:1;
     uint16_t initialized:1;
@@ -64,15 +78,21 @@ struct uwb_wcs_instance {
     uwb_ccp_timestamp_t master_epoch;
     uwb_ccp_timestamp_t local_epoch;
     uwb_wcs_states_t states;
+    uwb_wcs_affine_t affine;                        //!< Cached transform of states
     int32_t carrier_integrator;                     //!< Receiver carrier_integrator
     dpl_float64_t normalized_skew;
     dpl_float64_t fractional_skew;
     struct dpl_event postprocess_ev;
     struct uwb_ccp_instance * ccp;
-#if MYNEWT_VAL(TIMESCALE_ENABLED)
+#if MYNEWT_VAL(TIMESCALE_ENABLED) || MYNEWT_VAL(UWB_WCS_FILTER)
     struct uwb_mac_interface cbs;                   //!< MAC Layer Callbacks
+#endif
+#if MYNEWT_VAL(TIMESCALE_ENABLED)
     struct _timescale_instance_t * timescale;
 #endif
+#if MYNEWT_VAL(UWB_WCS_FILTER)
+    wcs_filter_t filter;                            //!< Fixed point clock model filter
+#endif
 };
 
 struct uwb_wcs_instance * uwb_wcs_init(struct uwb_wcs_instance * inst, struct uwb_ccp_instance * ccp);
@@ -96,6 +116,12 @@ uint32_t uwb_wcs_read_txtime_lo_master(struct uwb_dev * inst);
 uint64_t uwb_wcs_dtu_time_adjust(struct uwb_wcs_instance * wcs, uint64_t dtu_time);
 uint64_t uwb_wcs_local_to_master64(struct uwb_wcs_instance * wcs, uint64_t dtu_time);
 uint64_t uwb_wcs_local_to_master(struct uwb_wcs_instance * wcs, uint64_t dtu_time);
+void uwb_wcs_local_to_master64_array(struct uwb_wcs_instance * wcs, const uint64_t * dtu_time, uint64_t * master, uint16_t n);
+void uwb_wcs_affine_set(struct uwb_wcs_instance * wcs, int64_t offset, int64_t skew, int64_t drift);
+void uwb_wcs_affine_update(struct uwb_wcs_instance * wcs);
+#if MYNEWT_VAL(TIMESCALE_ENABLED)
+bool wcs_timescale_update(struct uwb_wcs_instance * wcs, double ratio);
+#endif
 uint64_t uwb_wcs_read_systime_master64(struct uwb_dev * inst);
 dpl_float64_t uwb_wcs_prediction(dpl_float64_t * x, dpl_float64_t T);
 
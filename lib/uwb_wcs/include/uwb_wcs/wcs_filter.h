@@ -0,0 +1,64 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file wcs_filter.h
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Fixed point clock model filter for wireless clock synchronization
+ */
+
+#ifndef _WCS_FILTER_H_
+#define _WCS_FILTER_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WCS_FILTER_GAINS (8)            /**< Gains of the first steps, the last one is the steady state */
+
+/**
+ * Kalman filter of the clock model master = time + skew * local + drift * local^2 / 2
+ * with time kept in the master reference and skew and drift normalised to the
+ * nominal ccp period. The gains are precomputed for that period, so an update
+ * only needs integer arithmetic.
+ */
+typedef struct wcs_filter {
+    int64_t time;                                   /**< Master lo40 time at the local epoch, Q16 DTU */
+    int64_t skew;                                   /**< Fractional skew, master/local - 1, Q60 */
+    int64_t drift;                                  /**< Change of skew per period, Q60 */
+    int64_t innovation;                             /**< Master time minus prediction at the last update, Q16 DTU */
+    int64_t period;                                 /**< Nominal ccp period, DTU */
+    int64_t inv_period;                             /**< 2^60 / period */
+    int32_t gain[WCS_FILTER_GAINS][3][2];           /**< Kalman gains, Q30 */
+    uint16_t step;                                  /**< Updates since the filter was (re)started */
+    uint16_t valid:1;                               /**< States are tracking */
+}wcs_filter_t;
+
+void wcs_filter_init(wcs_filter_t * filter, uint32_t period);
+void wcs_filter_reset(wcs_filter_t * filter);
+int wcs_filter_update(wcs_filter_t * filter, uint64_t master_lo40, uint64_t interval, int64_t skew);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _WCS_FILTER_H_ */
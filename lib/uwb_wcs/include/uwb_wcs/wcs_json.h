@@ -51,7 +51,6 @@ typedef struct wcs_json{
         uint64_t ppm_uint64;
     };
     char iobuf[MYNEWT_VAL(UWB_WCS_JSON_BUFSIZE)];
-    uint16_t idx;
 }wcs_json_t;
 
 wcs_json_t * wcs_json_init(wcs_json_t * json);
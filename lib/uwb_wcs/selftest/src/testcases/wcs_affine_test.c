@@ -0,0 +1,106 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "wcs_test.h"
+
+#define AFFINE_NSTAMPS      (64)
+
+static uint64_t local[AFFINE_NSTAMPS];
+static uint64_t master[AFFINE_NSTAMPS];
+
+static void
+affine_setup(struct uwb_wcs_instance * wcs, double ppm, double drift)
+{
+    memset(wcs, 0, sizeof(*wcs));
+    wcs->local_epoch.lo = 0xFFF0000000ULL;
+    wcs->master_epoch.timestamp = 0x0012340000001000ULL;
+    wcs->states.time = 4096.25;
+    wcs->states.skew = MYNEWT_VAL(UWB_WCS_DTU) * (1.0 + ppm * 1e-6);
+    wcs->states.drift = MYNEWT_VAL(UWB_WCS_DTU) * drift;
+    wcs->status.valid = 1;
+    uwb_wcs_affine_update(wcs);
+}
+
+/* Local stamps up to ~4s after the epoch, wrapping through the 40bit boundary */
+static void
+affine_fill(struct uwb_wcs_instance * wcs)
+{
+    for (int i = 0; i < AFFINE_NSTAMPS; i++) {
+        local[i] = (wcs->local_epoch.lo + (uint64_t)i * 4000000007ULL + i * i * 13) & 0xFFFFFFFFFFULL;
+    }
+}
+
+static uint64_t
+affine_float(struct uwb_wcs_instance * wcs, uint64_t dtu_time)
+{
+    uint64_t r;
+    uwb_wcs_affine_t affine = wcs->affine;
+    wcs->affine.valid = 0;
+    r = uwb_wcs_local_to_master64(wcs, dtu_time);
+    wcs->affine = affine;
+    return r;
+}
+
+/* WCS FIXED POINT TRANSFORM TEST */
+TEST_CASE_SELF(wcs_affine_test)
+{
+    struct uwb_wcs_instance wcs;
+    const double ppm[] = {0.0, 12.5, -37.1, 120.0};
+    const double drift[] = {0.0, 2e-9, -5e-8};
+
+    for (int p = 0; p < sizeof(ppm)/sizeof(ppm[0]); p++) {
+        for (int d = 0; d < sizeof(drift)/sizeof(drift[0]); d++) {
+            affine_setup(&wcs, ppm[p], drift[d]);
+            TEST_ASSERT_FATAL(wcs.affine.valid);
+            affine_fill(&wcs);
+            uwb_wcs_local_to_master64_array(&wcs, local, master, AFFINE_NSTAMPS);
+            for (int i = 0; i < AFFINE_NSTAMPS; i++) {
+                /* Within one DTU of the float path, and the array path agrees */
+                int64_t err = (int64_t)(master[i] - affine_float(&wcs, local[i]));
+                TEST_ASSERT(err >= -1 && err <= 1);
+                TEST_ASSERT(master[i] == uwb_wcs_local_to_master64(&wcs, local[i]));
+            }
+            TEST_ASSERT((master[0] >> 40) == 0x1234);
+        }
+    }
+
+    /* Coefficients that do not fit fall back to the float path */
+    affine_setup(&wcs, 5000.0, 0.0);
+    TEST_ASSERT(wcs.affine.valid == 0);
+    affine_fill(&wcs);
+    uwb_wcs_local_to_master64_array(&wcs, local, master, AFFINE_NSTAMPS);
+    TEST_ASSERT(master[7] == uwb_wcs_local_to_master64(&wcs, local[7]));
+
+    /* Out of range coefficients are rejected whichever estimator supplies them */
+    uwb_wcs_affine_set(&wcs, 65536, -5, 7);
+    TEST_ASSERT(wcs.affine.valid && wcs.affine.skew == -5 && wcs.affine.drift == 7);
+    uwb_wcs_affine_set(&wcs, -1, 0, 0);
+    TEST_ASSERT(wcs.affine.valid == 0);
+    uwb_wcs_affine_set(&wcs, 65536, (int64_t)INT32_MAX + 1, 0);
+    TEST_ASSERT(wcs.affine.valid == 0);
+    uwb_wcs_affine_set(&wcs, 65536, 0, (int64_t)INT32_MIN - 1);
+    TEST_ASSERT(wcs.affine.valid == 0);
+
+    /* Invalid states bypass the estimator */
+    affine_setup(&wcs, 12.5, 0.0);
+    wcs.status.valid = 0;
+    uwb_wcs_affine_update(&wcs);
+    TEST_ASSERT(wcs.affine.valid == 0);
+    TEST_ASSERT(uwb_wcs_local_to_master64(&wcs, wcs.local_epoch.lo + 10) == 0x0012340000001000ULL + 10);
+}
@@ -0,0 +1,166 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "wcs_test.h"
+#include "uwb_wcs/wcs_filter.h"
+
+#define FILTER_NFRAMES  (400)
+#define FILTER_SETTLE   (40)
+#define Q60             (1152921504606846976.0)
+
+/* One ccp frame as logged by a slave */
+struct filter_trace {
+    uint64_t master;        /* Master timestamp, unwrapped DTU */
+    uint64_t interval;      /* Local interval since the previous frame, DTU */
+    double skew;            /* Carrier integrator skew */
+    double true_skew;
+};
+
+static struct filter_trace trace[FILTER_NFRAMES];
+
+static uint32_t seed = 0x12345678;
+
+static double
+noise(double sigma)
+{
+    /* Sum of uniforms, roughly gaussian */
+    double s = 0;
+    for (int i = 0; i < 12; i++) {
+        seed = seed * 1664525 + 1013904223;
+        s += (seed >> 8) / (double)(1 << 24);
+    }
+    return (s - 6.0) * sigma;
+}
+
+/* Crystal warming up, skew walks from 12ppm with a slowly changing drift.
+ * Frame 150 and 151 are lost. The master starts close to the 40 bit wrap. */
+static void
+filter_trace_fill(uint32_t period)
+{
+    double P = (double)((uint64_t)period << 16);
+    double T = P / MYNEWT_VAL(UWB_WCS_DTU);
+    double skew = 12e-6, local = 0;
+    uint64_t master = (4ULL << 40) - 40 * (uint64_t)P;
+    int n = 0;
+
+    for (int i = 0; i < FILTER_NFRAMES + 2; i++) {
+        double drift = 40e-9 * T * (1.0 - i / (double)FILTER_NFRAMES);
+        double dl = P / (1.0 + skew + drift / 2);
+        skew += drift;
+        master += (uint64_t)P;
+        local += dl;
+        if (i == 150 || i == 151) {
+            continue;
+        }
+        trace[n].master = master;
+        trace[n].interval = (uint64_t)(local + noise(MYNEWT_VAL(UWB_WCS_FILTER_TIME_NOISE)));
+        trace[n].skew = skew + noise(MYNEWT_VAL(UWB_WCS_FILTER_SKEW_NOISE) * 1e-9);
+        trace[n].true_skew = skew;
+        local -= trace[n].interval;
+        n++;
+    }
+}
+
+#if MYNEWT_VAL(TIMESCALE_ENABLED)
+/* Production double filter, driven the way wcs_timescale_cb latches a ccp frame */
+static bool
+filter_timescale_update(struct uwb_wcs_instance * wcs, const struct filter_trace * frame)
+{
+    wcs->master_epoch.lo = frame->master & 0xFFFFFFFFFFULL;
+    wcs->observed_interval = frame->interval;
+    return wcs_timescale_update(wcs, frame->skew);
+}
+#endif
+
+static void
+filter_run(uint32_t period)
+{
+    wcs_filter_t filter;
+    double max_skew = 0, max_time = 0, max_truth = 0, max_ref_truth = 0;
+    int i, nvalid = 0;
+#if MYNEWT_VAL(TIMESCALE_ENABLED)
+    struct uwb_wcs_instance wcs;
+    uwb_wcs_states_t * states = &wcs.states;
+    memset(&wcs, 0, sizeof(wcs));
+#endif
+
+    filter_trace_fill(period);
+    wcs_filter_init(&filter, period);
+    TEST_ASSERT_FATAL(filter.inv_period > 0);
+
+    for (i = 0; i < FILTER_NFRAMES; i++) {
+        int rc = wcs_filter_update(&filter, trace[i].master & 0xFFFFFFFFFFULL,
+                                   trace[i].interval, (int64_t)(trace[i].skew * Q60));
+        /* Only the first frame (re)starts the filter, the 40 bit wrap and lost frames do not */
+        TEST_ASSERT(rc == (i == 0));
+#if MYNEWT_VAL(TIMESCALE_ENABLED)
+        bool valid = filter_timescale_update(&wcs, &trace[i]);
+#endif
+        if (i < FILTER_SETTLE) {
+            continue;
+        }
+        double skew = filter.skew / Q60;
+        max_truth = fmax(max_truth, fabs(skew - trace[i].true_skew));
+#if MYNEWT_VAL(TIMESCALE_ENABLED)
+        if (!valid) {
+            continue;
+        }
+        double ref_skew = states->skew / MYNEWT_VAL(UWB_WCS_DTU) - 1.0;
+        /* Time states compared on the 40 bit master timeline */
+        int64_t time = (int64_t)(((uint64_t)(filter.time >> 16) - (uint64_t)llround(states->time)) << 24) >> 24;
+        max_skew = fmax(max_skew, fabs(skew - ref_skew));
+        max_time = fmax(max_time, fabs((double)time));
+        max_ref_truth = fmax(max_ref_truth, fabs(ref_skew - trace[i].true_skew));
+        nvalid++;
+#endif
+    }
+
+    printf("{\"test\": \"wcs_filter\", \"period\": %lu, \"valid\": %d, \"skew_ppb\": %.3f, \"time_dtu\": %.1f, \"truth_ppb\": %.1f, \"ref_truth_ppb\": %.1f}\n",
+           (unsigned long)period, nvalid, max_skew * 1e9, max_time, max_truth * 1e9, max_ref_truth * 1e9);
+
+    TEST_ASSERT(max_truth < 100e-9);
+#if MYNEWT_VAL(TIMESCALE_ENABLED)
+    /* Agrees with the timescale filter across the 40 bit wrap and the lost frames */
+    TEST_ASSERT(nvalid > (FILTER_NFRAMES - FILTER_SETTLE) / 2);
+    TEST_ASSERT(max_skew < 100e-9);
+    TEST_ASSERT(max_time < 4096);
+    timescale_free(wcs.timescale);
+#endif
+}
+
+/* WCS FIXED POINT FILTER TEST */
+TEST_CASE_SELF(wcs_filter_test)
+{
+    wcs_filter_t filter;
+
+    filter_run(MYNEWT_VAL(UWB_CCP_PERIOD));
+    filter_run(0x10000);
+
+    /* A jump in master time restarts tracking */
+    wcs_filter_init(&filter, 0x10000);
+    TEST_ASSERT(wcs_filter_update(&filter, 1000000, 0, 0) == 1);
+    TEST_ASSERT(wcs_filter_update(&filter, 1000000 + (0x10000ULL << 16), 0x10000ULL << 16, 0) == 0);
+    TEST_ASSERT(wcs_filter_update(&filter, 1000000 + (0x30000ULL << 16), 0x10000ULL << 16, 0) == 1);
+    TEST_ASSERT(filter.step == 1);
+
+    /* Reset keeps the gains */
+    wcs_filter_reset(&filter);
+    TEST_ASSERT(filter.valid == 0);
+    TEST_ASSERT(filter.gain[WCS_FILTER_GAINS - 1][0][0] > 0);
+}
@@ -154,6 +154,87 @@ uwb_wcs_dtu_time_adjust(struct uwb_wcs_instance * wcs, uint64_t dtu_time)
     return dtu_time & 0x00FFFFFFFFFFUL;
 }
 
+/**
+ * Install a fixed point transform. Coefficients out of range leave the
+ * transform invalid so conversions take the float path.
+ *
+ * @param wcs     struct uwb_wcs_instance *
+ * @param offset  Master time at local epoch, Q16 DTU, must be >= 0
+ * @param skew    Fractional skew, Q40, must fit in int32
+ * @param drift   Half drift per DTU^2, Q80, must fit in int32
+ * @return void
+ */
+void
+uwb_wcs_affine_set(struct uwb_wcs_instance * wcs, int64_t offset, int64_t skew, int64_t drift)
+{
+#if MYNEWT_VAL(UWB_WCS_AFFINE)
+    uwb_wcs_affine_t affine = {0};
+    dpl_sr_t sr;
+
+    if (offset >= 0 && skew == (int32_t)skew && drift == (int32_t)drift) {
+        affine.offset = offset;
+        affine.skew = (int32_t)skew;
+        affine.drift = (int32_t)drift;
+        affine.valid = 1;
+    }
+
+    DPL_ENTER_CRITICAL(sr);
+    wcs->affine = affine;
+    DPL_EXIT_CRITICAL(sr);
+#endif
+}
+
+/**
+ * Refresh the fixed point transform from the estimator states. Call whenever
+ * wcs->states or wcs->status.valid change.
+ *
+ * @param wcs  struct uwb_wcs_instance *
+ * @return void
+ */
+void
+uwb_wcs_affine_update(struct uwb_wcs_instance * wcs)
+{
+#if MYNEWT_VAL(UWB_WCS_AFFINE)
+    dpl_float64_t dtu = DPL_FLOAT64_INIT(MYNEWT_VAL(UWB_WCS_DTU));
+
+    if (!wcs->status.valid) {
+        uwb_wcs_affine_set(wcs, -1, 0, 0);
+        return;
+    }
+    /* master = x0 + x1 * (delta / DTU) + x2 / 2 * (delta / DTU)^2 */
+    uwb_wcs_affine_set(wcs,
+        DPL_FLOAT64_INT(DPL_FLOAT64_MUL(wcs->states.time, DPL_FLOAT64_INIT(65536.0l))),
+        DPL_FLOAT64_INT(DPL_FLOAT64_MUL(
+            DPL_FLOAT64_SUB(DPL_FLOAT64_DIV(wcs->states.skew, dtu), DPL_FLOAT64_INIT(1.0l)),
+            DPL_FLOAT64_INIT(1099511627776.0l))),
+        DPL_FLOAT64_INT(DPL_FLOAT64_MUL(
+            DPL_FLOAT64_DIV(DPL_FLOAT64_DIV(wcs->states.drift, dtu), dtu),
+            DPL_FLOAT64_INIT(604462909807314587353088.0l))));
+#endif
+}
+
+/**
+ * Evaluate the cached transform for a local delta below 2^40 DTU. Every
+ * product is split so it fits in 64 bits.
+ *
+ * @param affine  Pointer to uwb_wcs_affine_t.
+ * @param delta   Local time since the local epoch, DTU.
+ * @return Master lo40 time, may exceed 40 bits
+ */
+static inline uint64_t
+wcs_affine_eval(const uwb_wcs_affine_t * affine, uint64_t delta)
+{
+    int64_t acc = affine->offset + (int64_t)(delta << 16);
+    uint64_t dk = (delta + 0x8000) >> 16;
+    uint64_t sq = dk * dk;
+
+    acc += (((int64_t)(delta >> 20) * affine->skew) >> 4)
+         + (((int64_t)(delta & 0xFFFFF) * affine->skew) >> 24);
+    acc += (((int64_t)(sq >> 24) * affine->drift) >> 8)
+         + (((int64_t)(sq & 0xFFFFFF) * affine->drift) >> 32);
+    return (uint64_t)(acc >> 16);
+}
+
 /**
  * Compensate for clock skew and offset relative to master clock reference frame
  *
@@ -171,6 +252,11 @@ uwb_wcs_local_to_master64(struct uwb_wcs_instance * wcs, uint64_t dtu_time)
     if(!wcs) return 0xffffffffffffffffULL;
     delta = ((dtu_time & 0x0FFFFFFFFFFUL) - wcs->local_epoch.lo) & 0x0FFFFFFFFFFUL;
 
+#if MYNEWT_VAL(UWB_WCS_AFFINE)
+    if (wcs->status.valid && wcs->affine.valid) {
+        master_lo40 = wcs_affine_eval(&wcs->affine, delta);
+    } else
+#endif
     if (wcs->status.valid) {
         /* No need to take special care of 40bit overflow as the timescale forward returns
          * a double value that can exceed the 40bit. */
@@ -182,6 +268,46 @@ uwb_wcs_local_to_master64(struct uwb_wcs_instance * wcs, uint64_t dtu_time)
     return (wcs->master_epoch.timestamp & 0xFFFFFF0000000000UL) + master_lo40;
 }
 
+/**
+ * Project an array of local timestamps to the clock master reference. The
+ * wcs state is sampled once so all results share the same transform.
+ *
+ * @param wcs       pointer to struct uwb_wcs_instance
+ * @param dtu_time  local observed timestamps
+ * @param master    output, 64bit master timestamps, may alias dtu_time
+ * @param n         number of timestamps
+ * @return void
+ */
+void
+uwb_wcs_local_to_master64_array(struct uwb_wcs_instance * wcs, const uint64_t * dtu_time, uint64_t * master, uint16_t n)
+{
+    uint16_t i;
+#if MYNEWT_VAL(UWB_WCS_AFFINE)
+    uwb_wcs_affine_t affine;
+    uint64_t local_lo, master_hi;
+    dpl_sr_t sr;
+
+    if (wcs && wcs->status.valid) {
+        DPL_ENTER_CRITICAL(sr);
+        affine = wcs->affine;
+        local_lo = wcs->local_epoch.lo;
+        master_hi = wcs->master_epoch.timestamp & 0xFFFFFF0000000000UL;
+        DPL_EXIT_CRITICAL(sr);
+
+        if (affine.valid) {
+            for (i = 0; i < n; i++) {
+                uint64_t delta = ((dtu_time[i] & 0x0FFFFFFFFFFUL) - local_lo) & 0x0FFFFFFFFFFUL;
+                master[i] = master_hi + wcs_affine_eval(&affine, delta);
+            }
+            return;
+        }
+    }
+#endif
+    for (i = 0; i < n; i++) {
+        master[i] = uwb_wcs_local_to_master64(wcs, dtu_time[i]);
+    }
+}
+
 /**
  * Compensate for clock skew and offset relative to master clock reference frame
  *
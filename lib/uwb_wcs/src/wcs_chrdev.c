@@ -32,6 +32,7 @@
 #include <linux/sched/signal.h>
 #endif
 #include <linux/kfifo.h>
+#include <uwb/uwb_telemetry.h>
 #include <uwb/uwb.h>
 #include <uwb_ccp/uwb_ccp.h>
 #include <uwb_wcs/uwb_wcs.h>
@@ -52,6 +53,7 @@ struct wcs_encode_data {
     struct mutex write_lock;
     local_record_fifo_t fifo;
     int have_init;
+    uint32_t format;                    //!< uwb_telemetry_format_t of this device
 	struct device *dev;
 	struct cdev cdev;
 	struct class *class;
@@ -164,7 +166,20 @@ wcs_chrdev_write(struct file *file, const char __user *buf, size_t len, loff_t *
         wcs->states.time = jwcs.wcs[0];
         wcs->states.skew = jwcs.wcs[1];
         wcs->states.drift = jwcs.wcs[2];
+        uwb_wcs_affine_update(wcs);
         slog("wcs update for utime=%llu\n", jwcs.utime);
+        if (ed->format == UWB_TELEMETRY_FORMAT_BINARY) {
+            uwb_telemetry_wcs_t rec = {
+                .utime = jwcs.utime,
+                .wcs = {uwb_telemetry_f64(&jwcs.wcs[0]),
+                        uwb_telemetry_f64(&jwcs.wcs[1]),
+                        uwb_telemetry_f64(&jwcs.wcs[2])},
+                .ppm = uwb_telemetry_f64(&jwcs.ppm)
+            };
+            uwb_telemetry_hdr_init(&rec.hdr, UWB_TELEMETRY_WCS, wcs->ccp->dev_inst->idx, sizeof(rec));
+            wcs_chrdev_output(wcs->ccp->dev_inst->idx, (char *)&rec, sizeof(rec));
+            break;
+        }
         wcs_json_write_uint64(&jwcs);
         n = strlen(jwcs.iobuf);
         jwcs.iobuf[n]='\n';
@@ -200,6 +215,29 @@ wcs_poll(struct file *filp, struct poll_table_struct *wait)
 	return mask;
 }
 
+static long
+wcs_chrdev_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    uint32_t format;
+    struct wcs_encode_data *ed = file->private_data;
+
+    switch (cmd) {
+    case UWB_TELEMETRY_IOC_SET_FORMAT:
+        if (get_user(format, (uint32_t __user *)arg)) {
+            return -EFAULT;
+        }
+        if (format > UWB_TELEMETRY_FORMAT_BINARY) {
+            return -EINVAL;
+        }
+        ed->format = format;
+        return 0;
+    case UWB_TELEMETRY_IOC_GET_FORMAT:
+        return put_user(ed->format, (uint32_t __user *)arg);
+    default:
+        return -ENOTTY;
+    }
+}
+
 static const struct file_operations wcs_chrdev_fops = {
     .owner   = THIS_MODULE,
     .open    = wcs_chrdev_open,
@@ -207,6 +245,7 @@ static const struct file_operations wcs_chrdev_fops = {
     .read    = wcs_chrdev_read,
     .write   = wcs_chrdev_write,
     .poll    = wcs_poll,
+    .unlocked_ioctl = wcs_chrdev_ioctl,
 };
 
 static char*
@@ -272,6 +311,7 @@ wcs_chrdev_create(struct uwb_wcs_instance * wcs)
     INIT_KFIFO(ed->fifo);
     init_waitqueue_head(&ed->wait);
 
+    ed->format = MYNEWT_VAL(UWB_TELEMETRY_FORMAT);
     ed->have_init = 1;
     return 0;
 
@@ -304,6 +344,15 @@ wcs_chrdev_destroy(int idx)
     unregister_chrdev_region(MKDEV(ed->major, 0), 1);
 }
 
+int
+wcs_chrdev_format(int idx)
+{
+    if (idx >= ARRAY_SIZE(wcs_encode_inst) || !wcs_encode_inst[idx].have_init) {
+        return UWB_TELEMETRY_FORMAT_JSON;
+    }
+    return wcs_encode_inst[idx].format;
+}
+
 int
 wcs_chrdev_output(int idx, char *buf, size_t len)
 {
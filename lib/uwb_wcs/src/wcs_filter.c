@@ -0,0 +1,440 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file wcs_filter.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Fixed point clock model filter for wireless clock synchronization
+ *
+ * @details Alternative to the timescale package for targets where dpl_float64_t is
+ * emulated. The filter tracks the same three states, master time, skew and drift, from
+ * the ccp master timestamps and the carrier integrator. The noise model does not change
+ * between frames, so the Kalman gains only depend on the step count and are computed
+ * once per ccp period; the first WCS_FILTER_GAINS-1 steps get their own gains and later
+ * steps share the steady state gain. A ccp frame then costs a handful of integer
+ * multiplies.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <dpl/dpl.h>
+#include <dpl/dpl_cputime.h>
+
+#include <uwb/uwb.h>
+#include <uwb_wcs/uwb_wcs.h>
+#include <uwb_wcs/wcs_filter.h>
+#if MYNEWT_VAL(UWB_WCS_VERBOSE)
+#include <uwb_wcs/wcs_json.h>
+#endif
+
+#define Q60 (1152921504606846976.0l)
+
+/**
+ * Signed 64 x 64 bit multiply, shifted right by n < 64 bits.
+ * The result must fit in 64 bits, it is rounded towards zero.
+ */
+static int64_t
+mulshr(int64_t a, int64_t b, unsigned n)
+{
+    uint64_t ua = (a < 0) ? -(uint64_t)a : (uint64_t)a;
+    uint64_t ub = (b < 0) ? -(uint64_t)b : (uint64_t)b;
+    uint64_t p00 = (ua & 0xFFFFFFFF) * (ub & 0xFFFFFFFF);
+    uint64_t p01 = (ua & 0xFFFFFFFF) * (ub >> 32);
+    uint64_t p10 = (ua >> 32) * (ub & 0xFFFFFFFF);
+    uint64_t p11 = (ua >> 32) * (ub >> 32);
+    uint64_t mid = (p00 >> 32) + (p01 & 0xFFFFFFFF) + (p10 & 0xFFFFFFFF);
+    uint64_t lo = (mid << 32) | (p00 & 0xFFFFFFFF);
+    uint64_t hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+    uint64_t r = (n == 0) ? lo : (lo >> n) | (hi << (64 - n));
+
+    return ((a < 0) != (b < 0)) ? -(int64_t)r : (int64_t)r;
+}
+
+/**
+ * Iterate the Riccati equation of the clock model and store the gains as Q30.
+ * Time is expressed in periods so that all states and gains are dimensionless:
+ * x = [time / period, skew, drift per period], z = [time / period, skew].
+ */
+static void
+wcs_filter_gains(wcs_filter_t * filter, uint32_t period)
+{
+    const dpl_float64_t zero = DPL_FLOAT64_INIT(0.0l);
+    const dpl_float64_t F[3][3] = {
+        {DPL_FLOAT64_INIT(1.0l), DPL_FLOAT64_INIT(1.0l), DPL_FLOAT64_INIT(0.5l)},
+        {zero, DPL_FLOAT64_INIT(1.0l), DPL_FLOAT64_INIT(1.0l)},
+        {zero, zero, DPL_FLOAT64_INIT(1.0l)}
+    };
+    dpl_float64_t P[3][3], FP[3][3], K[3][2], S[2][2], det, tmp;
+    dpl_float64_t rt, rs, qs, qd, T;
+    int i, j, m, step;
+
+    /* Period in seconds, and the noise variances in normalised units */
+    T = DPL_FLOAT64_DIV(DPL_FLOAT64_U64_TO_F64((uint64_t)period << 16), DPL_FLOAT64_INIT(MYNEWT_VAL(UWB_WCS_DTU)));
+    rt = DPL_FLOAT64_DIV(DPL_FLOAT64_INIT(MYNEWT_VAL(UWB_WCS_FILTER_TIME_NOISE)),
+                         DPL_FLOAT64_U64_TO_F64((uint64_t)period << 16));
+    rt = DPL_FLOAT64_MUL(rt, rt);
+    rs = DPL_FLOAT64_MUL(DPL_FLOAT64_INIT(MYNEWT_VAL(UWB_WCS_FILTER_SKEW_NOISE)), DPL_FLOAT64_INIT(1e-9l));
+    rs = DPL_FLOAT64_MUL(rs, rs);
+    qs = DPL_FLOAT64_MUL(DPL_FLOAT64_MUL(DPL_FLOAT64_INIT(MYNEWT_VAL(UWB_WCS_FILTER_DRIFT_NOISE)),
+                                         DPL_FLOAT64_INIT(1e-9l)), T);
+    qs = DPL_FLOAT64_MUL(qs, qs);
+    qd = DPL_FLOAT64_MUL(qs, DPL_FLOAT64_INIT(0.01l));
+
+    /* The filter is started from a single measurement with an unknown drift */
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 3; j++) {
+            P[i][j] = zero;
+        }
+    }
+    P[0][0] = rt;
+    P[1][1] = rs;
+    P[2][2] = DPL_FLOAT64_MUL(qs, DPL_FLOAT64_INIT(1e4l));
+
+    for (step = 1; step < WCS_FILTER_GAINS + 256; step++) {
+        /* P = F P F' + Q */
+        for (i = 0; i < 3; i++) {
+            for (j = 0; j < 3; j++) {
+                FP[i][j] = zero;
+                for (m = 0; m < 3; m++) {
+                    FP[i][j] = DPL_FLOAT64_ADD(FP[i][j], DPL_FLOAT64_MUL(F[i][m], P[m][j]));
+                }
+            }
+        }
+        for (i = 0; i < 3; i++) {
+            for (j = 0; j < 3; j++) {
+                P[i][j] = zero;
+                for (m = 0; m < 3; m++) {
+                    P[i][j] = DPL_FLOAT64_ADD(P[i][j], DPL_FLOAT64_MUL(FP[i][m], F[j][m]));
+                }
+            }
+        }
+        P[1][1] = DPL_FLOAT64_ADD(P[1][1], qs);
+        P[2][2] = DPL_FLOAT64_ADD(P[2][2], qd);
+
+        /* K = P H' inv(H P H' + R) */
+        det = DPL_FLOAT64_SUB(DPL_FLOAT64_MUL(DPL_FLOAT64_ADD(P[0][0], rt), DPL_FLOAT64_ADD(P[1][1], rs)),
+                              DPL_FLOAT64_MUL(P[0][1], P[1][0]));
+        S[0][0] = DPL_FLOAT64_DIV(DPL_FLOAT64_ADD(P[1][1], rs), det);
+        S[0][1] = DPL_FLOAT64_DIV(DPL_FLOAT64_SUB(zero, P[0][1]), det);
+        S[1][0] = DPL_FLOAT64_DIV(DPL_FLOAT64_SUB(zero, P[1][0]), det);
+        S[1][1] = DPL_FLOAT64_DIV(DPL_FLOAT64_ADD(P[0][0], rt), det);
+        for (i = 0; i < 3; i++) {
+            for (j = 0; j < 2; j++) {
+                K[i][j] = DPL_FLOAT64_ADD(DPL_FLOAT64_MUL(P[i][0], S[0][j]), DPL_FLOAT64_MUL(P[i][1], S[1][j]));
+            }
+        }
+
+        /* P = (I - K H) P */
+        for (i = 0; i < 3; i++) {
+            for (j = 0; j < 3; j++) {
+                tmp = DPL_FLOAT64_ADD(DPL_FLOAT64_MUL(K[i][0], P[0][j]), DPL_FLOAT64_MUL(K[i][1], P[1][j]));
+                FP[i][j] = DPL_FLOAT64_SUB(P[i][j], tmp);
+            }
+        }
+        memcpy(P, FP, sizeof(P));
+
+        if (step < WCS_FILTER_GAINS || step == WCS_FILTER_GAINS + 255) {
+            m = (step < WCS_FILTER_GAINS) ? step - 1 : WCS_FILTER_GAINS - 1;
+            for (i = 0; i < 3; i++) {
+                for (j = 0; j < 2; j++) {
+                    filter->gain[m][i][j] = DPL_FLOAT64_INT(DPL_FLOAT64_MUL(K[i][j], DPL_FLOAT64_INIT(1073741824.0l)));
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @fn wcs_filter_init(wcs_filter_t * filter, uint32_t period)
+ * @brief Compute the gains for a ccp period and restart the filter. Only this
+ * needs floating point, updates are integer only.
+ *
+ * @param filter  Pointer to wcs_filter_t.
+ * @param period  Nominal ccp period, dwt usec.
+ * @return void
+ */
+void
+wcs_filter_init(wcs_filter_t * filter, uint32_t period)
+{
+    assert(period);
+    memset(filter, 0, sizeof(wcs_filter_t));
+    filter->period = (int64_t)period << 16;
+    filter->inv_period = (int64_t)((1ULL << 60) / (uint64_t)filter->period);
+    wcs_filter_gains(filter, period);
+}
+
+/**
+ * @fn wcs_filter_reset(wcs_filter_t * filter)
+ * @brief Restart tracking from the next measurement, keeping the gains.
+ *
+ * @param filter  Pointer to wcs_filter_t.
+ * @return void
+ */
+void
+wcs_filter_reset(wcs_filter_t * filter)
+{
+    filter->valid = 0;
+    filter->step = 0;
+}
+
+/**
+ * @fn wcs_filter_update(wcs_filter_t * filter, uint64_t master_lo40, uint64_t interval, int64_t skew)
+ * @brief Advance the filter by one ccp frame. Measurements too far from the prediction
+ * restart the filter from that measurement.
+ *
+ * @param filter       Pointer to wcs_filter_t.
+ * @param master_lo40  Master timestamp of the frame, DTU.
+ * @param interval     Local time since the previous frame, DTU.
+ * @param skew         Fractional skew measured from the carrier integrator, Q60.
+ * @return 0 if tracking, 1 if the filter was (re)started
+ */
+int
+wcs_filter_update(wcs_filter_t * filter, uint64_t master_lo40, uint64_t interval, int64_t skew)
+{
+    int64_t n, ds, e_t, e_tn, e_s;
+    int32_t (*k)[2];
+
+    if (!filter->valid) {
+        goto restart;
+    }
+
+    /* Predict over the interval, n periods in Q30 */
+    n = mulshr((int64_t)interval, filter->inv_period, 30);
+    ds = mulshr(filter->drift, n, 30);
+    filter->time += ((int64_t)interval << 16) + mulshr((int64_t)interval, filter->skew + ds / 2, 44);
+    filter->skew += ds;
+
+    /* Innovation, the time difference wraps at 40 bits */
+    e_t = (int64_t)((uint64_t)((int64_t)(master_lo40 << 16) - filter->time) << 8) >> 8;
+    if (e_t > (filter->period << 12) || e_t < -(filter->period << 12)) {
+        goto restart;
+    }
+    filter->innovation = e_t;
+    e_tn = mulshr(e_t, filter->inv_period, 16);
+    e_s = skew - filter->skew;
+
+    k = filter->gain[((filter->step < WCS_FILTER_GAINS) ? filter->step : WCS_FILTER_GAINS) - 1];
+    filter->time += mulshr(mulshr(k[0][0], e_tn, 30) + mulshr(k[0][1], e_s, 30), filter->period, 44);
+    filter->skew += mulshr(k[1][0], e_tn, 30) + mulshr(k[1][1], e_s, 30);
+    filter->drift += mulshr(k[2][0], e_tn, 30) + mulshr(k[2][1], e_s, 30);
+    filter->time &= 0x00FFFFFFFFFFFFFFLL;
+    if (filter->step < UINT16_MAX) {
+        filter->step++;
+    }
+    return 0;
+
+restart:
+    filter->time = (int64_t)(master_lo40 & 0x0FFFFFFFFFFULL) << 16;
+    filter->skew = skew;
+    filter->drift = 0;
+    filter->innovation = 0;
+    filter->step = 1;
+    filter->valid = 1;
+    return 1;
+}
+
+#if MYNEWT_VAL(UWB_WCS_FILTER)
+
+static bool wcs_filter_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs);
+static void wcs_filter_ev(struct dpl_event * ev);
+
+/**
+ * @fn wcs_filter_attach(struct uwb_wcs_instance * wcs)
+ * @brief Use the fixed point filter to process the ccp frames of a wcs instance.
+ *
+ * @param wcs  Pointer to struct uwb_wcs_instance.
+ * @return struct uwb_wcs_instance *
+ */
+struct uwb_wcs_instance *
+wcs_filter_attach(struct uwb_wcs_instance * wcs)
+{
+    struct uwb_ccp_instance * ccp = wcs->ccp;
+
+    wcs_filter_init(&wcs->filter, ccp->period);
+    wcs->cbs = (struct uwb_mac_interface){
+        .id = UWBEXT_WCS,
+        .inst_ptr = (void*)wcs,
+        .superframe_cb = wcs_filter_cb
+    };
+    wcs->normalized_skew = DPL_FLOAT64_INIT(1.0l);
+    wcs->fractional_skew = DPL_FLOAT64_INIT(0.0l);
+    uwb_mac_append_interface(ccp->dev_inst, &wcs->cbs);
+    uwb_wcs_set_postprocess(wcs, &wcs_filter_ev);
+    return wcs;
+}
+
+/**
+ * @fn wcs_filter_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
+ * @brief Superframe callback, interrupt context. Latches the epochs of the ccp frame.
+ *
+ * @param inst  Pointer to struct uwb_dev.
+ * @param cbs   Pointer to struct uwb_mac_interface.
+ * @return true
+ */
+static bool
+wcs_filter_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
+{
+    struct uwb_wcs_instance * wcs = (struct uwb_wcs_instance *)cbs->inst_ptr;
+    struct uwb_ccp_instance * ccp = wcs->ccp;
+
+    /* Predicted superframe, keep extrapolating from the last received epoch */
+    if (ccp->status.holdover) {
+        return true;
+    }
+
+    uwb_ccp_frame_t * frame = ccp->frames[(ccp->idx)%ccp->nframes];
+    wcs->carrier_integrator = frame->carrier_integrator;
+    wcs->observed_interval = (ccp->local_epoch - wcs->local_epoch.lo) & 0x0FFFFFFFFFFUL;
+    wcs->master_epoch.timestamp = ccp->master_epoch.timestamp;
+    wcs->local_epoch.timestamp += wcs->observed_interval;
+
+    if (ccp->status.valid) {
+        if (wcs->config.postprocess == true)
+            dpl_eventq_put(dpl_eventq_dflt_get(), &wcs->postprocess_ev);
+    } else {
+        wcs->normalized_skew = DPL_FLOAT64_INIT(1.0l);
+        wcs->fractional_skew = DPL_FLOAT64_INIT(0.0l);
+        wcs->status.initialized = 0;
+        wcs_filter_reset(&wcs->filter);
+    }
+    return true;
+}
+
+/**
+ * @fn wcs_filter_ev(struct dpl_event * ev)
+ * @brief Filter update, thread context. Publishes the states in the same form as the
+ * timescale filter so the rest of wcs is unchanged.
+ *
+ * @param ev  Pointer to struct dpl_event.
+ * @return void
+ */
+static void
+wcs_filter_ev(struct dpl_event * ev)
+{
+    assert(ev != NULL);
+    assert(dpl_event_get_arg(ev) != NULL);
+
+    struct uwb_wcs_instance * wcs = (struct uwb_wcs_instance *)dpl_event_get_arg(ev);
+    struct uwb_ccp_instance * ccp = wcs->ccp;
+    wcs_filter_t * filter = &wcs->filter;
+    dpl_float64_t dtu = DPL_FLOAT64_INIT(MYNEWT_VAL(UWB_WCS_DTU));
+    dpl_float64_t skew, drift;
+    int64_t ratio;
+
+    if (!ccp->status.valid) {
+        return;
+    }
+    if (filter->period != ((int64_t)ccp->period << 16)) {
+        wcs_filter_init(filter, ccp->period);
+    }
+
+    ratio = DPL_FLOAT64_INT(DPL_FLOAT64_MUL(uwb_calc_clock_offset_ratio(ccp->dev_inst, wcs->carrier_integrator,
+                                            UWB_CR_CARRIER_INTEGRATOR), DPL_FLOAT64_INIT(Q60)));
+    wcs_filter_update(filter, wcs->master_epoch.lo, wcs->observed_interval, ratio);
+    wcs->status.valid = wcs->status.initialized = 1;
+
+    skew = DPL_FLOAT64_DIV(DPL_FLOAT64_I64_TO_F64(filter->skew), DPL_FLOAT64_INIT(Q60));
+    drift = DPL_FLOAT64_DIV(DPL_FLOAT64_I64_TO_F64(filter->drift), DPL_FLOAT64_INIT(Q60));
+    wcs->states.time = DPL_FLOAT64_DIV(DPL_FLOAT64_I64_TO_F64(filter->time), DPL_FLOAT64_INIT(65536.0l));
+    wcs->normalized_skew = DPL_FLOAT64_ADD(DPL_FLOAT64_INIT(1.0l), skew);
+    wcs->fractional_skew = DPL_FLOAT64_SUB(DPL_FLOAT64_INIT(0.0l), skew);
+    wcs->states.skew = DPL_FLOAT64_MUL(wcs->normalized_skew, dtu);
+    /* Drift per period to drift per second, in DTU */
+    wcs->states.drift = DPL_FLOAT64_DIV(DPL_FLOAT64_MUL(DPL_FLOAT64_MUL(drift, dtu), dtu),
+                                        DPL_FLOAT64_I64_TO_F64(filter->period));
+
+#if MYNEWT_VAL(UWB_WCS_AFFINE)
+    /* The fixed point states map onto the cached transform without a float round trip */
+    uwb_wcs_affine_set(wcs, filter->time, filter->skew >> 20, mulshr(filter->drift, filter->inv_period, 41));
+#endif
+
+#if MYNEWT_VAL(UWB_WCS_VERBOSE)
+    wcs_json_t json = {
+        .utime = ccp->master_epoch.timestamp,
+        .wcs = {wcs->states.time, wcs->states.skew, wcs->states.drift},
+        .ppm = DPL_FLOAT64_MUL(wcs->fractional_skew, DPL_FLOAT64_INIT(1e6l))
+    };
+    wcs_json_write_uint64(&json);
+#endif
+}
+
+/**
+ * @fn wcs_filter_pkg_init(void)
+ * @brief Attach the fixed point filter to the wcs instance of each device.
+ *
+ * @return void
+ */
+void
+wcs_filter_pkg_init(void)
+{
+    int i;
+    struct uwb_dev * udev;
+    struct uwb_ccp_instance * ccp;
+
+#if MYNEWT_VAL(UWB_PKG_INIT_LOG)
+    printf("{\"utime\": %"PRIu32",\"msg\": \"wcs_filter_pkg_init\"}\n",
+           dpl_cputime_ticks_to_usecs(dpl_cputime_get32()));
+#endif
+
+    for (i = 0; i < MYNEWT_VAL(UWB_DEVICE_MAX); i++) {
+        udev = uwb_dev_idx_lookup(i);
+        if (!udev) {
+            continue;
+        }
+        ccp = (struct uwb_ccp_instance*)uwb_mac_find_cb_inst_ptr(udev, UWBEXT_CCP);
+        wcs_filter_attach(ccp->wcs);
+    }
+}
+
+/**
+ * @fn wcs_filter_pkg_down(int reason)
+ * @brief Detach the fixed point filter.
+ *
+ * @return int
+ */
+int
+wcs_filter_pkg_down(int reason)
+{
+    int i;
+    struct uwb_dev *udev;
+    struct uwb_wcs_instance * wcs;
+
+    for (i = 0; i < MYNEWT_VAL(UWB_DEVICE_MAX); i++) {
+        udev = uwb_dev_idx_lookup(i);
+        if (!udev) {
+            continue;
+        }
+        wcs = (struct uwb_wcs_instance*)uwb_mac_find_cb_inst_ptr(udev, UWBEXT_WCS);
+        if (!wcs) {
+            continue;
+        }
+        uwb_mac_remove_interface(wcs->ccp->dev_inst, wcs->cbs.id);
+    }
+
+    return 0;
+}
+
+#else
+
+void wcs_filter_pkg_init(void){return;};
+int wcs_filter_pkg_down(int reason){return 0;};
+
+#endif  //UWB_WCS_FILTER
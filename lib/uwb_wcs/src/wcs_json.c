@@ -30,8 +30,6 @@
 #include <assert.h>
 #include <uwb_wcs/wcs_json.h>
 
-static int wcs_write_line(void *buf, char* data, int len);
-
 wcs_json_t * wcs_json_init(wcs_json_t * json){
 
     if (json == NULL){
@@ -52,29 +50,13 @@ wcs_json_free(wcs_json_t * json){
         free(json);
 }
 
-static int
-wcs_write_line(void *buf, char* data, int len)
-{
-    wcs_json_t * json = buf;
-    for (uint16_t i=0; i < len; i++){
-        json->iobuf[(json->idx++)%MYNEWT_VAL(UWB_WCS_JSON_BUFSIZE)] = data[i];
-        if (data[i]=='\0'){
-            break;
-        }
-    }
-    if (json->iobuf[json->idx-1]=='\0')
-        json->idx = 0;
-    return len;
-}
-
 int
 wcs_json_write(wcs_json_t * json){
 
     struct json_value value;
     int rc;
 
-    json->encoder.je_write = wcs_write_line;
-    json->encoder.je_arg = (void *)json;
+    json_encode_buf_init(&json->encoder, json->iobuf, sizeof(json->iobuf));
     json->decoder.json_buf.jb_read_next = json_read_next;
     json->decoder.json_buf.jb_read_prev = json_read_prev;
     json->decoder.json_buf.jb_readn = json_readn;
@@ -104,7 +86,9 @@ wcs_json_write(wcs_json_t * json){
     json->encoder.je_wr_commas = 0;
     assert(rc == 0);
 
-    wcs_write_line(json->encoder.je_arg, "\0", 1);
+    if (json_encode_buf_finish(&json->encoder) < 0) {
+        rc = -1;
+    }
 
     return rc;
 }
@@ -115,8 +99,7 @@ wcs_json_write_uint64(wcs_json_t * json){
     struct json_value value;
     int rc;
 
-    json->encoder.je_write = wcs_write_line;
-    json->encoder.je_arg = (void *)  json;
+    json_encode_buf_init(&json->encoder, json->iobuf, sizeof(json->iobuf));
     json->decoder.json_buf.jb_read_next = json_read_next;
     json->decoder.json_buf.jb_read_prev = json_read_prev;
     json->decoder.json_buf.jb_readn = json_readn;
@@ -146,12 +129,16 @@ wcs_json_write_uint64(wcs_json_t * json){
     json->encoder.je_wr_commas = 0;
     assert(rc == 0);
 
-    wcs_write_line(json->encoder.je_arg, "\0", 1);
+    if (json_encode_buf_finish(&json->encoder) < 0) {
+        rc = -1;
+    }
 
     return rc;
 }
 
 #ifdef FLOAT_SUPPORT
+static struct json_attr_index wcs_json_read_index;
+
 int
 wcs_json_read(wcs_json_t * json, char * line){
 
@@ -201,8 +188,6 @@ wcs_json_read(wcs_json_t * json, char * line){
         }
     };
 
-    json->encoder.je_write = wcs_write_line;
-    json->encoder.je_arg = NULL;
     json->decoder.json_buf.jb_read_next = json_read_next;
     json->decoder.json_buf.jb_read_prev = json_read_prev;
     json->decoder.json_buf.jb_readn = json_readn;
@@ -211,12 +196,14 @@ wcs_json_read(wcs_json_t * json, char * line){
     json->decoder.end_buf = line + strlen(line);
     json->decoder.current_position = 0;
 
-    int rc = json_read_object(&json->decoder.json_buf, ccp_attr);
+    int rc = json_read_object_indexed(&json->decoder.json_buf, ccp_attr, &wcs_json_read_index);
 
     return rc;
 }
 #endif
 
+static struct json_attr_index wcs_json_read_uint64_index;
+
 int
 wcs_json_read_uint64(wcs_json_t * json, char * line){
 
@@ -262,8 +249,6 @@ wcs_json_read_uint64(wcs_json_t * json, char * line){
         }
     };
 
-    json->encoder.je_write = wcs_write_line;
-    json->encoder.je_arg = NULL;
     json->decoder.json_buf.jb_read_next = json_read_next;
     json->decoder.json_buf.jb_read_prev = json_read_prev;
     json->decoder.json_buf.jb_readn = json_readn;
@@ -272,7 +257,7 @@ wcs_json_read_uint64(wcs_json_t * json, char * line){
     json->decoder.end_buf = line + strlen(line);
     json->decoder.current_position = 0;
 
-    int rc = json_read_object(&json->decoder.json_buf, ccp_attr);
+    int rc = json_read_object_indexed(&json->decoder.json_buf, ccp_attr, &wcs_json_read_uint64_index);
 
     return rc;
 }
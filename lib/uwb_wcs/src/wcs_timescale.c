@@ -119,6 +119,11 @@ wcs_timescale_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
     struct uwb_wcs_instance * wcs = (struct uwb_wcs_instance *)cbs->inst_ptr;
     struct uwb_ccp_instance * ccp = wcs->ccp;
 
+    /* Predicted superframe, keep extrapolating from the last received epoch */
+    if (ccp->status.holdover) {
+        return true;
+    }
+
     uwb_ccp_frame_t * frame = ccp->frames[(ccp->idx)%ccp->nframes];
     wcs->carrier_integrator = frame->carrier_integrator;
     wcs->observed_interval = (ccp->local_epoch - wcs->local_epoch.lo) & 0x0FFFFFFFFFFUL; // Observed ccp interval
@@ -138,6 +143,54 @@ wcs_timescale_cb(struct uwb_dev * inst, struct uwb_mac_interface * cbs)
 }
 
 
+/**
+ * @fn wcs_timescale_update(struct uwb_wcs_instance * wcs, double ratio)
+ * @brief Timescale filter update from the latched master epoch and observed
+ * interval. (Re)starts the filter when wcs->status.initialized is clear and
+ * publishes the states and skews.
+ *
+ * @param wcs    Pointer to struct uwb_wcs_instance, wcs->timescale may be NULL.
+ * @param ratio  Clock offset ratio of the ccp frame, master/local - 1.
+ *
+ * @return true if the states are valid
+ */
+bool
+wcs_timescale_update(struct uwb_wcs_instance * wcs, double ratio)
+{
+    uwb_wcs_states_t * states = (uwb_wcs_states_t *) wcs->states.array;
+    double q[] = { MYNEWT_VAL(TIMESCALE_QVAR) * 1.0l, MYNEWT_VAL(TIMESCALE_QVAR) * 0.1l, MYNEWT_VAL(TIMESCALE_QVAR) * 0.01l};
+
+    if (wcs->status.initialized == 0){
+        states->time = (double) wcs->master_epoch.lo;
+        states->skew = (1.0l + ratio) * MYNEWT_VAL(UWB_WCS_DTU);
+        states->drift = 0;
+        double x0[] = {states->time, states->skew, states->drift};
+        double T = 1e-6l * MYNEWT_VAL(UWB_CCP_PERIOD);
+        wcs->timescale = timescale_init(wcs->timescale, x0, q, T);
+        ((timescale_states_t * )wcs->timescale->eke->x)->time = states->time;
+        ((timescale_states_t * )wcs->timescale->eke->x)->skew = states->skew;
+        ((timescale_states_t * )wcs->timescale->eke->x)->drift =states->drift;
+        wcs->status.valid = wcs->status.initialized = 1;
+    }else{
+        double z[] ={(double) wcs->master_epoch.lo, (1.0l + ratio) * MYNEWT_VAL(UWB_WCS_DTU)};
+        double T = wcs->observed_interval / MYNEWT_VAL(UWB_WCS_DTU) ; // observed interval in seconds, master reference
+        double r[] = {MYNEWT_VAL(TIMESCALE_RVAR), MYNEWT_VAL(UWB_WCS_DTU) * 1e20};
+        wcs->status.valid = timescale_main(wcs->timescale, z, q, r, T).valid;
+    }
+
+    if (wcs->status.valid){
+        states->time = ((timescale_states_t * )wcs->timescale->eke->x)->time;
+        states->skew = ((timescale_states_t * )wcs->timescale->eke->x)->skew;
+        states->drift = ((timescale_states_t * )wcs->timescale->eke->x)->drift;
+        wcs->normalized_skew = states->skew / MYNEWT_VAL(UWB_WCS_DTU);
+        wcs->fractional_skew = (dpl_float64_t) 1.0l - wcs->normalized_skew;
+    }else{
+        wcs->normalized_skew = (dpl_float64_t) 1.0l;
+        wcs->fractional_skew = (dpl_float64_t) 0.0l;
+    }
+    return wcs->status.valid;
+}
+
 /*!
  * @fn wcs_timescale_ev(struct dpl_event * ev)
  *
@@ -158,47 +211,14 @@ wcs_timescale_ev(struct dpl_event * ev)
 
     struct uwb_wcs_instance * wcs = (struct uwb_wcs_instance *)dpl_event_get_arg(ev);
     struct uwb_ccp_instance * ccp = wcs->ccp;
-    uwb_wcs_states_t * states = (uwb_wcs_states_t *) wcs->states.array;
-    timescale_instance_t * timescale = wcs->timescale;
 
     if(ccp->status.valid){
-        double q[] = { MYNEWT_VAL(TIMESCALE_QVAR) * 1.0l, MYNEWT_VAL(TIMESCALE_QVAR) * 0.1l, MYNEWT_VAL(TIMESCALE_QVAR) * 0.01l};
-
-        if (wcs->status.initialized == 0){
-            states->time = (double) wcs->master_epoch.lo;
-            states->skew = (1.0l + (double ) uwb_calc_clock_offset_ratio(
+        wcs_timescale_update(wcs, (double) uwb_calc_clock_offset_ratio(
                                 ccp->dev_inst, wcs->carrier_integrator,
-                                UWB_CR_CARRIER_INTEGRATOR)) * MYNEWT_VAL(UWB_WCS_DTU) ;
-            states->drift = 0;
-            double x0[] = {states->time, states->skew, states->drift};
-            double T = 1e-6l * MYNEWT_VAL(UWB_CCP_PERIOD);
-            timescale = timescale_init(timescale, x0, q, T);
-            ((timescale_states_t * )timescale->eke->x)->time = states->time;
-            ((timescale_states_t * )timescale->eke->x)->skew = states->skew;
-            ((timescale_states_t * )timescale->eke->x)->drift =states->drift;
-            wcs->status.valid = wcs->status.initialized = 1;
-        }else{
-            double z[] ={(double) wcs->master_epoch.lo,
-                        (1.0l + (double ) uwb_calc_clock_offset_ratio(
-                               ccp->dev_inst, wcs->carrier_integrator,
-                               UWB_CR_CARRIER_INTEGRATOR)) * MYNEWT_VAL(UWB_WCS_DTU)
-            };
-            double T = wcs->observed_interval / MYNEWT_VAL(UWB_WCS_DTU) ; // observed interval in seconds, master reference
-            double r[] = {MYNEWT_VAL(TIMESCALE_RVAR), MYNEWT_VAL(UWB_WCS_DTU) * 1e20};
-            wcs->status.valid = timescale_main(timescale, z, q, r, T).valid;
-        }
-
-        if (wcs->status.valid){
-            states->time = ((timescale_states_t * )timescale->eke->x)->time;
-            states->skew = ((timescale_states_t * )timescale->eke->x)->skew;
-            states->drift = ((timescale_states_t * )timescale->eke->x)->drift;
-            wcs->normalized_skew = states->skew / MYNEWT_VAL(UWB_WCS_DTU);
-            wcs->fractional_skew = (dpl_float64_t) 1.0l - wcs->normalized_skew;
-        }else{
-            wcs->normalized_skew = (dpl_float64_t) 1.0l;
-            wcs->fractional_skew = (dpl_float64_t) 0.0l;
-        }
+                                UWB_CR_CARRIER_INTEGRATOR));
+        uwb_wcs_affine_update(wcs);
 #if MYNEWT_VAL(UWB_WCS_VERBOSE)
+    uwb_wcs_states_t * states = (uwb_wcs_states_t *) wcs->states.array;
     wcs_json_t json = {
         .utime = ccp->master_epoch.timestamp,
         .wcs = {states->time, states->skew, states->drift},
@@ -0,0 +1,189 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file euclid_bench.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Host benchmark of the euclid solvers
+ *
+ * @details Times multilat_solve() on 8 noisy ranges per solve, from the closed form
+ * start through the refinement and the leave one out check, tdoa_solve() on one
+ * round of 8 arrivals per solve, and track_range() on single range updates of an
+ * active track. Build from the top of the tree, after a host build has generated
+ * syscfg.h, with:
+ *
+ *     cc -O2 -std=gnu99 -fms-extensions -DFLOAT_SUPPORT \
+ *        -I bin/targets/syscfg/generated/include -I porting/dpl/linux/include \
+ *        -I porting/dpl_os/include -I porting/dpl_hal/include -I porting/dpl_lib/include \
+ *        -I lib/euclid/include -I lib/euclid/src -o euclid_bench tools/uwb_bench/euclid_bench.c \
+ *        lib/euclid/src/multilat.c lib/euclid/src/tdoa.c lib/euclid/src/track.c -lm
+ *
+ * Usage:
+ *
+ *     euclid_bench [count]
+ *
+ * Prints one JSON line per solver, each timing count solves or updates.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+#include <euclid/multilat.h>
+#include <euclid/tdoa.h>
+#include <euclid/track.h>
+
+#define BENCH_TDOA_OFFSET (1234.5)
+
+static const triad_t bench_anchors[] = {
+    {.x = 0, .y = 0, .z = 2.5},
+    {.x = 20, .y = 0, .z = 3.0},
+    {.x = 20, .y = 15, .z = 0.5},
+    {.x = 0, .y = 15, .z = 2.8},
+    {.x = 10, .y = -2, .z = 0.3},
+    {.x = 10, .y = 17, .z = 3.1},
+    {.x = -2, .y = 7, .z = 1.0},
+    {.x = 22, .y = 8, .z = 2.2},
+};
+#define BENCH_NANCHORS (sizeof(bench_anchors) / sizeof(bench_anchors[0]))
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double
+bench_range(const triad_t * a, const triad_t * b)
+{
+    return sqrt((a->x - b->x) * (a->x - b->x) + (a->y - b->y) * (a->y - b->y) +
+                (a->z - b->z) * (a->z - b->z));
+}
+
+/* Sum of uniforms, close enough to gaussian here */
+static double
+bench_noise(double sigma)
+{
+    double s = 0;
+    for (int k = 0; k < 12; k++) {
+        s += (double)rand() / RAND_MAX;
+    }
+    return (s - 6) * sigma;
+}
+
+static void
+bench_print(const char * name, const char * unit, uint32_t count, uint64_t ns)
+{
+    printf("{\"bench\": \"%s\", \"%s\": %lu, \"usec\": %llu, \"%s_per_sec\": %llu}\n",
+           name, unit, (unsigned long)count, (unsigned long long)ns / 1000, unit,
+           (unsigned long long)(ns ? (uint64_t)count * 1000000000ULL / ns : 0));
+}
+
+static void
+bench_multilat(uint32_t solves)
+{
+    multilat_meas_t meas[BENCH_NANCHORS];
+    multilat_result_t result;
+    triad_t tag = {.x = 7.3, .y = 4.1, .z = 1.2};
+
+    for (uint16_t i = 0; i < BENCH_NANCHORS; i++) {
+        meas[i].anchor = bench_anchors[i];
+        meas[i].range = bench_range(&bench_anchors[i], &tag) + bench_noise(0.05);
+        meas[i].variance = 0.05 * 0.05;
+    }
+    uint64_t t0 = now_ns();
+    for (uint32_t s = 0; s < solves; s++) {
+        meas[s % BENCH_NANCHORS].range += ((s / BENCH_NANCHORS) & 1) ? 0.01 : -0.01;
+        multilat_solve(meas, BENCH_NANCHORS, 3, NULL, &result);
+    }
+    bench_print("multilat", "solves", solves, now_ns() - t0);
+}
+
+/* tdoa_solve() only touches the measurements and result passed in, nothing is allocated */
+static void
+bench_tdoa(uint32_t solves)
+{
+    tdoa_meas_t meas[BENCH_NANCHORS];
+    tdoa_result_t result;
+    triad_t tag = {.x = 7.3, .y = 4.1, .z = 1.2};
+
+    for (uint16_t i = 0; i < BENCH_NANCHORS; i++) {
+        meas[i].anchor = bench_anchors[i];
+        meas[i].tdoa = bench_range(&bench_anchors[i], &tag) + BENCH_TDOA_OFFSET + bench_noise(0.05);
+        meas[i].variance = 0.05 * 0.05;
+    }
+    uint64_t t0 = now_ns();
+    for (uint32_t s = 0; s < solves; s++) {
+        meas[s % BENCH_NANCHORS].tdoa += ((s / BENCH_NANCHORS) & 1) ? 0.01 : -0.01;
+        tdoa_solve(meas, BENCH_NANCHORS, 3, NULL, &result);
+    }
+    bench_print("tdoa", "solves", solves, now_ns() - t0);
+}
+
+/* Tag walking at 1 m/s along x */
+static void
+bench_walk(uint64_t utime, triad_t * tag)
+{
+    tag->x = 3 + utime * 1e-6;
+    tag->y = 6;
+    tag->z = 1.2;
+}
+
+static void
+bench_track(uint32_t updates)
+{
+    static track_t storage[4];
+    track_config_t config = {.dim = 3, .accel_noise = 0.5, .variance = 0.05 * 0.05, .gate = 5,
+                             .expiry = 2000000};
+    track_table_t table;
+    triad_t tag;
+    uint64_t utime;
+
+    /* Start the track at 100 Hz before timing updates at 1 kHz */
+    track_table_init(&table, storage, sizeof(storage) / sizeof(storage[0]), &config);
+    for (utime = 0; utime < 100000; utime += 10000) {
+        const triad_t * a = &bench_anchors[(utime / 10000) % BENCH_NANCHORS];
+        bench_walk(utime, &tag);
+        track_range(&table, 0x1234, utime, a, bench_range(a, &tag), 0);
+    }
+    uint64_t t0 = now_ns();
+    for (uint32_t i = 0; i < updates; i++, utime += 1000) {
+        const triad_t * a = &bench_anchors[i % BENCH_NANCHORS];
+        bench_walk(utime, &tag);
+        track_range(&table, 0x1234, utime, a, bench_range(a, &tag) + ((i & 1) ? 0.01 : -0.01), 0);
+    }
+    bench_print("track", "updates", updates, now_ns() - t0);
+}
+
+int
+main(int argc, char ** argv)
+{
+    uint32_t count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 100000;
+
+    srand(7);
+    bench_multilat(count);
+    bench_tdoa(count);
+    bench_track(count);
+    return 0;
+}
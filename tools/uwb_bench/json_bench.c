@@ -0,0 +1,474 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file json_bench.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Host benchmark of the json encoder and decoder
+ *
+ * @details Times the je_write path of the encoder against direct buffer output on
+ * payloads laid out like the rng, ccp, wcs and cir json writers, and the decoding of
+ * range log lines with the decoder as it was before the attribute index and in-place
+ * number parsing, json_read_object() and json_read_object_indexed(), all three on a
+ * json_decoder_t. Lines are decoded twice, once as written by the current encoder
+ * (shortest round trip reals, float32 for rssi and los) and once as written by the
+ * legacy %.3f encoder. Build from the top of the tree, after a host build has
+ * generated syscfg.h, with:
+ *
+ *     git show e731833^:lib/json/src/json_decode.c > json_decode_base.c
+ *     cc -O2 -std=gnu99 -fms-extensions -DFLOAT_SUPPORT \
+ *        -I bin/targets/syscfg/generated/include -I porting/dpl/linux/include \
+ *        -I porting/dpl_os/include -I porting/dpl_hal/include -I porting/dpl_lib/include \
+ *        -I lib/json/include -Djson_read_object=json_base_read_object \
+ *        -Djson_read_array=json_base_read_array -c json_decode_base.c
+ *     cc -O2 -std=gnu99 -fms-extensions -DFLOAT_SUPPORT \
+ *        -I bin/targets/syscfg/generated/include -I porting/dpl/linux/include \
+ *        -I porting/dpl_os/include -I porting/dpl_hal/include -I porting/dpl_lib/include \
+ *        -I lib/json/include -o json_bench tools/uwb_bench/json_bench.c \
+ *        lib/json/src/json_encode.c lib/json/src/json_decode.c lib/json/src/json_fmt.c \
+ *        lib/json/src/json_util.c porting/dpl/linux/src/dpl_atomic.c json_decode_base.o \
+ *        -lm -lpthread
+ *
+ * Usage:
+ *
+ *     json_bench [rounds]
+ *
+ * Prints one JSON line per payload, then one per log format for the decoder over
+ * rounds / 32 passes of the log.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include <dpl/dpl.h>
+#include <json/json.h>
+#include <json/json_util.h>
+
+#define ENCODE_BUF_SIZE     (512)
+#define DECODE_LOG_LINES    (32)
+
+static char encode_buf[ENCODE_BUF_SIZE];
+static uint16_t encode_idx;
+
+/* Per byte writer as used by the payload encoders before direct output */
+static int
+encode_write_line(void *buf, char *data, int len)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        encode_buf[(encode_idx++) % ENCODE_BUF_SIZE] = data[i];
+        if (data[i] == '\0') {
+            break;
+        }
+    }
+    if (encode_buf[encode_idx - 1] == '\0') {
+        encode_idx = 0;
+    }
+    return len;
+}
+
+static void
+encode_float_array(struct json_encoder *e, char *name, const dpl_float64_t *v, int n)
+{
+    struct json_value value;
+
+    json_encode_array_name(e, name);
+    json_encode_array_start(e);
+    for (int i = 0; i < n; i++) {
+        JSON_VALUE_FLOAT64(&value, v[i]);
+        json_encode_array_value(e, &value);
+    }
+    json_encode_array_finish(e);
+}
+
+/* Same layout as rng_json_write() */
+static void
+encode_rng(struct json_encoder *e)
+{
+    const dpl_float64_t raz[] = {4.231940746307373, 0.7853981633974483, 1.5707963267948966};
+    const dpl_float64_t braz[] = {4.229600429534912, -0.5235987755982988, 1.5707963267948966};
+    const dpl_float64_t rssi[] = {-81.86238861083984, -82.1, -82.35};
+    const dpl_float64_t los[] = {0.9375, 1.0, 0.96875};
+    struct json_value value;
+
+    json_encode_object_start(e);
+    JSON_VALUE_UINT(&value, 1591714503113ULL);
+    json_encode_object_entry(e, "utime", &value);
+    JSON_VALUE_UINT(&value, 117);
+    json_encode_object_entry(e, "seq", &value);
+    JSON_VALUE_UINT(&value, 0xE5A2);
+    json_encode_object_entry(e, "c", &value);
+    JSON_VALUE_UINT(&value, 0x1234);
+    json_encode_object_entry(e, "uid", &value);
+    JSON_VALUE_UINT(&value, 0x4321);
+    json_encode_object_entry(e, "ouid", &value);
+    encode_float_array(e, "raz", raz, 3);
+    encode_float_array(e, "braz", braz, 3);
+    encode_float_array(e, "rssi", rssi, 3);
+    encode_float_array(e, "los", los, 3);
+    JSON_VALUE_FLOAT64(&value, -4.268551349639893);
+    json_encode_object_entry(e, "ppm", &value);
+    json_encode_object_finish(e);
+}
+
+/* Same layout as ccp_json_write() */
+static void
+encode_ccp(struct json_encoder *e)
+{
+    const dpl_float64_t ccp[] = {832218710528.0, 65536000.0};
+    struct json_value value;
+
+    json_encode_object_start(e);
+    JSON_VALUE_UINT(&value, 1591714503113ULL);
+    json_encode_object_entry(e, "utime", &value);
+    encode_float_array(e, "ccp", ccp, 2);
+    JSON_VALUE_UINT(&value, 201);
+    json_encode_object_entry(e, "seq", &value);
+    JSON_VALUE_UINT(&value, 0x1234);
+    json_encode_object_entry(e, "uid", &value);
+    JSON_VALUE_FLOAT64(&value, 3.0517578125);
+    json_encode_object_entry(e, "ppm", &value);
+    json_encode_object_finish(e);
+}
+
+/* Same layout as wcs_json_write() */
+static void
+encode_wcs(struct json_encoder *e)
+{
+    const dpl_float64_t wcs[] = {832218710528.0, 1.0000030517578125, -1.2079226507921703e-13};
+    struct json_value value;
+
+    json_encode_object_start(e);
+    JSON_VALUE_UINT(&value, 1591714503113ULL);
+    json_encode_object_entry(e, "utime", &value);
+    encode_float_array(e, "wcs", wcs, 3);
+    JSON_VALUE_UINT(&value, 201);
+    json_encode_object_entry(e, "seq", &value);
+    JSON_VALUE_UINT(&value, 0x1234);
+    json_encode_object_entry(e, "uid", &value);
+    JSON_VALUE_FLOAT64(&value, 3.0517578125);
+    json_encode_object_entry(e, "ppm", &value);
+    json_encode_object_finish(e);
+}
+
+/* Same layout as cir_json_write() with 16 samples */
+static void
+encode_cir(struct json_encoder *e)
+{
+    struct json_value value;
+    int i;
+
+    json_encode_object_start(e);
+    JSON_VALUE_UINT(&value, 1591714503113ULL);
+    json_encode_object_entry(e, "utime", &value);
+    JSON_VALUE_STRING(&value, "ipatov");
+    json_encode_object_entry(e, "cir_type", &value);
+    JSON_VALUE_UINT(&value, 832218710528ULL);
+    json_encode_object_entry(e, "raw_ts", &value);
+    JSON_VALUE_UINT(&value, 27);
+    json_encode_object_entry(e, "resam_dly", &value);
+    JSON_VALUE_FLOAT64(&value, 745.25);
+    json_encode_object_entry(e, "fp_idx", &value);
+    JSON_VALUE_FLOAT64(&value, -84.43011474609375);
+    json_encode_object_entry(e, "fp_power", &value);
+    JSON_VALUE_FLOAT64(&value, 1.2566370614359172);
+    json_encode_object_entry(e, "angle", &value);
+    JSON_VALUE_UINT(&value, 118);
+    json_encode_object_entry(e, "acc_cnt", &value);
+    JSON_VALUE_UINT(&value, 8);
+    json_encode_object_entry(e, "offset", &value);
+    json_encode_array_name(e, "real");
+    json_encode_array_start(e);
+    for (i = 0; i < 16; i++) {
+        JSON_VALUE_INT(&value, (i * 2731) % 7919 - 3960);
+        json_encode_array_value(e, &value);
+    }
+    json_encode_array_finish(e);
+    json_encode_array_name(e, "imag");
+    json_encode_array_start(e);
+    for (i = 0; i < 16; i++) {
+        JSON_VALUE_INT(&value, (i * 1907) % 6143 - 3071);
+        json_encode_array_value(e, &value);
+    }
+    json_encode_array_finish(e);
+    json_encode_object_finish(e);
+}
+
+static int
+encode_direct(struct json_encoder *e, void (*payload)(struct json_encoder *))
+{
+    json_encode_buf_init(e, encode_buf, sizeof(encode_buf));
+    payload(e);
+    return json_encode_buf_finish(e);
+}
+
+static void
+encode_legacy(struct json_encoder *e, void (*payload)(struct json_encoder *))
+{
+    json_encode_buf_init(e, NULL, 0);
+    e->je_write = encode_write_line;
+    e->je_arg = NULL;
+    payload(e);
+    encode_write_line(NULL, "\0", 1);
+}
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+bench_encode(uint32_t rounds)
+{
+    struct json_encoder encoder;
+    int len = 0;
+    const struct {
+        const char *name;
+        void (*payload)(struct json_encoder *);
+    } payloads[] = {
+        {"rng", encode_rng}, {"ccp", encode_ccp}, {"wcs", encode_wcs}, {"cir", encode_cir}
+    };
+
+    memset(&encoder, 0, sizeof(encoder));
+    for (int k = 0; k < sizeof(payloads)/sizeof(payloads[0]); k++) {
+        uint64_t t0 = now_ns();
+        for (uint32_t r = 0; r < rounds; r++) {
+            encode_legacy(&encoder, payloads[k].payload);
+        }
+        uint64_t t1 = now_ns();
+        for (uint32_t r = 0; r < rounds; r++) {
+            len = encode_direct(&encoder, payloads[k].payload);
+        }
+        uint64_t t2 = now_ns();
+
+        printf("{\"bench\": \"json_encode\", \"payload\": \"%s\", \"rounds\": %lu, \"len\": %d, "
+               "\"je_write_usec\": %llu, \"direct_usec\": %llu}\n", payloads[k].name, (unsigned long)rounds, len,
+               (unsigned long long)(t1 - t0) / 1000, (unsigned long long)(t2 - t1) / 1000);
+    }
+}
+
+/* Decoded form of a range log line, as in rng_json_read() */
+struct decode_rng {
+    uint64_t utime;
+    uint64_t seq;
+    uint64_t uid;
+    uint64_t ouid;
+    dpl_float64_t raz[3];
+    dpl_float64_t rssi[3];
+    dpl_float64_t los[3];
+    dpl_float64_t ppm;
+    dpl_float64_t sts;
+    int64_t offset[4];
+};
+
+static char decode_log[DECODE_LOG_LINES][384];
+
+/* The decoder before the attribute index, built from git history with its symbols renamed */
+int json_base_read_object(struct json_buffer *, const struct json_attr_t *);
+
+static void
+decode_attrs(struct json_attr_t *attrs, struct decode_rng *r)
+{
+    struct json_attr_t tmpl[] = {
+        {.attribute = "utime", .type = t_uinteger, .addr.uinteger = &r->utime, .nodefault = true},
+        {.attribute = "seq", .type = t_uinteger, .addr.uinteger = &r->seq},
+        {.attribute = "uid", .type = t_uinteger, .addr.uinteger = &r->uid},
+        {.attribute = "ouid", .type = t_uinteger, .addr.uinteger = &r->ouid},
+        {.attribute = "raz", .type = t_array, .addr.array = {
+            .element_type = t_real, .arr.reals.store = r->raz, .maxlen = 3}},
+        {.attribute = "rssi", .type = t_array, .addr.array = {
+            .element_type = t_real, .arr.reals.store = r->rssi, .maxlen = 3}},
+        {.attribute = "los", .type = t_array, .addr.array = {
+            .element_type = t_real, .arr.reals.store = r->los, .maxlen = 3}},
+        {.attribute = "offset", .type = t_array, .addr.array = {
+            .element_type = t_integer, .arr.integers.store = r->offset, .maxlen = 4}},
+        {.attribute = "ppm", .type = t_real, .addr.real = &r->ppm},
+        {.attribute = "sts", .type = t_real, .addr.real = &r->sts},
+        {.attribute = NULL}
+    };
+    memcpy(attrs, tmpl, sizeof(tmpl));
+}
+
+/* Range, rssi and los of line l, element i, as a ranging session produces them */
+static dpl_float64_t
+decode_value(int a, int l, int i)
+{
+    switch (a) {
+    case 0:
+        /* Whole DTU times of flight in meters */
+        return (2000 + (l * 7919 + i * 104729) % 900) * 0.004691763978616;
+    case 1:
+        return (float)(-80.0 - ((l * 31 + i * 17) % 64) / 7.0);
+    default:
+        return (float)(0.5 + ((l * 13 + i * 5) % 16) / 32.0);
+    }
+}
+
+static void
+decode_log_fill(bool legacy)
+{
+    struct json_encoder encoder;
+    struct json_value value;
+    const char *arrays[] = {"raz", "rssi", "los"};
+    char *p;
+
+    memset(&encoder, 0, sizeof(encoder));
+    for (int l = 0; l < DECODE_LOG_LINES; l++) {
+        if (legacy) {
+            p = decode_log[l];
+            p += sprintf(p, "{\"utime\":%llu,\"seq\":%d,\"uid\":%d,\"ouid\":%d",
+                         1591714503113ULL + l * 10007ULL, l & 0xFF, 0x1234, 0x4321 + l);
+            for (int a = 0; a < 3; a++) {
+                p += sprintf(p, ",\"%s\":[%.3f,%.3f,%.3f]", arrays[a],
+                             decode_value(a, l, 0), decode_value(a, l, 1), decode_value(a, l, 2));
+            }
+            sprintf(p, ",\"offset\":[%d,%d,%d,%d],\"ppm\":%.3f}", (l - 16) * 1000,
+                    (l - 16) * 1000 + 1, (l - 16) * 1000 + 2, (l - 16) * 1000 + 3, -4.25 + l * 0.1171);
+            continue;
+        }
+        json_encode_buf_init(&encoder, decode_log[l], sizeof(decode_log[l]));
+        json_encode_object_start(&encoder);
+        JSON_VALUE_UINT(&value, 1591714503113ULL + l * 10007ULL);
+        json_encode_object_entry(&encoder, "utime", &value);
+        JSON_VALUE_UINT(&value, l & 0xFF);
+        json_encode_object_entry(&encoder, "seq", &value);
+        JSON_VALUE_UINT(&value, 0x1234);
+        json_encode_object_entry(&encoder, "uid", &value);
+        JSON_VALUE_UINT(&value, 0x4321 + l);
+        json_encode_object_entry(&encoder, "ouid", &value);
+        for (int a = 0; a < 3; a++) {
+            json_encode_array_name(&encoder, (char *) arrays[a]);
+            json_encode_array_start(&encoder);
+            for (int i = 0; i < 3; i++) {
+                if (a == 0) {
+                    JSON_VALUE_FLOAT64(&value, decode_value(a, l, i));
+                } else {
+                    JSON_VALUE_FLOAT32(&value, decode_value(a, l, i));
+                }
+                json_encode_array_value(&encoder, &value);
+            }
+            json_encode_array_finish(&encoder);
+        }
+        json_encode_array_name(&encoder, "offset");
+        json_encode_array_start(&encoder);
+        for (int i = 0; i < 4; i++) {
+            JSON_VALUE_INT(&value, (l - 16) * 1000 + i);
+            json_encode_array_value(&encoder, &value);
+        }
+        json_encode_array_finish(&encoder);
+        JSON_VALUE_FLOAT64(&value, -4.25 + l * 0.1171);
+        json_encode_object_entry(&encoder, "ppm", &value);
+        json_encode_object_finish(&encoder);
+        json_encode_buf_finish(&encoder);
+    }
+}
+
+static void
+decode_init(json_decoder_t *decoder, char *line)
+{
+    decoder->json_buf.jb_read_next = json_read_next;
+    decoder->json_buf.jb_read_prev = json_read_prev;
+    decoder->json_buf.jb_readn = json_readn;
+    decoder->start_buf = line;
+    decoder->end_buf = line + strlen(line);
+    decoder->current_position = 0;
+}
+
+static int
+decode_base(char *line, struct decode_rng *r)
+{
+    json_decoder_t decoder;
+    struct json_attr_t attrs[11];
+
+    decode_attrs(attrs, r);
+    decode_init(&decoder, line);
+    return json_base_read_object(&decoder.json_buf, attrs);
+}
+
+static int
+decode_linear(char *line, struct decode_rng *r)
+{
+    json_decoder_t decoder;
+    struct json_attr_t attrs[11];
+
+    decode_attrs(attrs, r);
+    decode_init(&decoder, line);
+    return json_read_object(&decoder.json_buf, attrs);
+}
+
+static int
+decode_indexed(char *line, struct decode_rng *r)
+{
+    static struct json_attr_index index;
+    json_decoder_t decoder;
+    struct json_attr_t attrs[11];
+
+    decode_attrs(attrs, r);
+    decode_init(&decoder, line);
+    return json_read_object_indexed(&decoder.json_buf, attrs, &index);
+}
+
+static uint64_t
+decode_time(int (*decode)(char *, struct decode_rng *), uint32_t rounds, int *errors)
+{
+    struct decode_rng r;
+    uint64_t t0 = now_ns();
+
+    for (uint32_t k = 0; k < rounds; k++) {
+        for (int l = 0; l < DECODE_LOG_LINES; l++) {
+            *errors += decode(decode_log[l], &r) != 0;
+        }
+    }
+    return now_ns() - t0;
+}
+
+static void
+bench_decode(uint32_t rounds, bool legacy)
+{
+    int errors = 0;
+
+    decode_log_fill(legacy);
+    uint64_t base = decode_time(decode_base, rounds, &errors);
+    uint64_t linear = decode_time(decode_linear, rounds, &errors);
+    uint64_t indexed = decode_time(decode_indexed, rounds, &errors);
+
+    printf("{\"bench\": \"json_decode\", \"format\": \"%s\", \"lines\": %llu, \"errors\": %d, "
+           "\"base_usec\": %llu, \"linear_usec\": %llu, \"indexed_usec\": %llu, \"speedup\": %.2f}\n",
+           (legacy) ? "legacy" : "current", (unsigned long long)rounds * DECODE_LOG_LINES, errors,
+           (unsigned long long)base / 1000, (unsigned long long)linear / 1000,
+           (unsigned long long)indexed / 1000, (double)base / indexed);
+}
+
+int
+main(int argc, char ** argv)
+{
+    uint32_t rounds = (argc > 1) ? strtoul(argv[1], NULL, 0) : 100000;
+
+    bench_encode(rounds);
+    bench_decode(rounds / 32 + 1, false);
+    bench_decode(rounds / 32 + 1, true);
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file panmaster_bench.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Host benchmark of the panmaster node index
+ *
+ * @details Times a join of every node at once, as after a site power cycle, then a
+ * renewal of every node with half of them late enough to lose their slot, on the
+ * hash, slot bitmap and lease wheel of panmaster_index.c. Build from the top of the
+ * tree, after a host build has generated syscfg.h, with:
+ *
+ *     cc -O2 -std=gnu99 -fms-extensions -DFLOAT_SUPPORT \
+ *        -I bin/targets/syscfg/generated/include -I porting/dpl/linux/include \
+ *        -I porting/dpl_os/include -I porting/dpl_hal/include -I porting/dpl_lib/include \
+ *        -I hw/drivers/uwb/include -I lib/pan_utils/include -I lib/panmaster/include \
+ *        -o panmaster_bench tools/uwb_bench/panmaster_bench.c lib/panmaster/src/panmaster_index.c
+ *
+ * Usage:
+ *
+ *     panmaster_bench [nodes]
+ *
+ * Prints one JSON line per table size, 256, 1024 and 4096 nodes unless given.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <panmaster/panmaster.h>
+#include <panmaster/panmaster_index.h>
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Join handling as done by panmaster_idx_find_node() and panrequest_cb() */
+static int
+bench_join(struct panm_index *idx, uint64_t euid, uint32_t now_ms, uint32_t lease_ms)
+{
+    int i = panm_index_find_euid(idx, euid);
+    if (i < 0) {
+        if ((i = panm_index_alloc(idx)) < 0) {
+            return -1;
+        }
+        idx->nodes[i].euid = euid;
+        idx->nodes[i].addr = panm_index_free_addr(idx, euid);
+        idx->nodes[i].role = 0;
+        idx->nodes[i].slot_id = 0xffff;
+        panm_index_insert(idx, i);
+    }
+    panm_index_slot_alloc(idx, i, now_ms);
+    panm_index_lease(idx, i, now_ms + lease_ms);
+    return i;
+}
+
+static int
+bench_index(uint16_t nnodes)
+{
+    struct panmaster_node_idx *nodes = calloc(nnodes, sizeof(*nodes));
+    uint16_t *buf16 = calloc(PANM_INDEX_U16(nnodes), sizeof(uint16_t));
+    uint32_t *buf32 = calloc(PANM_INDEX_U32(nnodes), sizeof(uint32_t));
+    struct panm_index idx;
+    uint32_t now_ms = 1000;
+    int i;
+
+    if (!nodes || !buf16 || !buf32) {
+        free(nodes);
+        free(buf16);
+        free(buf32);
+        return -1;
+    }
+    for (i = 0; i < nnodes; i++) {
+        PANMASTER_NODE_IDX_DEFAULT(nodes[i]);
+    }
+    panm_index_init(&idx, nodes, nnodes, buf16, buf32);
+
+    uint64_t t0 = now_ns();
+    for (i = 0; i < nnodes; i++) {
+        bench_join(&idx, 0x0123456700000000ULL + (uint64_t)i * 0x10001, now_ms, 30000);
+    }
+    uint64_t t1 = now_ns();
+
+    now_ms += 20000;
+    for (i = 0; i < nnodes; i++) {
+        bench_join(&idx, 0x0123456700000000ULL + (uint64_t)i * 0x10001, now_ms + 20000 * i / nnodes, 30000);
+    }
+    uint64_t t2 = now_ns();
+
+    printf("{\"bench\": \"panm_index\", \"nodes\": %u, \"join_usec\": %llu, \"renew_usec\": %llu, "
+           "\"joins_per_sec\": %llu}\n", nnodes, (unsigned long long)(t1 - t0) / 1000,
+           (unsigned long long)(t2 - t1) / 1000,
+           (unsigned long long)((t1 > t0) ? (uint64_t)nnodes * 1000000000ULL / (t1 - t0) : 0));
+    free(nodes);
+    free(buf16);
+    free(buf32);
+    return 0;
+}
+
+int
+main(int argc, char ** argv)
+{
+    static const uint16_t sizes[] = {256, 1024, 4096};
+    unsigned long nodes = (argc > 1) ? strtoul(argv[1], NULL, 0) : 0;
+
+    if (nodes) {
+        /* Table indices are 16bit, PANM_INDEX_NONE is reserved */
+        if (nodes >= PANM_INDEX_NONE) {
+            fprintf(stderr, "nodes must be below %u\n", PANM_INDEX_NONE);
+            return 1;
+        }
+        return bench_index(nodes) ? 1 : 0;
+    }
+    for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        if (bench_index(sizes[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
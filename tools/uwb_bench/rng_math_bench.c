@@ -0,0 +1,109 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file rng_math_bench.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Host benchmark of the range math
+ *
+ * @details Times calc_range_ss_batch() against the per frame path of calc_tof_ss()
+ * and uwb_rng_tof_to_meters() for nrng rounds of 8, 32 and 64 responders. Build from
+ * the top of the tree, after a host build has generated syscfg.h, with:
+ *
+ *     cc -O2 -std=gnu99 -fms-extensions -DFLOAT_SUPPORT \
+ *        -I bin/targets/syscfg/generated/include -I porting/dpl/linux/include \
+ *        -I porting/dpl_os/include -I porting/dpl_hal/include -I porting/dpl_lib/include \
+ *        -I hw/drivers/uwb/include -I lib/rng_math/include \
+ *        -o rng_math_bench tools/uwb_bench/rng_math_bench.c lib/rng_math/src/rng_math.c -lm
+ *
+ * Usage:
+ *
+ *     rng_math_bench [rounds]
+ *
+ * Prints one JSON line per round size.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <dpl/dpl.h>
+#include <rng_math/rng_math.h>
+
+#define BENCH_MAX_RESPONDERS (64)
+
+static uint32_t T1R[BENCH_MAX_RESPONDERS];
+static uint32_t T1r[BENCH_MAX_RESPONDERS];
+static float skew[BENCH_MAX_RESPONDERS];
+static float range[BENCH_MAX_RESPONDERS];
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Synthetic responders between 1m and ~64m with a few ppm of clock offset each */
+static void
+bench_fill(uint16_t n)
+{
+    for (uint16_t i = 0; i < n; i++) {
+        uint32_t tof = (uint32_t)((1.0 + i) / 0.00469030);
+        skew[i] = (float)((int16_t)(i * 37 % 21) - 10) * 1e-6f;
+        T1r[i] = 78593653 + i * 1003;
+        T1R[i] = (uint32_t)(T1r[i] * (1.0 - skew[i])) + 2 * tof;
+    }
+}
+
+int
+main(int argc, char ** argv)
+{
+    const uint16_t sizes[] = {8, 32, 64};
+    uint32_t rounds = (argc > 1) ? strtoul(argv[1], NULL, 0) : 100000;
+    volatile float sink = 0;
+
+    bench_fill(BENCH_MAX_RESPONDERS);
+    for (uint16_t k = 0; k < sizeof(sizes)/sizeof(sizes[0]); k++) {
+        uint16_t n = sizes[k];
+
+        uint64_t t0 = now_ns();
+        for (uint32_t r = 0; r < rounds; r++) {
+            calc_range_ss_batch(T1R, T1r, skew, range, n);
+            sink += range[n - 1];
+        }
+        uint64_t t1 = now_ns();
+        for (uint32_t r = 0; r < rounds; r++) {
+            for (uint16_t i = 0; i < n; i++) {
+                range[i] = uwb_rng_tof_to_meters(calc_tof_ss(T1R[i], 0, T1r[i], 0, skew[i]));
+            }
+            sink += range[n - 1];
+        }
+        uint64_t t2 = now_ns();
+
+        printf("{\"bench\": \"calc_range_ss_batch\", \"n\": %u, \"rounds\": %lu, \"batch_usec\": %llu, "
+               "\"scalar_usec\": %llu}\n", n, (unsigned long)rounds,
+               (unsigned long long)(t1 - t0) / 1000, (unsigned long long)(t2 - t1) / 1000);
+    }
+    (void)sink;
+    return 0;
+}
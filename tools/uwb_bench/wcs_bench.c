@@ -0,0 +1,126 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file wcs_bench.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Host benchmark of the wireless clock synchronisation transform
+ *
+ * @details Times uwb_wcs_local_to_master64() on the float path against the cached
+ * fixed point affine, and uwb_wcs_local_to_master64_array(), over 64 local stamps
+ * wrapping the 40bit boundary. uwb_wcs.c needs the uwb and dpl libraries, so build
+ * from the top of the tree after the generic host build (make -f Makefile.cmake
+ * generic && make -C build_generic) with:
+ *
+ *     cc -O2 -std=gnu99 -fms-extensions -DFLOAT_SUPPORT \
+ *        -I bin/targets/syscfg/generated/include -I porting/dpl/linux/include \
+ *        -I porting/dpl_os/include -I porting/dpl_hal/include -I porting/dpl_lib/include \
+ *        -I hw/drivers/uwb/include -I lib/uwb_ccp/include -I lib/uwb_wcs/include \
+ *        -o wcs_bench tools/uwb_bench/wcs_bench.c \
+ *        -Wl,--start-group $(find build_generic -name '*.a') -Wl,--end-group -lm -lpthread
+ *
+ * Usage:
+ *
+ *     wcs_bench [rounds]
+ *
+ * Prints one JSON line.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <dpl/dpl.h>
+#include <uwb_wcs/uwb_wcs.h>
+
+#define BENCH_NSTAMPS (64)
+
+static uint64_t local[BENCH_NSTAMPS];
+static uint64_t master[BENCH_NSTAMPS];
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* 12.5ppm skew with some drift, local stamps up to ~4s after the epoch */
+static void
+bench_setup(struct uwb_wcs_instance * wcs)
+{
+    memset(wcs, 0, sizeof(*wcs));
+    wcs->local_epoch.lo = 0xFFF0000000ULL;
+    wcs->master_epoch.timestamp = 0x0012340000001000ULL;
+    wcs->states.time = 4096.25;
+    wcs->states.skew = MYNEWT_VAL(UWB_WCS_DTU) * (1.0 + 12.5e-6);
+    wcs->states.drift = MYNEWT_VAL(UWB_WCS_DTU) * 2e-9;
+    wcs->status.valid = 1;
+    uwb_wcs_affine_update(wcs);
+
+    for (int i = 0; i < BENCH_NSTAMPS; i++) {
+        local[i] = (wcs->local_epoch.lo + (uint64_t)i * 4000000007ULL + i * i * 13) & 0xFFFFFFFFFFULL;
+    }
+}
+
+int
+main(int argc, char ** argv)
+{
+    struct uwb_wcs_instance wcs;
+    uint32_t rounds = (argc > 1) ? strtoul(argv[1], NULL, 0) : 100000;
+    volatile uint64_t sink = 0;
+
+    bench_setup(&wcs);
+    if (!wcs.affine.valid) {
+        fprintf(stderr, "affine transform not valid\n");
+        return 1;
+    }
+
+    uint64_t t0 = now_ns();
+    wcs.affine.valid = 0;
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (int i = 0; i < BENCH_NSTAMPS; i++) {
+            sink += uwb_wcs_local_to_master64(&wcs, local[i]);
+        }
+    }
+    wcs.affine.valid = 1;
+    uint64_t t1 = now_ns();
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (int i = 0; i < BENCH_NSTAMPS; i++) {
+            sink += uwb_wcs_local_to_master64(&wcs, local[i]);
+        }
+    }
+    uint64_t t2 = now_ns();
+    for (uint32_t r = 0; r < rounds; r++) {
+        uwb_wcs_local_to_master64_array(&wcs, local, master, BENCH_NSTAMPS);
+        sink += master[BENCH_NSTAMPS - 1];
+    }
+    uint64_t t3 = now_ns();
+
+    printf("{\"bench\": \"wcs_local_to_master64\", \"n\": %u, \"rounds\": %lu, \"float_usec\": %llu, "
+           "\"fixed_usec\": %llu, \"array_usec\": %llu}\n", BENCH_NSTAMPS, (unsigned long)rounds,
+           (unsigned long long)(t1 - t0) / 1000, (unsigned long long)(t2 - t1) / 1000,
+           (unsigned long long)(t3 - t2) / 1000);
+    (void)sink;
+    return 0;
+}
@@ -0,0 +1,1043 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file uwb_locate.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Gateway side position engine for many tags
+ *
+ * @details Reads the range and tdoa telemetry of all tags, binary records or JSON
+ * lines as written by the rng character device and by rtdoa tags built with
+ * RTDOA_TAG_TRACE, and solves a position per tag and measurement round with
+ * multilat_solve() or tdoa_solve(). The work is split in three stages connected
+ * by single producer, single consumer lock free rings:
+ *
+ *  - ingest, one thread, parses the stream and routes each report by a hash of the
+ *    tag address to a worker, so one tag is only ever handled by one worker;
+ *  - solve, one thread per worker, gathers the reports of each tag into rounds and
+ *    solves completed rounds in batches, starting from the tag's last position;
+ *  - output, one thread, writes one JSON line per position.
+ *
+ * A range round closes when a report arrives more than the window after its first
+ * one, a tdoa round when the request sequence number changes. Rounds left open are
+ * closed by a sweep once the stream has moved on by a window.
+ *
+ * Every stage exports its count, rate and latency percentiles as JSON lines on
+ * stderr, each interval and at the end. The latency of ingest is the parse time per
+ * record, of queue the time a report waits for its worker, of solve the time per
+ * solve and of output the time a position waits to be written.
+ *
+ * Build from the top of the tree with:
+ *
+ *     cc -O2 -std=gnu11 -pthread -fms-extensions -I hw/drivers/uwb/include -I lib/euclid/include \
+ *        -o uwb_locate tools/uwb_locate/uwb_locate.c lib/euclid/src/multilat.c \
+ *        lib/euclid/src/tdoa.c -lm
+ *
+ * Usage:
+ *
+ *     uwb_locate [-a anchors] [-w workers] [-d dim] [-W window] [-i interval] [-q] [file]
+ *     uwb_locate -S tags [-s seconds] [-m range|tdoa] [-w workers] [-q]
+ *
+ * The anchors file has one "uid x y z" line per anchor, uid in decimal or 0x hex. A
+ * range report is taken to be between the tag and whichever end is an anchor. -S runs
+ * the engine on a synthetic stream of that many tags at 10 Hz, ranging or receiving
+ * tdoa from their 6 nearest anchors with 5 cm of noise, for -s simulated seconds, and
+ * prints a bench line with the throughput and the horizontal and vertical position
+ * error. The synthetic anchors span 2.5 m in height against a 15 m grid, so the
+ * vertical error is several times the horizontal one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include <uwb/uwb_telemetry.h>
+#include <euclid/triad.h>
+#include <euclid/multilat.h>
+#include <euclid/tdoa.h>
+
+#define LOC_MAX_WORKERS     (64)
+#define LOC_MAX_ANCHORS     (4096)
+#define LOC_MAX_MEAS        (MULTILAT_MAX_MEAS)
+#define LOC_RING_SIZE       (16384)     //!< Reports or positions queued per worker, power of two
+#define LOC_BATCH           (256)       //!< Reports moved through a ring at a time
+#define LOC_SOLVE_BATCH     (64)        //!< Completed rounds solved back to back
+#define LOC_BUFSIZE         (65536)
+#define LOC_HIST_BINS       (48)        //!< Latency histogram, log2 of ns
+#define LOC_CACHELINE       (64)
+
+#define LOC_SYN_PERIOD      (100000)    //!< Synthetic round period, usec
+#define LOC_SYN_SPACING     (15.0)      //!< Synthetic anchor grid, m
+#define LOC_SYN_NEAREST     (6)         //!< Synthetic anchors heard per round
+#define LOC_SYN_NOISE       (0.05)      //!< Synthetic measurement noise, m
+#define LOC_SYN_TAG_BASE    (0x4000)
+
+enum loc_type {
+    LOC_RANGE = 0,
+    LOC_TDOA = 1
+};
+
+enum loc_stage_id {
+    LOC_STAGE_INGEST = 0,
+    LOC_STAGE_QUEUE,
+    LOC_STAGE_SOLVE,
+    LOC_STAGE_OUTPUT,
+    LOC_NSTAGES
+};
+
+static const char * const loc_stage_names[LOC_NSTAGES] = {"ingest", "queue", "solve", "output"};
+
+//! One measurement of one tag
+struct loc_report {
+    uint64_t utime;                 //!< Record time, usec
+    uint64_t t_queued;              //!< Monotonic ns when routed to the worker
+    uint16_t tag;
+    uint16_t anchor;
+    uint8_t type;                   //!< enum loc_type
+    uint8_t seq;
+    float value;                    //!< Range or tdoa, m
+};
+
+//! Measurements of one tag in one round
+struct loc_round {
+    uint64_t first_utime;
+    uint64_t utime;                 //!< Time of the latest measurement
+    uint64_t t_queued;              //!< Latest queue time of its reports
+    uint8_t type;
+    uint8_t seq;
+    uint8_t n;
+    uint16_t anchor[LOC_MAX_MEAS];
+    float value[LOC_MAX_MEAS];
+};
+
+struct loc_tag {
+    uint16_t uid;
+    uint8_t used;
+    uint8_t has_pos;
+    triad_t pos;                    //!< Last solved position, start point of the next solve
+    struct loc_round round;
+};
+
+struct loc_result {
+    uint64_t utime;
+    uint64_t t_solved;
+    uint16_t tag;
+    uint8_t type;
+    uint8_t n;
+    int8_t rc;
+    float pos[3];
+    float rms;
+    float dop;                      //!< gdop for tdoa, sqrt of the position variance trace per m of range noise otherwise
+};
+
+//! Single producer, single consumer ring of fixed size elements
+struct loc_ring {
+    _Atomic uint32_t head __attribute__((aligned(LOC_CACHELINE)));
+    uint32_t tail_cache;            //!< Producer's copy of tail
+    _Atomic uint32_t tail __attribute__((aligned(LOC_CACHELINE)));
+    uint32_t head_cache;            //!< Consumer's copy of head
+    uint32_t mask __attribute__((aligned(LOC_CACHELINE)));
+    uint32_t esize;
+    uint8_t * buf;
+};
+
+//! Counters of one stage in one thread, written by that thread only
+struct loc_stage {
+    _Atomic uint64_t count;
+    _Atomic uint64_t max_ns;
+    _Atomic uint64_t hist[LOC_HIST_BINS];
+} __attribute__((aligned(LOC_CACHELINE)));
+
+struct loc_worker {
+    pthread_t thread;
+    struct loc_engine * engine;
+    struct loc_ring in;
+    struct loc_ring out;
+    struct loc_tag * tags;
+    uint32_t tag_mask;
+    uint64_t latest_utime;
+    uint64_t swept_utime;
+    struct loc_tag * ready[LOC_SOLVE_BATCH];
+    struct loc_round rounds[LOC_SOLVE_BATCH];
+    uint16_t nready;
+    struct loc_stage stage[LOC_NSTAGES];
+    uint64_t dropped;               //!< Reports of tags the table had no room for
+};
+
+struct loc_engine {
+    tdoa_registry_t anchors;
+    tdoa_anchor_t anchor_storage[LOC_MAX_ANCHORS];
+    uint16_t nworkers;
+    uint8_t dim;
+    uint64_t window;                //!< usec
+    int quiet;
+    double interval;                //!< Metrics interval, s
+    struct loc_worker workers[LOC_MAX_WORKERS];
+    struct loc_stage ingest;
+    struct loc_stage output;
+    struct loc_report staged[LOC_MAX_WORKERS][LOC_BATCH];
+    uint16_t nstaged[LOC_MAX_WORKERS];
+    _Atomic int ingest_done;
+    _Atomic int workers_done;
+    uint64_t t_start;
+    uint64_t records;
+    uint64_t unrouted;              //!< Records without exactly one known anchor end
+    /* Synthetic stream */
+    uint32_t syn_ntags;
+    triad_t * syn_truth;
+    double err_xy;                  //!< Sums of squared position errors
+    double err_z;
+    double err_max;                 //!< Largest horizontal error
+    uint64_t err_n;
+};
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+stage_add(struct loc_stage * s, uint64_t ns)
+{
+    uint8_t bin = (ns == 0) ? 0 : 64 - __builtin_clzll(ns);
+
+    bin = (bin < LOC_HIST_BINS) ? bin : LOC_HIST_BINS - 1;
+    atomic_store_explicit(&s->count, atomic_load_explicit(&s->count, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    atomic_store_explicit(&s->hist[bin], atomic_load_explicit(&s->hist[bin], memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    if (ns > atomic_load_explicit(&s->max_ns, memory_order_relaxed)) {
+        atomic_store_explicit(&s->max_ns, ns, memory_order_relaxed);
+    }
+}
+
+static int
+ring_init(struct loc_ring * r, uint32_t size, uint32_t esize)
+{
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    r->tail_cache = r->head_cache = 0;
+    r->mask = size - 1;
+    r->esize = esize;
+    r->buf = aligned_alloc(LOC_CACHELINE, (size_t)size * esize);
+    return (r->buf) ? 0 : -1;
+}
+
+/* Producer side, returns the number of elements queued */
+static uint32_t
+ring_push(struct loc_ring * r, const void * src, uint32_t n)
+{
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t room = r->mask + 1 - (head - r->tail_cache);
+    uint32_t i;
+
+    if (room < n) {
+        r->tail_cache = atomic_load_explicit(&r->tail, memory_order_acquire);
+        room = r->mask + 1 - (head - r->tail_cache);
+    }
+    n = (n < room) ? n : room;
+    for (i = 0; i < n; i++) {
+        memcpy(r->buf + (size_t)((head + i) & r->mask) * r->esize, (const uint8_t *)src + (size_t)i * r->esize,
+               r->esize);
+    }
+    atomic_store_explicit(&r->head, head + n, memory_order_release);
+    return n;
+}
+
+/* Consumer side, returns the number of elements taken */
+static uint32_t
+ring_pop(struct loc_ring * r, void * dst, uint32_t max)
+{
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint32_t avail = r->head_cache - tail;
+    uint32_t i;
+
+    if (avail == 0) {
+        r->head_cache = atomic_load_explicit(&r->head, memory_order_acquire);
+        avail = r->head_cache - tail;
+    }
+    avail = (avail < max) ? avail : max;
+    for (i = 0; i < avail; i++) {
+        memcpy((uint8_t *)dst + (size_t)i * r->esize, r->buf + (size_t)((tail + i) & r->mask) * r->esize,
+               r->esize);
+    }
+    atomic_store_explicit(&r->tail, tail + avail, memory_order_release);
+    return avail;
+}
+
+/* Queue all n elements, waiting on the consumer when the ring is full */
+static void
+ring_push_all(struct loc_ring * r, const void * src, uint32_t n)
+{
+    uint32_t done = 0;
+
+    while (done < n) {
+        uint32_t k = ring_push(r, (const uint8_t *)src + (size_t)done * r->esize, n - done);
+        if (k == 0) {
+            sched_yield();
+        }
+        done += k;
+    }
+}
+
+static uint16_t
+route(const struct loc_engine * e, uint16_t tag)
+{
+    return ((tag * 0x9E3779B1u) >> 16) % e->nworkers;
+}
+
+/*
+ * Solve stage
+ */
+
+static struct loc_tag *
+tag_lookup(struct loc_worker * w, uint16_t uid)
+{
+    uint32_t i = (uid * 0x9E3779B1u) & w->tag_mask, k;
+
+    for (k = 0; k <= w->tag_mask; k++, i = (i + 1) & w->tag_mask) {
+        struct loc_tag * t = &w->tags[i];
+        if (!t->used) {
+            t->used = 1;
+            t->uid = uid;
+            return t;
+        }
+        if (t->uid == uid) {
+            return t;
+        }
+    }
+    return NULL;
+}
+
+static void
+solve_ready(struct loc_worker * w)
+{
+    const struct loc_engine * e = w->engine;
+    struct loc_result results[LOC_SOLVE_BATCH];
+    uint16_t i, j;
+
+    for (i = 0; i < w->nready; i++) {
+        struct loc_tag * t = w->ready[i];
+        struct loc_round * r = &w->rounds[i];
+        struct loc_result * res = &results[i];
+        uint64_t t0 = now_ns();
+        uint8_t n = 0;
+
+        res->utime = r->utime;
+        res->tag = t->uid;
+        res->type = r->type;
+        if (r->type == LOC_RANGE) {
+            multilat_meas_t meas[LOC_MAX_MEAS];
+            multilat_result_t out;
+            for (j = 0; j < r->n; j++) {
+                const triad_t * a = tdoa_registry_get(&e->anchors, r->anchor[j]);
+                meas[n].anchor = *a;
+                meas[n].range = r->value[j];
+                meas[n].variance = 0;
+                n++;
+            }
+            res->rc = multilat_solve(meas, n, e->dim, t->has_pos ? &t->pos : NULL, &out);
+            if (res->rc == 0) {
+                t->pos = out.pos;
+                res->rms = out.rms;
+                res->dop = sqrt((out.variance.x + out.variance.y + out.variance.z) / MULTILAT_DEFAULT_VARIANCE);
+            }
+        } else {
+            tdoa_meas_t meas[LOC_MAX_MEAS];
+            tdoa_result_t out;
+            for (j = 0; j < r->n; j++) {
+                const triad_t * a = tdoa_registry_get(&e->anchors, r->anchor[j]);
+                meas[n].anchor = *a;
+                meas[n].tdoa = r->value[j];
+                meas[n].variance = 0;
+                n++;
+            }
+            res->rc = tdoa_solve(meas, n, e->dim, t->has_pos ? &t->pos : NULL, &out);
+            if (res->rc == 0) {
+                t->pos = out.pos;
+                res->rms = out.rms;
+                res->dop = out.gdop;
+            }
+        }
+        if (res->rc == 0) {
+            t->has_pos = 1;
+            res->pos[0] = t->pos.x;
+            res->pos[1] = t->pos.y;
+            res->pos[2] = t->pos.z;
+        }
+        res->n = n;
+        res->t_solved = now_ns();
+        stage_add(&w->stage[LOC_STAGE_SOLVE], res->t_solved - t0);
+    }
+    ring_push_all(&w->out, results, w->nready);
+    w->nready = 0;
+}
+
+static void
+round_close(struct loc_worker * w, struct loc_tag * t)
+{
+    w->ready[w->nready] = t;
+    w->rounds[w->nready] = t->round;
+    w->nready++;
+    t->round.n = 0;
+    if (w->nready == LOC_SOLVE_BATCH) {
+        solve_ready(w);
+    }
+}
+
+/* Close the rounds the stream has left behind */
+static void
+round_sweep(struct loc_worker * w, int all)
+{
+    uint32_t i;
+
+    for (i = 0; i <= w->tag_mask; i++) {
+        struct loc_tag * t = &w->tags[i];
+        if (t->used && t->round.n &&
+            (all || t->round.first_utime + w->engine->window < w->latest_utime)) {
+            round_close(w, t);
+        }
+    }
+    w->swept_utime = w->latest_utime;
+}
+
+static void
+round_add(struct loc_worker * w, const struct loc_report * rep)
+{
+    struct loc_tag * t = tag_lookup(w, rep->tag);
+    struct loc_round * r;
+    uint8_t j;
+
+    if (t == NULL) {
+        w->dropped++;
+        return;
+    }
+    r = &t->round;
+    if (r->n && (rep->type != r->type ||
+                 (rep->type == LOC_TDOA && rep->seq != r->seq) ||
+                 (rep->type == LOC_RANGE && rep->utime > r->first_utime + w->engine->window))) {
+        round_close(w, t);
+    }
+    if (r->n == 0) {
+        r->first_utime = rep->utime;
+        r->type = rep->type;
+        r->seq = rep->seq;
+        r->t_queued = 0;
+    }
+    for (j = 0; j < r->n && r->anchor[j] != rep->anchor; j++);
+    r->anchor[j] = rep->anchor;
+    r->value[j] = rep->value;
+    r->n += (j == r->n);
+    r->utime = rep->utime;
+    r->t_queued = (rep->t_queued > r->t_queued) ? rep->t_queued : r->t_queued;
+    if (r->n == LOC_MAX_MEAS) {
+        round_close(w, t);
+    }
+    if (rep->utime > w->latest_utime) {
+        w->latest_utime = rep->utime;
+    }
+}
+
+static void *
+worker_main(void * arg)
+{
+    struct loc_worker * w = arg;
+    struct loc_report reports[LOC_BATCH];
+
+    for (;;) {
+        uint32_t n = ring_pop(&w->in, reports, LOC_BATCH), i;
+        if (n == 0) {
+            if (atomic_load_explicit(&w->engine->ingest_done, memory_order_acquire)) {
+                n = ring_pop(&w->in, reports, LOC_BATCH);
+                if (n == 0) {
+                    break;
+                }
+            } else {
+                sched_yield();
+                continue;
+            }
+        }
+        uint64_t t = now_ns();
+        for (i = 0; i < n; i++) {
+            stage_add(&w->stage[LOC_STAGE_QUEUE], t - reports[i].t_queued);
+            round_add(w, &reports[i]);
+        }
+        if (w->latest_utime > w->swept_utime + w->engine->window) {
+            round_sweep(w, 0);
+        }
+        if (w->nready) {
+            solve_ready(w);
+        }
+    }
+    round_sweep(w, 1);
+    if (w->nready) {
+        solve_ready(w);
+    }
+    atomic_fetch_add_explicit(&w->engine->workers_done, 1, memory_order_release);
+    return NULL;
+}
+
+/*
+ * Ingest stage
+ */
+
+static void
+ingest_flush(struct loc_engine * e, uint16_t k)
+{
+    uint64_t t = now_ns();
+    uint16_t i;
+
+    for (i = 0; i < e->nstaged[k]; i++) {
+        e->staged[k][i].t_queued = t;
+    }
+    ring_push_all(&e->workers[k].in, e->staged[k], e->nstaged[k]);
+    e->nstaged[k] = 0;
+}
+
+static void
+ingest_report(struct loc_engine * e, uint64_t utime, uint16_t uid, uint16_t ouid, uint8_t type, uint8_t seq,
+              float value)
+{
+    int uid_anchor = tdoa_registry_get(&e->anchors, uid) != NULL;
+    int ouid_anchor = tdoa_registry_get(&e->anchors, ouid) != NULL;
+    struct loc_report * rep;
+    uint16_t k;
+
+    e->records++;
+    if (isnan(value) || (type == LOC_TDOA && !ouid_anchor) || (type == LOC_RANGE && uid_anchor == ouid_anchor)) {
+        e->unrouted++;
+        return;
+    }
+    if (type == LOC_RANGE && uid_anchor) {
+        uint16_t tmp = uid;
+        uid = ouid;
+        ouid = tmp;
+    }
+    k = route(e, uid);
+    rep = &e->staged[k][e->nstaged[k]++];
+    rep->utime = utime;
+    rep->tag = uid;
+    rep->anchor = ouid;
+    rep->type = type;
+    rep->seq = seq;
+    rep->value = value;
+    if (e->nstaged[k] == LOC_BATCH) {
+        ingest_flush(e, k);
+    }
+}
+
+static float
+f32(uint32_t u)
+{
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static void
+ingest_record(struct loc_engine * e, const uint8_t * buf, size_t len)
+{
+    const uwb_telemetry_hdr_t * hdr = (const uwb_telemetry_hdr_t *) buf;
+
+    if (hdr->version != UWB_TELEMETRY_VERSION) {
+        return;
+    }
+    if (hdr->type == UWB_TELEMETRY_RNG && len >= sizeof(uwb_telemetry_rng_t)) {
+        const uwb_telemetry_rng_t * rec = (const uwb_telemetry_rng_t *) buf;
+        ingest_report(e, rec->utime, rec->uid, rec->ouid, LOC_RANGE, rec->seq, f32(rec->raz[0]));
+    } else if (hdr->type == UWB_TELEMETRY_TDOA && len >= sizeof(uwb_telemetry_tdoa_t)) {
+        const uwb_telemetry_tdoa_t * rec = (const uwb_telemetry_tdoa_t *) buf;
+        ingest_report(e, rec->utime, rec->uid, rec->ouid, LOC_TDOA, rec->seq, f32(rec->tdoa));
+    }
+}
+
+static const char *
+json_find(const char * line, const char * end, const char * key)
+{
+    size_t klen = strlen(key);
+    const char * p = line;
+
+    while ((p = memchr(p, '"', end - p)) != NULL && end - p > (ptrdiff_t)klen + 2) {
+        if (memcmp(p + 1, key, klen) == 0 && p[klen + 1] == '"') {
+            p += klen + 2;
+            while (p < end && (*p == ':' || *p == ' ' || *p == '[')) {
+                p++;
+            }
+            return p;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+/* Range and tdoa lines as written by rng_encode() and uwb_telemetry_decode, other lines are skipped */
+static void
+ingest_json(struct loc_engine * e, const char * line, const char * end)
+{
+    const char * utime = json_find(line, end, "utime");
+    const char * uid = json_find(line, end, "uid");
+    const char * ouid = json_find(line, end, "ouid");
+    const char * seq = json_find(line, end, "seq");
+    const char * raz = json_find(line, end, "raz");
+    const char * tdoa = json_find(line, end, "tdoa");
+
+    if (!utime || !uid || !ouid || !(raz || tdoa)) {
+        return;
+    }
+    ingest_report(e, strtoull(utime, NULL, 0), strtoul(uid, NULL, 0), strtoul(ouid, NULL, 0),
+                  (tdoa) ? LOC_TDOA : LOC_RANGE, (seq) ? strtoul(seq, NULL, 0) : 0,
+                  strtof((tdoa) ? tdoa : raz, NULL));
+}
+
+/* Parse the records in buf, returns the number of bytes consumed */
+static size_t
+ingest_parse(struct loc_engine * e, uint8_t * buf, size_t fill, int eof)
+{
+    uint64_t t0 = now_ns(), records = e->records;
+    size_t pos = 0;
+
+    while (pos < fill) {
+        if (buf[pos] == UWB_TELEMETRY_MAGIC) {
+            uint16_t len;
+            if (fill - pos < sizeof(uwb_telemetry_hdr_t)) {
+                break;
+            }
+            memcpy(&len, buf + pos + offsetof(uwb_telemetry_hdr_t, length), sizeof(len));
+            if (len < sizeof(uwb_telemetry_hdr_t)) {
+                pos++;
+                continue;
+            }
+            if (fill - pos < len) {
+                break;
+            }
+            ingest_record(e, buf + pos, len);
+            pos += len;
+        } else {
+            uint8_t * nl = memchr(buf + pos, '\n', fill - pos);
+            if (nl == NULL) {
+                if (eof || (pos == 0 && fill == LOC_BUFSIZE)) {
+                    pos = fill;
+                }
+                break;
+            }
+            ingest_json(e, (const char *)buf + pos, (const char *)nl);
+            pos = nl - buf + 1;
+        }
+    }
+    if (e->records > records) {
+        uint64_t per = (now_ns() - t0) / (e->records - records);
+        for (; records < e->records; records++) {
+            stage_add(&e->ingest, per);
+        }
+    }
+    return pos;
+}
+
+static void
+ingest_fd(struct loc_engine * e, int fd)
+{
+    static uint8_t buf[LOC_BUFSIZE];
+    size_t fill = 0, pos;
+    ssize_t n;
+
+    while ((n = read(fd, buf + fill, sizeof(buf) - fill)) > 0) {
+        fill += n;
+        pos = ingest_parse(e, buf, fill, 0);
+        memmove(buf, buf + pos, fill - pos);
+        fill -= pos;
+    }
+    ingest_parse(e, buf, fill, 1);
+}
+
+/*
+ * Synthetic stream
+ */
+
+static uint64_t syn_state = 0x853c49e6748fea9bULL;
+
+static double
+syn_uniform(void)
+{
+    syn_state ^= syn_state << 13;
+    syn_state ^= syn_state >> 7;
+    syn_state ^= syn_state << 17;
+    return (syn_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double
+syn_noise(double sigma)
+{
+    double s = 0;
+    for (int k = 0; k < 12; k++) {
+        s += syn_uniform();
+    }
+    return (s - 6) * sigma;
+}
+
+static void
+ingest_synthetic(struct loc_engine * e, double seconds, uint8_t type)
+{
+    uint32_t side = (uint32_t)ceil(sqrt(e->syn_ntags) * 3 / LOC_SYN_SPACING) + 1, i, k;
+    uint16_t (*nearest)[LOC_SYN_NEAREST] = calloc(e->syn_ntags, sizeof(*nearest));
+    uint8_t * buf = malloc(LOC_BUFSIZE);
+    uint64_t steps = (uint64_t)(seconds * 1e6 / LOC_SYN_PERIOD) * e->syn_ntags, s;
+    size_t fill = 0;
+
+    e->syn_truth = calloc(e->syn_ntags, sizeof(triad_t));
+    for (i = 0; i < side * side && i < LOC_MAX_ANCHORS; i++) {
+        triad_t a = {.x = (i % side) * LOC_SYN_SPACING, .y = (i / side) * LOC_SYN_SPACING,
+                     .z = 0.5 + 2.5 * ((i * 7) % 5) / 4.0};
+        tdoa_registry_set(&e->anchors, i + 1, &a);
+    }
+    for (i = 0; i < e->syn_ntags; i++) {
+        double best[LOC_SYN_NEAREST];
+        triad_t * t = &e->syn_truth[i];
+        t->x = syn_uniform() * (side - 1) * LOC_SYN_SPACING;
+        t->y = syn_uniform() * (side - 1) * LOC_SYN_SPACING;
+        t->z = 1 + syn_uniform();
+        for (k = 0; k < LOC_SYN_NEAREST; k++) {
+            best[k] = INFINITY;
+        }
+        for (k = 0; k < e->anchors.nanchors; k++) {
+            const triad_t * a = &e->anchors.anchors[k].pos;
+            double d = hypot(a->x - t->x, a->y - t->y);
+            int j = LOC_SYN_NEAREST - 1;
+            if (d >= best[j]) {
+                continue;
+            }
+            for (; j > 0 && best[j - 1] > d; j--) {
+                best[j] = best[j - 1];
+                nearest[i][j] = nearest[i][j - 1];
+            }
+            best[j] = d;
+            nearest[i][j] = e->anchors.anchors[k].uid;
+        }
+    }
+
+    /* Tags take turns through the period, each round is encoded and parsed like a live stream */
+    for (s = 0; s < steps; s++) {
+        uint32_t tag = s % e->syn_ntags;
+        uint64_t round = s / e->syn_ntags;
+        uint64_t utime = round * LOC_SYN_PERIOD + (uint64_t)tag * LOC_SYN_PERIOD / e->syn_ntags;
+        double offset = syn_uniform() * 1000;
+        const triad_t * t = &e->syn_truth[tag];
+
+        for (k = 0; k < LOC_SYN_NEAREST; k++) {
+            const triad_t * a = tdoa_registry_get(&e->anchors, nearest[tag][k]);
+            float value = sqrt((a->x - t->x) * (a->x - t->x) + (a->y - t->y) * (a->y - t->y) +
+                               (a->z - t->z) * (a->z - t->z)) + syn_noise(LOC_SYN_NOISE);
+            if (type == LOC_RANGE) {
+                uwb_telemetry_rng_t * rec = (uwb_telemetry_rng_t *)(buf + fill);
+                memset(rec, 0, sizeof(*rec));
+                uwb_telemetry_hdr_init(&rec->hdr, UWB_TELEMETRY_RNG, 0, sizeof(*rec));
+                rec->utime = utime + k * 500;
+                rec->uid = LOC_SYN_TAG_BASE + tag;
+                rec->ouid = nearest[tag][k];
+                rec->seq = round + k;
+                rec->raz[0] = uwb_telemetry_f32(&value);
+                fill += sizeof(*rec);
+            } else {
+                uwb_telemetry_tdoa_t * rec = (uwb_telemetry_tdoa_t *)(buf + fill);
+                memset(rec, 0, sizeof(*rec));
+                value += offset;
+                uwb_telemetry_hdr_init(&rec->hdr, UWB_TELEMETRY_TDOA, 0, sizeof(*rec));
+                rec->utime = utime + k * 500;
+                rec->uid = LOC_SYN_TAG_BASE + tag;
+                rec->ouid = nearest[tag][k];
+                rec->seq = round;
+                rec->tdoa = uwb_telemetry_f32(&value);
+                fill += sizeof(*rec);
+            }
+        }
+        if (fill > LOC_BUFSIZE - LOC_SYN_NEAREST * sizeof(uwb_telemetry_rng_t)) {
+            fill -= ingest_parse(e, buf, fill, 0);
+        }
+    }
+    ingest_parse(e, buf, fill, 1);
+    free(nearest);
+    free(buf);
+}
+
+/*
+ * Output stage and metrics
+ */
+
+static uint64_t
+hist_percentile(const uint64_t * hist, uint64_t count, double p)
+{
+    uint64_t target = (uint64_t)ceil(count * p), sum = 0;
+    uint8_t i;
+
+    for (i = 0; i < LOC_HIST_BINS; i++) {
+        sum += hist[i];
+        if (sum >= target && sum) {
+            return (i == 0) ? 0 : 1ULL << i;
+        }
+    }
+    return 0;
+}
+
+static void
+metrics_print(struct loc_engine * e)
+{
+    double elapsed = (now_ns() - e->t_start) * 1e-9;
+    uint8_t sid;
+    uint16_t k;
+
+    for (sid = 0; sid < LOC_NSTAGES; sid++) {
+        const struct loc_stage * parts[LOC_MAX_WORKERS];
+        uint64_t hist[LOC_HIST_BINS] = {0}, count = 0, max = 0;
+        uint16_t nparts = 0, p;
+        uint8_t i;
+
+        if (sid == LOC_STAGE_INGEST) {
+            parts[nparts++] = &e->ingest;
+        } else if (sid == LOC_STAGE_OUTPUT) {
+            parts[nparts++] = &e->output;
+        } else {
+            for (k = 0; k < e->nworkers; k++) {
+                parts[nparts++] = &e->workers[k].stage[sid];
+            }
+        }
+        for (p = 0; p < nparts; p++) {
+            uint64_t m = atomic_load_explicit(&parts[p]->max_ns, memory_order_relaxed);
+            count += atomic_load_explicit(&parts[p]->count, memory_order_relaxed);
+            max = (m > max) ? m : max;
+            for (i = 0; i < LOC_HIST_BINS; i++) {
+                hist[i] += atomic_load_explicit(&parts[p]->hist[i], memory_order_relaxed);
+            }
+        }
+        fprintf(stderr, "{\"elapsed\": %.3f,\"stage\": \"%s\",\"count\": %llu,\"rate\": %.0f,"
+                "\"p50_ns\": %llu,\"p99_ns\": %llu,\"max_ns\": %llu}\n",
+                elapsed, loc_stage_names[sid], (unsigned long long)count, elapsed > 0 ? count / elapsed : 0,
+                (unsigned long long)fmin(hist_percentile(hist, count, 0.5), max),
+                (unsigned long long)fmin(hist_percentile(hist, count, 0.99), max), (unsigned long long)max);
+    }
+}
+
+static void
+output_result(struct loc_engine * e, const struct loc_result * res)
+{
+    if (res->rc == 0 && e->syn_truth) {
+        const triad_t * t = &e->syn_truth[res->tag - LOC_SYN_TAG_BASE];
+        double err = (res->pos[0] - t->x) * (res->pos[0] - t->x) + (res->pos[1] - t->y) * (res->pos[1] - t->y);
+        e->err_xy += err;
+        e->err_z += (res->pos[2] - t->z) * (res->pos[2] - t->z);
+        e->err_max = fmax(e->err_max, sqrt(err));
+        e->err_n++;
+    }
+    if (e->quiet) {
+        return;
+    }
+    if (res->rc) {
+        printf("{\"utime\": %llu,\"uid\": %u,\"n\": %u,\"rc\": %d}\n",
+               (unsigned long long)res->utime, res->tag, res->n, res->rc);
+    } else {
+        printf("{\"utime\": %llu,\"uid\": %u,\"pos\": [%.3f,%.3f,%.3f],\"rms\": %.3f,\"dop\": %.2f,\"n\": %u}\n",
+               (unsigned long long)res->utime, res->tag, res->pos[0], res->pos[1], res->pos[2], res->rms,
+               res->dop, res->n);
+    }
+}
+
+static void *
+output_main(void * arg)
+{
+    struct loc_engine * e = arg;
+    struct loc_result results[LOC_BATCH];
+    uint64_t next = e->t_start + (uint64_t)(e->interval * 1e9);
+
+    for (;;) {
+        int done = atomic_load_explicit(&e->workers_done, memory_order_acquire) == e->nworkers;
+        uint32_t total = 0, n, i;
+        uint16_t k;
+
+        for (k = 0; k < e->nworkers; k++) {
+            while ((n = ring_pop(&e->workers[k].out, results, LOC_BATCH)) > 0) {
+                uint64_t t = now_ns();
+                for (i = 0; i < n; i++) {
+                    stage_add(&e->output, t - results[i].t_solved);
+                    output_result(e, &results[i]);
+                }
+                total += n;
+            }
+        }
+        if (e->interval > 0 && now_ns() > next) {
+            metrics_print(e);
+            next += (uint64_t)(e->interval * 1e9);
+        }
+        if (total == 0) {
+            if (done) {
+                break;
+            }
+            sched_yield();
+        }
+    }
+    fflush(stdout);
+    return NULL;
+}
+
+static int
+anchors_load(struct loc_engine * e, const char * path)
+{
+    FILE * f = fopen(path, "r");
+    char line[256];
+
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char * p = line;
+        triad_t pos = {0};
+        unsigned long uid = strtoul(p, &p, 0);
+        if (p == line || line[0] == '#') {
+            continue;
+        }
+        pos.x = strtod(p, &p);
+        pos.y = strtod(p, &p);
+        pos.z = strtod(p, &p);
+        if (tdoa_registry_set(&e->anchors, uid, &pos)) {
+            fprintf(stderr, "%s: more than %u anchors\n", path, LOC_MAX_ANCHORS);
+            break;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+int
+main(int argc, char ** argv)
+{
+    static struct loc_engine engine;
+    struct loc_engine * e = &engine;
+    const char * anchors = NULL;
+    pthread_t output;
+    double seconds = 5;
+    uint8_t type = LOC_RANGE;
+    uint64_t dropped = 0, solves = 0;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int fd = STDIN_FILENO;
+    int opt;
+    uint16_t k;
+
+    e->nworkers = (ncpu > 3) ? ncpu - 2 : 1;
+    e->dim = 3;
+    e->window = LOC_SYN_PERIOD / 2;
+    e->interval = 1;
+    tdoa_registry_init(&e->anchors, e->anchor_storage, LOC_MAX_ANCHORS);
+
+    while ((opt = getopt(argc, argv, "a:w:d:W:i:qS:s:m:")) != -1) {
+        switch (opt) {
+        case 'a': anchors = optarg; break;
+        case 'w': e->nworkers = atoi(optarg); break;
+        case 'd': e->dim = atoi(optarg); break;
+        case 'W': e->window = strtoull(optarg, NULL, 0); break;
+        case 'i': e->interval = atof(optarg); break;
+        case 'q': e->quiet = 1; break;
+        case 'S': e->syn_ntags = atoi(optarg); break;
+        case 's': seconds = atof(optarg); break;
+        case 'm': type = (strcmp(optarg, "tdoa") == 0) ? LOC_TDOA : LOC_RANGE; break;
+        default:
+            fprintf(stderr, "usage: %s [-a anchors] [-w workers] [-d dim] [-W window] [-i interval] [-q] [file]\n"
+                            "       %s -S tags [-s seconds] [-m range|tdoa] [-w workers] [-q]\n", argv[0], argv[0]);
+            return 1;
+        }
+    }
+    if (e->nworkers < 1 || e->nworkers > LOC_MAX_WORKERS || e->dim < 2 || e->dim > 3 ||
+        e->syn_ntags > 0xFFFF - LOC_SYN_TAG_BASE) {
+        fprintf(stderr, "bad arguments\n");
+        return 1;
+    }
+    if (anchors && anchors_load(e, anchors)) {
+        return 1;
+    }
+    if (!e->syn_ntags && optind < argc) {
+        fd = open(argv[optind], O_RDONLY);
+        if (fd < 0) {
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+
+    /* Each worker's table has room for twice its share of the 16 bit tag addresses */
+    uint32_t tag_size = 1024;
+    while (tag_size < 2 * 65536 / e->nworkers) {
+        tag_size <<= 1;
+    }
+    e->t_start = now_ns();
+    for (k = 0; k < e->nworkers; k++) {
+        struct loc_worker * w = &e->workers[k];
+        w->engine = e;
+        w->tag_mask = tag_size - 1;
+        w->tags = calloc(tag_size, sizeof(struct loc_tag));
+        if (!w->tags || ring_init(&w->in, LOC_RING_SIZE, sizeof(struct loc_report)) ||
+            ring_init(&w->out, LOC_RING_SIZE, sizeof(struct loc_result))) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        pthread_create(&w->thread, NULL, worker_main, w);
+    }
+    pthread_create(&output, NULL, output_main, e);
+
+    if (e->syn_ntags) {
+        ingest_synthetic(e, seconds, type);
+    } else {
+        ingest_fd(e, fd);
+    }
+    for (k = 0; k < e->nworkers; k++) {
+        ingest_flush(e, k);
+    }
+    atomic_store_explicit(&e->ingest_done, 1, memory_order_release);
+    for (k = 0; k < e->nworkers; k++) {
+        pthread_join(e->workers[k].thread, NULL);
+        dropped += e->workers[k].dropped;
+        solves += atomic_load(&e->workers[k].stage[LOC_STAGE_SOLVE].count);
+    }
+    pthread_join(output, NULL);
+    metrics_print(e);
+
+    double wall = (now_ns() - e->t_start) * 1e-9;
+    if (e->syn_ntags) {
+        printf("{\"bench\": \"uwb_locate\",\"mode\": \"%s\",\"tags\": %u,\"workers\": %u,\"records\": %llu,"
+               "\"solves\": %llu,\"wall_s\": %.3f,\"sim_s\": %.1f,\"solves_per_sec\": %.0f,\"realtime\": %.1f,"
+               "\"rmse_xy_m\": %.3f,\"rmse_z_m\": %.3f,\"max_err_xy_m\": %.3f}\n",
+               (type == LOC_TDOA) ? "tdoa" : "range", e->syn_ntags, e->nworkers,
+               (unsigned long long)e->records, (unsigned long long)solves, wall, seconds, solves / wall,
+               seconds / wall, e->err_n ? sqrt(e->err_xy / e->err_n) : 0,
+               (e->err_n && e->dim == 3) ? sqrt(e->err_z / e->err_n) : 0, e->err_max);
+    }
+    if (e->unrouted || dropped) {
+        fprintf(stderr, "{\"unrouted\": %llu,\"dropped\": %llu}\n",
+                (unsigned long long)e->unrouted, (unsigned long long)dropped);
+    }
+    return 0;
+}
@@ -0,0 +1,275 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file uwb_telemetry_decode.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Host side decoder for the binary telemetry records
+ *
+ * @details Reads a stream of records from a character device (or a capture of one)
+ * and prints one JSON line per record. JSON lines already present in the stream are
+ * passed through unchanged. Build with:
+ *
+ *     cc -O2 -I hw/drivers/uwb/include -o uwb_telemetry_decode tools/uwb_telemetry/uwb_telemetry_decode.c
+ *
+ * Usage:
+ *
+ *     uwb_telemetry_decode [-b] [file]
+ *
+ * -b switches the character device to binary output before reading. Without a file
+ * the stream is read from stdin.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <uwb/uwb_telemetry.h>
+
+#define DECODE_BUFSIZE (16384)
+
+static float
+f32(uint32_t u)
+{
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static double
+f64(uint64_t u)
+{
+    double f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static void
+decode_rng(const uwb_telemetry_rng_t * rec)
+{
+    printf("{\"utime\": %llu,\"seq\": %u,\"c\": %u,\"uid\": %u,\"ouid\": %u,\"raz\": [%f,%f,%f]",
+           (unsigned long long)rec->utime, rec->seq, rec->code, rec->uid, rec->ouid,
+           f32(rec->raz[0]), f32(rec->raz[1]), f32(rec->raz[2]));
+    if (rec->flags & UWB_TELEMETRY_RNG_HAS_REMOTE) {
+        printf(",\"braz\": [%f,%f,%f]", f32(rec->braz[0]), f32(rec->braz[1]), f32(rec->braz[2]));
+    }
+    if (rec->flags & UWB_TELEMETRY_RNG_HAS_DIAG) {
+        printf(",\"rssi\": [%f,%f,%f],\"los\": [%f]", f32(rec->rssi[0]), f32(rec->rssi[1]),
+               f32(rec->rssi[2]), f32(rec->los));
+    }
+    printf(",\"pd\": %f}\n", f32(rec->pdoa));
+}
+
+static void
+decode_ccp(const uwb_telemetry_ccp_t * rec)
+{
+    printf("{\"utime\": %llu,\"ccp\": [%llu,%llu],\"seq\": %u,\"ppm\": %f}\n",
+           (unsigned long long)rec->utime, (unsigned long long)rec->timestamp,
+           (unsigned long long)rec->delta, rec->seq, f32(rec->ppm));
+}
+
+static void
+decode_wcs(const uwb_telemetry_wcs_t * rec)
+{
+    printf("{\"utime\": %llu,\"wcs\": [%.17g,%.17g,%.17g],\"ppm\": %.17g}\n",
+           (unsigned long long)rec->utime, f64(rec->wcs[0]), f64(rec->wcs[1]),
+           f64(rec->wcs[2]), f64(rec->ppm));
+}
+
+static void
+decode_twr(const uwb_telemetry_twr_t * rec)
+{
+    printf("{\"utime\": %llu,\"twr\": [%u,%u,%u,%u,%u],\"ts\": [%u,%u,%u,%u,%u,%u,%u,%u],"
+           "\"ci\": %d,\"skew_ppt\": %lld}\n",
+           (unsigned long long)rec->utime, rec->code, rec->uid, rec->ouid, rec->seq, rec->flags,
+           rec->ts[0][0], rec->ts[0][1], rec->ts[0][2], rec->ts[0][3],
+           rec->ts[1][0], rec->ts[1][1], rec->ts[1][2], rec->ts[1][3],
+           rec->carrier_integrator, (long long)(f64(rec->skew) * 1e12));
+}
+
+static void
+decode_tdoa(const uwb_telemetry_tdoa_t * rec)
+{
+    printf("{\"utime\": %llu,\"seq\": %u,\"uid\": %u,\"ouid\": %u,\"tdoa\": %f}\n",
+           (unsigned long long)rec->utime, rec->seq, rec->uid, rec->ouid, f32(rec->tdoa));
+}
+
+static void
+decode_cir(const uwb_telemetry_cir_t * rec)
+{
+    uint16_t i;
+    printf("{\"utime\": %llu,\"cir_type\": \"%.*s\",\"raw_ts\": %llu,\"resam_dly\": %u,"
+           "\"fp_idx\": %f,\"fp_power\": %f,\"angle\": %f,\"acc_cnt\": %u",
+           (unsigned long long)rec->utime, (int)strnlen(rec->type, sizeof(rec->type)), rec->type,
+           (unsigned long long)rec->raw_ts, rec->resampler_delay, f32(rec->fp_idx),
+           f32(rec->fp_power), f32(rec->angle), rec->accumulator_count);
+    if (rec->cir_count) {
+        printf(",\"offset\": %u,\"real\": [", rec->cir_offset);
+        for (i = 0; i < rec->cir_count; i++) {
+            printf("%s%d", i ? "," : "", rec->samples[2*i]);
+        }
+        printf("],\"imag\": [");
+        for (i = 0; i < rec->cir_count; i++) {
+            printf("%s%d", i ? "," : "", rec->samples[2*i + 1]);
+        }
+        printf("]");
+    }
+    printf("}\n");
+}
+
+/**
+ * Decode one binary record.
+ *
+ * @return 0 on success, -1 if the record is malformed
+ */
+static int
+decode_record(const uint8_t * buf, size_t len)
+{
+    const uwb_telemetry_hdr_t * hdr = (const uwb_telemetry_hdr_t *) buf;
+
+    if (hdr->version != UWB_TELEMETRY_VERSION) {
+        fprintf(stderr, "unsupported schema version %u\n", hdr->version);
+        return -1;
+    }
+    switch (hdr->type) {
+    case UWB_TELEMETRY_RNG:
+        if (len < sizeof(uwb_telemetry_rng_t)) {
+            return -1;
+        }
+        decode_rng((const uwb_telemetry_rng_t *) buf);
+        break;
+    case UWB_TELEMETRY_CCP:
+        if (len < sizeof(uwb_telemetry_ccp_t)) {
+            return -1;
+        }
+        decode_ccp((const uwb_telemetry_ccp_t *) buf);
+        break;
+    case UWB_TELEMETRY_WCS:
+        if (len < sizeof(uwb_telemetry_wcs_t)) {
+            return -1;
+        }
+        decode_wcs((const uwb_telemetry_wcs_t *) buf);
+        break;
+    case UWB_TELEMETRY_CIR:
+        if (len < sizeof(uwb_telemetry_cir_t) ||
+            len < sizeof(uwb_telemetry_cir_t) +
+                  ((const uwb_telemetry_cir_t *) buf)->cir_count * 2 * sizeof(int32_t)) {
+            return -1;
+        }
+        decode_cir((const uwb_telemetry_cir_t *) buf);
+        break;
+    case UWB_TELEMETRY_TWR:
+        if (len < sizeof(uwb_telemetry_twr_t)) {
+            return -1;
+        }
+        decode_twr((const uwb_telemetry_twr_t *) buf);
+        break;
+    case UWB_TELEMETRY_TDOA:
+        if (len < sizeof(uwb_telemetry_tdoa_t)) {
+            return -1;
+        }
+        decode_tdoa((const uwb_telemetry_tdoa_t *) buf);
+        break;
+    default:
+        /* Unknown types are skipped so newer firmware can add records */
+        break;
+    }
+    return 0;
+}
+
+int
+main(int argc, char ** argv)
+{
+    static uint8_t buf[DECODE_BUFSIZE];
+    size_t fill = 0;
+    int set_binary = 0;
+    int fd = STDIN_FILENO;
+    ssize_t n;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b")) != -1) {
+        switch (opt) {
+        case 'b':
+            set_binary = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-b] [file]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind < argc) {
+        fd = open(argv[optind], O_RDONLY);
+        if (fd < 0) {
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+    if (set_binary) {
+        uint32_t format = UWB_TELEMETRY_FORMAT_BINARY;
+        if (ioctl(fd, UWB_TELEMETRY_IOC_SET_FORMAT, &format) < 0) {
+            perror("UWB_TELEMETRY_IOC_SET_FORMAT");
+            return 1;
+        }
+    }
+
+    while ((n = read(fd, buf + fill, sizeof(buf) - fill)) > 0) {
+        size_t pos = 0;
+        fill += n;
+        while (pos < fill) {
+            if (buf[pos] == UWB_TELEMETRY_MAGIC) {
+                uint16_t len;
+                if (fill - pos < sizeof(uwb_telemetry_hdr_t)) {
+                    break;
+                }
+                memcpy(&len, buf + pos + offsetof(uwb_telemetry_hdr_t, length), sizeof(len));
+                if (len < sizeof(uwb_telemetry_hdr_t) || len > sizeof(buf)) {
+                    /* Not a record, resynchronise on the next byte */
+                    pos++;
+                    continue;
+                }
+                if (fill - pos < len) {
+                    break;
+                }
+                if (decode_record(buf + pos, len)) {
+                    fprintf(stderr, "malformed record at offset %zu\n", pos);
+                }
+                pos += len;
+            } else {
+                /* JSON text, pass through up to and including the newline */
+                uint8_t * nl = memchr(buf + pos, '\n', fill - pos);
+                if (nl == NULL) {
+                    if (pos == 0 && fill == sizeof(buf)) {
+                        pos = fill;
+                    }
+                    break;
+                }
+                fwrite(buf + pos, 1, nl - buf + 1 - pos, stdout);
+                pos = nl - buf + 1;
+            }
+        }
+        memmove(buf, buf + pos, fill - pos);
+        fill -= pos;
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,284 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file uwb_trace_capture.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Build a replayable trace file from ccp and rng output
+ *
+ * @details Reads the ccp and rng character devices (binary telemetry or JSON lines), or
+ * a capture of them, or the console output of a Mynewt target, and appends the clock
+ * calibration packets and the raw two way range timestamps to a uwb_trace_hdr_t file.
+ * Ranges carry raw timestamps only with RNG_TRACE enabled. Other records and lines are
+ * skipped. Build with:
+ *
+ *     cc -O2 -I hw/drivers/uwb/include -o uwb_trace_capture tools/uwb_trace/uwb_trace_capture.c
+ *
+ * Usage:
+ *
+ *     uwb_trace_capture [-a] trace.bin [file ...]
+ *
+ * -a appends to an existing trace. Without files the stream is read from stdin. Stop a
+ * live capture with ctrl-c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <uwb/uwb_telemetry.h>
+#include <uwb/uwb_trace.h>
+
+#define CAPTURE_BUFSIZE (16384)
+
+static FILE * out;
+static uint64_t count;
+static volatile sig_atomic_t stop;
+
+static void
+on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static double
+f64(uint64_t u)
+{
+    double f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static uint64_t
+u64(double f)
+{
+    uint64_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static void
+emit(const uwb_trace_rec_t * rec)
+{
+    if (fwrite(rec, sizeof(*rec), 1, out) != 1) {
+        perror("write");
+        exit(1);
+    }
+    count++;
+}
+
+static void
+capture_record(const uint8_t * buf, size_t len)
+{
+    const uwb_telemetry_hdr_t * hdr = (const uwb_telemetry_hdr_t *) buf;
+    uwb_trace_rec_t rec = {.dev_idx = hdr->dev_idx};
+
+    if (hdr->version != UWB_TELEMETRY_VERSION) {
+        return;
+    }
+    if (hdr->type == UWB_TELEMETRY_CCP && len >= sizeof(uwb_telemetry_ccp_t)) {
+        const uwb_telemetry_ccp_t * ccp = (const uwb_telemetry_ccp_t *) buf;
+        float ppm;
+        memcpy(&ppm, &ccp->ppm, sizeof(ppm));
+        rec.type = UWB_TRACE_CCP;
+        rec.seq = ccp->seq;
+        rec.utime = ccp->utime;
+        rec.skew = u64(ppm * 1e-6);
+        rec.ccp.timestamp = ccp->timestamp;
+        rec.ccp.delta = ccp->delta;
+        emit(&rec);
+    } else if (hdr->type == UWB_TELEMETRY_TWR && len >= sizeof(uwb_telemetry_twr_t)) {
+        const uwb_telemetry_twr_t * twr = (const uwb_telemetry_twr_t *) buf;
+        rec.type = UWB_TRACE_TWR;
+        rec.seq = twr->seq;
+        rec.flags = twr->flags;
+        rec.uid = twr->uid;
+        rec.ouid = twr->ouid;
+        rec.code = twr->code;
+        rec.carrier_integrator = twr->carrier_integrator;
+        rec.utime = twr->utime;
+        rec.skew = twr->skew;
+        memcpy(rec.ts, twr->ts, sizeof(rec.ts));
+        emit(&rec);
+    }
+}
+
+/*
+ * The ccp JSON line carries the timestamps and the ppm as the bit patterns of doubles:
+ * {"utime": N,"ccp": [ts,delta],"seq": N,"ppm": N}
+ * The twr line is written by rng_encode with RNG_TRACE:
+ * {"utime": N,"twr": [code,uid,ouid,seq,flags],"ts": [8 x u32],"ci": N,"skew_ppt": N}
+ */
+static void
+capture_line(const char * line)
+{
+    unsigned long long utime, a, b, c;
+    unsigned int code, uid, ouid, seq, flags, ts[8];
+    long ci;
+    long long skew_ppt;
+    uwb_trace_rec_t rec = {0};
+
+    if (sscanf(line, "{\"utime\": %llu,\"ccp\": [%llu,%llu],\"seq\": %u,\"ppm\": %llu",
+               &utime, &a, &b, &seq, &c) == 5) {
+        rec.type = UWB_TRACE_CCP;
+        rec.seq = seq;
+        rec.utime = utime;
+        rec.skew = u64(f64(c) * 1e-6);
+        rec.ccp.timestamp = (uint64_t)f64(a);
+        rec.ccp.delta = (uint64_t)f64(b);
+        emit(&rec);
+    } else if (sscanf(line, "{\"utime\": %llu,\"twr\": [%u,%u,%u,%u,%u],\"ts\": [%u,%u,%u,%u,%u,%u,%u,%u],"
+                      "\"ci\": %ld,\"skew_ppt\": %lld", &utime, &code, &uid, &ouid, &seq, &flags,
+                      &ts[0], &ts[1], &ts[2], &ts[3], &ts[4], &ts[5], &ts[6], &ts[7],
+                      &ci, &skew_ppt) == 16) {
+        rec.type = UWB_TRACE_TWR;
+        rec.seq = seq;
+        rec.flags = flags;
+        rec.uid = uid;
+        rec.ouid = ouid;
+        rec.code = code;
+        rec.carrier_integrator = ci;
+        rec.utime = utime;
+        rec.skew = u64(skew_ppt * 1e-12);
+        memcpy(rec.ts, ts, sizeof(rec.ts));
+        emit(&rec);
+    }
+}
+
+static void
+capture_fd(int fd)
+{
+    static uint8_t buf[CAPTURE_BUFSIZE + 1];
+    size_t fill = 0;
+    ssize_t n;
+
+    while (!stop && (n = read(fd, buf + fill, CAPTURE_BUFSIZE - fill)) > 0) {
+        size_t pos = 0;
+        fill += n;
+        while (pos < fill) {
+            if (buf[pos] == UWB_TELEMETRY_MAGIC) {
+                uint16_t len;
+                if (fill - pos < sizeof(uwb_telemetry_hdr_t)) {
+                    break;
+                }
+                memcpy(&len, buf + pos + offsetof(uwb_telemetry_hdr_t, length), sizeof(len));
+                if (len < sizeof(uwb_telemetry_hdr_t) || len > CAPTURE_BUFSIZE) {
+                    pos++;
+                    continue;
+                }
+                if (fill - pos < len) {
+                    break;
+                }
+                capture_record(buf + pos, len);
+                pos += len;
+            } else {
+                uint8_t * nl = memchr(buf + pos, '\n', fill - pos);
+                if (nl == NULL) {
+                    if (pos == 0 && fill == CAPTURE_BUFSIZE) {
+                        pos = fill;
+                    }
+                    break;
+                }
+                *nl = '\0';
+                capture_line((const char *)buf + pos);
+                pos = nl - buf + 1;
+            }
+        }
+        memmove(buf, buf + pos, fill - pos);
+        fill -= pos;
+    }
+}
+
+int
+main(int argc, char ** argv)
+{
+    uwb_trace_hdr_t hdr = {
+        .magic = UWB_TRACE_MAGIC,
+        .version = UWB_TRACE_VERSION,
+        .hdr_size = sizeof(uwb_trace_hdr_t),
+        .rec_size = sizeof(uwb_trace_rec_t)
+    };
+    int append = 0;
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, "a")) != -1) {
+        switch (opt) {
+        case 'a':
+            append = 1;
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (optind >= argc) {
+        goto usage;
+    }
+
+    out = fopen(argv[optind], append ? "r+b" : "w+b");
+    if (out == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+    if (append) {
+        if (fread(&hdr, sizeof(hdr), 1, out) != 1 || memcmp(hdr.magic, UWB_TRACE_MAGIC, sizeof(hdr.magic)) ||
+            hdr.version != UWB_TRACE_VERSION || hdr.rec_size != sizeof(uwb_trace_rec_t)) {
+            fprintf(stderr, "%s: not a version %d trace\n", argv[optind], UWB_TRACE_VERSION);
+            return 1;
+        }
+        count = hdr.count;
+        fseek(out, hdr.hdr_size + count * hdr.rec_size, SEEK_SET);
+    } else {
+        fwrite(&hdr, sizeof(hdr), 1, out);
+    }
+
+    /* Reads from a character device only end on a signal, the header is still written */
+    struct sigaction sa = {.sa_handler = on_signal};
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (optind + 1 == argc) {
+        capture_fd(STDIN_FILENO);
+    }
+    for (i = optind + 1; i < argc && !stop; i++) {
+        int fd = open(argv[i], O_RDONLY);
+        if (fd < 0) {
+            perror(argv[i]);
+            return 1;
+        }
+        capture_fd(fd);
+        close(fd);
+    }
+
+    hdr.count = count;
+    fseek(out, 0, SEEK_SET);
+    fwrite(&hdr, sizeof(hdr), 1, out);
+    fclose(out);
+    fprintf(stderr, "%llu records\n", (unsigned long long)count);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-a] trace.bin [file ...]\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,333 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file uwb_trace_replay.c
+ * @author UWB Core <uwbcore@gmail.com>
+ * @date 2020
+ * @brief Replay a recorded trace through the clock sync and ranging math
+ *
+ * @details Memory maps a trace written by uwb_trace_capture and runs every record, as
+ * fast as possible, through the same library code the target uses: ccp frames through
+ * the wcs clock model filter (wcs_filter_update) and ranges through calc_tof_ss /
+ * calc_tof_ds and uwb_rng_tof_to_meters, dispatched on the frame code as
+ * uwb_rng_twr_to_tof does. Filter parameters are the syscfg values the tool is built
+ * with, so a parameter is tuned by rebuilding with e.g. -DMYNEWT_VAL_UWB_WCS_FILTER_SKEW_NOISE=50
+ * in front of the generated syscfg.h. Build from the top of the tree, after a host build
+ * has generated syscfg.h, with:
+ *
+ *     cc -O2 -std=gnu99 -fms-extensions -DFLOAT_SUPPORT \
+ *        -I bin/targets/syscfg/generated/include -I porting/dpl/linux/include \
+ *        -I porting/dpl_os/include -I porting/dpl_hal/include -I porting/dpl_lib/include \
+ *        -I hw/drivers/uwb/include -I lib/euclid/include -I lib/rng_math/include \
+ *        -I lib/uwb_ccp/include -I lib/uwb_wcs/include -I lib/json/include \
+ *        -o uwb_trace_replay tools/uwb_trace/uwb_trace_replay.c \
+ *        lib/uwb_wcs/src/wcs_filter.c lib/rng_math/src/rng_math.c -lm
+ *
+ * Usage:
+ *
+ *     uwb_trace_replay [-q] [-s] [-p period] trace.bin
+ *
+ * Prints one JSON line per record with the result and the processing time, then a
+ * summary line per device and per ranging pair. -q prints the summaries only. -s uses
+ * the carrier integrator skew for ranges even where the target had wcs compensate the
+ * timestamps. -p sets the ccp period in dwt usec, by default it is taken from the first
+ * ccp interval of each device.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <dpl/dpl.h>
+#include <uwb/uwb_ftypes.h>
+#include <uwb/uwb_trace.h>
+#include <uwb/uwb_telemetry.h>
+#include <uwb_wcs/wcs_filter.h>
+#include <rng_math/rng_math.h>
+
+#define REPLAY_NDEVS    (8)
+#define REPLAY_NPAIRS   (256)
+#define DTU_NS          (1e9 / (128 * 499.2e6))
+#define Q60             (1152921504606846976.0)
+
+//! Running mean and variance
+struct replay_stat {
+    uint64_t n;
+    double mean;
+    double m2;
+    double max;
+};
+
+struct replay_dev {
+    wcs_filter_t filter;
+    struct replay_stat sync_ns;             //!< Master time minus the one period prediction
+    struct replay_stat skew_ppb;            //!< Filter skew minus carrier integrator skew
+    struct replay_stat ccp_ns;              //!< Processing time per ccp frame
+    uint64_t restarts;
+};
+
+struct replay_pair {
+    uint16_t uid, ouid;
+    struct replay_stat range;               //!< Range, m
+    struct replay_stat twr_ns;              //!< Processing time per range
+};
+
+static struct replay_dev devs[REPLAY_NDEVS];
+static struct replay_pair pairs[REPLAY_NPAIRS];
+static int npairs;
+
+static void
+stat_add(struct replay_stat * s, double x)
+{
+    double d = x - s->mean;
+    s->n++;
+    s->mean += d / s->n;
+    s->m2 += d * (x - s->mean);
+    s->max = (s->n == 1 || fabs(x) > s->max) ? fabs(x) : s->max;
+}
+
+static double
+stat_std(const struct replay_stat * s)
+{
+    return (s->n > 1) ? sqrt(s->m2 / (s->n - 1)) : 0;
+}
+
+static double
+stat_rms(const struct replay_stat * s)
+{
+    return sqrt(s->mean * s->mean + ((s->n > 1) ? s->m2 / s->n : 0));
+}
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double
+f64(uint64_t u)
+{
+    double f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static struct replay_pair *
+pair_get(uint16_t uid, uint16_t ouid)
+{
+    int i;
+    for (i = 0; i < npairs; i++) {
+        if (pairs[i].uid == uid && pairs[i].ouid == ouid) {
+            return &pairs[i];
+        }
+    }
+    if (npairs == REPLAY_NPAIRS) {
+        return NULL;
+    }
+    pairs[npairs].uid = uid;
+    pairs[npairs].ouid = ouid;
+    return &pairs[npairs++];
+}
+
+static void
+replay_ccp(const uwb_trace_rec_t * rec, uint32_t period, int quiet)
+{
+    struct replay_dev * dev = &devs[rec->dev_idx % REPLAY_NDEVS];
+    double skew = f64(rec->skew);
+    uint64_t t0, t1;
+    int rc;
+
+    if (dev->filter.period == 0) {
+        if (period == 0) {
+            /* Nominal period from the first interval, rounded to a multiple of 0x100 usec */
+            period = (uint32_t)(((rec->ccp.delta >> 16) + 0x80) & ~0xFFULL);
+            if (period == 0) {
+                return;
+            }
+        }
+        wcs_filter_init(&dev->filter, period);
+    }
+
+    t0 = now_ns();
+    rc = wcs_filter_update(&dev->filter, rec->ccp.timestamp & 0x0FFFFFFFFFFULL, rec->ccp.delta,
+                           (int64_t)(skew * Q60));
+    t1 = now_ns();
+
+    stat_add(&dev->ccp_ns, t1 - t0);
+    if (rc) {
+        dev->restarts++;
+    } else {
+        stat_add(&dev->sync_ns, dev->filter.innovation / 65536.0 * DTU_NS);
+        stat_add(&dev->skew_ppb, (dev->filter.skew / Q60 - skew) * 1e9);
+    }
+    if (!quiet) {
+        printf("{\"utime\": %llu,\"dev\": %u,\"ccp\": %u,\"restart\": %d,\"sync_ns\": %.3f,"
+               "\"skew_ppm\": %.6f,\"skew_err_ppb\": %.3f,\"drift_ppb\": %.4f,\"proc_ns\": %llu}\n",
+               (unsigned long long)rec->utime, rec->dev_idx, rec->seq, rc,
+               dev->filter.innovation / 65536.0 * DTU_NS, dev->filter.skew / Q60 * 1e6,
+               (dev->filter.skew / Q60 - skew) * 1e9, dev->filter.drift / Q60 * 1e9,
+               (unsigned long long)(t1 - t0));
+    }
+}
+
+static void
+replay_twr(const uwb_trace_rec_t * rec, int carrier_skew, int quiet)
+{
+    struct replay_pair * pair = pair_get(rec->uid, rec->ouid);
+    const uint32_t * a = rec->ts[0];
+    const uint32_t * b = rec->ts[1];
+    dpl_float64_t skew, tof = 0, range;
+    uint64_t t0, t1;
+
+    skew = (rec->flags & UWB_TELEMETRY_TWR_WCS && !carrier_skew) ? 0 : f64(rec->skew);
+
+    t0 = now_ns();
+    switch(rec->code) {
+        case UWB_DATA_CODE_SS_TWR ... UWB_DATA_CODE_SS_TWR_END:
+        case UWB_DATA_CODE_SS_TWR_ACK ... UWB_DATA_CODE_SS_TWR_ACK_END:
+        case UWB_DATA_CODE_SS_TWR_EXT ... UWB_DATA_CODE_SS_TWR_EXT_END:
+            tof = calc_tof_ss(b[1], b[0], b[3], b[2], skew);
+            break;
+        case UWB_DATA_CODE_DS_TWR ... UWB_DATA_CODE_DS_TWR_END:
+        case UWB_DATA_CODE_DS_TWR_EXT ... UWB_DATA_CODE_DS_TWR_EXT_END:
+        case UWB_DATA_CODE_ADS_TWR ... UWB_DATA_CODE_ADS_TWR_END:
+            tof = calc_tof_ds(a[1], a[0], a[3], a[2], b[1], b[0], b[3], b[2]);
+            break;
+    }
+    range = uwb_rng_tof_to_meters(tof);
+    t1 = now_ns();
+
+    if (pair) {
+        stat_add(&pair->range, range);
+        stat_add(&pair->twr_ns, t1 - t0);
+    }
+    if (!quiet) {
+        printf("{\"utime\": %llu,\"dev\": %u,\"twr\": [%u,%u,%u],\"tof\": %.3f,\"range\": %.4f,\"proc_ns\": %llu}\n",
+               (unsigned long long)rec->utime, rec->dev_idx, rec->code, rec->uid, rec->ouid,
+               tof, range, (unsigned long long)(t1 - t0));
+    }
+}
+
+int
+main(int argc, char ** argv)
+{
+    const uwb_trace_hdr_t * hdr;
+    const uwb_trace_rec_t * rec;
+    struct stat st;
+    uint32_t period = 0;
+    int quiet = 0, carrier_skew = 0;
+    uint64_t i, t0, t1;
+    int opt, fd;
+
+    while ((opt = getopt(argc, argv, "qsp:")) != -1) {
+        switch (opt) {
+        case 'q':
+            quiet = 1;
+            break;
+        case 's':
+            carrier_skew = 1;
+            break;
+        case 'p':
+            period = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (optind >= argc) {
+        goto usage;
+    }
+
+    fd = open(argv[optind], O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(argv[optind]);
+        return 1;
+    }
+    if ((size_t)st.st_size < sizeof(uwb_trace_hdr_t)) {
+        fprintf(stderr, "%s: too short\n", argv[optind]);
+        return 1;
+    }
+    hdr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (hdr == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    if (memcmp(hdr->magic, UWB_TRACE_MAGIC, sizeof(hdr->magic)) || hdr->version != UWB_TRACE_VERSION ||
+        hdr->rec_size != sizeof(uwb_trace_rec_t) ||
+        hdr->hdr_size + hdr->count * hdr->rec_size > (uint64_t)st.st_size) {
+        fprintf(stderr, "%s: not a complete version %d trace\n", argv[optind], UWB_TRACE_VERSION);
+        return 1;
+    }
+    rec = (const uwb_trace_rec_t *)((const uint8_t *)hdr + hdr->hdr_size);
+
+    t0 = now_ns();
+    for (i = 0; i < hdr->count; i++) {
+        switch (rec[i].type) {
+        case UWB_TRACE_CCP:
+            replay_ccp(&rec[i], period, quiet);
+            break;
+        case UWB_TRACE_TWR:
+            replay_twr(&rec[i], carrier_skew, quiet);
+            break;
+        default:
+            break;
+        }
+    }
+    t1 = now_ns();
+
+    for (i = 0; i < REPLAY_NDEVS; i++) {
+        struct replay_dev * dev = &devs[i];
+        if (dev->ccp_ns.n == 0) {
+            continue;
+        }
+        printf("{\"summary\": \"ccp\",\"dev\": %u,\"frames\": %llu,\"restarts\": %llu,"
+               "\"sync_ns\": {\"rms\": %.3f,\"max\": %.3f},\"skew_err_ppb\": {\"rms\": %.3f,\"max\": %.3f},"
+               "\"proc_ns\": {\"mean\": %.1f,\"max\": %.0f}}\n",
+               (unsigned)i, (unsigned long long)dev->ccp_ns.n, (unsigned long long)dev->restarts,
+               stat_rms(&dev->sync_ns), dev->sync_ns.max, stat_rms(&dev->skew_ppb), dev->skew_ppb.max,
+               dev->ccp_ns.mean, dev->ccp_ns.max);
+    }
+    for (i = 0; i < (uint64_t)npairs; i++) {
+        struct replay_pair * pair = &pairs[i];
+        printf("{\"summary\": \"twr\",\"uid\": %u,\"ouid\": %u,\"ranges\": %llu,"
+               "\"range\": {\"mean\": %.4f,\"std\": %.4f},\"proc_ns\": {\"mean\": %.1f,\"max\": %.0f}}\n",
+               pair->uid, pair->ouid, (unsigned long long)pair->range.n,
+               pair->range.mean, stat_std(&pair->range), pair->twr_ns.mean, pair->twr_ns.max);
+    }
+    printf("{\"summary\": \"trace\",\"records\": %llu,\"total_ms\": %.3f}\n",
+           (unsigned long long)hdr->count, (t1 - t0) / 1e6);
+
+    munmap((void *)hdr, st.st_size);
+    close(fd);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-q] [-s] [-p period] trace.bin\n", argv[0]);
+    return 1;
+}